@@ -521,7 +521,7 @@ struct __DRIdamageExtensionRec {
  * SWRast Loader extension.
  */
 #define __DRI_SWRAST_LOADER "DRI_SWRastLoader"
-#define __DRI_SWRAST_LOADER_VERSION 3
+#define __DRI_SWRAST_LOADER_VERSION 4
 struct __DRIswrastLoaderExtensionRec {
     __DRIextension base;
 
@@ -563,6 +563,34 @@ struct __DRIswrastLoaderExtensionRec {
    void (*getImage2)(__DRIdrawable *readable,
 		     int x, int y, int width, int height, int stride,
 		     char *data, void *loaderPrivate);
+
+    /**
+     * Put image to drawable from a SysV shared memory segment the driver
+     * allocated and attached at shmaddr.  The image starts at shmaddr +
+     * offset.  Lets the loader hand the segment to the display server
+     * instead of sending the pixels.  May be NULL.
+     *
+     * \since 4
+     */
+    void (*putImageShm)(__DRIdrawable *drawable, int op,
+                        int x, int y, int width, int height, int stride,
+                        int shmid, char *shmaddr, unsigned offset,
+                        void *loaderPrivate);
+
+    /**
+     * Put the changed parts of an image to drawable as a single update.
+     * data points to the whole width x height image, and rects holds
+     * num_rects x, y, width, height quadruples, with the origin at the top
+     * left, covering everything that changed since the previous put.  For
+     * loaders that present every put on its own, so that several putImage2
+     * calls would show several frames.  May be NULL.
+     *
+     * \since 4
+     */
+    void (*putImageRects)(__DRIdrawable *drawable, int op,
+                          int width, int height, int stride, char *data,
+                          const int *rects, int num_rects,
+                          void *loaderPrivate);
 };
 
 /**
@@ -265,6 +265,14 @@ struct dri2_egl_surface
    int                    dy;
    struct wl_callback    *throttle_callback;
    int			  format;
+   /* swrast: damage passed to eglSwapBuffersWithDamage, while swapping */
+   const EGLint          *swap_rects;
+   EGLint                 swap_n_rects;
+   /* swrast: bounding box (x, y, width, height in buffer coordinates) of
+    * what each of the last commits changed, newest first.  A zero width
+    * stands for the whole surface.
+    */
+   int                    damage_history[4][4];
 #endif
 
 #ifdef HAVE_DRM_PLATFORM
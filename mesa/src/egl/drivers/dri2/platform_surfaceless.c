@@ -276,24 +276,14 @@ static const __DRIimageLoaderExtension image_loader_extension = {
 
 #define DRM_RENDER_DEV_NAME  "%s/renderD%d"
 
-EGLBoolean
-dri2_initialize_surfaceless(_EGLDriver *drv, _EGLDisplay *disp)
+static EGLBoolean
+surfaceless_probe_device(_EGLDisplay *disp)
 {
-   struct dri2_egl_display *dri2_dpy;
-   const char* err;
-   int i;
-   int driver_loaded = 0;
-
-   loader_set_logger(_eglLog);
-
-   dri2_dpy = calloc(1, sizeof *dri2_dpy);
-   if (!dri2_dpy)
-      return _eglError(EGL_BAD_ALLOC, "eglInitialize");
-
-   disp->DriverData = (void *) dri2_dpy;
-
+   struct dri2_egl_display *dri2_dpy = disp->DriverData;
    const int limit = 64;
    const int base = 128;
+   int i;
+
    for (i = 0; i < limit; ++i) {
       char *card_path;
       if (asprintf(&card_path, DRM_RENDER_DEV_NAME, DRM_DIR_NAME, base + i) < 0)
@@ -307,15 +297,61 @@ dri2_initialize_surfaceless(_EGLDriver *drv, _EGLDisplay *disp)
 
       dri2_dpy->driver_name = loader_get_driver_for_fd(dri2_dpy->fd, 0);
       if (dri2_dpy->driver_name) {
-         if (dri2_load_driver(disp)) {
-            driver_loaded = 1;
-            break;
-         }
+         if (dri2_load_driver(disp))
+            return EGL_TRUE;
          free(dri2_dpy->driver_name);
       }
       close(dri2_dpy->fd);
    }
 
+   return EGL_FALSE;
+}
+
+/* kms_swrast doesn't need a DRM device: without one, it allocates its
+ * buffers from memfds, which still export and import as fds.
+ */
+static EGLBoolean
+surfaceless_probe_device_sw(_EGLDisplay *disp)
+{
+   struct dri2_egl_display *dri2_dpy = disp->DriverData;
+
+   dri2_dpy->fd = -1;
+   dri2_dpy->driver_name = strdup("kms_swrast");
+   if (!dri2_dpy->driver_name)
+      return EGL_FALSE;
+
+   if (!dri2_load_driver(disp)) {
+      free(dri2_dpy->driver_name);
+      dri2_dpy->driver_name = NULL;
+      return EGL_FALSE;
+   }
+
+   return EGL_TRUE;
+}
+
+EGLBoolean
+dri2_initialize_surfaceless(_EGLDriver *drv, _EGLDisplay *disp)
+{
+   struct dri2_egl_display *dri2_dpy;
+   const char* err;
+   int driver_loaded = 0;
+
+   loader_set_logger(_eglLog);
+
+   dri2_dpy = calloc(1, sizeof *dri2_dpy);
+   if (!dri2_dpy)
+      return _eglError(EGL_BAD_ALLOC, "eglInitialize");
+
+   disp->DriverData = (void *) dri2_dpy;
+
+   if (!getenv("LIBGL_ALWAYS_SOFTWARE"))
+      driver_loaded = surfaceless_probe_device(disp);
+
+   if (!driver_loaded) {
+      _eglLog(_EGL_DEBUG, "Falling back to kms_swrast without a DRM device");
+      driver_loaded = surfaceless_probe_device_sw(disp);
+   }
+
    if (!driver_loaded) {
       err = "DRI2: failed to load driver";
       goto cleanup_display;
@@ -359,7 +395,8 @@ cleanup_screen:
 cleanup_driver:
    dlclose(dri2_dpy->driver);
    free(dri2_dpy->driver_name);
-   close(dri2_dpy->fd);
+   if (dri2_dpy->fd >= 0)
+      close(dri2_dpy->fd);
 cleanup_display:
    free(dri2_dpy);
    disp->DriverData = NULL;
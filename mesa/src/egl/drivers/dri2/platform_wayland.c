@@ -45,6 +45,9 @@
 #include <wayland-client.h>
 #include "wayland-drm-client-protocol.h"
 
+/* Free swrast buffers the compositor hasn't held for this many frames. */
+#define BUFFER_TRIM_AGE_HYSTERESIS 20
+
 enum wl_drm_format_flags {
    HAS_ARGB8888 = 1,
    HAS_XRGB8888 = 2,
@@ -289,6 +292,7 @@ dri2_wl_release_buffers(struct dri2_egl_surface *dri2_surf)
       dri2_surf->color_buffers[i].linear_copy = NULL;
       dri2_surf->color_buffers[i].data = NULL;
       dri2_surf->color_buffers[i].locked = 0;
+      dri2_surf->color_buffers[i].age = 0;
    }
 
    if (dri2_dpy->dri2) {
@@ -1435,12 +1439,16 @@ swrast_update_buffers(struct dri2_egl_surface *dri2_surf)
                                     dri2_dpy->wl_queue) == -1)
          return -1;
 
-   /* try get free buffer already created */
+   /* try get free buffer already created, preferring the one with the most
+    * recent contents as it needs the least copied into it */
    for (i = 0; i < ARRAY_SIZE(dri2_surf->color_buffers); i++) {
       if (!dri2_surf->color_buffers[i].locked &&
           dri2_surf->color_buffers[i].wl_buffer) {
-          dri2_surf->back = &dri2_surf->color_buffers[i];
-          break;
+         if (!dri2_surf->back ||
+             (dri2_surf->color_buffers[i].age > 0 &&
+              (dri2_surf->back->age == 0 ||
+               dri2_surf->color_buffers[i].age < dri2_surf->back->age)))
+            dri2_surf->back = &dri2_surf->color_buffers[i];
       }
    }
 
@@ -1459,6 +1467,7 @@ swrast_update_buffers(struct dri2_egl_surface *dri2_surf)
                 _eglError(EGL_BAD_ALLOC, "failed to allocate color buffer");
                  return -1;
              }
+             dri2_surf->back->age = 0;
              wl_proxy_set_queue((struct wl_proxy *) dri2_surf->back->wl_buffer,
                                 dri2_dpy->wl_queue);
              wl_buffer_add_listener(dri2_surf->back->wl_buffer,
@@ -1475,17 +1484,20 @@ swrast_update_buffers(struct dri2_egl_surface *dri2_surf)
 
    dri2_surf->back->locked = 1;
 
-   /* If we have an extra unlocked buffer at this point, we had to do triple
-    * buffering for a while, but now can go back to just double buffering.
-    * That means we can free any unlocked buffer now. */
+   /* If a buffer has stayed unlocked for a while, we had to do triple
+    * buffering at some point but are back to double buffering, so it can
+    * be freed.  Keeping it around for some frames avoids reallocating
+    * whenever the compositor holds on to a buffer a little longer. */
    for (i = 0; i < ARRAY_SIZE(dri2_surf->color_buffers); i++) {
       if (!dri2_surf->color_buffers[i].locked &&
-          dri2_surf->color_buffers[i].wl_buffer) {
+          dri2_surf->color_buffers[i].wl_buffer &&
+          dri2_surf->color_buffers[i].age > BUFFER_TRIM_AGE_HYSTERESIS) {
          wl_buffer_destroy(dri2_surf->color_buffers[i].wl_buffer);
          munmap(dri2_surf->color_buffers[i].data,
                 dri2_surf->color_buffers[i].data_size);
          dri2_surf->color_buffers[i].wl_buffer = NULL;
          dri2_surf->color_buffers[i].data = NULL;
+         dri2_surf->color_buffers[i].age = 0;
       }
    }
 
@@ -1509,10 +1521,94 @@ dri2_wl_swrast_get_backbuffer_data(struct dri2_egl_surface *dri2_surf)
    return dri2_surf->back->data;
 }
 
+/**
+ * Bounding box, in buffer coordinates, of the damage passed to the swap in
+ * progress.  Returns EGL_FALSE if it's the whole surface.
+ */
+static EGLBoolean
+swrast_swap_damage(struct dri2_egl_surface *dri2_surf, int box[4])
+{
+   int x0 = INT_MAX, y0 = INT_MAX, x1 = 0, y1 = 0;
+   int i;
+
+   if (!dri2_surf->swap_n_rects)
+      return EGL_FALSE;
+
+   for (i = 0; i < dri2_surf->swap_n_rects; i++) {
+      const EGLint *rect = &dri2_surf->swap_rects[i * 4];
+      /* EGL rects have their origin at the bottom left */
+      int top = dri2_surf->base.Height - rect[1] - rect[3];
+
+      x0 = MIN2(x0, rect[0]);
+      y0 = MIN2(y0, top);
+      x1 = MAX2(x1, rect[0] + rect[2]);
+      y1 = MAX2(y1, top + rect[3]);
+   }
+
+   x0 = MAX2(x0, 0);
+   y0 = MAX2(y0, 0);
+   x1 = MIN2(x1, dri2_surf->base.Width);
+   y1 = MIN2(y1, dri2_surf->base.Height);
+
+   if (x1 <= x0 || y1 <= y0)
+      return EGL_FALSE;
+
+   box[0] = x0;
+   box[1] = y0;
+   box[2] = x1 - x0;
+   box[3] = y1 - y0;
+   return EGL_TRUE;
+}
+
+/**
+ * Extend box by what the last n commits changed.  Returns EGL_FALSE if that
+ * covers the whole surface or isn't known.
+ */
+static EGLBoolean
+swrast_add_damage_history(struct dri2_egl_surface *dri2_surf, int n,
+                          int box[4])
+{
+   int i;
+
+   if (n > (int) ARRAY_SIZE(dri2_surf->damage_history))
+      return EGL_FALSE;
+
+   for (i = 0; i < n; i++) {
+      const int *prev = dri2_surf->damage_history[i];
+      int x1, y1;
+
+      if (prev[2] == 0)
+         return EGL_FALSE;
+
+      x1 = MAX2(box[0] + box[2], prev[0] + prev[2]);
+      y1 = MAX2(box[1] + box[3], prev[1] + prev[3]);
+      box[0] = MIN2(box[0], prev[0]);
+      box[1] = MIN2(box[1], prev[1]);
+      box[2] = x1 - box[0];
+      box[3] = y1 - box[1];
+   }
+
+   return EGL_TRUE;
+}
+
 static void
-dri2_wl_swrast_commit_backbuffer(struct dri2_egl_surface *dri2_surf)
+dri2_wl_swrast_commit_backbuffer(struct dri2_egl_surface *dri2_surf,
+                                 const int damage[4])
 {
    struct dri2_egl_display *dri2_dpy = dri2_egl_display(dri2_surf->base.Resource.Display);
+   EGLBoolean damaged = EGL_FALSE;
+   int i;
+
+   for (i = 0; i < ARRAY_SIZE(dri2_surf->color_buffers); i++)
+      if (dri2_surf->color_buffers[i].age > 0)
+         dri2_surf->color_buffers[i].age++;
+   dri2_surf->back->age = 1;
+
+   memmove(&dri2_surf->damage_history[1], &dri2_surf->damage_history[0],
+           sizeof(dri2_surf->damage_history) -
+           sizeof(dri2_surf->damage_history[0]));
+   memcpy(dri2_surf->damage_history[0], damage,
+          sizeof(dri2_surf->damage_history[0]));
 
    if (dri2_surf->base.SwapInterval > 0) {
       dri2_surf->throttle_callback =
@@ -1536,8 +1632,23 @@ dri2_wl_swrast_commit_backbuffer(struct dri2_egl_surface *dri2_surf)
    dri2_surf->dx = 0;
    dri2_surf->dy = 0;
 
-   wl_surface_damage(dri2_surf->wl_win->surface,
-                     0, 0, INT32_MAX, INT32_MAX);
+   /* As in dri2_wl_swap_buffers_with_damage(), only pass on the damage
+    * if the compositor takes it in buffer coordinates.  The application's
+    * damage wins over what the driver reported. */
+   if (dri2_surf->swap_n_rects) {
+      damaged = try_damage_buffer(dri2_surf, dri2_surf->swap_rects,
+                                  dri2_surf->swap_n_rects);
+   } else if (damage[2] > 0) {
+      /* EGL rects have their origin at the bottom left */
+      const EGLint rect[4] = {
+         damage[0], dri2_surf->base.Height - damage[1] - damage[3],
+         damage[2], damage[3]
+      };
+      damaged = try_damage_buffer(dri2_surf, rect, 1);
+   }
+   if (!damaged)
+      wl_surface_damage(dri2_surf->wl_win->surface,
+                        0, 0, INT32_MAX, INT32_MAX);
    wl_surface_commit(dri2_surf->wl_win->surface);
 
    /* If we're not waiting for a frame callback then we'll at least throttle
@@ -1570,20 +1681,20 @@ dri2_wl_swrast_get_drawable_info(__DRIdrawable * draw,
 }
 
 static void
-dri2_wl_swrast_get_image(__DRIdrawable * read,
-                         int x, int y, int w, int h,
-                         char *data, void *loaderPrivate)
+dri2_wl_swrast_get_image2(__DRIdrawable * read,
+                          int x, int y, int w, int h, int stride,
+                          char *data, void *loaderPrivate)
 {
    struct dri2_egl_surface *dri2_surf = loaderPrivate;
    int copy_width = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, w);
    int x_offset = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, x);
    int src_stride = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, dri2_surf->base.Width);
-   int dst_stride = copy_width;
+   int dst_stride = stride;
    char *src, *dst;
 
    src = dri2_wl_swrast_get_frontbuffer_data(dri2_surf);
    if (!src) {
-      memset(data, 0, copy_width * h);
+      memset(data, 0, stride * h);
       return;
    }
 
@@ -1606,6 +1717,79 @@ dri2_wl_swrast_get_image(__DRIdrawable * read,
    }
 }
 
+static void
+dri2_wl_swrast_get_image(__DRIdrawable * read,
+                         int x, int y, int w, int h,
+                         char *data, void *loaderPrivate)
+{
+   struct dri2_egl_surface *dri2_surf = loaderPrivate;
+   int stride = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, w);
+
+   dri2_wl_swrast_get_image2(read, x, y, w, h, stride, data, loaderPrivate);
+}
+
+/**
+ * Copy rect (x, y, width, height) of an image starting at src to the same
+ * place in the back buffer, clipped to the surface.
+ */
+static void
+swrast_copy_rect(struct dri2_egl_surface *dri2_surf,
+                 const char *src, int src_stride, const int rect[4])
+{
+   int dst_stride = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, dri2_surf->base.Width);
+   int x0 = MAX2(rect[0], 0);
+   int y0 = MAX2(rect[1], 0);
+   int x1 = MIN2(rect[0] + rect[2], dri2_surf->base.Width);
+   int y1 = MIN2(rect[1] + rect[3], dri2_surf->base.Height);
+   int x_offset, copy_width;
+   char *dst;
+
+   if (x1 <= x0 || y1 <= y0)
+      return;
+
+   x_offset = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, x0);
+   copy_width = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, x1 - x0);
+   dst = dri2_wl_swrast_get_backbuffer_data(dri2_surf);
+   dst += y0 * dst_stride + x_offset;
+   src += y0 * src_stride + x_offset;
+
+   for (; y0 < y1; y0++) {
+      memcpy(dst, src, copy_width);
+      src += src_stride;
+      dst += dst_stride;
+   }
+}
+
+/**
+ * Bring the back buffer up to date with the frame being shown, ahead of a
+ * partial update.
+ */
+static void
+swrast_restore_backbuffer(__DRIdrawable *draw,
+                          struct dri2_egl_surface *dri2_surf)
+{
+   int stride = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, dri2_surf->base.Width);
+   char *front = dri2_wl_swrast_get_frontbuffer_data(dri2_surf);
+   int box[4];
+
+   if (dri2_surf->back->age == 1)
+      return;
+
+   /* The buffer holds the frame from age commits ago, so only what changed
+    * since has to be copied */
+   memcpy(box, dri2_surf->damage_history[0], sizeof(box));
+   if (front && dri2_surf->back->age > 1 &&
+       swrast_add_damage_history(dri2_surf, dri2_surf->back->age - 1, box)) {
+      swrast_copy_rect(dri2_surf, front, stride, box);
+      return;
+   }
+
+   dri2_wl_swrast_get_image(draw, 0, 0,
+                            dri2_surf->base.Width, dri2_surf->base.Height,
+                            dri2_wl_swrast_get_backbuffer_data(dri2_surf),
+                            dri2_surf);
+}
+
 static void
 dri2_wl_swrast_put_image2(__DRIdrawable * draw, int op,
                          int x, int y, int w, int h, int stride,
@@ -1614,7 +1798,9 @@ dri2_wl_swrast_put_image2(__DRIdrawable * draw, int op,
    struct dri2_egl_surface *dri2_surf = loaderPrivate;
    int copy_width = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, w);
    int dst_stride = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, dri2_surf->base.Width);
-   int x_offset = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, x);
+   int x_offset;
+   int damage[4] = { 0, 0, 0, 0 };
+   int box[4];
    char *src, *dst;
 
    assert(copy_width <= stride);
@@ -1622,12 +1808,33 @@ dri2_wl_swrast_put_image2(__DRIdrawable * draw, int op,
    (void) swrast_update_buffers(dri2_surf);
    dst = dri2_wl_swrast_get_backbuffer_data(dri2_surf);
 
-   /* partial copy, copy old content */
-   if (copy_width < dst_stride)
-      dri2_wl_swrast_get_image(draw, 0, 0,
-                               dri2_surf->base.Width, dri2_surf->base.Height,
-                               dst, loaderPrivate);
+   if (x > 0 || y > 0 ||
+       w < dri2_surf->base.Width || h < dri2_surf->base.Height) {
+      /* partial copy, the rest of the buffer must hold the last frame */
+      swrast_restore_backbuffer(draw, dri2_surf);
+      damage[0] = x;
+      damage[1] = y;
+      damage[2] = MIN2(w, dri2_surf->base.Width - x);
+      damage[3] = MIN2(h, dri2_surf->base.Height - y);
+   } else if (swrast_swap_damage(dri2_surf, damage) &&
+              dri2_surf->back->age > 0) {
+      /* The buffer holds the frame from age swaps ago, so only what changed
+       * since then has to be copied */
+      memcpy(box, damage, sizeof(box));
+      if (swrast_add_damage_history(dri2_surf, dri2_surf->back->age - 1,
+                                    box)) {
+         data += (box[1] - y) * stride +
+                 dri2_wl_swrast_get_stride_for_format(dri2_surf->format,
+                                                      box[0] - x);
+         x = box[0];
+         y = box[1];
+         h = box[3];
+         copy_width = dri2_wl_swrast_get_stride_for_format(dri2_surf->format,
+                                                           box[2]);
+      }
+   }
 
+   x_offset = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, x);
    dst += x_offset;
    dst += y * dst_stride;
 
@@ -1644,7 +1851,7 @@ dri2_wl_swrast_put_image2(__DRIdrawable * draw, int op,
       src += stride;
       dst += dst_stride;
    }
-   dri2_wl_swrast_commit_backbuffer(dri2_surf);
+   dri2_wl_swrast_commit_backbuffer(dri2_surf, damage);
 }
 
 static void
@@ -1660,6 +1867,52 @@ dri2_wl_swrast_put_image(__DRIdrawable * draw, int op,
                              stride, data, loaderPrivate);
 }
 
+static void
+dri2_wl_swrast_put_image_rects(__DRIdrawable * draw, int op,
+                               int w, int h, int stride, char *data,
+                               const int *rects, int num_rects,
+                               void *loaderPrivate)
+{
+   struct dri2_egl_surface *dri2_surf = loaderPrivate;
+   int x0 = INT_MAX, y0 = INT_MAX, x1 = 0, y1 = 0;
+   int damage[4];
+   int i;
+
+   for (i = 0; i < num_rects; i++) {
+      const int *rect = &rects[i * 4];
+
+      x0 = MIN2(x0, rect[0]);
+      y0 = MIN2(y0, rect[1]);
+      x1 = MAX2(x1, rect[0] + rect[2]);
+      y1 = MAX2(y1, rect[1] + rect[3]);
+   }
+
+   x0 = MAX2(x0, 0);
+   y0 = MAX2(y0, 0);
+   x1 = MIN2(x1, dri2_surf->base.Width);
+   y1 = MIN2(y1, dri2_surf->base.Height);
+
+   if (x1 <= x0 || y1 <= y0) {
+      dri2_wl_swrast_put_image2(draw, op, 0, 0, w, h, stride, data,
+                                loaderPrivate);
+      return;
+   }
+
+   /* Every put is committed as a frame of its own, so all the rectangles
+    * go out together, damaging their bounding box.
+    */
+   (void) swrast_update_buffers(dri2_surf);
+   swrast_restore_backbuffer(draw, dri2_surf);
+   for (i = 0; i < num_rects; i++)
+      swrast_copy_rect(dri2_surf, data, stride, &rects[i * 4]);
+
+   damage[0] = x0;
+   damage[1] = y0;
+   damage[2] = x1 - x0;
+   damage[3] = y1 - y0;
+   dri2_wl_swrast_commit_backbuffer(dri2_surf, damage);
+}
+
 /**
  * Called via eglCreateWindowSurface(), drv->API.CreateWindowSurface().
  */
@@ -1722,15 +1975,28 @@ dri2_wl_swrast_create_window_surface(_EGLDriver *drv, _EGLDisplay *disp,
 }
 
 static EGLBoolean
-dri2_wl_swrast_swap_buffers(_EGLDriver *drv, _EGLDisplay *disp, _EGLSurface *draw)
+dri2_wl_swrast_swap_buffers_with_damage(_EGLDriver *drv, _EGLDisplay *disp,
+                                        _EGLSurface *draw,
+                                        const EGLint *rects, EGLint n_rects)
 {
    struct dri2_egl_display *dri2_dpy = dri2_egl_display(disp);
    struct dri2_egl_surface *dri2_surf = dri2_egl_surface(draw);
 
+   /* picked up by put_image2 and commit_backbuffer */
+   dri2_surf->swap_rects = rects;
+   dri2_surf->swap_n_rects = n_rects;
    dri2_dpy->core->swapBuffers(dri2_surf->dri_drawable);
+   dri2_surf->swap_rects = NULL;
+   dri2_surf->swap_n_rects = 0;
    return EGL_TRUE;
 }
 
+static EGLBoolean
+dri2_wl_swrast_swap_buffers(_EGLDriver *drv, _EGLDisplay *disp, _EGLSurface *draw)
+{
+   return dri2_wl_swrast_swap_buffers_with_damage(drv, disp, draw, NULL, 0);
+}
+
 static void
 shm_handle_format(void *data, struct wl_shm *shm, uint32_t format)
 {
@@ -1780,7 +2046,7 @@ static struct dri2_egl_display_vtbl dri2_wl_swrast_display_vtbl = {
    .create_image = dri2_fallback_create_image_khr,
    .swap_interval = dri2_wl_swap_interval,
    .swap_buffers = dri2_wl_swrast_swap_buffers,
-   .swap_buffers_with_damage = dri2_fallback_swap_buffers_with_damage,
+   .swap_buffers_with_damage = dri2_wl_swrast_swap_buffers_with_damage,
    .swap_buffers_region = dri2_fallback_swap_buffers_region,
    .post_sub_buffer = dri2_fallback_post_sub_buffer,
    .copy_buffers = dri2_fallback_copy_buffers,
@@ -1841,11 +2107,14 @@ dri2_initialize_wayland_swrast(_EGLDriver *drv, _EGLDisplay *disp)
       goto cleanup_shm;
 
    dri2_dpy->swrast_loader_extension.base.name = __DRI_SWRAST_LOADER;
-   dri2_dpy->swrast_loader_extension.base.version = 2;
+   dri2_dpy->swrast_loader_extension.base.version = 4;
    dri2_dpy->swrast_loader_extension.getDrawableInfo = dri2_wl_swrast_get_drawable_info;
    dri2_dpy->swrast_loader_extension.putImage = dri2_wl_swrast_put_image;
    dri2_dpy->swrast_loader_extension.getImage = dri2_wl_swrast_get_image;
    dri2_dpy->swrast_loader_extension.putImage2 = dri2_wl_swrast_put_image2;
+   dri2_dpy->swrast_loader_extension.getImage2 = dri2_wl_swrast_get_image2;
+   dri2_dpy->swrast_loader_extension.putImageShm = NULL;
+   dri2_dpy->swrast_loader_extension.putImageRects = dri2_wl_swrast_put_image_rects;
 
    dri2_dpy->extensions[0] = &dri2_dpy->swrast_loader_extension.base;
    dri2_dpy->extensions[1] = NULL;
@@ -1855,6 +2124,8 @@ dri2_initialize_wayland_swrast(_EGLDriver *drv, _EGLDisplay *disp)
 
    dri2_wl_setup_swap_interval(dri2_dpy);
 
+   disp->Extensions.EXT_swap_buffers_with_damage = EGL_TRUE;
+
    types = EGL_WINDOW_BIT;
    for (i = 0; dri2_dpy->driver_configs[i]; i++) {
       config = dri2_dpy->driver_configs[i];
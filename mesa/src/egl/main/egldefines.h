@@ -50,6 +50,7 @@ extern "C" {
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 #define MIN2(A, B)  (((A) < (B)) ? (A) : (B))
+#define MAX2(A, B)  (((A) > (B)) ? (A) : (B))
 
 #ifdef __cplusplus
 }
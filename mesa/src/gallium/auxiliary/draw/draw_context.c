@@ -1089,6 +1089,17 @@ draw_collect_pipeline_statistics(struct draw_context *draw,
    draw->collect_statistics = enable;
 }
 
+/**
+ * Returns the vertex cache counters accumulated by the vsplit frontend
+ * since the context was created.
+ */
+void
+draw_get_vertex_cache_stats(const struct draw_context *draw,
+                            struct draw_vertex_cache_stats *stats)
+{
+   *stats = draw->pt.vcache_stats;
+}
+
 /**
  * Computes clipper invocation statistics.
  *
@@ -291,6 +291,21 @@ void draw_set_force_passthrough( struct draw_context *draw,
 void draw_collect_pipeline_statistics(struct draw_context *draw,
                                       boolean enable);
 
+/**
+ * Post-transform vertex cache counters for indexed draws.
+ *
+ * The ratio vertices_shaded / primitives gives the average cache miss
+ * ratio (ACMR) of the index data submitted so far.
+ */
+struct draw_vertex_cache_stats {
+   uint64_t vertices_referenced;  /**< indices consumed */
+   uint64_t vertices_shaded;      /**< vertices fetched and shaded */
+   uint64_t primitives;           /**< quads and polygons as triangles */
+};
+
+void draw_get_vertex_cache_stats(const struct draw_context *draw,
+                                 struct draw_vertex_cache_stats *stats);
+
 /*******************************************************************************
  * Draw pipeline 
  */
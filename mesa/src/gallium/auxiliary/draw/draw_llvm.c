@@ -1528,7 +1528,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    struct gallivm_state *gallivm = variant->gallivm;
    LLVMContextRef context = gallivm->context;
    LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
-   LLVMTypeRef arg_types[11];
+   LLVMTypeRef arg_types[12];
    unsigned num_arg_types =
       elts ? ARRAY_SIZE(arg_types) : ARRAY_SIZE(arg_types) - 1;
    LLVMTypeRef func_type;
@@ -1540,15 +1540,16 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    LLVMValueRef end, start;
    LLVMValueRef count, fetch_elts, fetch_elt_max, fetch_count;
    LLVMValueRef vertex_id_offset, start_instance;
+   LLVMValueRef instance_id, num_instances, aligned_count;
    LLVMValueRef stride, step, io_itr;
-   LLVMValueRef io_ptr, vbuffers_ptr, vb_ptr;
+   LLVMValueRef io_ptr, io_instance_ptr, vbuffers_ptr, vb_ptr;
    LLVMValueRef zero = lp_build_const_int32(gallivm, 0);
    LLVMValueRef one = lp_build_const_int32(gallivm, 1);
    struct draw_context *draw = llvm->draw;
    const struct tgsi_shader_info *vs_info = &draw->vs.vertex_shader->info;
    unsigned i, j;
    struct lp_build_context bld;
-   struct lp_build_loop_state lp_loop;
+   struct lp_build_loop_state lp_loop, instance_loop;
    const int vector_length = lp_native_vector_width / 32;
    LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
    LLVMValueRef fetch_max;
@@ -1594,6 +1595,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    arg_types[i++] = int32_type;                     /* instance_id */
    arg_types[i++] = int32_type;                     /* vertex_id_offset */
    arg_types[i++] = int32_type;                     /* start_instance */
+   arg_types[i++] = int32_type;                     /* num_instances */
 
    func_type = LLVMFunctionType(int32_type, arg_types, num_arg_types, 0);
 
@@ -1621,18 +1623,20 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
     */
    stride                    = LLVMGetParam(variant_func, 5 + (elts ? 1 : 0));
    vb_ptr                    = LLVMGetParam(variant_func, 6 + (elts ? 1 : 0));
-   system_values.instance_id = LLVMGetParam(variant_func, 7 + (elts ? 1 : 0));
+   instance_id               = LLVMGetParam(variant_func, 7 + (elts ? 1 : 0));
    vertex_id_offset          = LLVMGetParam(variant_func, 8 + (elts ? 1 : 0));
    start_instance            = LLVMGetParam(variant_func, 9 + (elts ? 1 : 0));
+   num_instances             = LLVMGetParam(variant_func, 10 + (elts ? 1 : 0));
 
    lp_build_name(context_ptr, "context");
    lp_build_name(io_ptr, "io");
    lp_build_name(vbuffers_ptr, "vbuffers");
    lp_build_name(stride, "stride");
    lp_build_name(vb_ptr, "vb");
-   lp_build_name(system_values.instance_id, "instance_id");
+   lp_build_name(instance_id, "instance_id");
    lp_build_name(vertex_id_offset, "vertex_id_offset");
    lp_build_name(start_instance, "start_instance");
+   lp_build_name(num_instances, "num_instances");
 
    if (elts) {
       fetch_elts    = LLVMGetParam(variant_func, 3);
@@ -1688,6 +1692,24 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
 
    fetch_max = LLVMBuildSub(builder, end, one, "fetch_max");
 
+   /*
+    * Consecutive instances are stored one after another, each padded to
+    * a whole number of vectors.  The fetch indices are shared by all of
+    * them, only the instanced attributes and the instance id change.
+    */
+   aligned_count = LLVMBuildAnd(builder,
+                                LLVMBuildAdd(builder, count,
+                                             lp_build_const_int32(gallivm, vector_length - 1), ""),
+                                lp_build_const_int32(gallivm, ~(vector_length - 1)),
+                                "aligned_count");
+
+   lp_build_loop_begin(&instance_loop, gallivm, zero);
+
+   system_values.instance_id = LLVMBuildAdd(builder, instance_id,
+                                            instance_loop.counter, "");
+   io_itr = LLVMBuildMul(builder, instance_loop.counter, aligned_count, "");
+   io_instance_ptr = LLVMBuildGEP(builder, io_ptr, &io_itr, 1, "");
+
    lp_build_loop_begin(&lp_loop, gallivm, zero);
    {
       LLVMValueRef inputs[PIPE_MAX_SHADER_INPUTS][TGSI_NUM_CHANNELS];
@@ -1700,7 +1722,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
 
       io_itr = lp_loop.counter;
 
-      io = LLVMBuildGEP(builder, io_ptr, &io_itr, 1, "");
+      io = LLVMBuildGEP(builder, io_instance_ptr, &io_itr, 1, "");
 #if DEBUG_STORE
       lp_build_printf(gallivm, " --- io %d = %p, loop counter %d\n",
                       io_itr, io, lp_loop.counter);
@@ -1841,6 +1863,8 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    }
    lp_build_loop_end_cond(&lp_loop, count, step, LLVMIntUGE);
 
+   lp_build_loop_end_cond(&instance_loop, num_instances, one, LLVMIntUGE);
+
    sampler->destroy(sampler);
 
    /* return clipping boolean value for function */
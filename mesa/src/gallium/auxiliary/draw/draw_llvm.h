@@ -271,7 +271,8 @@ typedef int
                       struct pipe_vertex_buffer *vertex_buffers,
                       unsigned instance_id,
                       unsigned vertex_id_offset,
-                      unsigned start_instance);
+                      unsigned start_instance,
+                      unsigned num_instances);
 
 
 typedef int
@@ -285,7 +286,8 @@ typedef int
                            struct pipe_vertex_buffer *vertex_buffers,
                            unsigned instance_id,
                            unsigned vertex_id_offset,
-                           unsigned start_instance);
+                           unsigned start_instance,
+                           unsigned num_instances);
 
 
 typedef int
@@ -46,6 +46,8 @@
 
 #include "tgsi/tgsi_scan.h"
 
+#include "draw/draw_context.h"
+
 #ifdef HAVE_LLVM
 struct gallivm_state;
 #endif
@@ -210,6 +212,9 @@ struct draw_context
          float (*planes)[DRAW_TOTAL_CLIP_PLANES][4]; 
       } user;
 
+      /** vsplit post-transform vertex cache counters */
+      struct draw_vertex_cache_stats vcache_stats;
+
       boolean test_fse;         /* enable FSE even though its not correct (eg for softpipe) */
       boolean no_fse;           /* disable FSE even when it is correct */
    } pt;
@@ -322,6 +327,9 @@ struct draw_context
 
    unsigned instance_id;
    unsigned start_instance;
+   /** number of instances, starting at instance_id, the middle end may
+    * process in one run; it lowers this to the number actually done */
+   unsigned instance_count;
    unsigned start_index;
 
    struct draw_llvm *llvm;
@@ -461,6 +461,7 @@ draw_vbo(struct draw_context *draw,
    unsigned instance;
    unsigned index_limit;
    unsigned count;
+   boolean batch_instances;
    unsigned fpstate = util_fpstate_get();
    struct pipe_draw_info resolved_info;
 
@@ -544,10 +545,21 @@ draw_vbo(struct draw_context *draw,
     * the min_index/max_index hints given by the state tracker.
     */
 
-   for (instance = 0; instance < info->instance_count; instance++) {
+   /* The llvm middle end can shade several instances per variant call,
+    * reusing the split and fetch indices of the first one.
+    */
+   batch_instances = draw->pt.middle.llvm &&
+                     !info->primitive_restart &&
+                     info->start_instance + info->instance_count - 1 >=
+                     info->start_instance;
+
+   for (instance = 0; instance < info->instance_count;
+        instance += draw->instance_count) {
       unsigned instance_idx = instance + info->start_instance;
       draw->start_instance = info->start_instance;
       draw->instance_id = instance;
+      draw->instance_count = batch_instances ?
+                             info->instance_count - instance : 1;
       /* check for overflow */
       if (instance_idx < instance ||
           instance_idx < draw->start_instance) {
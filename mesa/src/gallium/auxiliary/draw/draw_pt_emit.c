@@ -45,6 +45,9 @@ struct pt_emit {
 
    const struct vertex_info *vinfo;
 
+   /** hand our vertices straight to the render, skipping translate */
+   boolean direct;
+
    float zero4[4];
 
 };
@@ -115,6 +118,18 @@ draw_pt_emit_prepare(struct pt_emit *emit,
    hw_key.nr_elements = vinfo->num_attribs;
    hw_key.output_stride = vinfo->size * 4;
 
+   /* If the hw vertex is just a copy of the shader outputs the render can
+    * consume our vertices as they are, if it knows how to.
+    */
+   emit->direct = draw->render->set_vertices != NULL;
+   for (i = 0; i < vinfo->num_attribs; i++) {
+      if (vinfo->attrib[i].emit != EMIT_4F ||
+          vinfo->attrib[i].src_index != i) {
+         emit->direct = FALSE;
+         break;
+      }
+   }
+
    if (!emit->translate ||
        translate_key_compare(&emit->translate->key, &hw_key) != 0) {
       translate_key_sanitize(&hw_key);
@@ -158,37 +173,46 @@ draw_pt_emit(struct pt_emit *emit,
     */
    render->set_primitive(draw->render, prim_info->prim);
 
-   render->allocate_vertices(render,
-                             (ushort)translate->key.output_stride,
-                             (ushort)vertex_count);
-
-   hw_verts = render->map_vertices(render);
-   if (!hw_verts) {
-      debug_warn_once("map of vertex buffer failed (out of memory?)");
-      return;
+   if (emit->direct) {
+      if (!render->set_vertices(render, vertex_data,
+                                (ushort)stride, (ushort)vertex_count)) {
+         debug_warn_once("set_vertices failed");
+         return;
+      }
    }
+   else {
+      render->allocate_vertices(render,
+                                (ushort)translate->key.output_stride,
+                                (ushort)vertex_count);
+
+      hw_verts = render->map_vertices(render);
+      if (!hw_verts) {
+         debug_warn_once("map of vertex buffer failed (out of memory?)");
+         return;
+      }
 
-   translate->set_buffer(translate,
-                         0,
-                         vertex_data,
-                         stride,
-                         ~0);
-
-   translate->set_buffer(translate,
-                         1,
-                         &draw->rasterizer->point_size,
-                         0,
-                         ~0);
-
-   /* fetch/translate vertex attribs to fill hw_verts[] */
-   translate->run(translate,
-                  0,
-                  vertex_count,
-                  0,
-                  0,
-                  hw_verts);
-
-   render->unmap_vertices(render, 0, vertex_count - 1);
+      translate->set_buffer(translate,
+                            0,
+                            vertex_data,
+                            stride,
+                            ~0);
+
+      translate->set_buffer(translate,
+                            1,
+                            &draw->rasterizer->point_size,
+                            0,
+                            ~0);
+
+      /* fetch/translate vertex attribs to fill hw_verts[] */
+      translate->run(translate,
+                     0,
+                     vertex_count,
+                     0,
+                     0,
+                     hw_verts);
+
+      render->unmap_vertices(render, 0, vertex_count - 1);
+   }
 
    for (start = i = 0;
         i < prim_info->primitive_count;
@@ -229,6 +253,13 @@ draw_pt_emit_linear(struct pt_emit *emit,
     */
    render->set_primitive(draw->render, prim_info->prim);
 
+   if (emit->direct) {
+      if (!render->set_vertices(render, vertex_data,
+                                (ushort)stride, (ushort)count))
+         goto fail;
+      goto emit_prims;
+   }
+
    if (!render->allocate_vertices(render,
                                   (ushort)translate->key.output_stride,
                                   (ushort)count))
@@ -264,6 +295,7 @@ draw_pt_emit_linear(struct pt_emit *emit,
 
    render->unmap_vertices(render, 0, count - 1);
 
+emit_prims:
    for (start = i = 0;
         i < prim_info->primitive_count;
         start += prim_info->primitive_lengths[i], i++)
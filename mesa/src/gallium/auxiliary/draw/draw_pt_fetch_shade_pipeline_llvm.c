@@ -39,6 +39,13 @@
 #include "gallivm/lp_bld_init.h"
 
 
+/**
+ * How many vertices to shade at once when processing several instances in
+ * a single variant call.  Keeps the intermediate storage cache-sized.
+ */
+#define DRAW_LLVM_INSTANCE_BATCH_VERTICES 4096
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -336,71 +343,25 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Run everything after the vertex shader on the vertices of one instance.
+ */
 static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+llvm_pipeline_post_vs(struct llvm_middle_end *fpme,
+                      struct draw_vertex_info *in_vert_info,
+                      const struct draw_prim_info *in_prim_info,
+                      unsigned clipped)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
    struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
    struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info llvm_vert_info;
    struct draw_vertex_info gs_vert_info;
-   struct draw_vertex_info *vert_info;
    struct draw_prim_info ia_prim_info;
    struct draw_vertex_info ia_vert_info;
+   struct draw_vertex_info *vert_info = in_vert_info;
    const struct draw_prim_info *prim_info = in_prim_info;
    boolean free_prim_info = FALSE;
    unsigned opt = fpme->opt;
-   unsigned clipped = 0;
-
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
-      MALLOC(fpme->vertex_size *
-             align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
-      assert(0);
-      return;
-   }
-
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
-
-   if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
-                                       draw->pt.user.vbuffer,
-                                       fetch_info->start,
-                                       fetch_info->count,
-                                       fpme->vertex_size,
-                                       draw->pt.vertex_buffer,
-                                       draw->instance_id,
-                                       draw->start_index,
-                                       draw->start_instance);
-   else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
-                                            draw->pt.user.vbuffer,
-                                            fetch_info->elts,
-                                            draw->pt.user.eltMax,
-                                            fetch_info->count,
-                                            fpme->vertex_size,
-                                            draw->pt.vertex_buffer,
-                                            draw->instance_id,
-                                            draw->pt.user.eltBias,
-                                            draw->start_instance);
-
-   /* Finished with fetch and vs:
-    */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
 
    if ((opt & PT_SHADE) && gshader) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
@@ -413,7 +374,6 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                                &gs_vert_info,
                                &gs_prim_info);
 
-      FREE(vert_info->verts);
       vert_info = &gs_vert_info;
       prim_info = &gs_prim_info;
    } else {
@@ -422,7 +382,6 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                                  &ia_prim_info, &ia_vert_info);
 
          if (ia_vert_info.count) {
-            FREE(vert_info->verts);
             vert_info = &ia_vert_info;
             prim_info = &ia_prim_info;
             free_prim_info = TRUE;
@@ -431,49 +390,141 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
    }
    if (prim_info->count == 0) {
       debug_printf("GS/IA didn't emit any vertices!\n");
-
-      FREE(vert_info->verts);
-      if (free_prim_info) {
-         FREE(prim_info->primitive_lengths);
-      }
-      return;
    }
+   else {
+      /* stream output needs to be done before clipping */
+      draw_pt_so_emit( fpme->so_emit, vert_info, prim_info );
 
-   /* stream output needs to be done before clipping */
-   draw_pt_so_emit( fpme->so_emit, vert_info, prim_info );
+      draw_stats_clipper_primitives(draw, prim_info);
 
-   draw_stats_clipper_primitives(draw, prim_info);
+      /*
+       * if there's no position, need to stop now, or the latter stages
+       * will try to access non-existent position output.
+       */
+      if (draw_current_shader_position_output(draw) != -1) {
+         if ((opt & PT_SHADE) && (gshader ||
+                                  draw->vs.vertex_shader->info.writes_viewport_index)) {
+            clipped = draw_pt_post_vs_run( fpme->post_vs, vert_info, prim_info );
+         }
+         /* "clipped" also includes non-one edgeflag */
+         if (clipped) {
+            opt |= PT_PIPELINE;
+         }
 
-   /*
-    * if there's no position, need to stop now, or the latter stages
-    * will try to access non-existent position output.
-    */
-   if (draw_current_shader_position_output(draw) != -1) {
-      if ((opt & PT_SHADE) && (gshader ||
-                               draw->vs.vertex_shader->info.writes_viewport_index)) {
-         clipped = draw_pt_post_vs_run( fpme->post_vs, vert_info, prim_info );
-      }
-      /* "clipped" also includes non-one edgeflag */
-      if (clipped) {
-         opt |= PT_PIPELINE;
+         /* Do we need to run the pipeline? Now will come here if clipped
+          */
+         if (opt & PT_PIPELINE) {
+            pipeline( fpme, vert_info, prim_info );
+         }
+         else {
+            emit( fpme->emit, vert_info, prim_info );
+         }
       }
+   }
 
-      /* Do we need to run the pipeline? Now will come here if clipped
-       */
-      if (opt & PT_PIPELINE) {
-         pipeline( fpme, vert_info, prim_info );
-      }
-      else {
-         emit( fpme->emit, vert_info, prim_info );
-      }
+   /* the vertex shader outputs belong to the caller */
+   if (vert_info != in_vert_info) {
+      FREE(vert_info->verts);
    }
-   FREE(vert_info->verts);
    if (free_prim_info) {
       FREE(prim_info->primitive_lengths);
    }
 }
 
 
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   const unsigned first_instance = draw->instance_id;
+   const unsigned aligned_count =
+      align(fetch_info->count, lp_native_vector_width / 32);
+   struct draw_vertex_info llvm_vert_info;
+   struct vertex_header *verts;
+   unsigned num_instances, batch, instance, i;
+   unsigned clipped = 0;
+
+   /* Instances can only be processed together when the frontend didn't
+    * split the primitive, otherwise their primitives would be emitted out
+    * of order.  Tell draw_vbo() we only did the current one.
+    */
+   if (prim_info->flags & (DRAW_SPLIT_BEFORE | DRAW_SPLIT_AFTER))
+      draw->instance_count = 1;
+
+   /* fetch_info->count can be 0 */
+   num_instances = draw->instance_count;
+   batch = CLAMP(DRAW_LLVM_INSTANCE_BATCH_VERTICES / MAX2(aligned_count, 1),
+                 1, num_instances);
+
+   verts = (struct vertex_header *)
+      MALLOC(fpme->vertex_size * aligned_count * batch);
+   if (!verts) {
+      assert(0);
+      return;
+   }
+
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count * num_instances;
+      draw->statistics.ia_primitives +=
+         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count) *
+         num_instances;
+      draw->statistics.vs_invocations += fetch_info->count * num_instances;
+   }
+
+   llvm_vert_info.count = fetch_info->count;
+   llvm_vert_info.vertex_size = fpme->vertex_size;
+   llvm_vert_info.stride = fpme->vertex_size;
+
+   for (instance = 0; instance < num_instances; instance += batch) {
+      const unsigned nr = MIN2(batch, num_instances - instance);
+
+      /* fetch and shade all instances of this batch in one go */
+      if (fetch_info->linear)
+         clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
+                                          verts,
+                                          draw->pt.user.vbuffer,
+                                          fetch_info->start,
+                                          fetch_info->count,
+                                          fpme->vertex_size,
+                                          draw->pt.vertex_buffer,
+                                          first_instance + instance,
+                                          draw->start_index,
+                                          draw->start_instance,
+                                          nr);
+      else
+         clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
+                                               verts,
+                                               draw->pt.user.vbuffer,
+                                               fetch_info->elts,
+                                               draw->pt.user.eltMax,
+                                               fetch_info->count,
+                                               fpme->vertex_size,
+                                               draw->pt.vertex_buffer,
+                                               first_instance + instance,
+                                               draw->pt.user.eltBias,
+                                               draw->start_instance,
+                                               nr);
+
+      for (i = 0; i < nr; i++) {
+         if (instance + i > 0) {
+            draw->instance_id = first_instance + instance + i;
+            draw_new_instance(draw);
+         }
+
+         llvm_vert_info.verts = (struct vertex_header *)
+            ((char *)verts + i * aligned_count * fpme->vertex_size);
+
+         llvm_pipeline_post_vs(fpme, &llvm_vert_info, prim_info, clipped);
+      }
+   }
+
+   FREE(verts);
+}
+
+
 static inline unsigned
 prim_type(unsigned prim, unsigned flags)
 {
@@ -23,19 +23,37 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <inttypes.h>
+
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_prim.h"
 
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
 
 #define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+
+/*
+ * The post-transform vertex cache is set-associative with CACHE_WAYS
+ * entries per set and FIFO replacement within a set.  The number of
+ * entries can be tuned with DRAW_VSPLIT_CACHE_SIZE; there is no point in
+ * making it larger than a segment since the cache is reset per segment.
+ */
+#define CACHE_WAYS          4
+#define MAX_CACHE_SIZE      SEGMENT_SIZE
+#define DEFAULT_CACHE_SIZE  512
+#define MAX_CACHE_SETS      (MAX_CACHE_SIZE / CACHE_WAYS)
 
 /* The largest possible index withing an index buffer */
 #define MAX_ELT_IDX 0xffffffff
 
+DEBUG_GET_ONCE_NUM_OPTION(vsplit_cache_size, "DRAW_VSPLIT_CACHE_SIZE",
+                          DEFAULT_CACHE_SIZE)
+DEBUG_GET_ONCE_BOOL_OPTION(vsplit_stats, "DRAW_VSPLIT_STATS", FALSE)
+
 struct vsplit_frontend {
    struct draw_pt_front_end base;
    struct draw_context *draw;
@@ -54,9 +72,15 @@ struct vsplit_frontend {
 
    struct {
       /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      unsigned fetches[MAX_CACHE_SETS][CACHE_WAYS];
+      ushort draws[MAX_CACHE_SETS][CACHE_WAYS];
+      /* an entry is only valid if its serial matches the cache serial */
+      unsigned serials[MAX_CACHE_SETS][CACHE_WAYS];
+      /* next way to replace in each set */
+      ubyte victim[MAX_CACHE_SETS];
+
+      unsigned serial;
+      unsigned set_mask;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
@@ -67,8 +91,13 @@ struct vsplit_frontend {
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
+   /* Invalidate all entries at once by bumping the serial.  Only when it
+    * wraps around do the stale serials need to be wiped.
+    */
+   if (++vsplit->cache.serial == 0) {
+      memset(vsplit->cache.serials, 0, sizeof(vsplit->cache.serials));
+      vsplit->cache.serial = 1;
+   }
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -76,6 +105,13 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   struct draw_vertex_cache_stats *stats = &vsplit->draw->pt.vcache_stats;
+
+   stats->vertices_referenced += vsplit->cache.num_draw_elts;
+   stats->vertices_shaded += vsplit->cache.num_fetch_elts;
+   stats->primitives += u_reduced_prims_for_vertices(vsplit->prim,
+                                                     vsplit->cache.num_draw_elts);
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
@@ -87,23 +123,34 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch, unsigned ofbias)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
-
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch || ofbias) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
-
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+   const unsigned set = fetch & vsplit->cache.set_mask;
+   const unsigned serial = vsplit->cache.serial;
+   unsigned way;
+
+   /* An overflow due to the element bias always needs a new fetch */
+   if (!ofbias) {
+      for (way = 0; way < CACHE_WAYS; way++) {
+         if (vsplit->cache.fetches[set][way] == fetch &&
+             vsplit->cache.serials[set][way] == serial) {
+            vsplit->draw_elts[vsplit->cache.num_draw_elts++] =
+               vsplit->cache.draws[set][way];
+            return;
+         }
+      }
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   /* update cache */
+   way = vsplit->cache.victim[set];
+   vsplit->cache.victim[set] = (way + 1) % CACHE_WAYS;
+   vsplit->cache.fetches[set][way] = fetch;
+   vsplit->cache.draws[set][way] = vsplit->cache.num_fetch_elts;
+   vsplit->cache.serials[set][way] = serial;
+
+   /* add fetch */
+   assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] =
+      vsplit->cache.num_fetch_elts;
+   vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
 }
 
 /**
@@ -198,16 +245,7 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
                       unsigned start, unsigned fetch, int elt_bias)
 {
    struct draw_context *draw = vsplit->draw;
-   unsigned raw_elem_idx = start + fetch + elt_bias;
    VSPLIT_CREATE_IDX(elts, start, fetch, elt_bias);
-
-   /* special care for DRAW_MAX_FETCH_IDX */
-   if (raw_elem_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = raw_elem_idx - 1; /* force update */
-      vsplit->cache.has_max_fetch = TRUE;
-   }
-
    vsplit_add_cache(vsplit, elt_idx, ofbias);
 }
 
@@ -279,6 +317,18 @@ static void vsplit_flush(struct draw_pt_front_end *frontend, unsigned flags)
 
 static void vsplit_destroy(struct draw_pt_front_end *frontend)
 {
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+   const struct draw_vertex_cache_stats *stats =
+      &vsplit->draw->pt.vcache_stats;
+
+   if (debug_get_option_vsplit_stats() && stats->primitives) {
+      debug_printf("draw: vsplit cache: %"PRIu64" vertices referenced, "
+                   "%"PRIu64" shaded, %"PRIu64" primitives (ACMR %.3f)\n",
+                   stats->vertices_referenced, stats->vertices_shaded,
+                   stats->primitives,
+                   (double) stats->vertices_shaded / stats->primitives);
+   }
+
    FREE(frontend);
 }
 
@@ -286,11 +336,17 @@ static void vsplit_destroy(struct draw_pt_front_end *frontend)
 struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
 {
    struct vsplit_frontend *vsplit = CALLOC_STRUCT(vsplit_frontend);
+   unsigned cache_size;
    ushort i;
 
    if (!vsplit)
       return NULL;
 
+   /* round down to a power of two number of sets */
+   cache_size = CLAMP(debug_get_option_vsplit_cache_size(),
+                      CACHE_WAYS, MAX_CACHE_SIZE);
+   vsplit->cache.set_mask = (1 << util_logbase2(cache_size / CACHE_WAYS)) - 1;
+
    vsplit->base.prepare = vsplit_prepare;
    vsplit->base.run     = NULL;
    vsplit->base.flush   = vsplit_flush;
@@ -118,6 +118,11 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
       draw_elts = vsplit->draw_elts;
    }
 
+   draw->pt.vcache_stats.vertices_referenced += icount;
+   draw->pt.vcache_stats.vertices_shaded += fetch_count;
+   draw->pt.vcache_stats.primitives +=
+      u_reduced_prims_for_vertices(vsplit->prim, icount);
+
    return vsplit->middle->run_linear_elts(vsplit->middle,
                                           fetch_start, fetch_count,
                                           draw_elts, icount, 0x0);
@@ -90,6 +90,22 @@ struct vbuf_render {
                            ushort min_index,
                            ushort max_index );
 
+   /**
+    * Optional: render straight out of the draw module's post-transform
+    * vertices instead of having them emitted into a vertex buffer first.
+    * Replaces allocate/map/unmap_vertices.
+    *
+    * Only used when the vertex info is a plain copy of the shader outputs
+    * (every attribute EMIT_4F, attribute i taken from output i).  The
+    * 'vertices' pointer refers to the first output of the first vertex,
+    * which is only 4 byte aligned, and stays valid until
+    * release_vertices() is called.
+    */
+   boolean (*set_vertices)( struct vbuf_render *,
+                            const void *vertices,
+                            ushort vertex_size,
+                            ushort nr_vertices );
+
    /**
     * Notify the renderer of the current primitive when it changes.
     * Must succeed for TRIANGLES, LINES and POINTS.  Other prims at
@@ -0,0 +1,509 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * AVX2 translate backend.
+ *
+ * Converts eight vertices at a time: every channel of an attribute is
+ * fetched for all eight vertices with one gather, converted to float in
+ * one go, and the eight results are transposed back to one float[4] per
+ * vertex.  Only conversions to float outputs from 32-bit float or 8-bit
+ * RGBA/BGRA inputs are handled, which covers the draw module's fetch and
+ * emit of most vertex layouts.  Keys with anything else, with instanced
+ * elements, or which only copy attributes, aren't handled and
+ * translate_create() falls back to the other backends.
+ *
+ * The conversions are the same single precision operations as those of
+ * the u_format unpack functions used by translate_generic.c, so both
+ * produce identical results.
+ *
+ * This file is built with -mavx2, so it must only be called after
+ * checking util_cpu_caps.has_avx2.
+ */
+
+#include <immintrin.h>
+
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_cpu_detect.h"
+#include "pipe/p_state.h"
+#include "translate.h"
+
+
+/**
+ * Number of vertices whose indices are clamped and converted per step.
+ * Must be a multiple of 8.
+ */
+#define AVX2_RUN_BATCH 64
+
+
+enum avx2_fetch {
+   AVX2_FETCH_FLOAT,     /**< 1 to 4 32-bit floats */
+   AVX2_FETCH_UNORM8,    /**< 4 unsigned normalized bytes */
+   AVX2_FETCH_USCALED8   /**< 4 unsigned scaled bytes */
+};
+
+
+struct translate_avx2 {
+   struct translate translate;
+
+   struct {
+      enum avx2_fetch fetch;
+      unsigned nr_channels;     /**< channels read, for AVX2_FETCH_FLOAT */
+      boolean swap_rb;          /**< BGRA byte order */
+      unsigned input_size;      /**< bytes read per vertex */
+      unsigned buffer;
+      unsigned input_offset;
+
+      unsigned output_channels;
+      unsigned output_offset;
+
+      const uint8_t *input_ptr;
+      unsigned input_stride;
+      unsigned max_index;
+   } attrib[TRANSLATE_MAX_ATTRIBS];
+
+   unsigned nr_attrib;
+};
+
+
+static struct translate_avx2 *translate_avx2( struct translate *translate )
+{
+   return (struct translate_avx2 *)translate;
+}
+
+
+/**
+ * Fetch one attribute of eight vertices, at base + offsets, as four
+ * vectors holding one channel each.  Missing channels read as (0, 0, 0, 1)
+ * like u_format's unpack functions give them.
+ */
+static inline void
+avx2_fetch8(const struct translate_avx2 *ta, unsigned attr,
+            const uint8_t *base, __m256i offsets, __m256 chan[4])
+{
+   unsigned c;
+
+   switch (ta->attrib[attr].fetch) {
+   case AVX2_FETCH_FLOAT:
+      for (c = 0; c < 4; c++) {
+         if (c < ta->attrib[attr].nr_channels)
+            chan[c] = _mm256_i32gather_ps((const float *)(base + 4 * c),
+                                          offsets, 1);
+         else
+            chan[c] = _mm256_set1_ps(c == 3 ? 1.0f : 0.0f);
+      }
+      break;
+
+   case AVX2_FETCH_UNORM8:
+   case AVX2_FETCH_USCALED8:
+   {
+      const __m256i mask = _mm256_set1_epi32(0xff);
+      __m256i texel = _mm256_i32gather_epi32((const int *)base, offsets, 1);
+
+      for (c = 0; c < 4; c++) {
+         __m256i value = _mm256_srli_epi32(texel, 8 * c);
+         chan[c] = _mm256_cvtepi32_ps(_mm256_and_si256(value, mask));
+      }
+
+      if (ta->attrib[attr].fetch == AVX2_FETCH_UNORM8) {
+         /* ubyte_to_float() */
+         const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+         for (c = 0; c < 4; c++)
+            chan[c] = _mm256_mul_ps(chan[c], scale);
+      }
+
+      if (ta->attrib[attr].swap_rb) {
+         __m256 tmp = chan[0];
+         chan[0] = chan[2];
+         chan[2] = tmp;
+      }
+      break;
+   }
+
+   default:
+      assert(0);
+   }
+}
+
+
+/**
+ * Transpose four channel vectors of eight vertices back to a float[4] per
+ * vertex and store the first 'nr_channels' of each of the first 'count'
+ * vertices.
+ */
+static inline void
+avx2_emit8(const __m256 chan[4], unsigned count, unsigned nr_channels,
+           uint8_t *dst, unsigned output_stride)
+{
+   const __m128i mask = _mm_setr_epi32(-1,
+                                       nr_channels > 1 ? -1 : 0,
+                                       nr_channels > 2 ? -1 : 0,
+                                       nr_channels > 3 ? -1 : 0);
+   __m256 t0 = _mm256_unpacklo_ps(chan[0], chan[1]);
+   __m256 t1 = _mm256_unpackhi_ps(chan[0], chan[1]);
+   __m256 t2 = _mm256_unpacklo_ps(chan[2], chan[3]);
+   __m256 t3 = _mm256_unpackhi_ps(chan[2], chan[3]);
+   __m256 v[4];
+   __m128 vert[8];
+   unsigned i;
+
+   /* v[i] holds vertex i in the low half and vertex i + 4 in the high one */
+   v[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+   v[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+   v[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+   v[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+   for (i = 0; i < 4; i++) {
+      vert[i] = _mm256_castps256_ps128(v[i]);
+      vert[i + 4] = _mm256_extractf128_ps(v[i], 1);
+   }
+
+   for (i = 0; i < count; i++) {
+      if (nr_channels == 4)
+         _mm_storeu_ps((float *)dst, vert[i]);
+      else
+         _mm_maskstore_ps((float *)dst, mask, vert[i]);
+      dst += output_stride;
+   }
+}
+
+
+/**
+ * Convert one attribute of 'count' vertices.  'elts' must have room for
+ * 'count' rounded up to a multiple of 8, with the padding entries being
+ * valid indices.
+ */
+static void
+avx2_run_attrib(const struct translate_avx2 *ta, unsigned attr,
+                const unsigned *elts, unsigned count, uint8_t *dst)
+{
+   const unsigned output_stride = ta->translate.key.output_stride;
+   const unsigned input_stride = ta->attrib[attr].input_stride;
+   const unsigned input_size = ta->attrib[attr].input_size;
+   const unsigned count8 = align(count, 8);
+   const __m256i max_index = _mm256_set1_epi32(ta->attrib[attr].max_index);
+   const __m256i stride = _mm256_set1_epi32(input_stride);
+   unsigned idx[AVX2_RUN_BATCH];
+   unsigned max = 0;
+   boolean offsets_fit;
+   unsigned i, j;
+
+   assert(count8 <= AVX2_RUN_BATCH);
+
+   /* clamp to avoid going out of bounds */
+   for (i = 0; i < count8; i += 8) {
+      __m256i index = _mm256_loadu_si256((const __m256i *)(elts + i));
+      index = _mm256_min_epu32(index, max_index);
+      _mm256_storeu_si256((__m256i *)(idx + i), index);
+   }
+
+   for (i = 0; i < count8; i++)
+      max = MAX2(max, idx[i]);
+
+   /* The gathers take signed 32-bit offsets */
+   offsets_fit = (uint64_t)max * input_stride + input_size <= INT32_MAX;
+
+   for (i = 0; i < count; i += 8) {
+      const uint8_t *base = ta->attrib[attr].input_ptr;
+      __m256i offsets;
+      __m256 chan[4];
+
+      if (likely(offsets_fit)) {
+         offsets = _mm256_loadu_si256((const __m256i *)(idx + i));
+         offsets = _mm256_mullo_epi32(offsets, stride);
+      }
+      else {
+         /* Far apart vertices: copy them next to each other first. */
+         PIPE_ALIGN_VAR(16) uint8_t tmp[8][16];
+
+         for (j = 0; j < 8; j++)
+            memcpy(tmp[j], base + (ptrdiff_t)input_stride * idx[i + j],
+                   input_size);
+
+         base = tmp[0];
+         offsets = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+      }
+
+      avx2_fetch8(ta, attr, base, offsets, chan);
+      avx2_emit8(chan, MIN2(count - i, 8), ta->attrib[attr].output_channels,
+                 dst, output_stride);
+      dst += 8 * output_stride;
+   }
+}
+
+
+/**
+ * Convert up to AVX2_RUN_BATCH vertices, one attribute at a time.
+ * 'elts' must have room for AVX2_RUN_BATCH entries.
+ */
+static void
+avx2_run_batch(const struct translate_avx2 *ta, unsigned *elts,
+               unsigned count, uint8_t *vert)
+{
+   unsigned attr, i;
+
+   if (!count)
+      return;
+
+   for (i = count; i < align(count, 8); i++)
+      elts[i] = elts[count - 1];
+
+   for (attr = 0; attr < ta->nr_attrib; attr++)
+      avx2_run_attrib(ta, attr, elts, count,
+                      vert + ta->attrib[attr].output_offset);
+}
+
+
+/*
+ * Instanced elements and instance ids are not handled by this backend,
+ * so start_instance and instance_id are unused below.
+ */
+
+static void PIPE_CDECL avx2_run_elts( struct translate *translate,
+                                      const unsigned *elts,
+                                      unsigned count,
+                                      unsigned start_instance,
+                                      unsigned instance_id,
+                                      void *output_buffer )
+{
+   struct translate_avx2 *ta = translate_avx2(translate);
+   const unsigned output_stride = ta->translate.key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned batch[AVX2_RUN_BATCH];
+
+   while (count) {
+      unsigned n = MIN2(count, AVX2_RUN_BATCH);
+
+      memcpy(batch, elts, n * sizeof batch[0]);
+      avx2_run_batch(ta, batch, n, vert);
+      elts += n;
+      vert += n * output_stride;
+      count -= n;
+   }
+}
+
+static void PIPE_CDECL avx2_run_elts16( struct translate *translate,
+                                        const uint16_t *elts,
+                                        unsigned count,
+                                        unsigned start_instance,
+                                        unsigned instance_id,
+                                        void *output_buffer )
+{
+   struct translate_avx2 *ta = translate_avx2(translate);
+   const unsigned output_stride = ta->translate.key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned batch[AVX2_RUN_BATCH];
+   unsigned i;
+
+   while (count) {
+      unsigned n = MIN2(count, AVX2_RUN_BATCH);
+
+      for (i = 0; i < n; i++)
+         batch[i] = elts[i];
+      avx2_run_batch(ta, batch, n, vert);
+      elts += n;
+      vert += n * output_stride;
+      count -= n;
+   }
+}
+
+static void PIPE_CDECL avx2_run_elts8( struct translate *translate,
+                                       const uint8_t *elts,
+                                       unsigned count,
+                                       unsigned start_instance,
+                                       unsigned instance_id,
+                                       void *output_buffer )
+{
+   struct translate_avx2 *ta = translate_avx2(translate);
+   const unsigned output_stride = ta->translate.key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned batch[AVX2_RUN_BATCH];
+   unsigned i;
+
+   while (count) {
+      unsigned n = MIN2(count, AVX2_RUN_BATCH);
+
+      for (i = 0; i < n; i++)
+         batch[i] = elts[i];
+      avx2_run_batch(ta, batch, n, vert);
+      elts += n;
+      vert += n * output_stride;
+      count -= n;
+   }
+}
+
+static void PIPE_CDECL avx2_run( struct translate *translate,
+                                 unsigned start,
+                                 unsigned count,
+                                 unsigned start_instance,
+                                 unsigned instance_id,
+                                 void *output_buffer )
+{
+   struct translate_avx2 *ta = translate_avx2(translate);
+   const unsigned output_stride = ta->translate.key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned batch[AVX2_RUN_BATCH];
+   unsigned i;
+
+   while (count) {
+      unsigned n = MIN2(count, AVX2_RUN_BATCH);
+
+      for (i = 0; i < n; i += 8) {
+         __m256i index = _mm256_add_epi32(_mm256_set1_epi32(start + i),
+                                          _mm256_setr_epi32(0, 1, 2, 3,
+                                                            4, 5, 6, 7));
+         _mm256_storeu_si256((__m256i *)(batch + i), index);
+      }
+      avx2_run_batch(ta, batch, n, vert);
+      start += n;
+      vert += n * output_stride;
+      count -= n;
+   }
+}
+
+
+static void avx2_set_buffer( struct translate *translate,
+                             unsigned buf,
+                             const void *ptr,
+                             unsigned stride,
+                             unsigned max_index )
+{
+   struct translate_avx2 *ta = translate_avx2(translate);
+   unsigned i;
+
+   for (i = 0; i < ta->nr_attrib; i++) {
+      if (ta->attrib[i].buffer == buf) {
+         ta->attrib[i].input_ptr = ((const uint8_t *)ptr +
+                                    ta->attrib[i].input_offset);
+         ta->attrib[i].input_stride = stride;
+         ta->attrib[i].max_index = max_index;
+      }
+   }
+}
+
+
+static void avx2_release( struct translate *translate )
+{
+   FREE(translate);
+}
+
+
+/**
+ * Number of channels of the 32-bit float formats, or 0 for any other.
+ */
+static unsigned
+float_format_channels(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_R32_FLOAT: return 1;
+   case PIPE_FORMAT_R32G32_FLOAT: return 2;
+   case PIPE_FORMAT_R32G32B32_FLOAT: return 3;
+   case PIPE_FORMAT_R32G32B32A32_FLOAT: return 4;
+   default: return 0;
+   }
+}
+
+
+struct translate *translate_avx2_create( const struct translate_key *key )
+{
+   struct translate_avx2 *ta;
+   unsigned i;
+
+   util_cpu_detect();
+
+   if (!util_cpu_caps.has_avx2)
+      return NULL;
+
+   ta = CALLOC_STRUCT(translate_avx2);
+   if (!ta)
+      return NULL;
+
+   assert(key->nr_elements <= TRANSLATE_MAX_ATTRIBS);
+
+   ta->translate.key = *key;
+   ta->translate.release = avx2_release;
+   ta->translate.set_buffer = avx2_set_buffer;
+   ta->translate.run_elts = avx2_run_elts;
+   ta->translate.run_elts16 = avx2_run_elts16;
+   ta->translate.run_elts8 = avx2_run_elts8;
+   ta->translate.run = avx2_run;
+
+   for (i = 0; i < key->nr_elements; i++) {
+      const struct translate_element *element = &key->element[i];
+      unsigned input_channels = float_format_channels(element->input_format);
+
+      if (element->type != TRANSLATE_ELEMENT_NORMAL ||
+          element->instance_divisor)
+         goto fail;
+
+      ta->attrib[i].output_channels =
+         float_format_channels(element->output_format);
+      if (!ta->attrib[i].output_channels)
+         goto fail;
+
+      if (input_channels) {
+         ta->attrib[i].fetch = AVX2_FETCH_FLOAT;
+         ta->attrib[i].nr_channels =
+            MIN2(input_channels, ta->attrib[i].output_channels);
+         ta->attrib[i].input_size = 4 * input_channels;
+      }
+      else {
+         switch (element->input_format) {
+         case PIPE_FORMAT_R8G8B8A8_UNORM:
+            ta->attrib[i].fetch = AVX2_FETCH_UNORM8;
+            break;
+         case PIPE_FORMAT_B8G8R8A8_UNORM:
+            ta->attrib[i].fetch = AVX2_FETCH_UNORM8;
+            ta->attrib[i].swap_rb = TRUE;
+            break;
+         case PIPE_FORMAT_R8G8B8A8_USCALED:
+            ta->attrib[i].fetch = AVX2_FETCH_USCALED8;
+            break;
+         default:
+            goto fail;
+         }
+         ta->attrib[i].input_size = 4;
+      }
+
+      ta->attrib[i].buffer = element->input_buffer;
+      ta->attrib[i].input_offset = element->input_offset;
+      ta->attrib[i].output_offset = element->output_offset;
+   }
+
+   ta->nr_attrib = key->nr_elements;
+
+   /* Keys which only copy attributes are left to translate_sse.c, whose
+    * straight moves are faster.
+    */
+   for (i = 0; i < key->nr_elements; i++) {
+      if (key->element[i].input_format != key->element[i].output_format)
+         return &ta->translate;
+   }
+
+fail:
+   FREE(ta);
+   return NULL;
+}
@@ -44,6 +44,16 @@ typedef void (*fetch_func)(void *dst,
                            const uint8_t *src,
                            unsigned i, unsigned j);
 typedef void (*emit_func)(const void *attrib, void *ptr);
+typedef void (*unpack_func)(void *dst, unsigned dst_stride,
+                            const uint8_t *src, unsigned src_stride,
+                            unsigned width, unsigned height);
+
+/**
+ * Number of vertices converted per step by generic_run().  Attributes
+ * are unpacked a whole batch at a time into a float4 scratch array,
+ * so this bounds the stack usage of that array.
+ */
+#define GENERIC_RUN_BATCH 64
 
 
 
@@ -54,6 +64,7 @@ struct translate_generic {
       enum translate_element_type type;
 
       fetch_func fetch;
+      unpack_func unpack;
       unsigned buffer;
       unsigned input_offset;
       unsigned instance_divisor;
@@ -76,6 +87,9 @@ struct translate_generic {
    } attrib[TRANSLATE_MAX_ATTRIBS];
 
    unsigned nr_attrib;
+
+   /* TRUE if every element can go through the batched path in generic_run */
+   boolean batch;
 };
 
 
@@ -700,6 +714,52 @@ static void PIPE_CDECL generic_run_elts8( struct translate *translate,
    }
 }
 
+/**
+ * Convert 'count' consecutive vertices starting at 'start', one attribute
+ * at a time.  The source rows are unpacked in a single call to the
+ * u_format unpack function rather than one fetch per vertex, and the
+ * emit loop stays on one function pointer for the whole batch.
+ * The caller guarantees count <= GENERIC_RUN_BATCH and that no vertex
+ * in the range needs clamping to max_index.
+ */
+static void
+generic_run_batch( struct translate_generic *tg,
+                   unsigned start,
+                   unsigned count,
+                   uint8_t *vert )
+{
+   const unsigned output_stride = tg->translate.key.output_stride;
+   float data[GENERIC_RUN_BATCH][4];
+   unsigned attr, i;
+
+   for (attr = 0; attr < tg->nr_attrib; attr++) {
+      const unsigned input_stride = tg->attrib[attr].input_stride;
+      const uint8_t *src = tg->attrib[attr].input_ptr +
+                           (ptrdiff_t)input_stride * start;
+      uint8_t *dst = vert + tg->attrib[attr].output_offset;
+      int copy_size = tg->attrib[attr].copy_size;
+
+      if (copy_size >= 0) {
+         for (i = 0; i < count; i++) {
+            memcpy(dst, src, copy_size);
+            src += input_stride;
+            dst += output_stride;
+         }
+      }
+      else {
+         emit_func emit = tg->attrib[attr].emit;
+
+         tg->attrib[attr].unpack(data, sizeof data[0], src, input_stride,
+                                 1, count);
+
+         for (i = 0; i < count; i++) {
+            emit(data[i], dst);
+            dst += output_stride;
+         }
+      }
+   }
+}
+
 static void PIPE_CDECL generic_run( struct translate *translate,
                                     unsigned start,
                                     unsigned count,
@@ -708,12 +768,35 @@ static void PIPE_CDECL generic_run( struct translate *translate,
                                     void *output_buffer )
 {
    struct translate_generic *tg = translate_generic(translate);
+   const unsigned output_stride = tg->translate.key.output_stride;
    char *vert = output_buffer;
    unsigned i;
 
+   if (tg->batch) {
+      unsigned max_index = ~0;
+
+      for (i = 0; i < tg->nr_attrib; i++)
+         max_index = MIN2(max_index, tg->attrib[i].max_index);
+
+      /* Batch everything up to the first vertex which would need to be
+       * clamped; the remainder takes the per-vertex path below.
+       */
+      while (count && start <= max_index) {
+         unsigned n = MIN2(count, GENERIC_RUN_BATCH);
+
+         if (max_index - start < n - 1)
+            n = max_index - start + 1;
+
+         generic_run_batch(tg, start, n, (uint8_t *)vert);
+         vert += n * output_stride;
+         start += n;
+         count -= n;
+      }
+   }
+
    for (i = 0; i < count; i++) {
       generic_run_one(tg, start + i, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+      vert += output_stride;
    }
 }
 
@@ -805,13 +888,16 @@ struct translate *translate_generic_create( const struct translate_key *key )
          if (format_desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED) {
             assert(format_desc->fetch_rgba_sint);
             tg->attrib[i].fetch = (fetch_func)format_desc->fetch_rgba_sint;
+            tg->attrib[i].unpack = (unpack_func)format_desc->unpack_rgba_sint;
          } else {
             assert(format_desc->fetch_rgba_uint);
             tg->attrib[i].fetch = (fetch_func)format_desc->fetch_rgba_uint;
+            tg->attrib[i].unpack = (unpack_func)format_desc->unpack_rgba_uint;
          }
       } else {
          assert(format_desc->fetch_rgba_float);
          tg->attrib[i].fetch = (fetch_func)format_desc->fetch_rgba_float;
+         tg->attrib[i].unpack = (unpack_func)format_desc->unpack_rgba_float;
       }
 
       tg->attrib[i].buffer = key->element[i].input_buffer;
@@ -844,6 +930,23 @@ struct translate *translate_generic_create( const struct translate_key *key )
 
    tg->nr_attrib = key->nr_elements;
 
+   /* Instanced elements and instance ids don't vary per vertex, and
+    * block-compressed formats can't be unpacked one row per vertex, so
+    * those keep converting one vertex at a time.
+    */
+   tg->batch = TRUE;
+   for (i = 0; i < key->nr_elements; i++) {
+      const struct util_format_description *format_desc =
+            util_format_description(key->element[i].input_format);
+
+      if (tg->attrib[i].type != TRANSLATE_ELEMENT_NORMAL ||
+          tg->attrib[i].instance_divisor ||
+          (tg->attrib[i].copy_size < 0 &&
+           (!tg->attrib[i].unpack ||
+            format_desc->block.width != 1 ||
+            format_desc->block.height != 1)))
+         tg->batch = FALSE;
+   }
 
    return &tg->translate;
 }
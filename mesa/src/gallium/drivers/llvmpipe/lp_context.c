@@ -36,6 +36,8 @@
 #include "util/u_inlines.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_string.h"
+#include "util/u_atomic.h"
 #include "util/simple_list.h"
 #include "lp_clear.h"
 #include "lp_context.h"
@@ -56,7 +58,7 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    uint i, j;
 
-   lp_print_counters();
+   lp_print_counters(&llvmpipe->counters);
 
    if (llvmpipe->blitter) {
       util_blitter_destroy(llvmpipe->blitter);
@@ -141,6 +143,15 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
 
    memset(llvmpipe, 0, sizeof *llvmpipe);
 
+   {
+      static int32_t num_contexts = 0;
+      char thread_name[32];
+
+      util_snprintf(thread_name, sizeof thread_name, "context-%d",
+                    p_atomic_inc_return(&num_contexts));
+      llvmpipe->trace = lp_trace_create_buffer(thread_name);
+   }
+
    make_empty_list(&llvmpipe->fs_variants_list);
 
    make_empty_list(&llvmpipe->setup_variants_list);
@@ -216,8 +227,6 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    draw_wide_point_threshold(llvmpipe->draw, 10000.0);
    draw_wide_line_threshold(llvmpipe->draw, 10000.0);
 
-   lp_reset_counters();
-
    return &llvmpipe->pipe;
 
  fail:
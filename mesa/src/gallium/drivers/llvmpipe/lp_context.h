@@ -38,7 +38,9 @@
 
 #include "lp_tex_sample.h"
 #include "lp_jit.h"
+#include "lp_perf.h"
 #include "lp_setup.h"
+#include "lp_trace.h"
 #include "lp_state_fs.h"
 #include "lp_state_setup.h"
 
@@ -95,6 +97,12 @@ struct llvmpipe_context {
    struct pipe_query_data_pipeline_statistics pipeline_statistics;
    unsigned active_statistics_queries;
 
+   /** Totals over all the scenes rasterized and shaders compiled */
+   struct lp_counters counters;
+
+   /** LP_TRACE event buffer of the thread using this context */
+   struct lp_trace_buffer *trace;
+
    unsigned active_occlusion_queries;
 
    unsigned dirty; /**< Mask of LP_NEW_x flags */
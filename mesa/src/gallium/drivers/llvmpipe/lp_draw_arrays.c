@@ -66,6 +66,8 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
       return;
    }
 
+   LP_TRACE_BEGIN(lp->trace, "draw");
+
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
@@ -156,6 +158,8 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
     * internally when this condition is seen?)
     */
    draw_flush(draw);
+
+   LP_TRACE_END(lp->trace, "draw");
 }
 
 
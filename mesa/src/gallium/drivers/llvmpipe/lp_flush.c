@@ -50,11 +50,15 @@ llvmpipe_flush( struct pipe_context *pipe,
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
 
+   LP_TRACE_BEGIN(llvmpipe->trace, "flush");
+
    draw_flush(llvmpipe->draw);
 
    /* ask the setup module to flush */
    lp_setup_flush(llvmpipe->setup, fence, reason);
 
+   LP_TRACE_END(llvmpipe->trace, "flush");
+
    /* Enable to dump BMPs of the color/depth buffers each frame */
    if (0) {
       static unsigned frame_no = 1;
@@ -0,0 +1,671 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Linear fragment path.
+ *
+ * Recognizes fragment shaders which only copy a texture, output a color,
+ * or modulate a texture by a color, with no or "over" blending into a
+ * single 8-bit unorm color buffer, and shades whole spans of those with
+ * 8-bit fixed-point arithmetic on packed pixels.
+ *
+ * The per-pixel arithmetic (see lp_linear.h) is that of the LLVM paths
+ * for 8-bit unorm data, which lp_test_linear checks: bilinear filtering
+ * uses the same 8.8 fixed-point weights and lerps as lp_bld_sample_aos.c,
+ * and blending the same lerp / normalized multiply as lp_bld_blend.c.
+ * Anything else (varying colors, perspective texturing, other formats
+ * or filters) falls back to the generated code.
+ *
+ * The texture coordinates are not computed exactly like the generated
+ * code does though, so a texel or filter weight can differ now and then,
+ * which is why the path is only used with LP_PERF=linear_fs:
+ *
+ * - lp_bld_interp.c evaluates a0 + x * dadx + y * dady with
+ *   llvm.fmuladd, which is fused only when gallivm enabled FMA, and
+ *   multiplies perspective attributes by 1/w after interpolation, where
+ *   setup_attrib() folds 1/w into the coefficients.
+ * - lp_bld_sample_aos.c wraps coordinates per wrap mode and per path:
+ *   lp_build_sample_wrap_nearest_float() for instance takes the fraction
+ *   of the normalized coordinate before scaling it for REPEAT, and
+ *   truncates the clamped coordinate for CLAMP_TO_EDGE, where
+ *   wrap_coord() masks or clamps the floored texel index.
+ *
+ * Using it by default needs fetch_texel() to evaluate the coordinates in
+ * that order (with fmaf() when util_cpu_caps.has_fma), setup_attrib() to
+ * apply 1/w afterwards, wrap_coord() to round per wrap mode like the
+ * sampler, and lp_test_linear to compare fetch_texel() with the
+ * generated sampler for every wrap mode and filter.
+ */
+
+#include "pipe/p_defines.h"
+#include "pipe/p_shader_tokens.h"
+#include "util/u_math.h"
+#include "util/u_format.h"
+#include "util/u_rect.h"
+#include "tgsi/tgsi_parse.h"
+
+#include "lp_debug.h"
+#include "lp_linear.h"
+#include "lp_rast_priv.h"
+#include "lp_state_fs.h"
+
+
+#define MAX_LINEAR_INSTRUCTIONS 2
+
+
+/**
+ * Is the source register a plain, unswizzled read of the given file?
+ */
+static boolean
+is_plain_src(const struct tgsi_full_src_register *src, unsigned file)
+{
+   return src->Register.File == file &&
+          !src->Register.Indirect &&
+          !src->Register.Dimension &&
+          !src->Register.Absolute &&
+          !src->Register.Negate &&
+          src->Register.SwizzleX == TGSI_SWIZZLE_X &&
+          src->Register.SwizzleY == TGSI_SWIZZLE_Y &&
+          src->Register.SwizzleZ == TGSI_SWIZZLE_Z &&
+          src->Register.SwizzleW == TGSI_SWIZZLE_W;
+}
+
+
+static boolean
+is_plain_dst(const struct tgsi_full_dst_register *dst, unsigned file)
+{
+   return dst->Register.File == file &&
+          !dst->Register.Indirect &&
+          !dst->Register.Dimension &&
+          dst->Register.WriteMask == TGSI_WRITEMASK_XYZW;
+}
+
+
+static boolean
+is_simple_tex(const struct tgsi_full_instruction *inst, unsigned dst_file)
+{
+   return inst->Instruction.Opcode == TGSI_OPCODE_TEX &&
+          (inst->Texture.Texture == TGSI_TEXTURE_2D ||
+           inst->Texture.Texture == TGSI_TEXTURE_RECT) &&
+          inst->Texture.NumOffsets == 0 &&
+          is_plain_dst(&inst->Dst[0], dst_file) &&
+          is_plain_src(&inst->Src[0], TGSI_FILE_INPUT) &&
+          inst->Src[1].Register.File == TGSI_FILE_SAMPLER &&
+          inst->Src[1].Register.Index == 0 &&
+          !inst->Src[1].Register.Indirect;
+}
+
+
+/**
+ * Match the shader against the forms the linear path handles.
+ */
+static unsigned
+analyse_shader(const struct lp_fragment_shader *shader,
+               unsigned *tex_input,
+               unsigned *color_input)
+{
+   const struct tgsi_shader_info *info = &shader->info.base;
+   struct tgsi_full_instruction insts[MAX_LINEAR_INSTRUCTIONS];
+   struct tgsi_parse_context parse;
+   unsigned num_insts = 0;
+   boolean too_long = FALSE;
+
+   if (info->uses_kill ||
+       info->writes_z ||
+       info->writes_stencil ||
+       info->num_outputs != 1 ||
+       info->output_semantic_name[0] != TGSI_SEMANTIC_COLOR)
+      return LP_LINEAR_NONE;
+
+   tgsi_parse_init(&parse, shader->base.tokens);
+   while (!tgsi_parse_end_of_tokens(&parse)) {
+      tgsi_parse_token(&parse);
+      if (parse.FullToken.Token.Type == TGSI_TOKEN_TYPE_INSTRUCTION) {
+         if (parse.FullToken.FullInstruction.Instruction.Opcode == TGSI_OPCODE_END)
+            break;
+         if (num_insts == MAX_LINEAR_INSTRUCTIONS) {
+            too_long = TRUE;
+            break;
+         }
+         insts[num_insts++] = parse.FullToken.FullInstruction;
+      }
+   }
+   tgsi_parse_free(&parse);
+
+   if (too_long)
+      return LP_LINEAR_NONE;
+
+   if (num_insts == 1) {
+      /* MOV OUT[0], IN[c] */
+      if (insts[0].Instruction.Opcode == TGSI_OPCODE_MOV &&
+          is_plain_dst(&insts[0].Dst[0], TGSI_FILE_OUTPUT) &&
+          is_plain_src(&insts[0].Src[0], TGSI_FILE_INPUT)) {
+         *color_input = insts[0].Src[0].Register.Index;
+         return LP_LINEAR_COLOR;
+      }
+
+      /* TEX OUT[0], IN[t], SAMP[0] */
+      if (is_simple_tex(&insts[0], TGSI_FILE_OUTPUT)) {
+         *tex_input = insts[0].Src[0].Register.Index;
+         return LP_LINEAR_TEX;
+      }
+   }
+   else if (num_insts == 2) {
+      /* TEX TEMP[x], IN[t], SAMP[0]
+       * MUL OUT[0], TEMP[x], IN[c]   (either operand order)
+       */
+      const struct tgsi_full_instruction *mul = &insts[1];
+      unsigned temp = insts[0].Dst[0].Register.Index;
+
+      if (is_simple_tex(&insts[0], TGSI_FILE_TEMPORARY) &&
+          mul->Instruction.Opcode == TGSI_OPCODE_MUL &&
+          is_plain_dst(&mul->Dst[0], TGSI_FILE_OUTPUT)) {
+         unsigned i;
+
+         for (i = 0; i < 2; i++) {
+            if (is_plain_src(&mul->Src[i], TGSI_FILE_TEMPORARY) &&
+                mul->Src[i].Register.Index == temp &&
+                is_plain_src(&mul->Src[1 - i], TGSI_FILE_INPUT)) {
+               *tex_input = insts[0].Src[0].Register.Index;
+               *color_input = mul->Src[1 - i].Register.Index;
+               return LP_LINEAR_TEX_MODULATE;
+            }
+         }
+      }
+   }
+
+   return LP_LINEAR_NONE;
+}
+
+
+/**
+ * Resolve the interpolation of an fs input.
+ * \return FALSE if the linear path can't interpolate it.
+ */
+static boolean
+input_interp(const struct lp_fragment_shader_variant *variant,
+             unsigned input,
+             boolean *perspective)
+{
+   const struct lp_shader_input *in = &variant->shader->inputs[input];
+
+   if (in->cyl_wrap)
+      return FALSE;
+
+   switch (in->interp) {
+   case LP_INTERP_CONSTANT:
+   case LP_INTERP_LINEAR:
+      *perspective = FALSE;
+      return TRUE;
+   case LP_INTERP_PERSPECTIVE:
+      *perspective = TRUE;
+      return TRUE;
+   case LP_INTERP_COLOR:
+      *perspective = !variant->key.flatshade;
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+/**
+ * 8-bit unorm formats with four 8-bit channels in B,G,R,A or R,G,B,A
+ * memory order.
+ */
+static boolean
+is_linear_format(enum pipe_format format, boolean *rgba, boolean *has_alpha)
+{
+   switch (format) {
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+      *rgba = FALSE;
+      *has_alpha = TRUE;
+      return TRUE;
+   case PIPE_FORMAT_B8G8R8X8_UNORM:
+      *rgba = FALSE;
+      *has_alpha = FALSE;
+      return TRUE;
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+      *rgba = TRUE;
+      *has_alpha = TRUE;
+      return TRUE;
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+      *rgba = TRUE;
+      *has_alpha = FALSE;
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+static boolean
+is_linear_wrap(unsigned wrap, boolean pot)
+{
+   return wrap == PIPE_TEX_WRAP_CLAMP_TO_EDGE ||
+          (wrap == PIPE_TEX_WRAP_REPEAT && pot);
+}
+
+
+/**
+ * Decide whether a new variant can use the linear path, and fill in
+ * variant->linear accordingly.
+ */
+void
+lp_linear_init_variant(struct lp_fragment_shader_variant *variant)
+{
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+   const struct pipe_rt_blend_state *rt = &key->blend.rt[0];
+   struct lp_linear_info *linear = &variant->linear;
+   unsigned tex_input = 0, color_input = 0;
+   boolean cbuf_rgba, cbuf_alpha;
+   unsigned kind;
+
+   memset(linear, 0, sizeof *linear);
+
+   if (!(LP_PERF & PERF_LINEAR_FS))
+      return;
+
+#ifndef PIPE_ARCH_LITTLE_ENDIAN
+   /* Pixels are handled as packed 32-bit words. */
+   return;
+#endif
+
+   if (key->nr_cbufs != 1 ||
+       !is_linear_format(key->cbuf_format[0], &cbuf_rgba, &cbuf_alpha) ||
+       !util_format_colormask_full(util_format_description(key->cbuf_format[0]),
+                                   rt->colormask) ||
+       key->depth.enabled ||
+       key->stencil[0].enabled ||
+       key->alpha.enabled ||
+       key->occlusion_count ||
+       key->blend.logicop_enable ||
+       key->blend.alpha_to_coverage)
+      return;
+
+   if (rt->blend_enable) {
+      if (rt->rgb_func != PIPE_BLEND_ADD ||
+          rt->alpha_func != PIPE_BLEND_ADD ||
+          rt->rgb_src_factor != rt->alpha_src_factor ||
+          rt->rgb_dst_factor != PIPE_BLENDFACTOR_INV_SRC_ALPHA ||
+          rt->alpha_dst_factor != PIPE_BLENDFACTOR_INV_SRC_ALPHA)
+         return;
+
+      if (rt->rgb_src_factor == PIPE_BLENDFACTOR_SRC_ALPHA)
+         linear->blend = LP_LINEAR_BLEND_ALPHA;
+      else if (rt->rgb_src_factor == PIPE_BLENDFACTOR_ONE)
+         linear->blend = LP_LINEAR_BLEND_PREMUL;
+      else
+         return;
+   }
+
+   kind = analyse_shader(variant->shader, &tex_input, &color_input);
+   if (kind == LP_LINEAR_NONE)
+      return;
+
+   if (kind != LP_LINEAR_TEX) {
+      boolean perspective;
+      if (!input_interp(variant, color_input, &perspective))
+         return;
+      linear->color_input = color_input;
+      linear->color_perspective = perspective;
+   }
+
+   if (kind != LP_LINEAR_COLOR) {
+      const struct lp_static_texture_state *texture =
+         &key->state[0].texture_state;
+      const struct lp_static_sampler_state *sampler =
+         &key->state[0].sampler_state;
+      boolean tex_rgba, tex_alpha, perspective;
+
+      if (key->nr_samplers < 1 ||
+          key->nr_sampler_views < 1 ||
+          !is_linear_format(texture->format, &tex_rgba, &tex_alpha) ||
+          texture->swizzle_r != PIPE_SWIZZLE_X ||
+          texture->swizzle_g != PIPE_SWIZZLE_Y ||
+          texture->swizzle_b != PIPE_SWIZZLE_Z ||
+          (texture->swizzle_a != PIPE_SWIZZLE_W &&
+           texture->swizzle_a != PIPE_SWIZZLE_1) ||
+          (texture->target != PIPE_TEXTURE_2D &&
+           texture->target != PIPE_TEXTURE_RECT) ||
+          sampler->min_mip_filter != PIPE_TEX_MIPFILTER_NONE ||
+          sampler->min_img_filter != sampler->mag_img_filter ||
+          sampler->compare_mode ||
+          sampler->force_nearest_s ||
+          sampler->force_nearest_t ||
+          !is_linear_wrap(sampler->wrap_s, texture->pot_width) ||
+          !is_linear_wrap(sampler->wrap_t, texture->pot_height) ||
+          !input_interp(variant, tex_input, &perspective))
+         return;
+
+      linear->tex_input = tex_input;
+      linear->tex_perspective = perspective;
+      linear->tex_bilinear =
+         sampler->min_img_filter == PIPE_TEX_FILTER_LINEAR;
+      linear->tex_swap_rb = tex_rgba != cbuf_rgba;
+      linear->tex_alpha_one = !tex_alpha ||
+                              texture->swizzle_a == PIPE_SWIZZLE_1;
+   }
+
+   linear->cbuf_rgba = cbuf_rgba;
+   linear->kind = kind;
+}
+
+
+/** Swap the R and B bytes of a packed pixel */
+static inline uint32_t
+swap_rb(uint32_t p)
+{
+   return (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+}
+
+
+static inline int
+wrap_coord(int i, int size, unsigned wrap)
+{
+   if (wrap == PIPE_TEX_WRAP_REPEAT)
+      return i & (size - 1);
+   return CLAMP(i, 0, size - 1);
+}
+
+
+/**
+ * Per-command state: everything which is constant across the spans of
+ * one primitive.
+ */
+struct linear_setup
+{
+   const struct lp_linear_info *linear;
+
+   /* texture coordinates, and their scale to texels (times 256 for
+    * bilinear)
+    */
+   float s0, dsdx, dsdy;
+   float t0, dtdx, dtdy;
+   float scale_s, scale_t;
+
+   const uint8_t *tex_data;
+   unsigned tex_stride;
+   int tex_width, tex_height;
+   unsigned wrap_s, wrap_t;
+
+   /* constant color, packed in cbuf order */
+   uint32_t color;
+
+   /* modulation tables, in cbuf channel order */
+   uint8_t modulate[4][256];
+};
+
+
+/**
+ * Fetch the texel for pixel (x, y), packed in cbuf order.
+ */
+static inline uint32_t
+fetch_texel(const struct linear_setup *setup, int x, int y)
+{
+   const struct lp_linear_info *linear = setup->linear;
+   float s = (setup->s0 + setup->dsdx * x + setup->dsdy * y) * setup->scale_s;
+   float t = (setup->t0 + setup->dtdx * x + setup->dtdy * y) * setup->scale_t;
+   uint32_t texel;
+
+   if (linear->tex_bilinear) {
+      /* 8.8 fixed point, minus half a texel, as in
+       * lp_build_sample_image_linear()
+       */
+      int sf = util_iround(s) - 128;
+      int tf = util_iround(t) - 128;
+      int s0 = sf >> 8, t0 = tf >> 8;
+      int s1 = wrap_coord(s0 + 1, setup->tex_width, setup->wrap_s);
+      int t1 = wrap_coord(t0 + 1, setup->tex_height, setup->wrap_t);
+      const uint8_t *row0, *row1;
+      uint32_t p00, p01, p10, p11;
+
+      s0 = wrap_coord(s0, setup->tex_width, setup->wrap_s);
+      t0 = wrap_coord(t0, setup->tex_height, setup->wrap_t);
+
+      row0 = setup->tex_data + t0 * setup->tex_stride;
+      row1 = setup->tex_data + t1 * setup->tex_stride;
+      p00 = *(const uint32_t *)(row0 + s0 * 4);
+      p01 = *(const uint32_t *)(row0 + s1 * 4);
+      p10 = *(const uint32_t *)(row1 + s0 * 4);
+      p11 = *(const uint32_t *)(row1 + s1 * 4);
+
+      texel = lp_linear_lerp_pixel(lp_linear_lerp_pixel(p00, p01, sf & 0xff),
+                                   lp_linear_lerp_pixel(p10, p11, sf & 0xff),
+                                   tf & 0xff);
+   }
+   else {
+      int si = wrap_coord(util_ifloor(s), setup->tex_width, setup->wrap_s);
+      int ti = wrap_coord(util_ifloor(t), setup->tex_height, setup->wrap_t);
+
+      texel = *(const uint32_t *)(setup->tex_data +
+                                  ti * setup->tex_stride + si * 4);
+   }
+
+   if (linear->tex_swap_rb)
+      texel = swap_rb(texel);
+   if (linear->tex_alpha_one)
+      texel |= 0xff000000;
+
+   return texel;
+}
+
+
+static inline uint32_t
+modulate_pixel(const struct linear_setup *setup, uint32_t p)
+{
+   return ((uint32_t)setup->modulate[0][p & 0xff]) |
+          ((uint32_t)setup->modulate[1][(p >> 8) & 0xff] << 8) |
+          ((uint32_t)setup->modulate[2][(p >> 16) & 0xff] << 16) |
+          ((uint32_t)setup->modulate[3][p >> 24] << 24);
+}
+
+
+/**
+ * Evaluate an attribute's plane equation as an affine function of the
+ * pixel position.
+ * \return FALSE if the attribute isn't affine in screen space.
+ */
+static boolean
+setup_attrib(const struct lp_rast_shader_inputs *inputs,
+             unsigned attrib, unsigned chan, boolean perspective,
+             float *a0, float *dadx, float *dady)
+{
+   const float (*coef_a0)[4] = (const float (*)[4])GET_A0(inputs);
+   const float (*coef_dadx)[4] = (const float (*)[4])GET_DADX(inputs);
+   const float (*coef_dady)[4] = (const float (*)[4])GET_DADY(inputs);
+   float scale = 1.0f;
+
+   if (perspective) {
+      /* Only affine if 1/w is constant over the primitive. */
+      if (coef_dadx[0][3] != 0.0f || coef_dady[0][3] != 0.0f)
+         return FALSE;
+      scale = 1.0f / coef_a0[0][3];
+   }
+
+   *a0 = coef_a0[attrib][chan] * scale;
+   *dadx = coef_dadx[attrib][chan] * scale;
+   *dady = coef_dady[attrib][chan] * scale;
+   return TRUE;
+}
+
+
+static boolean
+setup_texture(struct linear_setup *setup,
+              const struct lp_rasterizer_task *task,
+              const struct lp_rast_shader_inputs *inputs)
+{
+   const struct lp_linear_info *linear = setup->linear;
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   const struct lp_static_sampler_state *sampler =
+      &variant->key.state[0].sampler_state;
+   const struct lp_jit_texture *tex = &task->state->jit_context.textures[0];
+   const unsigned level = tex->first_level;
+   const unsigned attrib = linear->tex_input + 1;
+
+   if (!tex->base)
+      return FALSE;
+
+   if (!setup_attrib(inputs, attrib, 0, linear->tex_perspective,
+                     &setup->s0, &setup->dsdx, &setup->dsdy) ||
+       !setup_attrib(inputs, attrib, 1, linear->tex_perspective,
+                     &setup->t0, &setup->dtdx, &setup->dtdy))
+      return FALSE;
+
+   setup->tex_width = u_minify(tex->width, level);
+   setup->tex_height = u_minify(tex->height, level);
+   setup->tex_data = (const uint8_t *)tex->base + tex->mip_offsets[level];
+   setup->tex_stride = tex->row_stride[level];
+   setup->wrap_s = sampler->wrap_s;
+   setup->wrap_t = sampler->wrap_t;
+
+   /* Scaled after interpolation, the way the sampler code does it */
+   setup->scale_s = 1.0f;
+   setup->scale_t = 1.0f;
+   if (sampler->normalized_coords) {
+      setup->scale_s = (float)setup->tex_width;
+      setup->scale_t = (float)setup->tex_height;
+   }
+   if (linear->tex_bilinear) {
+      setup->scale_s *= 256.0f;
+      setup->scale_t *= 256.0f;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Set up the constant color, or the tables modulating texels with it.
+ * \return FALSE if the color varies over the primitive.
+ */
+static boolean
+setup_color(struct linear_setup *setup,
+            const struct lp_rast_shader_inputs *inputs)
+{
+   const struct lp_linear_info *linear = setup->linear;
+   const unsigned attrib = linear->color_input + 1;
+   float color[4];
+   unsigned chan;
+
+   for (chan = 0; chan < 4; chan++) {
+      float dadx, dady;
+      if (!setup_attrib(inputs, attrib, chan, linear->color_perspective,
+                        &color[chan], &dadx, &dady) ||
+          dadx != 0.0f || dady != 0.0f)
+         return FALSE;
+   }
+
+   /* cbuf channel order */
+   if (!linear->cbuf_rgba) {
+      float tmp = color[0];
+      color[0] = color[2];
+      color[2] = tmp;
+   }
+
+   if (linear->kind == LP_LINEAR_COLOR) {
+      setup->color = 0;
+      for (chan = 0; chan < 4; chan++)
+         setup->color |= (uint32_t)float_to_ubyte(color[chan]) << (chan * 8);
+   }
+   else {
+      /* Tabulate converting the texel to float, multiplying and
+       * converting back.
+       */
+      for (chan = 0; chan < 4; chan++) {
+         unsigned i;
+         for (i = 0; i < 256; i++)
+            setup->modulate[chan][i] =
+               lp_linear_modulate8(i, color[chan]);
+      }
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Shade the pixels of 'box' (inclusive, within the current tile) with
+ * the linear path.
+ * \return FALSE if the current variant or primitive can't use it, in
+ *         which case nothing was done.
+ */
+boolean
+lp_linear_rasterize_rect(struct lp_rasterizer_task *task,
+                         const struct lp_rast_shader_inputs *inputs,
+                         const struct u_rect *box)
+{
+   const struct lp_scene *scene = task->scene;
+   const struct lp_linear_info *linear = &task->state->variant->linear;
+   struct linear_setup setup;
+   unsigned stride;
+   uint8_t *row;
+   int x, y;
+
+   if (linear->kind == LP_LINEAR_NONE)
+      return FALSE;
+
+   setup.linear = linear;
+
+   if (linear->kind != LP_LINEAR_COLOR &&
+       !setup_texture(&setup, task, inputs))
+      return FALSE;
+
+   if (linear->kind != LP_LINEAR_TEX &&
+       !setup_color(&setup, inputs))
+      return FALSE;
+
+   stride = scene->cbufs[0].stride;
+   row = task->color_tiles[0] +
+         (box->y0 % TILE_SIZE) * stride +
+         (box->x0 % TILE_SIZE) * 4;
+   if (inputs->layer)
+      row += inputs->layer * scene->cbufs[0].layer_stride;
+
+   for (y = box->y0; y <= box->y1; y++) {
+      uint32_t *dst = (uint32_t *)row;
+
+      for (x = box->x0; x <= box->x1; x++) {
+         uint32_t src;
+
+         if (linear->kind == LP_LINEAR_COLOR) {
+            src = setup.color;
+         }
+         else {
+            src = fetch_texel(&setup, x, y);
+            if (linear->kind == LP_LINEAR_TEX_MODULATE)
+               src = modulate_pixel(&setup, src);
+         }
+
+         if (linear->blend != LP_LINEAR_BLEND_NONE)
+            src = lp_linear_blend_pixel(linear->blend, src, *dst);
+
+         *dst++ = src;
+      }
+
+      row += stride;
+   }
+
+   return TRUE;
+}
@@ -0,0 +1,170 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Linear fragment path: shades whole spans of simple 2D fragment shaders
+ * (texture copy, constant color, texture modulated by a constant color)
+ * with 8-bit fixed-point arithmetic on packed pixels, bypassing the SoA
+ * float pipeline.
+ */
+
+#ifndef LP_LINEAR_H
+#define LP_LINEAR_H
+
+#include "pipe/p_compiler.h"
+#include "util/u_math.h"
+
+
+struct u_rect;
+struct lp_fragment_shader_variant;
+struct lp_rasterizer_task;
+struct lp_rast_shader_inputs;
+
+
+#define LP_LINEAR_NONE          0
+#define LP_LINEAR_COLOR         1  /**< OUT = IN[color] */
+#define LP_LINEAR_TEX           2  /**< OUT = TEX(IN[tex]) */
+#define LP_LINEAR_TEX_MODULATE  3  /**< OUT = TEX(IN[tex]) * IN[color] */
+
+#define LP_LINEAR_BLEND_NONE     0
+#define LP_LINEAR_BLEND_ALPHA    1  /**< SRC_ALPHA, INV_SRC_ALPHA */
+#define LP_LINEAR_BLEND_PREMUL   2  /**< ONE, INV_SRC_ALPHA */
+
+
+/**
+ * Per-variant description of what the linear path has to do, filled in
+ * at variant creation.  kind is LP_LINEAR_NONE if the variant can't use
+ * the linear path at all.
+ */
+struct lp_linear_info
+{
+   unsigned kind:2;
+   unsigned blend:2;
+   unsigned tex_input:8;        /**< fs input index of the texcoords */
+   unsigned color_input:8;      /**< fs input index of the color */
+   unsigned tex_perspective:1;
+   unsigned color_perspective:1;
+   unsigned tex_bilinear:1;
+   unsigned tex_swap_rb:1;      /**< texel and cbuf R/B order differ */
+   unsigned tex_alpha_one:1;    /**< texture has no alpha channel */
+   unsigned cbuf_rgba:1;        /**< cbuf is R,G,B,A in memory */
+};
+
+
+void
+lp_linear_init_variant(struct lp_fragment_shader_variant *variant);
+
+boolean
+lp_linear_rasterize_rect(struct lp_rasterizer_task *task,
+                         const struct lp_rast_shader_inputs *inputs,
+                         const struct u_rect *box);
+
+
+/*
+ * Per-pixel arithmetic of the linear path, on pixels packed in 32 bits
+ * with alpha in the top byte.  Each has to give the same result as the
+ * code generated for 8-bit unorm data, which lp_test_linear checks.
+ */
+
+
+/**
+ * 8-bit lerp with 8.8 fixed-point weight, as lp_build_lerp() does with
+ * prescaled weights.
+ */
+static inline int
+lp_linear_lerp8(int v0, int v1, int w)
+{
+   return v0 + (((v1 - v0) * w) >> 8);
+}
+
+
+static inline uint32_t
+lp_linear_lerp_pixel(uint32_t p0, uint32_t p1, int w)
+{
+   uint32_t res = 0;
+   unsigned shift;
+
+   for (shift = 0; shift < 32; shift += 8) {
+      int c0 = (p0 >> shift) & 0xff;
+      int c1 = (p1 >> shift) & 0xff;
+      res |= (uint32_t)(lp_linear_lerp8(c0, c1, w) & 0xff) << shift;
+   }
+   return res;
+}
+
+
+/**
+ * a * b / 255 with rounding, as lp_build_mul_norm() does.
+ */
+static inline unsigned
+lp_linear_mul_norm8(unsigned a, unsigned b)
+{
+   unsigned ab = a * b;
+   return (ab + (ab >> 8) + 0x80) >> 8;
+}
+
+
+/**
+ * Blend a pixel with LP_LINEAR_BLEND_ALPHA or LP_LINEAR_BLEND_PREMUL, as
+ * lp_build_blend_aos() does.
+ */
+static inline uint32_t
+lp_linear_blend_pixel(unsigned blend, uint32_t src, uint32_t dst)
+{
+   unsigned a = src >> 24;
+   uint32_t res = 0;
+   unsigned shift;
+
+   if (blend == LP_LINEAR_BLEND_ALPHA) {
+      /* complementary factors, lp_build_blend() uses a lerp */
+      int w = a + (a >> 7);
+      for (shift = 0; shift < 32; shift += 8) {
+         int s = (src >> shift) & 0xff;
+         int d = (dst >> shift) & 0xff;
+         res |= (uint32_t)(lp_linear_lerp8(d, s, w) & 0xff) << shift;
+      }
+   }
+   else {
+      for (shift = 0; shift < 32; shift += 8) {
+         unsigned s = (src >> shift) & 0xff;
+         unsigned d = (dst >> shift) & 0xff;
+         res |= MIN2(s + lp_linear_mul_norm8(d, 255 - a), 255) << shift;
+      }
+   }
+   return res;
+}
+
+
+/**
+ * An 8-bit texel channel modulated by a color channel, through float
+ * the way the shader does it.
+ */
+static inline ubyte
+lp_linear_modulate8(unsigned texel, float color)
+{
+   return float_to_ubyte(ubyte_to_float(texel) * color);
+}
+
+
+#endif /* LP_LINEAR_H */
@@ -31,80 +31,115 @@
 
 
 
-struct lp_counters lp_count;
+#define COUNTER(NAME, FIELD) \
+   {NAME, offsetof(struct lp_counters, FIELD), FALSE}
+
+const struct lp_counter_info lp_counter_info[LP_NUM_COUNTER_INFO] = {
+   COUNTER("triangles", nr_tris),
+   COUNTER("culled-triangles", nr_culled_tris),
+   COUNTER("rectangles", nr_rects),
+   COUNTER("block-prims", nr_block_prims),
+   COUNTER("block-triangles", nr_block_tris),
+   COUNTER("empty-64x64", nr_empty_64),
+   COUNTER("fully-covered-64x64", nr_fully_covered_64),
+   COUNTER("partially-covered-64x64", nr_partially_covered_64),
+   COUNTER("shade-opaque-64x64", nr_shade_opaque_64),
+   COUNTER("pure-shade-opaque-64x64", nr_pure_shade_opaque_64),
+   COUNTER("shade-64x64", nr_shade_64),
+   COUNTER("pure-shade-64x64", nr_pure_shade_64),
+   COUNTER("empty-16x16", nr_empty_16),
+   COUNTER("fully-covered-16x16", nr_fully_covered_16),
+   COUNTER("partially-covered-16x16", nr_partially_covered_16),
+   COUNTER("empty-4x4", nr_empty_4),
+   COUNTER("fully-covered-4x4", nr_fully_covered_4),
+   COUNTER("partially-covered-4x4", nr_partially_covered_4),
+   COUNTER("color-tile-clears", nr_color_tile_clear),
+   COUNTER("llvm-compiles", nr_llvm_compiles),
+   {"llvm-compile-time", offsetof(struct lp_counters, llvm_compile_time), TRUE},
+};
+
+#undef COUNTER
 
 
 void
-lp_reset_counters(void)
+lp_counters_add(struct lp_counters *dst, const struct lp_counters *src)
 {
-   memset(&lp_count, 0, sizeof(lp_count));
+   uint64_t *d = (uint64_t *)dst;
+   const uint64_t *s = (const uint64_t *)src;
+   unsigned i;
+
+   for (i = 0; i < sizeof *dst / sizeof *d; i++)
+      d[i] += s[i];
 }
 
 
 void
-lp_print_counters(void)
+lp_print_counters(const struct lp_counters *counters)
 {
    if (LP_DEBUG & DEBUG_COUNTERS) {
       unsigned total_64, total_16, total_4;
       float p1, p2, p3, p4, p5, p6;
 
-      debug_printf("llvmpipe: nr_triangles:                 %9u\n", lp_count.nr_tris);
-      debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
+      debug_printf("llvmpipe: nr_triangles:                 %9u\n", (unsigned) counters->nr_tris);
+      debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", (unsigned) counters->nr_culled_tris);
+      debug_printf("llvmpipe: nr_rectangles:                %9u\n", (unsigned) counters->nr_rects);
+      debug_printf("llvmpipe: nr_block_prims:               %9u\n", (unsigned) counters->nr_block_prims);
+      debug_printf("llvmpipe: nr_block_tris:                %9u\n", (unsigned) counters->nr_block_tris);
 
-      total_64 = (lp_count.nr_empty_64 + 
-                  lp_count.nr_fully_covered_64 +
-                  lp_count.nr_partially_covered_64);
+      total_64 = (counters->nr_empty_64 + 
+                  counters->nr_fully_covered_64 +
+                  counters->nr_partially_covered_64);
 
-      p1 = 100.0 * (float) lp_count.nr_empty_64 / (float) total_64;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_64 / (float) total_64;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_64 / (float) total_64;
-      p5 = 100.0 * (float) lp_count.nr_shade_opaque_64 / (float) total_64;
-      p6 = 100.0 * (float) lp_count.nr_shade_64 / (float) total_64;
+      p1 = 100.0 * (float) counters->nr_empty_64 / (float) total_64;
+      p2 = 100.0 * (float) counters->nr_fully_covered_64 / (float) total_64;
+      p3 = 100.0 * (float) counters->nr_partially_covered_64 / (float) total_64;
+      p5 = 100.0 * (float) counters->nr_shade_opaque_64 / (float) total_64;
+      p6 = 100.0 * (float) counters->nr_shade_64 / (float) total_64;
 
       debug_printf("llvmpipe: nr_64x64:                     %9u\n", total_64);
-      debug_printf("llvmpipe:   nr_fully_covered_64x64:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_64, p2, total_64);
-      debug_printf("llvmpipe:     nr_shade_opaque_64x64:    %9u (%3.0f%% of %u)\n", lp_count.nr_shade_opaque_64, p5, total_64);
-      debug_printf("llvmpipe:        nr_pure_shade_opaque:  %9u (%3.0f%% of %u)\n", lp_count.nr_pure_shade_opaque_64, 0.0, lp_count.nr_shade_opaque_64);
-      debug_printf("llvmpipe:     nr_shade_64x64:           %9u (%3.0f%% of %u)\n", lp_count.nr_shade_64, p6, total_64);
-      debug_printf("llvmpipe:        nr_pure_shade:         %9u (%3.0f%% of %u)\n", lp_count.nr_pure_shade_64, 0.0, lp_count.nr_shade_64);
-      debug_printf("llvmpipe:   nr_partially_covered_64x64: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_64, p3, total_64);
-      debug_printf("llvmpipe:   nr_empty_64x64:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_64, p1, total_64);
-
-      total_16 = (lp_count.nr_empty_16 + 
-                  lp_count.nr_fully_covered_16 +
-                  lp_count.nr_partially_covered_16);
-
-      p1 = 100.0 * (float) lp_count.nr_empty_16 / (float) total_16;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_16 / (float) total_16;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_16 / (float) total_16;
+      debug_printf("llvmpipe:   nr_fully_covered_64x64:     %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_fully_covered_64, p2, total_64);
+      debug_printf("llvmpipe:     nr_shade_opaque_64x64:    %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_shade_opaque_64, p5, total_64);
+      debug_printf("llvmpipe:        nr_pure_shade_opaque:  %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_pure_shade_opaque_64, 0.0, (unsigned) counters->nr_shade_opaque_64);
+      debug_printf("llvmpipe:     nr_shade_64x64:           %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_shade_64, p6, total_64);
+      debug_printf("llvmpipe:        nr_pure_shade:         %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_pure_shade_64, 0.0, (unsigned) counters->nr_shade_64);
+      debug_printf("llvmpipe:   nr_partially_covered_64x64: %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_partially_covered_64, p3, total_64);
+      debug_printf("llvmpipe:   nr_empty_64x64:             %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_empty_64, p1, total_64);
+
+      total_16 = (counters->nr_empty_16 + 
+                  counters->nr_fully_covered_16 +
+                  counters->nr_partially_covered_16);
+
+      p1 = 100.0 * (float) counters->nr_empty_16 / (float) total_16;
+      p2 = 100.0 * (float) counters->nr_fully_covered_16 / (float) total_16;
+      p3 = 100.0 * (float) counters->nr_partially_covered_16 / (float) total_16;
 
       debug_printf("llvmpipe: nr_16x16:                     %9u\n", total_16);
-      debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_16, p2, total_16);
-      debug_printf("llvmpipe:   nr_partially_covered_16x16: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_16, p3, total_16);
-      debug_printf("llvmpipe:   nr_empty_16x16:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_16, p1, total_16);
+      debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_fully_covered_16, p2, total_16);
+      debug_printf("llvmpipe:   nr_partially_covered_16x16: %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_partially_covered_16, p3, total_16);
+      debug_printf("llvmpipe:   nr_empty_16x16:             %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_empty_16, p1, total_16);
 
-      total_4 = (lp_count.nr_empty_4 +
-                 lp_count.nr_fully_covered_4 +
-                 lp_count.nr_partially_covered_4);
+      total_4 = (counters->nr_empty_4 +
+                 counters->nr_fully_covered_4 +
+                 counters->nr_partially_covered_4);
 
-      p1 = 100.0 * (float) lp_count.nr_empty_4 / (float) total_4;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_4 / (float) total_4;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_4 / (float) total_4;
-      p4 = 100.0 * (float) lp_count.nr_non_empty_4 / (float) total_4;
+      p1 = 100.0 * (float) counters->nr_empty_4 / (float) total_4;
+      p2 = 100.0 * (float) counters->nr_fully_covered_4 / (float) total_4;
+      p3 = 100.0 * (float) counters->nr_partially_covered_4 / (float) total_4;
+      p4 = 100.0 * (float) counters->nr_non_empty_4 / (float) total_4;
 
       debug_printf("llvmpipe: nr_tri_4x4:                   %9u\n", total_4);
-      debug_printf("llvmpipe:   nr_fully_covered_4x4:       %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_4, p2, total_4);
-      debug_printf("llvmpipe:   nr_partially_covered_4x4:   %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_4, p3, total_4);
-      debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", lp_count.nr_empty_4, p1, total_4);
-      debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p4, total_4);
-
-      debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
-      debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
-      debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
-
-      debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
-      debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
-      debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
+      debug_printf("llvmpipe:   nr_fully_covered_4x4:       %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_fully_covered_4, p2, total_4);
+      debug_printf("llvmpipe:   nr_partially_covered_4x4:   %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_partially_covered_4, p3, total_4);
+      debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_empty_4, p1, total_4);
+      debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", (unsigned) counters->nr_non_empty_4, p4, total_4);
+
+      debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", (unsigned) counters->nr_color_tile_clear);
+      debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", (unsigned) counters->nr_color_tile_load);
+      debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", (unsigned) counters->nr_color_tile_store);
+
+      debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", (unsigned) counters->nr_llvm_compiles);
+      debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", counters->llvm_compile_time / 1000000.0);
+      debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", counters->llvm_compile_time / 1000000.0 / counters->nr_llvm_compiles);
 
    }
 }
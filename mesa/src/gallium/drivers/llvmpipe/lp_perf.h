@@ -36,56 +36,82 @@
 #include "pipe/p_compiler.h"
 
 /**
- * Various counters
+ * Various counters.
+ *
+ * Setup counts into the scene being binned and each rasterizer thread
+ * into its own task, so nothing needs to be atomic.  When a scene has
+ * been rasterized the task counts are folded into the scene and the
+ * scene's into its context, where the driver queries read them.
+ * All fields are uint64_t; see lp_counter_info.
  */
 struct lp_counters
 {
-   unsigned nr_tris;
-   unsigned nr_culled_tris;
-   unsigned nr_empty_64;
-   unsigned nr_fully_covered_64;
-   unsigned nr_partially_covered_64;
-   unsigned nr_pure_shade_opaque_64;
-   unsigned nr_pure_shade_64;
-   unsigned nr_shade_64;
-   unsigned nr_shade_opaque_64;
-   unsigned nr_empty_16;
-   unsigned nr_fully_covered_16;
-   unsigned nr_partially_covered_16;
-   unsigned nr_empty_4;
-   unsigned nr_fully_covered_4;
-   unsigned nr_partially_covered_4;
-   unsigned nr_non_empty_4;
-   unsigned nr_llvm_compiles;
-   int64_t llvm_compile_time;  /**< total, in microseconds */
-
-   unsigned nr_color_tile_clear;
-   unsigned nr_color_tile_load;
-   unsigned nr_color_tile_store;
+   uint64_t nr_tris;
+   uint64_t nr_culled_tris;
+   uint64_t nr_rects;
+   uint64_t nr_block_prims;
+   uint64_t nr_block_tris;
+   uint64_t nr_empty_64;
+   uint64_t nr_fully_covered_64;
+   uint64_t nr_partially_covered_64;
+   uint64_t nr_pure_shade_opaque_64;
+   uint64_t nr_pure_shade_64;
+   uint64_t nr_shade_64;
+   uint64_t nr_shade_opaque_64;
+   uint64_t nr_empty_16;
+   uint64_t nr_fully_covered_16;
+   uint64_t nr_partially_covered_16;
+   uint64_t nr_empty_4;
+   uint64_t nr_fully_covered_4;
+   uint64_t nr_partially_covered_4;
+   uint64_t nr_non_empty_4;
+   uint64_t nr_llvm_compiles;
+   uint64_t llvm_compile_time;  /**< total, in microseconds */
+
+   uint64_t nr_color_tile_clear;
+   uint64_t nr_color_tile_load;
+   uint64_t nr_color_tile_store;
+};
+
+
+/**
+ * Describes a counter exposed as a driver query.
+ */
+struct lp_counter_info
+{
+   const char *name;
+   unsigned offset;       /**< offsetof(struct lp_counters, ...) */
+   boolean microseconds;
 };
 
+#define LP_NUM_COUNTER_INFO 21
+
+extern const struct lp_counter_info lp_counter_info[LP_NUM_COUNTER_INFO];
+
 
-extern struct lp_counters lp_count;
+/**
+ * Increment the named counter of a scene, rasterizer task or context,
+ * i.e. anything with a "counters" member.
+ */
+#define LP_COUNT(owner, counter) (owner)->counters.counter++
+#define LP_COUNT_ADD(owner, counter, incr)  (owner)->counters.counter += (incr)
+#define LP_COUNT_GET(owner, counter) ((owner)->counters.counter)
 
 
-/** Increment the named counter (only for debug builds) */
-#ifdef DEBUG
-#define LP_COUNT(counter) lp_count.counter++
-#define LP_COUNT_ADD(counter, incr)  lp_count.counter += (incr)
-#define LP_COUNT_GET(counter) (lp_count.counter)
-#else
-#define LP_COUNT(counter)
-#define LP_COUNT_ADD(counter, incr) (void)(incr)
-#define LP_COUNT_GET(counter) 0
-#endif
+static inline uint64_t
+lp_counter_value(const struct lp_counters *counters, unsigned index)
+{
+   return *(const uint64_t *)((const char *)counters +
+                              lp_counter_info[index].offset);
+}
 
 
 extern void
-lp_reset_counters(void);
+lp_counters_add(struct lp_counters *dst, const struct lp_counters *src);
 
 
 extern void
-lp_print_counters(void);
+lp_print_counters(const struct lp_counters *counters);
 
 
 #endif /* LP_PERF_H */
@@ -55,7 +55,8 @@ llvmpipe_create_query(struct pipe_context *pipe,
 {
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= PIPE_QUERY_DRIVER_SPECIFIC && type < LP_QUERY_DRIVER_LAST));
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
@@ -67,6 +68,31 @@ llvmpipe_create_query(struct pipe_context *pipe,
 }
 
 
+/**
+ * Current value of a driver-specific query's counter.
+ */
+static uint64_t
+llvmpipe_driver_query_value(struct llvmpipe_context *llvmpipe,
+                            unsigned type)
+{
+   const struct lp_setup_scene_stats *stats =
+      lp_setup_get_scene_stats(llvmpipe->setup);
+
+   switch (type) {
+   case LP_QUERY_FORCED_FLUSHES:
+      return stats->forced_flushes;
+   case LP_QUERY_SCENE_MAX_SIZE:
+      return stats->max_size;
+   case LP_QUERY_SCENE_MAX_RESOURCE_SIZE:
+      return stats->max_resource_size;
+   default:
+      assert(type >= LP_QUERY_COUNTER_FIRST && type < LP_QUERY_DRIVER_LAST);
+      return lp_counter_value(&llvmpipe->counters,
+                              type - LP_QUERY_COUNTER_FIRST);
+   }
+}
+
+
 static void
 llvmpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
 {
@@ -175,7 +201,21 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       *stats = pq->stats;
    }
       break;
+   case LP_QUERY_FORCED_FLUSHES:
+      *result = pq->end[0] - pq->start[0];
+      break;
+   case LP_QUERY_SCENE_MAX_SIZE:
+   case LP_QUERY_SCENE_MAX_RESOURCE_SIZE:
+      /* the limit in use when the query ended */
+      *result = pq->end[0];
+      break;
    default:
+      if (pq->type >= LP_QUERY_COUNTER_FIRST &&
+          pq->type < LP_QUERY_DRIVER_LAST) {
+         /* counts land in the context as scenes get rasterized */
+         *result = pq->end[0] - pq->start[0];
+         break;
+      }
       assert(0);
       break;
    }
@@ -190,6 +230,14 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   /* Driver queries are sampled at binning time and never enter the
+    * scene.
+    */
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->start[0] = llvmpipe_driver_query_value(llvmpipe, pq->type);
+      return true;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -245,6 +293,11 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->end[0] = llvmpipe_driver_query_value(llvmpipe, pq->type);
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
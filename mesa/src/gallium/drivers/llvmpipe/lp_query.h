@@ -36,11 +36,22 @@
 #include <limits.h>
 #include "os/os_thread.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 struct llvmpipe_context;
 
 
+/* Driver-specific queries, listed by llvmpipe_get_driver_query_info():
+ */
+#define LP_QUERY_FORCED_FLUSHES           (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_SCENE_MAX_SIZE           (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+#define LP_QUERY_SCENE_MAX_RESOURCE_SIZE  (PIPE_QUERY_DRIVER_SPECIFIC + 2)
+/* one query per lp_counter_info entry */
+#define LP_QUERY_COUNTER_FIRST            (PIPE_QUERY_DRIVER_SPECIFIC + 3)
+#define LP_QUERY_DRIVER_LAST  (LP_QUERY_COUNTER_FIRST + LP_NUM_COUNTER_INFO)
+
+
 struct llvmpipe_query {
    uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
    uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
@@ -39,6 +39,7 @@
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
+#include "lp_linear.h"
 #include "lp_perf.h"
 #include "lp_query.h"
 #include "lp_rast.h"
@@ -124,17 +125,15 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
 
 
 /**
- * Clear the rasterizer's current color tile.
- * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ * Fill the current tile of a color buffer with a clear value.
+ * Clears always clear all bound layers.
  */
 static void
-lp_rast_clear_color(struct lp_rasterizer_task *task,
-                    const union lp_rast_cmd_arg arg)
+lp_rast_do_clear_color(struct lp_rasterizer_task *task,
+                       unsigned cbuf,
+                       union util_color uc)
 {
    const struct lp_scene *scene = task->scene;
-   unsigned cbuf = arg.clear_rb->cbuf;
-   union util_color uc;
    enum pipe_format format;
 
    /* we never bin clear commands for non-existing buffers */
@@ -142,7 +141,6 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
    assert(scene->fb.cbufs[cbuf]);
 
    format = scene->fb.cbufs[cbuf]->format;
-   uc = arg.clear_rb->color_val;
 
    /*
     * this is pretty rough since we have target format (bunch of bytes...) here.
@@ -165,22 +163,20 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                  &uc);
 
    /* this will increase for each rb which probably doesn't mean much */
-   LP_COUNT(nr_color_tile_clear);
+   LP_COUNT(task, nr_color_tile_clear);
 }
 
 
 /**
- * Clear the rasterizer's current z/stencil tile.
- * This is a bin command called during bin processing.
- * Clear commands always clear all bound layers.
+ * Clear the current tile of the z/stencil buffer.
+ * Clears always clear all bound layers.
  */
 static void
-lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
-                       const union lp_rast_cmd_arg arg)
+lp_rast_do_clear_zstencil(struct lp_rasterizer_task *task,
+                          uint64_t clear_value64,
+                          uint64_t clear_mask64)
 {
    const struct lp_scene *scene = task->scene;
-   uint64_t clear_value64 = arg.clear_zstencil.value;
-   uint64_t clear_mask64 = arg.clear_zstencil.mask;
    uint32_t clear_value = (uint32_t) clear_value64;
    uint32_t clear_mask = (uint32_t) clear_mask64;
    const unsigned height = task->height;
@@ -284,6 +280,181 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Clip a copy/fill rectangle to the current tile.
+ * \return FALSE if they don't intersect.
+ */
+static boolean
+lp_rast_clip_rect_to_tile(const struct lp_rasterizer_task *task,
+                          const struct u_rect *rect,
+                          struct u_rect *clipped)
+{
+   struct u_rect tile;
+
+   tile.x0 = task->x;
+   tile.y0 = task->y;
+   tile.x1 = task->x + task->width - 1;
+   tile.y1 = task->y + task->height - 1;
+
+   if (!u_rect_test_intersection(rect, &tile))
+      return FALSE;
+
+   *clipped = tile;
+   u_rect_find_intersection(rect, clipped);
+   return TRUE;
+}
+
+
+/**
+ * Copy the part of a region within the current tile between a color
+ * buffer and another image.
+ * This is a bin command called during bin processing.
+ */
+static void
+lp_rast_copy_rect(struct lp_rasterizer_task *task,
+                  const union lp_rast_cmd_arg arg)
+{
+   const struct lp_scene *scene = task->scene;
+   const struct lp_rast_copy *copy = arg.copy;
+   unsigned cbuf = copy->cbuf;
+   enum pipe_format format;
+   struct u_rect rect;
+
+   assert(cbuf < scene->fb.nr_cbufs);
+   assert(scene->fb.cbufs[cbuf]);
+
+   if (!lp_rast_clip_rect_to_tile(task, &copy->rect, &rect))
+      return;
+
+   format = scene->fb.cbufs[cbuf]->format;
+
+   if (copy->to_cbuf) {
+      util_copy_rect(scene->cbufs[cbuf].map, format,
+                     scene->cbufs[cbuf].stride,
+                     rect.x0, rect.y0,
+                     rect.x1 - rect.x0 + 1, rect.y1 - rect.y0 + 1,
+                     copy->data, copy->stride,
+                     rect.x0 + copy->dx, rect.y0 + copy->dy);
+   }
+   else {
+      util_copy_rect(copy->data, format, copy->stride,
+                     rect.x0 + copy->dx, rect.y0 + copy->dy,
+                     rect.x1 - rect.x0 + 1, rect.y1 - rect.y0 + 1,
+                     scene->cbufs[cbuf].map,
+                     scene->cbufs[cbuf].stride,
+                     rect.x0, rect.y0);
+   }
+}
+
+
+/**
+ * Fill the part of a color buffer region within the current tile.
+ * Unlike lp_rast_clear_color() this only touches the first bound layer.
+ * This is a bin command called during bin processing.
+ */
+static void
+lp_rast_fill_rect(struct lp_rasterizer_task *task,
+                  const union lp_rast_cmd_arg arg)
+{
+   const struct lp_scene *scene = task->scene;
+   const struct lp_rast_copy *fill = arg.copy;
+   unsigned cbuf = fill->cbuf;
+   union util_color uc = fill->color_val;
+   struct u_rect rect;
+
+   assert(cbuf < scene->fb.nr_cbufs);
+   assert(scene->fb.cbufs[cbuf]);
+
+   if (!lp_rast_clip_rect_to_tile(task, &fill->rect, &rect))
+      return;
+
+   util_fill_rect(scene->cbufs[cbuf].map,
+                  scene->fb.cbufs[cbuf]->format,
+                  scene->cbufs[cbuf].stride,
+                  rect.x0, rect.y0,
+                  rect.x1 - rect.x0 + 1, rect.y1 - rect.y0 + 1,
+                  &uc);
+}
+
+/**
+ * Write out the clears of the current tile which have been deferred.
+ * \param mask  which of the LP_RAST_CLEAR_PENDING_x bits to resolve
+ */
+static void
+lp_rast_resolve_clears(struct lp_rasterizer_task *task, unsigned mask)
+{
+   unsigned pending = task->clears_pending & mask;
+
+   task->clears_pending &= ~mask;
+
+   if (pending & LP_RAST_CLEAR_PENDING_ZS) {
+      lp_rast_do_clear_zstencil(task, task->clear_zs_value,
+                                task->clear_zs_mask);
+      pending &= ~LP_RAST_CLEAR_PENDING_ZS;
+   }
+
+   while (pending) {
+      unsigned cbuf = u_bit_scan(&pending);
+      lp_rast_do_clear_color(task, cbuf, task->clear_color[cbuf]);
+   }
+}
+
+
+/**
+ * Clear the rasterizer's current color tile.
+ * This is a bin command called during bin processing.
+ *
+ * The clear is only recorded here.  It's written out right before the
+ * first following command which accesses the tile, or at the end of the
+ * tile.  If the tile gets completely overwritten first, or cleared again,
+ * the clear never touches memory at all.
+ *
+ * Note the clear is only deferred while rasterizing this one bin: a tile
+ * which nothing else touches is still filled at the end of the tile, just
+ * as before.  Skipping those too would need per-surface "cleared" state
+ * kept across scenes and resolved wherever the surface's memory is read
+ * (transfer maps, sampling, display, copies), which isn't done.
+ */
+static void
+lp_rast_clear_color(struct lp_rasterizer_task *task,
+                    const union lp_rast_cmd_arg arg)
+{
+   unsigned cbuf = arg.clear_rb->cbuf;
+
+   assert(cbuf < task->scene->fb.nr_cbufs);
+
+   task->clear_color[cbuf] = arg.clear_rb->color_val;
+   task->clears_pending |= LP_RAST_CLEAR_PENDING_COLOR(cbuf);
+}
+
+
+/**
+ * Clear the rasterizer's current z/stencil tile.
+ * This is a bin command called during bin processing.
+ * Like color clears, this is deferred; a pending clear and a new one with
+ * a partial mask are merged into a single clear.
+ */
+static void
+lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
+                       const union lp_rast_cmd_arg arg)
+{
+   uint64_t value = arg.clear_zstencil.value;
+   uint64_t mask = arg.clear_zstencil.mask;
+
+   if (!task->scene->fb.zsbuf)
+      return;
+
+   if (task->clears_pending & LP_RAST_CLEAR_PENDING_ZS) {
+      value |= task->clear_zs_value & ~mask;
+      mask |= task->clear_zs_mask;
+   }
+
+   task->clear_zs_value = value;
+   task->clear_zs_mask = mask;
+   task->clears_pending |= LP_RAST_CLEAR_PENDING_ZS;
+}
+
+
 
 /**
  * Run the shader on all blocks in a tile.  This is used when a tile is
@@ -315,6 +486,18 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
+   if (variant->linear.kind != LP_LINEAR_NONE) {
+      struct u_rect box;
+
+      box.x0 = tile_x;
+      box.y0 = tile_y;
+      box.x1 = tile_x + task->width - 1;
+      box.y1 = tile_y + task->height - 1;
+
+      if (lp_linear_rasterize_rect(task, inputs, &box))
+         return;
+   }
+
    /* render the whole 64x64 tile in 4x4 chunks */
    for (y = 0; y < task->height; y += 4){
       for (x = 0; x < task->width; x += 4) {
@@ -471,6 +654,90 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Shade the part of an axis-aligned rectangle within the current tile.
+ * Coverage follows directly from the clipped box, so each 4x4 block
+ * gets either a full mask or a mask built from its row/column ranges.
+ * This is a bin command called during bin processing.
+ */
+static void
+lp_rast_rectangle(struct lp_rasterizer_task *task,
+                  const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_rectangle *rect = arg.rectangle;
+   const struct lp_rast_shader_inputs *inputs = &rect->inputs;
+   struct u_rect box;
+   int x, y;
+
+   if (inputs->disable) {
+      /* This command was partially binned and has been disabled */
+      return;
+   }
+
+   LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
+
+   assert(task->state);
+   if (!task->state) {
+      return;
+   }
+
+   if (!lp_rast_clip_rect_to_tile(task, &rect->box, &box))
+      return;
+
+   if (lp_linear_rasterize_rect(task, inputs, &box)) {
+      task->ps_invocations +=
+         ((box.x1 >> 2) - (box.x0 >> 2) + 1) *
+         ((box.y1 >> 2) - (box.y0 >> 2) + 1) *
+         task->state->variant->ps_inv_multiplier;
+      return;
+   }
+
+   for (y = box.y0 & ~3; y <= box.y1; y += 4) {
+      int r0 = MAX2(box.y0 - y, 0);
+      int r1 = MIN2(box.y1 - y, 3);
+      unsigned rows = (0xffff << (4 * r0)) & (0xffff >> (12 - 4 * r1));
+
+      for (x = box.x0 & ~3; x <= box.x1; x += 4) {
+         int c0 = MAX2(box.x0 - x, 0);
+         int c1 = MIN2(box.x1 - x, 3);
+         unsigned cols = ((0xf << c0) & (0xf >> (3 - c1))) * 0x1111;
+         unsigned mask = rows & cols;
+
+         if (mask == 0xffff)
+            lp_rast_shade_quads_all(task, inputs, x, y);
+         else
+            lp_rast_shade_quads_mask(task, inputs, x, y, mask);
+      }
+   }
+}
+
+
+/**
+ * Shade a batch of points and lines within a single 4x4 block, in the
+ * order they were binned.
+ * This is a bin command called during bin processing.
+ */
+static void
+lp_rast_block_prims(struct lp_rasterizer_task *task,
+                    const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_block_prims *prims = arg.block_prims;
+   unsigned i;
+
+   LP_DBG(DEBUG_RAST, "%s %u\n", __FUNCTION__, prims->header.count);
+
+   assert(task->state);
+   if (!task->state) {
+      return;
+   }
+
+   for (i = 0; i < prims->header.count; i++) {
+      lp_rast_shade_quads_mask(task, prims->prim[i].inputs,
+                               prims->header.x, prims->header.y,
+                               prims->prim[i].mask);
+   }
+}
+
 
 /**
  * Begin a new occlusion query.
@@ -552,6 +819,8 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
       lp_rast_end_query(task, lp_rast_arg_query(task->scene->active_queries[i]));
    }
 
+   lp_rast_resolve_clears(task, ~0);
+
    /* debug */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
    task->depth_tile = NULL;
@@ -589,7 +858,12 @@ static lp_rast_cmd_func dispatch[LP_RAST_OP_MAX] =
    lp_rast_triangle_32_8,
    lp_rast_triangle_32_3_4,
    lp_rast_triangle_32_3_16,
-   lp_rast_triangle_32_4_16
+   lp_rast_triangle_32_4_16,
+   lp_rast_copy_rect,
+   lp_rast_fill_rect,
+   lp_rast_rectangle,
+   lp_rast_block_prims,
+   lp_rast_block_tris
 };
 
 
@@ -606,7 +880,35 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
-         dispatch[block->cmd[k]]( task, block->arg[k] );
+         unsigned cmd = block->cmd[k];
+
+         if (task->clears_pending) {
+            switch (cmd) {
+            case LP_RAST_OP_CLEAR_COLOR:
+            case LP_RAST_OP_CLEAR_ZSTENCIL:
+            case LP_RAST_OP_BEGIN_QUERY:
+            case LP_RAST_OP_END_QUERY:
+            case LP_RAST_OP_SET_STATE:
+               break;
+            case LP_RAST_OP_SHADE_TILE_OPAQUE:
+               /* Writes every color pixel of the only bound layer of the
+                * only color buffer, and doesn't touch depth/stencil.
+                */
+               if (task->scene->fb_max_layer == 0) {
+                  assert(task->scene->fb.nr_cbufs == 1);
+                  task->clears_pending &= ~LP_RAST_CLEAR_PENDING_COLOR(0);
+               }
+               lp_rast_resolve_clears(task, ~LP_RAST_CLEAR_PENDING_ZS);
+               break;
+            default:
+               lp_rast_resolve_clears(task, ~0);
+               break;
+            }
+         }
+
+         LP_TRACE_BEGIN(task->trace, lp_rast_cmd_name(cmd));
+         dispatch[cmd]( task, block->arg[k] );
+         LP_TRACE_END(task->trace, lp_rast_cmd_name(cmd));
       }
    }
 }
@@ -623,20 +925,24 @@ static void
 rasterize_bin(struct lp_rasterizer_task *task,
               const struct cmd_bin *bin, int x, int y )
 {
+   LP_TRACE_BEGIN(task->trace, "bin");
+
    lp_rast_tile_begin( task, bin, x, y );
 
    do_rasterize_bin(task, bin, x, y);
 
    lp_rast_tile_end(task);
 
+   LP_TRACE_END(task->trace, "bin");
+
 
    /* Debug/Perf flags:
     */
    if (bin->head->count == 1) {
       if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE_OPAQUE)
-         LP_COUNT(nr_pure_shade_opaque_64);
+         LP_COUNT(task, nr_pure_shade_opaque_64);
       else if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE)
-         LP_COUNT(nr_pure_shade_64);
+         LP_COUNT(task, nr_pure_shade_64);
    }
 }
 
@@ -665,6 +971,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
 {
    task->scene = scene;
 
+   LP_TRACE_BEGIN(task->trace, "scene");
+
    /* Clear the cache tags. This should not always be necessary but
       simpler for now. */
 #if LP_USE_TEXTURE_CACHE
@@ -705,6 +1013,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
+   LP_TRACE_END(task->trace, "scene");
+
    if (scene->fence) {
       lp_fence_signal(scene->fence);
    }
@@ -774,6 +1084,23 @@ lp_rast_finish( struct lp_rasterizer *rast )
 }
 
 
+/**
+ * Add what the threads counted since the last call to \p counters.
+ * Only call this when the threads are idle, i.e. after lp_rast_finish().
+ */
+void
+lp_rast_collect_counters( struct lp_rasterizer *rast,
+                          struct lp_counters *counters )
+{
+   unsigned i;
+
+   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+      lp_counters_add(counters, &rast->tasks[i].counters);
+      memset(&rast->tasks[i].counters, 0, sizeof rast->tasks[i].counters);
+   }
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
@@ -802,7 +1129,9 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
       /* wait for work */
       if (debug)
          debug_printf("thread %d waiting for work\n", task->thread_index);
+      LP_TRACE_BEGIN(task->trace, "idle");
       pipe_semaphore_wait(&task->work_ready);
+      LP_TRACE_END(task->trace, "idle");
 
       if (rast->exit_flag)
          break;
@@ -819,7 +1148,9 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
       /* Wait for all threads to get here so that threads[1+] don't
        * get a null rast->curr_scene pointer.
        */
+      LP_TRACE_BEGIN(task->trace, "barrier");
       pipe_barrier_wait( &rast->barrier );
+      LP_TRACE_END(task->trace, "barrier");
 
       /* do work */
       if (debug)
@@ -829,7 +1160,9 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
                       rast->curr_scene);
       
       /* wait for all threads to finish with this scene */
+      LP_TRACE_BEGIN(task->trace, "barrier");
       pipe_barrier_wait( &rast->barrier );
+      LP_TRACE_END(task->trace, "barrier");
 
       /* XXX: shouldn't be necessary:
        */
@@ -894,8 +1227,14 @@ lp_rast_create( unsigned num_threads )
 
    for (i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
+      char thread_name[16];
+
       task->rast = rast;
       task->thread_index = i;
+
+      util_snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", i);
+      task->trace = lp_trace_create_buffer(thread_name);
+
       task->thread_data.cache = align_malloc(sizeof(struct lp_build_format_cache),
                                              16);
       if (!task->thread_data.cache) {
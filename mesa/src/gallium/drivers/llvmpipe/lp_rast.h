@@ -39,12 +39,14 @@
 
 #include "pipe/p_compiler.h"
 #include "util/u_pack_color.h"
+#include "util/u_rect.h"
 #include "lp_jit.h"
 
 
 struct lp_rasterizer;
 struct lp_scene;
 struct lp_fence;
+struct lp_counters;
 struct cmd_bin;
 
 #define FIXED_TYPE_WIDTH 64
@@ -149,6 +151,95 @@ struct lp_rast_clear_rb {
 };
 
 
+/**
+ * Copy between a color buffer of the scene and another texture image,
+ * or fill of a color buffer region.  Each bin handles the part of
+ * 'rect' (in framebuffer coordinates) covered by its tile.
+ */
+struct lp_rast_copy {
+   struct u_rect rect;
+   unsigned cbuf;
+   boolean to_cbuf;           /**< copy direction, unused for fills */
+   union util_color color_val; /**< fill value */
+
+   /** the other image, addressed with framebuffer coordinates + dx, dy */
+   uint8_t *data;
+   unsigned stride;
+   int dx, dy;
+};
+
+
+/**
+ * Axis-aligned rectangle (a pair of triangles detected in setup), for
+ * the tiles it covers only partially.  'box' is inclusive, in
+ * framebuffer pixels and already clipped to scissor and framebuffer,
+ * so the rasterizer needs no edge functions.
+ */
+struct lp_rast_rectangle {
+   struct u_rect box;
+
+   /* inputs for the shader */
+   struct lp_rast_shader_inputs inputs;
+   /* followed by a0, dadx, dady */
+};
+
+
+/**
+ * Start of the per-block batch commands below, which setup appends to.
+ * Only 'max' entries are allocated; setup starts small and allocates
+ * bigger batches for blocks which keep receiving primitives.
+ */
+struct lp_rast_block_header {
+   unsigned x, y;               /**< block position, in framebuffer pixels */
+   unsigned count;
+   unsigned max;
+};
+
+
+#define LP_RAST_BLOCK_PRIMS_MAX 16
+
+/**
+ * Points, lines and triangles which touch a single 4x4 block, batched
+ * together in one command.  Setup has already worked out each
+ * primitive's coverage mask, so all that is left is to run the shader.
+ * Each inputs is followed by its a0, dadx, dady as usual.
+ */
+struct lp_rast_block_prims {
+   struct lp_rast_block_header header;
+   struct {
+      unsigned mask;
+      const struct lp_rast_shader_inputs *inputs;
+   } prim[LP_RAST_BLOCK_PRIMS_MAX];
+};
+
+
+/**
+ * A triangle edge reduced to whole pixels within a 16x16 block: pixel
+ * (i, j) of the block is inside when c - dcdx * i + dcdy * j >= 0.
+ */
+struct lp_rast_plane16 {
+   int32_t c;
+   int32_t dcdx;
+   int32_t dcdy;
+};
+
+
+#define LP_RAST_BLOCK_TRIS_MAX 16
+
+/**
+ * Small triangles contained in a single 16x16 block, batched together.
+ * Only three edges are kept per triangle, in 32 bits and relative to the
+ * block, instead of a full lp_rast_triangle plane array.
+ */
+struct lp_rast_block_tris {
+   struct lp_rast_block_header header;
+   struct {
+      struct lp_rast_plane16 plane[3];
+      const struct lp_rast_shader_inputs *inputs;
+   } tri[LP_RAST_BLOCK_TRIS_MAX];
+};
+
+
 #define GET_A0(inputs) ((float (*)[4])((inputs)+1))
 #define GET_DADX(inputs) ((float (*)[4])((char *)((inputs) + 1) + (inputs)->stride))
 #define GET_DADY(inputs) ((float (*)[4])((char *)((inputs) + 1) + 2 * (inputs)->stride))
@@ -169,6 +260,10 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 void
 lp_rast_finish( struct lp_rasterizer *rast );
 
+void
+lp_rast_collect_counters( struct lp_rasterizer *rast,
+                          struct lp_counters *counters );
+
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
@@ -178,6 +273,11 @@ union lp_rast_cmd_arg {
    } triangle;
    const struct lp_rast_state *set_state;
    const struct lp_rast_clear_rb *clear_rb;
+   const struct lp_rast_copy *copy;
+   const struct lp_rast_rectangle *rectangle;
+   struct lp_rast_block_header *block;       /* either of these two */
+   struct lp_rast_block_prims *block_prims;  /* setup appends to it */
+   struct lp_rast_block_tris *block_tris;    /* ditto */
    struct {
       uint64_t value;
       uint64_t mask;
@@ -224,6 +324,30 @@ lp_rast_arg_triangle_contained( const struct lp_rast_triangle *triangle,
    return arg;
 }
 
+static inline union lp_rast_cmd_arg
+lp_rast_arg_rectangle( const struct lp_rast_rectangle *rectangle )
+{
+   union lp_rast_cmd_arg arg;
+   arg.rectangle = rectangle;
+   return arg;
+}
+
+static inline union lp_rast_cmd_arg
+lp_rast_arg_block_prims( struct lp_rast_block_prims *block_prims )
+{
+   union lp_rast_cmd_arg arg;
+   arg.block_prims = block_prims;
+   return arg;
+}
+
+static inline union lp_rast_cmd_arg
+lp_rast_arg_block_tris( struct lp_rast_block_tris *block_tris )
+{
+   union lp_rast_cmd_arg arg;
+   arg.block_tris = block_tris;
+   return arg;
+}
+
 static inline union lp_rast_cmd_arg
 lp_rast_arg_state( const struct lp_rast_state *state )
 {
@@ -302,10 +426,17 @@ lp_rast_arg_null( void )
 #define LP_RAST_OP_TRIANGLE_32_3_4   0x1a
 #define LP_RAST_OP_TRIANGLE_32_3_16  0x1b
 #define LP_RAST_OP_TRIANGLE_32_4_16  0x1c
+#define LP_RAST_OP_COPY_RECT         0x1d
+#define LP_RAST_OP_FILL_RECT         0x1e
+#define LP_RAST_OP_RECTANGLE         0x1f
+#define LP_RAST_OP_BLOCK_PRIMS       0x20
+#define LP_RAST_OP_BLOCK_TRIS        0x21
 
-#define LP_RAST_OP_MAX               0x1d
+#define LP_RAST_OP_MAX               0x22
 #define LP_RAST_OP_MASK              0xff
 
+const char *
+lp_rast_cmd_name(unsigned cmd);
 void
 lp_debug_bins( struct lp_scene *scene );
 void
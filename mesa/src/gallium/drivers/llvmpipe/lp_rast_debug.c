@@ -54,9 +54,15 @@ static const char *cmd_names[LP_RAST_OP_MAX] =
    "triangle_32_3_4",
    "triangle_32_3_16",
    "triangle_32_4_16",
+   "copy_rect",
+   "fill_rect",
+   "rectangle",
+   "block_prims",
+   "block_tris",
 };
 
-static const char *cmd_name(unsigned cmd)
+const char *
+lp_rast_cmd_name(unsigned cmd)
 {
    assert(ARRAY_SIZE(cmd_names) > cmd);
    return cmd_names[cmd];
@@ -115,7 +121,7 @@ debug_bin( const struct cmd_bin *bin, int x, int y )
             state = head->arg[i].state;
 
          debug_printf("%d: %s %s\n", j,
-                      cmd_name(head->cmd[i]),
+                      lp_rast_cmd_name(head->cmd[i]),
                       is_blend(state, head, i) ? "blended" : "");
       }
       head = head->next;
@@ -263,7 +269,7 @@ do_debug_bin( struct tile *tile,
          int count = 0;
             
          if (print_cmds)
-            debug_printf("%c: %15s", val, cmd_name(block->cmd[k]));
+            debug_printf("%c: %15s", val, lp_rast_cmd_name(block->cmd[k]));
 
          if (block->cmd[k] == LP_RAST_OP_SET_STATE)
             tile->state = block->arg[k].state;
@@ -37,6 +37,7 @@
 #include "lp_state.h"
 #include "lp_texture.h"
 #include "lp_limits.h"
+#include "lp_trace.h"
 
 
 #define TILE_VECTOR_HEIGHT 4
@@ -76,6 +77,11 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+
+/** lp_rasterizer_task::clears_pending bits */
+#define LP_RAST_CLEAR_PENDING_COLOR(cbuf) (1 << (cbuf))
+#define LP_RAST_CLEAR_PENDING_ZS          (1 << PIPE_MAX_COLOR_BUFS)
+
 /**
  * Per-thread rasterization state
  */
@@ -91,6 +97,15 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /**
+    * Clears of the current tile which haven't been written to memory yet,
+    * see lp_rast_clear_color().  Always empty outside of a tile.
+    */
+   unsigned clears_pending;
+   union util_color clear_color[PIPE_MAX_COLOR_BUFS];
+   uint64_t clear_zs_value;
+   uint64_t clear_zs_mask;
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
@@ -102,6 +117,12 @@ struct lp_rasterizer_task
    uint64_t ps_invocations;
    uint8_t ps_inv_multiplier;
 
+   /** This thread's counts, see lp_rast_collect_counters() */
+   struct lp_counters counters;
+
+   /** LP_TRACE event buffer, NULL unless tracing */
+   struct lp_trace_buffer *trace;
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -337,6 +358,9 @@ void lp_rast_triangle_32_3_16( struct lp_rasterizer_task *,
 void lp_rast_triangle_32_4_16( struct lp_rasterizer_task *, 
                             const union lp_rast_cmd_arg );
 
+void lp_rast_block_tris( struct lp_rasterizer_task *,
+                         const union lp_rast_cmd_arg );
+
 void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
@@ -133,6 +133,49 @@ lp_rast_triangle_4_16(struct lp_rasterizer_task *task,
    lp_rast_triangle_4(task, arg2);
 }
 
+
+/**
+ * Rasterize a batch of small triangles contained in one 16x16 block, in
+ * the order they were binned.
+ */
+void
+lp_rast_block_tris(struct lp_rasterizer_task *task,
+                   const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_block_tris *tris = arg.block_tris;
+   unsigned i, j;
+   int ix, iy;
+
+   assert(task->state);
+   if (!task->state) {
+      return;
+   }
+
+   for (i = 0; i < tris->header.count; i++) {
+      const struct lp_rast_plane16 *plane = tris->tri[i].plane;
+
+      for (iy = 0; iy < 16; iy += 4) {
+         for (ix = 0; ix < 16; ix += 4) {
+            unsigned mask = 0xffff;
+
+            for (j = 0; j < 3; j++) {
+               mask &= ~build_mask_linear(plane[j].c -
+                                          plane[j].dcdx * ix +
+                                          plane[j].dcdy * iy,
+                                          -plane[j].dcdx,
+                                          plane[j].dcdy);
+            }
+
+            if (mask)
+               lp_rast_shade_quads_mask(task, tris->tri[i].inputs,
+                                        tris->header.x + ix,
+                                        tris->header.y + iy,
+                                        mask);
+         }
+      }
+   }
+}
+
 #if defined(PIPE_ARCH_SSE)
 
 #include <emmintrin.h>
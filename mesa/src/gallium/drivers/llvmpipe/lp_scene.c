@@ -26,6 +26,7 @@
  **************************************************************************/
 
 #include "util/u_framebuffer.h"
+#include "util/u_atomic.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
@@ -38,11 +39,24 @@
 
 #define RESOURCE_REF_SZ 32
 
-/** List of resource references */
+/** Initial size of the resource hash table, log2 */
+#define RESOURCE_TABLE_ORDER 6
+
+/** A resource referenced by the scene */
 struct resource_ref {
-   struct pipe_resource *resource[RESOURCE_REF_SZ];
+   struct pipe_resource *resource;
+   /** resource storage at the time the reference was taken */
+   struct llvmpipe_storage *storage;
+   /** masks of the levels read/written by the scene */
+   unsigned read_levels;
+   unsigned write_levels;
+};
+
+/** List of resource references */
+struct resource_ref_block {
+   struct resource_ref ref[RESOURCE_REF_SZ];
    int count;
-   struct resource_ref *next;
+   struct resource_ref_block *next;
 };
 
 
@@ -58,11 +72,23 @@ lp_scene_create( struct pipe_context *pipe )
       return NULL;
 
    scene->pipe = pipe;
+   scene->max_size = LP_SCENE_MAX_SIZE;
+   scene->max_resource_size = LP_SCENE_MAX_RESOURCE_SIZE;
 
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   pipe_mutex_init(scene->mutex);
+   scene->resource_table_order = RESOURCE_TABLE_ORDER;
+   scene->resource_table =
+      CALLOC(1 << RESOURCE_TABLE_ORDER, sizeof *scene->resource_table);
+   if (!scene->data.head || !scene->resource_table) {
+      FREE(scene->data.head);
+      FREE(scene->resource_table);
+      FREE(scene);
+      return NULL;
+   }
+
+   STATIC_ASSERT(TILES_X * TILES_Y <= 1 << 16);
 
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
@@ -90,9 +116,9 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   pipe_mutex_destroy(scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
+   FREE(scene->resource_table);
    FREE(scene);
 }
 
@@ -209,7 +235,7 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
-   int i, j;
+   int i;
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
@@ -235,14 +261,15 @@ lp_scene_end_rasterization(struct lp_scene *scene )
 
    /* Reset all command lists:
     */
-   for (i = 0; i < scene->tiles_x; i++) {
-      for (j = 0; j < scene->tiles_y; j++) {
-         struct cmd_bin *bin = lp_scene_get_bin(scene, i, j);
-         bin->head = NULL;
-         bin->tail = NULL;
-         bin->last_state = NULL;
-      }
+   for (i = 0; i < scene->num_active_bins; i++) {
+      struct cmd_bin *bin = &scene->tile[0][0] + scene->active_bins[i];
+      bin->head = NULL;
+      bin->tail = NULL;
+      bin->last_state = NULL;
    }
+   scene->num_active_bins = 0;
+
+   memset(&scene->counters, 0, sizeof scene->counters);
 
    /* If there are any bins which weren't cleared by the loop above,
     * they will be caught (on debug builds at least) by this assert:
@@ -252,23 +279,31 @@ lp_scene_end_rasterization(struct lp_scene *scene )
    /* Decrement texture ref counts
     */
    {
-      struct resource_ref *ref;
+      struct resource_ref_block *block;
       int i, j = 0;
 
-      for (ref = scene->resources; ref; ref = ref->next) {
-         for (i = 0; i < ref->count; i++) {
+      for (block = scene->resources; block; block = block->next) {
+         for (i = 0; i < block->count; i++) {
+            struct resource_ref *ref = &block->ref[i];
             if (LP_DEBUG & DEBUG_SETUP)
                debug_printf("resource %d: %p %dx%d sz %d\n",
                             j,
-                            (void *) ref->resource[i],
-                            ref->resource[i]->width0,
-                            ref->resource[i]->height0,
-                            llvmpipe_resource_size(ref->resource[i]));
+                            (void *) ref->resource,
+                            ref->resource->width0,
+                            ref->resource->height0,
+                            llvmpipe_resource_size(ref->resource));
             j++;
-            pipe_resource_reference(&ref->resource[i], NULL);
+            pipe_resource_reference(&ref->resource, NULL);
+            llvmpipe_storage_reference(&ref->storage, NULL);
          }
       }
 
+      memset(scene->resource_table, 0,
+             (1 << scene->resource_table_order) *
+             sizeof *scene->resource_table);
+      scene->num_resources = 0;
+      scene->num_written_resources = 0;
+
       if (LP_DEBUG & DEBUG_SETUP)
          debug_printf("scene %d resources, sz %d\n",
                       j, scene->resource_reference_size);
@@ -316,6 +351,9 @@ lp_scene_new_cmd_block( struct lp_scene *scene,
          bin->tail = block;
       }
       else {
+         /* first command for this bin */
+         scene->active_bins[scene->num_active_bins++] =
+            bin - &scene->tile[0][0];
          bin->head = block;
          bin->tail = block;
       }
@@ -330,7 +368,7 @@ lp_scene_new_cmd_block( struct lp_scene *scene,
 struct data_block *
 lp_scene_new_data_block( struct lp_scene *scene )
 {
-   if (scene->scene_size + DATA_BLOCK_SIZE > LP_SCENE_MAX_SIZE) {
+   if (scene->scene_size + DATA_BLOCK_SIZE > scene->max_size) {
       if (0) debug_printf("%s: failed\n", __FUNCTION__);
       scene->alloc_failed = TRUE;
       return NULL;
@@ -369,58 +407,137 @@ lp_scene_data_size( const struct lp_scene *scene )
 
 
 /**
- * Add a reference to a resource by the scene.
+ * Find the hash table slot of a resource/storage pair: either the one
+ * holding its reference, or the empty one it would go in.
  */
-boolean
-lp_scene_add_resource_reference(struct lp_scene *scene,
-                                struct pipe_resource *resource,
-                                boolean initializing_scene)
+static struct resource_ref **
+find_resource_ref(const struct lp_scene *scene,
+                  const struct pipe_resource *resource,
+                  const struct llvmpipe_storage *storage)
+{
+   unsigned mask = (1 << scene->resource_table_order) - 1;
+   unsigned hash = (unsigned)(((uintptr_t)resource >> 4) ^
+                              ((uintptr_t)storage >> 6)) * 2654435761u;
+   unsigned i = hash >> (32 - scene->resource_table_order);
+
+   for (;;) {
+      struct resource_ref **slot = &scene->resource_table[i];
+      if (!*slot ||
+          ((*slot)->resource == resource && (*slot)->storage == storage))
+         return slot;
+      i = (i + 1) & mask;
+   }
+}
+
+
+/**
+ * Double the size of the resource hash table.
+ */
+static boolean
+grow_resource_table(struct lp_scene *scene)
 {
-   struct resource_ref *ref, **last = &scene->resources;
+   struct resource_ref **old_table = scene->resource_table;
+   struct resource_ref_block *block;
    int i;
 
-   /* Look at existing resource blocks:
+   scene->resource_table =
+      CALLOC(2 << scene->resource_table_order, sizeof *scene->resource_table);
+   if (!scene->resource_table) {
+      scene->resource_table = old_table;
+      return FALSE;
+   }
+
+   FREE(old_table);
+   scene->resource_table_order++;
+
+   for (block = scene->resources; block; block = block->next) {
+      for (i = 0; i < block->count; i++) {
+         struct resource_ref *ref = &block->ref[i];
+         *find_resource_ref(scene, ref->resource, ref->storage) = ref;
+      }
+   }
+
+   return TRUE;
+}
+
+
+static boolean
+add_resource_reference(struct lp_scene *scene,
+                       struct pipe_resource *resource,
+                       struct llvmpipe_storage *storage,
+                       unsigned usage,
+                       unsigned levels,
+                       boolean initializing_scene)
+{
+   struct resource_ref **slot;
+   struct resource_ref_block *block;
+   struct resource_ref *ref;
+
+   /* A resource renamed while the scene was being built is referenced
+    * once per storage it had.
     */
-   for (ref = scene->resources; ref; ref = ref->next) {
-      last = &ref->next;
+   slot = find_resource_ref(scene, resource, storage);
+   if (*slot) {
+      ref = *slot;
 
-      /* Search for this resource:
+      /* Commands already binned may write these levels from any tile, so
+       * they can't be read by later commands of the scene.
        */
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
-            return TRUE;
-
-      if (ref->count < RESOURCE_REF_SZ) {
-         /* If the block is half-empty, then append the reference here.
-          */
-         break;
+      if ((ref->write_levels & levels) &&
+          !(usage & LP_REFERENCED_FOR_WRITE))
+         return FALSE;
+
+      ref->read_levels |= levels;
+      if (usage & LP_REFERENCED_FOR_WRITE) {
+         if (!ref->write_levels)
+            scene->num_written_resources++;
+         ref->write_levels |= levels;
       }
+      return TRUE;
+   }
+
+   /* Keep the table at most half full.
+    */
+   if (2 * (scene->num_resources + 1) > (1u << scene->resource_table_order)) {
+      if (!grow_resource_table(scene))
+         return FALSE;
+      slot = find_resource_ref(scene, resource, storage);
    }
 
-   /* Create a new block if no half-empty block was found.
+   /* Create a new block if the current one is full.
     */
-   if (!ref) {
-      assert(*last == NULL);
-      *last = lp_scene_alloc(scene, sizeof *ref);
-      if (*last == NULL)
-          return FALSE;
-
-      ref = *last;
-      memset(ref, 0, sizeof *ref);
+   block = scene->resources;
+   if (!block || block->count == RESOURCE_REF_SZ) {
+      block = lp_scene_alloc(scene, sizeof *block);
+      if (!block)
+         return FALSE;
+
+      block->count = 0;
+      block->next = scene->resources;
+      scene->resources = block;
    }
 
    /* Append the reference to the reference block.
     */
-   pipe_resource_reference(&ref->resource[ref->count++], resource);
+   ref = &block->ref[block->count++];
+   memset(ref, 0, sizeof *ref);
+   ref->read_levels = levels;
+   ref->write_levels = (usage & LP_REFERENCED_FOR_WRITE) ? levels : 0;
+   llvmpipe_storage_reference(&ref->storage, storage);
+   pipe_resource_reference(&ref->resource, resource);
+   *slot = ref;
+   scene->num_resources++;
+   if (ref->write_levels)
+      scene->num_written_resources++;
    scene->resource_reference_size += llvmpipe_resource_size(resource);
 
    /* Heuristic to advise scene flushes.  This isn't helpful in the
     * initial setup of the scene, but after that point flush on the
-    * next resource added which exceeds 64MB in referenced texture
-    * data.
+    * next resource added which exceeds the scene's limit on
+    * referenced texture data.
     */
    if (!initializing_scene &&
-       scene->resource_reference_size >= LP_SCENE_MAX_RESOURCE_SIZE)
+       scene->resource_reference_size >= scene->max_resource_size)
       return FALSE;
 
    return TRUE;
@@ -428,82 +545,101 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
 
 /**
- * Does this scene have a reference to the given resource?
+ * Add a reference to a resource by the scene.
+ * \param storage  the resource storage the scene's commands point into
+ * \param levels  mask of the levels the commands read
  */
 boolean
-lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                const struct pipe_resource *resource)
+lp_scene_add_resource_reference(struct lp_scene *scene,
+                                struct pipe_resource *resource,
+                                struct llvmpipe_storage *storage,
+                                unsigned levels,
+                                boolean initializing_scene)
 {
-   const struct resource_ref *ref;
-   int i;
-
-   for (ref = scene->resources; ref; ref = ref->next) {
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
-            return TRUE;
-   }
-
-   return FALSE;
+   return add_resource_reference(scene, resource, storage,
+                                 LP_REFERENCED_FOR_READ, levels,
+                                 initializing_scene);
 }
 
 
+/**
+ * Note that commands of the scene write to some levels of a resource,
+ * other than through the framebuffer.  FALSE means the scene should be
+ * flushed first.
+ */
+boolean
+lp_scene_add_resource_write(struct lp_scene *scene,
+                            struct pipe_resource *resource,
+                            struct llvmpipe_storage *storage,
+                            unsigned levels)
+{
+   return add_resource_reference(scene, resource, storage,
+                                 LP_REFERENCED_FOR_READ |
+                                 LP_REFERENCED_FOR_WRITE,
+                                 levels, FALSE);
+}
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/**
+ * Does this scene have a reference to any of the given levels of a
+ * resource?  References to storage the resource has since been renamed
+ * away from don't count.
+ * \return bitmask of LP_REFERENCED_FOR_READ/WRITE
+ */
+unsigned
+lp_scene_is_resource_referenced(const struct lp_scene *scene,
+                                const struct pipe_resource *resource,
+                                unsigned levels)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
+   const struct llvmpipe_storage *storage =
+      llvmpipe_resource_const(resource)->storage;
+   const struct resource_ref *ref =
+      *find_resource_ref(scene, resource, storage);
+   unsigned usage = LP_UNREFERENCED;
+
+   if (ref) {
+      if (ref->read_levels & levels)
+         usage |= LP_REFERENCED_FOR_READ;
+      if (ref->write_levels & levels)
+         usage |= LP_REFERENCED_FOR_WRITE;
    }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
-   }
-   return TRUE;
+
+   return usage;
 }
 
 
+
+
 void
 lp_scene_bin_iter_begin( struct lp_scene *scene )
 {
-   scene->curr_x = scene->curr_y = -1;
+   scene->curr_bin = 0;
 }
 
 
 /**
  * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Only bins which have commands are returned, so empty tiles of a
+ * mostly untouched framebuffer cost nothing.
  * Multiple rendering threads will call this function to get a chunk
  * of work (a bin) to work on.
  */
 struct cmd_bin *
 lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   unsigned i = p_atomic_inc_return(&scene->curr_bin) - 1;
+   unsigned index;
 
-   pipe_mutex_lock(scene->mutex);
-
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
+   if (i >= scene->num_active_bins) {
       /* no more bins left */
-      goto end;
+      return NULL;
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   index = scene->active_bins[i];
+   *x = index / TILES_Y;
+   *y = index % TILES_Y;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   pipe_mutex_unlock(scene->mutex);
-   return bin;
+   return lp_scene_get_bin(scene, *x, *y);
 }
 
 
@@ -551,6 +687,28 @@ void lp_scene_begin_binning( struct lp_scene *scene,
 
 void lp_scene_end_binning( struct lp_scene *scene )
 {
+   unsigned i, j;
+
+   /* Every bin with commands may write its tile of the color buffers,
+    * which display targets need to know to present only those.
+    */
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      struct pipe_surface *cbuf = scene->fb.cbufs[i];
+      struct llvmpipe_resource *lpr;
+
+      if (!cbuf)
+         continue;
+
+      lpr = llvmpipe_resource(cbuf->texture);
+      if (!lpr->damage)
+         continue;
+
+      for (j = 0; j < scene->num_active_bins; j++) {
+         unsigned bin = scene->active_bins[j];
+         llvmpipe_resource_damage_tile(lpr, bin / TILES_Y, bin % TILES_Y);
+      }
+   }
+
    if (LP_DEBUG & DEBUG_SCENE) {
       debug_printf("rasterize scene:\n");
       debug_printf("  scene_size: %u\n",
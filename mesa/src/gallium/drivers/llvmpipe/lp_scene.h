@@ -38,9 +38,11 @@
 #include "os/os_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
+#include "lp_perf.h"
 
 struct lp_scene_queue;
 struct lp_rast_state;
+struct llvmpipe_storage;
 
 /* We're limited to 2K by 2K for 32bit fixed point rasterization.
  * Will need a 64-bit version for larger framebuffers.
@@ -58,14 +60,26 @@ struct lp_rast_state;
  */
 #define DATA_BLOCK_SIZE (64 * 1024)
 
-/* Scene temporary storage is clamped to this size:
+/* Scene temporary storage is clamped to scene->max_size, which setup
+ * picks per scene.  It's never less than this, which leaves room for a
+ * command block in every bin plus some data:
  */
 #define LP_SCENE_MAX_SIZE (9*1024*1024)
 
-/* The maximum amount of texture storage referenced by a scene is
- * clamped to this size:
+/* Upper bound for scene->max_size, however many tiles and threads:
+ */
+#define LP_SCENE_MAX_SIZE_LIMIT (256*1024*1024)
+
+/* Initial scene storage budget per tile, adjusted from what previous
+ * scenes actually binned:
+ */
+#define LP_SCENE_TILE_BUDGET (16*1024)
+
+/* The amount of texture storage referenced by a scene is clamped to
+ * scene->max_resource_size, which lies between these two:
  */
 #define LP_SCENE_MAX_RESOURCE_SIZE (64*1024*1024)
+#define LP_SCENE_MAX_RESOURCE_SIZE_LIMIT (1024*1024*1024)
 
 
 /* switch to a non-pointer value for this:
@@ -116,6 +130,7 @@ struct data_block_list {
 };
 
 struct resource_ref;
+struct resource_ref_block;
 
 /**
  * All bins and bin data are contained here.
@@ -135,6 +150,9 @@ struct lp_scene {
    /* If queries were either active or there were begin/end query commands */
    boolean had_queries;
 
+   /* What binning and, once finished, rasterization of this scene did */
+   struct lp_counters counters;
+
    /* Framebuffer mappings - valid only between begin_rasterization()
     * and end_rasterization().
     */
@@ -152,7 +170,16 @@ struct lp_scene {
    struct pipe_framebuffer_state fb;
 
    /** list of resources referenced by the scene commands */
-   struct resource_ref *resources;
+   struct resource_ref_block *resources;
+
+   /** hash of the references above, by resource and storage, with
+    * 1 << resource_table_order slots
+    */
+   struct resource_ref **resource_table;
+   unsigned resource_table_order;
+   unsigned num_resources;
+   /** How many of them the scene's commands write to */
+   unsigned num_written_resources;
 
    /** Total memory used by the scene (in bytes).  This sums all the
     * data blocks and counts all bins, state, resource references and
@@ -165,6 +192,10 @@ struct lp_scene {
     */
    unsigned resource_reference_size;
 
+   /** Limits on the two sizes above, chosen by setup for each scene */
+   unsigned max_size;
+   unsigned max_resource_size;
+
    boolean alloc_failed;
    boolean discard;
    /**
@@ -173,8 +204,15 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   pipe_mutex mutex;
+   /**
+    * Bins which received any commands, in the order they got their
+    * first one, as indices into tile[][] (x * TILES_Y + y).  Only these
+    * need visiting at rasterization and reset time.
+    */
+   uint16_t active_bins[TILES_X * TILES_Y];
+   unsigned num_active_bins;
+
+   int curr_bin;        /**< for iterating over active_bins */
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -197,10 +235,18 @@ struct cmd_block *lp_scene_new_cmd_block( struct lp_scene *scene,
 
 boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
+                                        struct llvmpipe_storage *storage,
+                                        unsigned levels,
                                         boolean initializing_scene);
 
-boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                        const struct pipe_resource *resource );
+boolean lp_scene_add_resource_write(struct lp_scene *scene,
+                                    struct pipe_resource *resource,
+                                    struct llvmpipe_storage *storage,
+                                    unsigned levels);
+
+unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
+                                         const struct pipe_resource *resource,
+                                         unsigned levels);
 
 
 /**
@@ -219,7 +265,7 @@ lp_scene_alloc( struct lp_scene *scene, unsigned size)
    if (LP_DEBUG & DEBUG_MEM)
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
 		   size, block->used, DATA_BLOCK_SIZE,
-		   scene->scene_size, LP_SCENE_MAX_SIZE);
+		   scene->scene_size, scene->max_size);
 
    if (block->used + size > DATA_BLOCK_SIZE) {
       block = lp_scene_new_data_block( scene );
@@ -253,7 +299,7 @@ lp_scene_alloc_aligned( struct lp_scene *scene, unsigned size,
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
 		   size + alignment - 1,
 		   block->used, DATA_BLOCK_SIZE,
-		   scene->scene_size, LP_SCENE_MAX_SIZE);
+		   scene->scene_size, scene->max_size);
        
    if (block->used + size + alignment - 1 > DATA_BLOCK_SIZE) {
       block = lp_scene_new_data_block( scene );
@@ -47,6 +47,8 @@
 #include "lp_debug.h"
 #include "lp_public.h"
 #include "lp_limits.h"
+#include "lp_query.h"
+#include "lp_trace.h"
 #include "lp_rast.h"
 
 #include "state_tracker/sw_winsys.h"
@@ -81,6 +83,7 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "linear_fs",      PERF_LINEAR_FS, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -296,8 +299,10 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
       return 1;
    case PIPE_CAP_COPY_BETWEEN_COMPRESSED_AND_PLAIN_FORMATS:
       return 1;
+   case PIPE_CAP_TEXTURE_FROM_USER_MEMORY:
+      return 1;
+   case PIPE_CAP_RESOURCE_FROM_USER_MEMORY: /* buffers can't be wrapped */
    case PIPE_CAP_MULTISAMPLE_Z_RESOLVE:
-   case PIPE_CAP_RESOURCE_FROM_USER_MEMORY:
    case PIPE_CAP_DEVICE_RESET_STATUS_QUERY:
    case PIPE_CAP_MAX_SHADER_PATCH_VARYINGS:
    case PIPE_CAP_DEPTH_BOUNDS_TEST:
@@ -525,10 +530,53 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
+   struct pipe_box boxes[LP_MAX_DAMAGE_BOXES];
+   unsigned nboxes = 0;
+   boolean shown = FALSE;
+   unsigned i;
 
    assert(texture->dt);
-   if (texture->dt)
-      winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+   if (!texture->dt)
+      return;
+
+   pipe_mutex_lock(screen->display_mutex);
+   for (i = 0; i < LP_MAX_DISPLAYED; i++) {
+      if (screen->displayed[i].drawable == context_private) {
+         shown = screen->displayed[i].resource_id == texture->id;
+         break;
+      }
+   }
+   if (i == LP_MAX_DISPLAYED) {
+      i = screen->next_displayed;
+      screen->next_displayed = (i + 1) % LP_MAX_DISPLAYED;
+      screen->displayed[i].drawable = context_private;
+   }
+
+   if (sub_box) {
+      /* The drawable only gets part of the texture, so it shows a mix of
+       * it and whatever was there before.  Keep the damage for the next
+       * full present.
+       */
+      if (!shown)
+         screen->displayed[i].drawable = NULL;
+      pipe_mutex_unlock(screen->display_mutex);
+
+      winsys->displaytarget_display(winsys, texture->dt, context_private,
+                                    1, sub_box);
+      return;
+   }
+
+   /* Only what was drawn since the drawable last showed this texture
+    * needs to go out.
+    */
+   nboxes = llvmpipe_resource_get_damage(texture, boxes, ARRAY_SIZE(boxes));
+   if (!shown)
+      nboxes = 0;
+   screen->displayed[i].resource_id = texture->id;
+   pipe_mutex_unlock(screen->display_mutex);
+
+   winsys->displaytarget_display(winsys, texture->dt, context_private,
+                                 nboxes, nboxes ? boxes : NULL);
 }
 
 static void
@@ -545,7 +593,11 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if(winsys->destroy)
       winsys->destroy(winsys);
 
+   llvmpipe_free_cached_storage(screen);
+
    pipe_mutex_destroy(screen->rast_mutex);
+   pipe_mutex_destroy(screen->storage_mutex);
+   pipe_mutex_destroy(screen->display_mutex);
 
    FREE(screen);
 }
@@ -592,6 +644,69 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+#define QUERY(NAME, ENUM, UNITS) \
+   {NAME, ENUM, {0}, UNITS, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE, 0, 0x0}
+
+   static const struct pipe_driver_query_info queries[] = {
+      QUERY("forced-flushes", LP_QUERY_FORCED_FLUSHES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("scene-max-size", LP_QUERY_SCENE_MAX_SIZE,
+            PIPE_DRIVER_QUERY_TYPE_BYTES),
+      QUERY("scene-max-resource-size", LP_QUERY_SCENE_MAX_RESOURCE_SIZE,
+            PIPE_DRIVER_QUERY_TYPE_BYTES),
+   };
+#undef QUERY
+
+   if (!info)
+      return ARRAY_SIZE(queries) + LP_NUM_COUNTER_INFO;
+
+   if (index < ARRAY_SIZE(queries)) {
+      *info = queries[index];
+      return 1;
+   }
+
+   index -= ARRAY_SIZE(queries);
+   if (index >= LP_NUM_COUNTER_INFO)
+      return 0;
+
+   memset(info, 0, sizeof *info);
+   info->name = lp_counter_info[index].name;
+   info->query_type = LP_QUERY_COUNTER_FIRST + index;
+   info->type = lp_counter_info[index].microseconds ?
+                PIPE_DRIVER_QUERY_TYPE_MICROSECONDS :
+                PIPE_DRIVER_QUERY_TYPE_UINT64;
+   info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE;
+   return 1;
+}
+
+
+/**
+ * All the driver queries go in a single group, which is what
+ * GL_AMD_performance_monitor exposes.
+ */
+static int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info)
+{
+   if (!info)
+      return 1;
+
+   if (index != 0)
+      return 0;
+
+   info->name = "Driver statistics";
+   info->num_queries = llvmpipe_get_driver_query_info(screen, 0, NULL);
+   info->max_active_queries = info->num_queries;
+   return 1;
+}
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -636,6 +751,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_driver_query_group_info =
+      llvmpipe_get_driver_query_group_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -646,6 +764,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   lp_trace_init();
+
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
       lp_jit_screen_cleanup(screen);
@@ -653,6 +773,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
       return NULL;
    }
    pipe_mutex_init(screen->rast_mutex);
+   pipe_mutex_init(screen->storage_mutex);
+   pipe_mutex_init(screen->display_mutex);
 
    util_format_s3tc_init();
 
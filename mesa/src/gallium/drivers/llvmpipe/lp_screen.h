@@ -43,6 +43,23 @@
 struct sw_winsys;
 
 
+/** Max number, total bytes and single block size of released
+ * texture/buffer storage kept for reuse
+ */
+#define LP_MAX_CACHED_STORAGE 16
+#define LP_MAX_CACHED_STORAGE_BYTES (32 * 1024 * 1024)
+#define LP_MAX_CACHED_STORAGE_SIZE (16 * 1024 * 1024)
+
+/** Number of rasterized scenes after which unused cached storage is freed */
+#define LP_MAX_CACHED_STORAGE_AGE 4
+
+/** Number of drawables for which the last displayed resource is known */
+#define LP_MAX_DISPLAYED 8
+
+/** Max rectangles a damaged display target is presented as */
+#define LP_MAX_DAMAGE_BOXES 32
+
+
 struct llvmpipe_screen
 {
    struct pipe_screen base;
@@ -57,6 +74,31 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /** Storage released by renamed or destroyed resources, for reuse,
+    * oldest first
+    */
+   pipe_mutex storage_mutex;
+   unsigned num_cached_storage;
+   unsigned cached_storage_bytes;
+   unsigned storage_age;  /**< number of scenes rasterized */
+   struct {
+      void *data;
+      unsigned size;
+      unsigned age;  /**< storage_age when it was released */
+   } cached_storage[LP_MAX_CACHED_STORAGE];
+
+   /**
+    * Which resource each recently used drawable shows.  Presenting only
+    * the damage of a display target is only right if the drawable still
+    * shows that display target.
+    */
+   pipe_mutex display_mutex;
+   unsigned next_displayed;
+   struct {
+      void *drawable;
+      unsigned resource_id;
+   } displayed[LP_MAX_DISPLAYED];
 };
 
 
@@ -64,6 +64,64 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
 
+/**
+ * Choose the memory limits of the scene about to be binned.  The data
+ * limit is the per-tile budget times the number of tiles, as denser
+ * framebuffers need proportionally more bins and commands.  More
+ * rasterizer threads drain a big scene faster, so they raise the
+ * ceiling; splitting a frame costs a load and store of every tile.
+ */
+static void
+lp_setup_set_scene_limits(struct lp_setup_context *setup)
+{
+   struct lp_scene *scene = setup->scene;
+   uint64_t size = (uint64_t)scene->tiles_x * scene->tiles_y *
+                   setup->scene_tile_budget;
+   uint64_t ceiling = (uint64_t)LP_SCENE_MAX_SIZE *
+                      (1 + MAX2(1, setup->num_threads));
+
+   ceiling = MIN2(ceiling, LP_SCENE_MAX_SIZE_LIMIT);
+   scene->max_size = (unsigned)CLAMP(size, LP_SCENE_MAX_SIZE, ceiling);
+   scene->max_resource_size = setup->scene_stats.max_resource_size;
+
+   setup->scene_stats.max_size = scene->max_size;
+}
+
+
+/**
+ * Feed what the scene just binned back into the limits of the next
+ * one.  A scene that ran out of room doubles the budget that ran out;
+ * budgets decay again once scenes use less than a quarter of them, so
+ * a single heavy frame doesn't pin memory forever.
+ */
+static void
+lp_setup_update_scene_limits(struct lp_setup_context *setup)
+{
+   const struct lp_scene *scene = setup->scene;
+   unsigned tiles = MAX2(1, scene->tiles_x * scene->tiles_y);
+   unsigned tile_bytes = scene->scene_size / tiles;
+   unsigned max_resource_size = setup->scene_stats.max_resource_size;
+
+   if (scene->alloc_failed) {
+      setup->scene_tile_budget = MIN2(setup->scene_tile_budget * 2,
+                                      LP_SCENE_MAX_SIZE_LIMIT / 2);
+   }
+   else if (tile_bytes < setup->scene_tile_budget / 4) {
+      setup->scene_tile_budget = MAX2(setup->scene_tile_budget / 2,
+                                      LP_SCENE_TILE_BUDGET);
+   }
+
+   if (scene->resource_reference_size >= scene->max_resource_size) {
+      setup->scene_stats.max_resource_size =
+         MIN2(max_resource_size, LP_SCENE_MAX_RESOURCE_SIZE_LIMIT / 2) * 2;
+   }
+   else if (scene->resource_reference_size < max_resource_size / 4) {
+      setup->scene_stats.max_resource_size =
+         MAX2(max_resource_size / 2, LP_SCENE_MAX_RESOURCE_SIZE);
+   }
+}
+
+
 static void
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
@@ -84,6 +142,7 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
 
    lp_scene_begin_binning(setup->scene, &setup->fb, setup->rasterizer_discard);
 
+   lp_setup_set_scene_limits(setup);
 }
 
 
@@ -158,6 +217,8 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    memcpy(scene->active_queries, setup->active_queries,
           scene->num_active_queries * sizeof(scene->active_queries[0]));
 
+   lp_setup_update_scene_limits(setup);
+
    lp_scene_end_binning(scene);
 
    lp_fence_reference(&setup->last_fence, scene->fence);
@@ -177,13 +238,21 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
     * Certainly, lp_scene_end_rasterization() would need to be deferred too
     * and there's probably other bits why this doesn't actually work.
     */
+   LP_TRACE_BEGIN(setup->trace, "rasterize");
    lp_rast_queue_scene(screen->rast, scene);
    lp_rast_finish(screen->rast);
+   LP_TRACE_END(setup->trace, "rasterize");
+   lp_rast_collect_counters(screen->rast, &scene->counters);
    pipe_mutex_unlock(screen->rast_mutex);
 
+   lp_counters_add(&llvmpipe_context(scene->pipe)->counters,
+                   &scene->counters);
+
    lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
+   llvmpipe_age_cached_storage(screen);
+
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
 }
 
@@ -392,21 +461,11 @@ lp_setup_bind_framebuffer( struct lp_setup_context *setup,
 }
 
 
-/*
- * Try to clear one color buffer of the attached fb, either by binning a clear
- * command or queuing up the clear for later (when binning is started).
- */
-static boolean
-lp_setup_try_clear_color_buffer(struct lp_setup_context *setup,
-                                const union pipe_color_union *color,
-                                unsigned cbuf)
+static void
+lp_setup_pack_clear_color(enum pipe_format format,
+                          const union pipe_color_union *color,
+                          union util_color *uc)
 {
-   union lp_rast_cmd_arg clearrb_arg;
-   union util_color uc;
-   enum pipe_format format = setup->fb.cbufs[cbuf]->format;
-
-   LP_DBG(DEBUG_SETUP, "%s state %d\n", __FUNCTION__, setup->state);
-
    if (util_format_is_pure_integer(format)) {
       /*
        * We expect int/uint clear values here, though some APIs
@@ -414,16 +473,35 @@ lp_setup_try_clear_color_buffer(struct lp_setup_context *setup,
        * couldn't handle it)...
        */
       if (util_format_is_pure_sint(format)) {
-         util_format_write_4i(format, color->i, 0, &uc, 0, 0, 0, 1, 1);
+         util_format_write_4i(format, color->i, 0, uc, 0, 0, 0, 1, 1);
       }
       else {
          assert(util_format_is_pure_uint(format));
-         util_format_write_4ui(format, color->ui, 0, &uc, 0, 0, 0, 1, 1);
+         util_format_write_4ui(format, color->ui, 0, uc, 0, 0, 0, 1, 1);
       }
    }
    else {
-      util_pack_color(color->f, format, &uc);
+      util_pack_color(color->f, format, uc);
    }
+}
+
+
+/*
+ * Try to clear one color buffer of the attached fb, either by binning a clear
+ * command or queuing up the clear for later (when binning is started).
+ */
+static boolean
+lp_setup_try_clear_color_buffer(struct lp_setup_context *setup,
+                                const union pipe_color_union *color,
+                                unsigned cbuf)
+{
+   union lp_rast_cmd_arg clearrb_arg;
+   union util_color uc;
+   enum pipe_format format = setup->fb.cbufs[cbuf]->format;
+
+   LP_DBG(DEBUG_SETUP, "%s state %d\n", __FUNCTION__, setup->state);
+
+   lp_setup_pack_clear_color(format, color, &uc);
 
    if (setup->state == SETUP_ACTIVE) {
       struct lp_scene *scene = setup->scene;
@@ -575,6 +653,251 @@ lp_setup_clear( struct lp_setup_context *setup,
 
 
 
+/**
+ * Return the index of the bound color buffer showing the given texture
+ * image, or -1 if there is none.
+ */
+static int
+lp_setup_find_cbuf(const struct lp_setup_context *setup,
+                   const struct pipe_resource *resource,
+                   unsigned level,
+                   unsigned layer)
+{
+   unsigned i;
+
+   if (!llvmpipe_resource_is_texture(resource))
+      return -1;
+
+   for (i = 0; i < setup->fb.nr_cbufs; i++) {
+      const struct pipe_surface *cbuf = setup->fb.cbufs[i];
+
+      if (cbuf &&
+          cbuf->texture == resource &&
+          cbuf->u.tex.level == level &&
+          cbuf->u.tex.first_layer == layer)
+         return i;
+   }
+
+   return -1;
+}
+
+
+/**
+ * Bin a copy or fill command into every tile 'rect' touches.  For copies
+ * the scene also takes a reference on the other image.
+ */
+static boolean
+lp_setup_bin_rect(struct lp_setup_context *setup,
+                  unsigned cmd,
+                  const struct lp_rast_copy *rect,
+                  struct pipe_resource *other,
+                  unsigned other_level)
+{
+   struct lp_scene *scene = setup->scene;
+   struct lp_rast_copy *stored;
+   union lp_rast_cmd_arg arg;
+   int x, y;
+
+   if (other) {
+      struct llvmpipe_storage *storage = llvmpipe_resource(other)->storage;
+      boolean ok;
+
+      if (rect->to_cbuf)
+         ok = lp_scene_add_resource_reference(scene, other, storage,
+                                              1 << other_level, FALSE);
+      else
+         ok = lp_scene_add_resource_write(scene, other, storage,
+                                          1 << other_level);
+
+      if (!ok)
+         return FALSE;
+   }
+
+   stored = lp_scene_alloc_aligned(scene, sizeof *stored, 8);
+   if (!stored)
+      return FALSE;
+
+   *stored = *rect;
+   arg.copy = stored;
+
+   for (y = rect->rect.y0 / TILE_SIZE; y <= rect->rect.y1 / TILE_SIZE; y++) {
+      for (x = rect->rect.x0 / TILE_SIZE; x <= rect->rect.x1 / TILE_SIZE; x++) {
+         if (!lp_scene_bin_command(scene, x, y, cmd, arg))
+            return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Bin a copy/fill, restarting the scene once if it ran out of space.
+ * Copies and fills are idempotent, so re-binning the tiles which had
+ * already got the command into the flushed scene is harmless.
+ */
+static boolean
+lp_setup_try_bin_rect(struct lp_setup_context *setup,
+                      unsigned cmd,
+                      const struct lp_rast_copy *rect,
+                      struct pipe_resource *other,
+                      unsigned other_level)
+{
+   if (setup->rasterizer_discard)
+      return FALSE;
+
+   /* The scene's tiles only cover the framebuffer. */
+   if (rect->rect.x0 < 0 || rect->rect.y0 < 0 ||
+       rect->rect.x1 >= (int) setup->fb.width ||
+       rect->rect.y1 >= (int) setup->fb.height)
+      return FALSE;
+
+   if (!set_scene_state(setup, SETUP_ACTIVE, __FUNCTION__))
+      return FALSE;
+
+   if (!lp_setup_bin_rect(setup, cmd, rect, other, other_level)) {
+      if (!lp_setup_flush_and_restart(setup))
+         return FALSE;
+
+      if (!lp_setup_bin_rect(setup, cmd, rect, other, other_level))
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Try to turn a resource_copy_region() into a scene command.  This works
+ * when one side of the copy is a bound color buffer: the copy is then
+ * split per tile and ordered against the draws to that tile, instead of
+ * flushing and waiting for the scene before copying on this thread.
+ *
+ * \return FALSE if the copy has to be done the synchronous way.
+ */
+boolean
+lp_setup_copy_region(struct lp_setup_context *setup,
+                     struct pipe_resource *dst, unsigned dst_level,
+                     unsigned dstx, unsigned dsty, unsigned dstz,
+                     struct pipe_resource *src, unsigned src_level,
+                     const struct pipe_box *src_box)
+{
+   struct lp_rast_copy copy;
+   struct pipe_resource *other;
+   struct llvmpipe_resource *lpr;
+   unsigned other_level, other_layer, other_usage;
+   unsigned blocksize = util_format_get_blocksize(src->format);
+   int cbuf;
+
+   if (src_box->depth != 1 ||
+       src_box->width <= 0 ||
+       src_box->height <= 0 ||
+       util_format_is_compressed(src->format) ||
+       util_format_is_compressed(dst->format) ||
+       util_format_get_blocksize(dst->format) != blocksize)
+      return FALSE;
+
+   memset(&copy, 0, sizeof copy);
+
+   cbuf = lp_setup_find_cbuf(setup, dst, dst_level, dstz);
+   if (cbuf >= 0) {
+      copy.to_cbuf = TRUE;
+      copy.rect.x0 = dstx;
+      copy.rect.y0 = dsty;
+      copy.dx = src_box->x - (int) dstx;
+      copy.dy = src_box->y - (int) dsty;
+      other = src;
+      other_level = src_level;
+      other_layer = src_box->z;
+   }
+   else {
+      cbuf = lp_setup_find_cbuf(setup, src, src_level, src_box->z);
+      if (cbuf < 0)
+         return FALSE;
+
+      copy.to_cbuf = FALSE;
+      copy.rect.x0 = src_box->x;
+      copy.rect.y0 = src_box->y;
+      copy.dx = (int) dstx - src_box->x;
+      copy.dy = (int) dsty - src_box->y;
+      other = dst;
+      other_level = dst_level;
+      other_layer = dstz;
+   }
+
+   copy.rect.x1 = copy.rect.x0 + src_box->width - 1;
+   copy.rect.y1 = copy.rect.y0 + src_box->height - 1;
+   copy.cbuf = cbuf;
+
+   if (util_format_get_blocksize(setup->fb.cbufs[cbuf]->format) != blocksize)
+      return FALSE;
+
+   /* The other image is accessed directly by the rasterizer threads, so
+    * it has to be plain texture memory which isn't written by the scene
+    * (that includes being bound to the framebuffer), and which isn't
+    * read by the scene either if the copy writes to it.  Wrapped user
+    * memory has no storage, but is never renamed either.
+    */
+   lpr = llvmpipe_resource(other);
+   if (!llvmpipe_resource_is_texture(other) ||
+       (!lpr->storage && !lpr->userBuffer))
+      return FALSE;
+
+   other_usage = lp_setup_is_resource_referenced(setup, other,
+                                                 1 << other_level);
+   if (copy.to_cbuf ? (other_usage & LP_REFERENCED_FOR_WRITE) : other_usage)
+      return FALSE;
+
+   copy.data = llvmpipe_get_texture_image_address(lpr, other_layer,
+                                                  other_level);
+   copy.stride = lpr->row_stride[other_level];
+
+   return lp_setup_try_bin_rect(setup, LP_RAST_OP_COPY_RECT, &copy,
+                                other, other_level);
+}
+
+
+/**
+ * Try to turn a clear_render_target() of a bound color buffer into a
+ * scene command.
+ * \return FALSE if the fill has to be done the synchronous way.
+ */
+boolean
+lp_setup_fill_region(struct lp_setup_context *setup,
+                     struct pipe_surface *dst,
+                     const union pipe_color_union *color,
+                     unsigned dstx, unsigned dsty,
+                     unsigned width, unsigned height)
+{
+   struct lp_rast_copy fill;
+   int cbuf;
+
+   if (!width || !height)
+      return TRUE;
+
+   if (!llvmpipe_resource_is_texture(dst->texture) ||
+       dst->u.tex.first_layer != dst->u.tex.last_layer)
+      return FALSE;
+
+   cbuf = lp_setup_find_cbuf(setup, dst->texture, dst->u.tex.level,
+                             dst->u.tex.first_layer);
+   if (cbuf < 0 ||
+       setup->fb.cbufs[cbuf]->format != dst->format)
+      return FALSE;
+
+   memset(&fill, 0, sizeof fill);
+
+   fill.cbuf = cbuf;
+   fill.rect.x0 = dstx;
+   fill.rect.y0 = dsty;
+   fill.rect.x1 = dstx + width - 1;
+   fill.rect.y1 = dsty + height - 1;
+   lp_setup_pack_clear_color(dst->format, color, &fill.color_val);
+
+   return lp_setup_try_bin_rect(setup, LP_RAST_OP_FILL_RECT, &fill, NULL, 0);
+}
+
+
 void 
 lp_setup_set_triangle_state( struct lp_setup_context *setup,
                              unsigned cull_mode,
@@ -814,6 +1137,9 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
           * reference to it.
           */
          pipe_resource_reference(&setup->fs.current_tex[i], res);
+         llvmpipe_storage_reference(&setup->fs.current_storage[i],
+                                    lp_tex->storage);
+         setup->fs.current_tex_levels[i] = 1;
 
          if (!lp_tex->dt) {
             /* regular texture - setup array of mipmap level offsets */
@@ -827,6 +1153,9 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
                assert(first_level <= last_level);
                assert(last_level <= res->last_level);
                jit_tex->base = lp_tex->tex_data;
+               setup->fs.current_tex_levels[i] =
+                  u_bit_consecutive(first_level,
+                                    last_level - first_level + 1);
             }
             else {
               jit_tex->base = lp_tex->data;
@@ -921,6 +1250,7 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
       }
       else {
          pipe_resource_reference(&setup->fs.current_tex[i], NULL);
+         llvmpipe_storage_reference(&setup->fs.current_storage[i], NULL);
       }
    }
    setup->fs.current_tex_num = num;
@@ -961,34 +1291,84 @@ lp_setup_set_fragment_sampler_state(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Does the framebuffer surface render to any of the given levels of
+ * a texture?
+ */
+static inline boolean
+surface_renders_to(const struct pipe_surface *surf,
+                   const struct pipe_resource *texture,
+                   unsigned levels)
+{
+   if (!surf || surf->texture != texture)
+      return FALSE;
+
+   /* Buffer surfaces use u.buf, and only have level 0 */
+   if (!llvmpipe_resource_is_texture(texture))
+      return (levels & 1) != 0;
+
+   return (levels & (1 << surf->u.tex.level)) != 0;
+}
+
+
 /**
  * Is the given texture referenced by any scene?
  * Note: we have to check all scenes including any scenes currently
  * being rendered and the current scene being built.
+ * \param levels  mask of the levels of interest
  */
 unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
-                                const struct pipe_resource *texture )
+                                const struct pipe_resource *texture,
+                                unsigned levels )
 {
+   unsigned usage = LP_UNREFERENCED;
    unsigned i;
 
    /* check the render targets */
    for (i = 0; i < setup->fb.nr_cbufs; i++) {
-      if (setup->fb.cbufs[i] && setup->fb.cbufs[i]->texture == texture)
+      if (surface_renders_to(setup->fb.cbufs[i], texture, levels))
          return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
-   if (setup->fb.zsbuf && setup->fb.zsbuf->texture == texture) {
+   if (surface_renders_to(setup->fb.zsbuf, texture, levels)) {
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
+   /* check textures referenced by the scene, and resources written by
+    * binned copies
+    */
    for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
-      }
+      usage |= lp_scene_is_resource_referenced(setup->scenes[i], texture,
+                                               levels);
+   }
+
+   return usage;
+}
+
+
+/**
+ * Do binned commands of any scene write to the given texture?  Unlike
+ * lp_setup_is_resource_referenced(), rendering to the current framebuffer
+ * doesn't count.
+ * \param levels  mask of the levels of interest
+ */
+boolean
+lp_setup_is_resource_written(const struct lp_setup_context *setup,
+                             const struct pipe_resource *texture,
+                             unsigned levels)
+{
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+      const struct lp_scene *scene = setup->scenes[i];
+
+      if (scene->num_written_resources &&
+          (lp_scene_is_resource_referenced(scene, texture, levels) &
+           LP_REFERENCED_FOR_WRITE))
+         return TRUE;
    }
 
-   return LP_UNREFERENCED;
+   return FALSE;
 }
 
 
@@ -1162,6 +1542,8 @@ try_update_scene_state( struct lp_setup_context *setup )
             if (setup->fs.current_tex[i]) {
                if (!lp_scene_add_resource_reference(scene,
                                                     setup->fs.current_tex[i],
+                                                    setup->fs.current_storage[i],
+                                                    setup->fs.current_tex_levels[i],
                                                     new_scene)) {
                   assert(!new_scene);
                   return FALSE;
@@ -1277,6 +1659,7 @@ lp_setup_destroy( struct lp_setup_context *setup )
 
    for (i = 0; i < ARRAY_SIZE(setup->fs.current_tex); i++) {
       pipe_resource_reference(&setup->fs.current_tex[i], NULL);
+      llvmpipe_storage_reference(&setup->fs.current_storage[i], NULL);
    }
 
    for (i = 0; i < ARRAY_SIZE(setup->constants); i++) {
@@ -1325,6 +1708,11 @@ lp_setup_create( struct pipe_context *pipe,
 
 
    setup->num_threads = screen->num_threads;
+   setup->trace = llvmpipe_context(pipe)->trace;
+   setup->scene_tile_budget = LP_SCENE_TILE_BUDGET;
+   setup->scene_stats.max_size = LP_SCENE_MAX_SIZE;
+   setup->scene_stats.max_resource_size = LP_SCENE_MAX_RESOURCE_SIZE;
+
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
@@ -1364,6 +1752,13 @@ no_setup:
 }
 
 
+const struct lp_setup_scene_stats *
+lp_setup_get_scene_stats(const struct lp_setup_context *setup)
+{
+   return &setup->scene_stats;
+}
+
+
 /**
  * Put a BeginQuery command into all bins.
  */
@@ -1487,6 +1882,8 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 
    assert(setup->state == SETUP_ACTIVE);
 
+   setup->scene_stats.forced_flushes++;
+
    if (!set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__))
       return FALSE;
    
@@ -35,6 +35,7 @@ struct vertex_info;
 
 
 struct pipe_resource;
+struct pipe_box;
 struct pipe_query;
 struct pipe_surface;
 struct pipe_blend_color;
@@ -62,6 +63,21 @@ lp_setup_clear(struct lp_setup_context *setup,
 
 
 
+boolean
+lp_setup_copy_region(struct lp_setup_context *setup,
+                     struct pipe_resource *dst, unsigned dst_level,
+                     unsigned dstx, unsigned dsty, unsigned dstz,
+                     struct pipe_resource *src, unsigned src_level,
+                     const struct pipe_box *src_box);
+
+boolean
+lp_setup_fill_region(struct lp_setup_context *setup,
+                     struct pipe_surface *dst,
+                     const union pipe_color_union *color,
+                     unsigned dstx, unsigned dsty,
+                     unsigned width, unsigned height);
+
+
 void
 lp_setup_flush( struct lp_setup_context *setup,
                 struct pipe_fence_handle **fence,
@@ -137,7 +153,13 @@ lp_setup_set_fragment_sampler_state(struct lp_setup_context *setup,
 
 unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
-                                const struct pipe_resource *texture );
+                                const struct pipe_resource *texture,
+                                unsigned levels );
+
+boolean
+lp_setup_is_resource_written(const struct lp_setup_context *setup,
+                             const struct pipe_resource *texture,
+                             unsigned levels);
 
 void
 lp_setup_set_flatshade_first( struct lp_setup_context *setup, 
@@ -151,6 +173,20 @@ void
 lp_setup_set_vertex_info( struct lp_setup_context *setup, 
                           struct vertex_info *info );
 
+/**
+ * Scene memory limits and how often they cut a frame short, reported
+ * through the llvmpipe driver queries.
+ */
+struct lp_setup_scene_stats
+{
+   uint64_t forced_flushes;       /**< mid-frame flushes to free memory */
+   unsigned max_size;             /**< scene data limit in use */
+   unsigned max_resource_size;    /**< referenced texture limit in use */
+};
+
+const struct lp_setup_scene_stats *
+lp_setup_get_scene_stats(const struct lp_setup_context *setup);
+
 void
 lp_setup_begin_query(struct lp_setup_context *setup,
                      struct llvmpipe_query *pq);
@@ -81,6 +81,10 @@ struct lp_setup_context
    uint sprite_coord_enable, sprite_coord_origin;
    uint vertex_buffer_size;
    void *vertex_buffer;
+   /* vertices being drawn: either vertex_buffer, or the draw module's own
+    * vertices when it bypasses the vertex buffer (see set_vertices)
+    */
+   const void *vertex_data;
 
    /* Final pipeline stage for draw module.  Draw module should
     * create/install this itself now.
@@ -91,6 +95,10 @@ struct lp_setup_context
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
+   struct lp_setup_scene_stats scene_stats;
+   struct lp_trace_buffer *trace;
+   unsigned scene_tile_budget;   /**< scene bytes allowed per tile */
+
    struct lp_fence *last_fence;
    struct llvmpipe_query *active_queries[LP_MAX_ACTIVE_BINNED_QUERIES];
    unsigned active_binned_queries;
@@ -133,6 +141,10 @@ struct lp_setup_context
       const struct lp_rast_state *stored; /**< what's in the scene */
       struct lp_rast_state current;  /**< currently set state */
       struct pipe_resource *current_tex[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+      /** storage current.jit_context.textures[] point into */
+      struct llvmpipe_storage *current_storage[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+      /** masks of the levels of current_tex[] the sampler views cover */
+      unsigned current_tex_levels[PIPE_MAX_SHADER_SAMPLER_VIEWS];
       unsigned current_tex_num;
    } fs;
 
@@ -221,4 +233,34 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                        int nr_planes,
                        unsigned scissor_index );
 
+struct lp_rast_rectangle *
+lp_setup_alloc_rectangle(struct lp_scene *scene,
+                         unsigned nr_inputs);
+
+boolean
+lp_setup_bin_rectangle(struct lp_setup_context *setup,
+                       struct lp_rast_rectangle *rect);
+
+unsigned
+lp_setup_box_mask(const struct u_rect *box, int x, int y);
+
+unsigned
+lp_setup_planes_mask(const struct lp_rast_plane *plane, int nr_planes,
+                     int x, int y);
+
+boolean
+lp_setup_bin_block(struct lp_setup_context *setup,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y,
+                   unsigned mask);
+
+boolean
+lp_setup_rectangle(struct lp_setup_context *setup,
+                   const float (*a0)[4],
+                   const float (*a1)[4],
+                   const float (*a2)[4],
+                   const float (*b0)[4],
+                   const float (*b1)[4],
+                   const float (*b2)[4]);
+
 #endif
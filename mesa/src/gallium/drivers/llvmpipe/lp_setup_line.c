@@ -340,7 +340,7 @@ try_setup_line( struct lp_setup_context *setup,
    dy = v1[0][1] - v2[0][1];
    area = (dx * dx  + dy * dy);
    if (area == 0) {
-      LP_COUNT(nr_culled_tris);
+      LP_COUNT(scene, nr_culled_tris);
       return TRUE;
    }
 
@@ -569,13 +569,13 @@ try_setup_line( struct lp_setup_context *setup,
    if (bbox.x1 < bbox.x0 ||
        bbox.y1 < bbox.y0) {
       if (0) debug_printf("empty bounding box\n");
-      LP_COUNT(nr_culled_tris);
+      LP_COUNT(scene, nr_culled_tris);
       return TRUE;
    }
 
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("offscreen\n");
-      LP_COUNT(nr_culled_tris);
+      LP_COUNT(scene, nr_culled_tris);
       return TRUE;
    }
 
@@ -610,7 +610,7 @@ try_setup_line( struct lp_setup_context *setup,
    line->v[1][1] = v2[0][1];
 #endif
 
-   LP_COUNT(nr_tris);
+   LP_COUNT(scene, nr_tris);
 
    if (lp_context->active_statistics_queries &&
        !llvmpipe_rasterization_disabled(lp_context)) {
@@ -695,6 +695,31 @@ try_setup_line( struct lp_setup_context *setup,
       if (plane[i].dcdy > 0) plane[i].eo += plane[i].dcdy;
    }
 
+   /*
+    * Short lines touching a single 4x4 block: work out the coverage here
+    * (the draw region takes care of the scissor) and hand the rasterizer
+    * just the mask, batched with the block's other small primitives.
+    * The planes aren't needed past this point, so give their space back.
+    */
+   {
+      struct u_rect trimmed = bbox;
+      u_rect_find_intersection(&setup->draw_regions[viewport_index],
+                               &trimmed);
+
+      if ((trimmed.x0 & ~3) == (trimmed.x1 & ~3) &&
+          (trimmed.y0 & ~3) == (trimmed.y1 & ~3)) {
+         int bx = trimmed.x0 & ~3;
+         int by = trimmed.y0 & ~3;
+         unsigned mask = (lp_setup_planes_mask(plane, 4, bx, by) &
+                          lp_setup_box_mask(&trimmed, bx, by));
+
+         lp_scene_putback_data(scene,
+                               nr_planes * sizeof(struct lp_rast_plane));
+
+         return lp_setup_bin_block(setup, &line->inputs, bx, by, mask);
+      }
+   }
+
 
    /* 
     * When rasterizing scissored tris, use the intersection of the
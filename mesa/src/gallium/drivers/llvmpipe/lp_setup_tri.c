@@ -221,7 +221,7 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
 {
    struct lp_scene *scene = setup->scene;
 
-   LP_COUNT(nr_fully_covered_64);
+   LP_COUNT(scene, nr_fully_covered_64);
 
    /* if variant is opaque and scissor doesn't effect the tile */
    if (inputs->opaque) {
@@ -244,13 +244,13 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
          lp_scene_bin_reset( scene, tx, ty );
       }
 
-      LP_COUNT(nr_shade_opaque_64);
+      LP_COUNT(scene, nr_shade_opaque_64);
       return lp_scene_bin_cmd_with_state( scene, tx, ty,
                                           setup->fs.stored,
                                           LP_RAST_OP_SHADE_TILE_OPAQUE,
                                           lp_rast_arg_inputs(inputs) );
    } else {
-      LP_COUNT(nr_shade_64);
+      LP_COUNT(scene, nr_shade_64);
       return lp_scene_bin_cmd_with_state( scene, tx, ty,
                                           setup->fs.stored, 
                                           LP_RAST_OP_SHADE_TILE,
@@ -325,13 +325,13 @@ do_triangle_ccw(struct lp_setup_context *setup,
    if (bbox.x1 < bbox.x0 ||
        bbox.y1 < bbox.y0) {
       if (0) debug_printf("empty bounding box\n");
-      LP_COUNT(nr_culled_tris);
+      LP_COUNT(scene, nr_culled_tris);
       return TRUE;
    }
 
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("offscreen\n");
-      LP_COUNT(nr_culled_tris);
+      LP_COUNT(scene, nr_culled_tris);
       return TRUE;
    }
 
@@ -370,7 +370,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
    tri->v[2][1] = v2[0][1];
 #endif
 
-   LP_COUNT(nr_tris);
+   LP_COUNT(scene, nr_tris);
 
    /* Setup parameter interpolants:
     */
@@ -749,6 +749,103 @@ floor_pot(uint32_t n)
 }
 
 
+/**
+ * Look for a batch command for the block at x, y that can still be
+ * appended to: it has to be the last command in the bin (so drawing
+ * order is kept) and no state change may have come in between.
+ * \param max  returns the size the block's next batch should have
+ */
+static union lp_rast_cmd_arg *
+last_block_batch(struct lp_setup_context *setup,
+                 unsigned cmd, int x, int y,
+                 unsigned *max)
+{
+   struct cmd_bin *bin = lp_scene_get_bin(setup->scene,
+                                          x / TILE_SIZE, y / TILE_SIZE);
+   struct cmd_block *tail = bin->tail;
+   union lp_rast_cmd_arg *arg;
+
+   *max = 2;
+
+   if (bin->last_state != setup->fs.stored ||
+       !tail || !tail->count ||
+       tail->cmd[tail->count - 1] != cmd)
+      return NULL;
+
+   arg = &tail->arg[tail->count - 1];
+   if (arg->block->x != x || arg->block->y != y)
+      return NULL;
+
+   *max = arg->block->max * 2;
+   return arg;
+}
+
+
+/**
+ * Hand the three planes at the end of a triangle back to the scene, which
+ * is only possible while they are the last thing allocated from it.
+ */
+static void
+putback_planes(struct lp_scene *scene, const struct lp_rast_plane *plane)
+{
+   assert(scene->data.head &&
+          (const ubyte *)&plane[3] ==
+          scene->data.head->data + scene->data.head->used);
+   lp_scene_putback_data(scene, 3 * sizeof *plane);
+}
+
+
+/**
+ * Bin a triangle contained in the 16x16 block at x, y (in framebuffer
+ * pixels), keeping only a compact copy of its three planes.
+ */
+static boolean
+bin_block_tri(struct lp_setup_context *setup,
+              const struct lp_rast_shader_inputs *inputs,
+              const struct lp_rast_plane16 *plane,
+              int x, int y)
+{
+   struct lp_rast_block_tris *tris;
+   union lp_rast_cmd_arg *arg;
+   unsigned max;
+
+   LP_COUNT(setup->scene, nr_block_tris);
+
+   arg = last_block_batch(setup, LP_RAST_OP_BLOCK_TRIS, x, y, &max);
+   if (arg && arg->block->count < arg->block->max) {
+      tris = arg->block_tris;
+   }
+   else {
+      max = MIN2(max, LP_RAST_BLOCK_TRIS_MAX);
+      tris = lp_scene_alloc_aligned(setup->scene,
+                                    offsetof(struct lp_rast_block_tris, tri) +
+                                    max * sizeof tris->tri[0],
+                                    8);
+      if (!tris)
+         return FALSE;
+
+      tris->header.x = x;
+      tris->header.y = y;
+      tris->header.count = 0;
+      tris->header.max = max;
+
+      if (!lp_scene_bin_cmd_with_state(setup->scene,
+                                       x / TILE_SIZE, y / TILE_SIZE,
+                                       setup->fs.stored,
+                                       LP_RAST_OP_BLOCK_TRIS,
+                                       lp_rast_arg_block_tris(tris)))
+         return FALSE;
+   }
+
+   memcpy(tris->tri[tris->header.count].plane, plane,
+          sizeof tris->tri[0].plane);
+   tris->tri[tris->header.count].inputs = inputs;
+   tris->header.count++;
+
+   return TRUE;
+}
+
+
 boolean
 lp_setup_bin_triangle( struct lp_setup_context *setup,
                        struct lp_rast_triangle *tri,
@@ -793,18 +890,30 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
 	     ix0 == bbox->x1 / TILE_SIZE);
 
       if (nr_planes == 3) {
+         /* Triangles this small are batched per block and don't keep their
+          * planes, whose space (the tail of the triangle, which was the
+          * last thing allocated) is handed back to the scene.  Dense
+          * meshes then use far less scene memory and far fewer commands.
+          * Where the rasterizer has SIMD code for triangles in a 16x16
+          * block, those still get a command each and keep their planes.
+          */
+         struct lp_rast_plane *plane = GET_PLANES(tri);
+         int bx = ix0 * TILE_SIZE;
+         int by = iy0 * TILE_SIZE;
+
          if (sz < 4)
          {
             /* Triangle is contained in a single 4x4 stamp:
              */
+            unsigned mask;
+
             assert(px + 4 <= TILE_SIZE);
             assert(py + 4 <= TILE_SIZE);
-            return lp_scene_bin_cmd_with_state( scene, ix0, iy0,
-                                                setup->fs.stored,
-                                                use_32bits ?
-                                                LP_RAST_OP_TRIANGLE_32_3_4 :
-                                                LP_RAST_OP_TRIANGLE_3_4,
-                                                lp_rast_arg_triangle_contained(tri, px, py) );
+
+            mask = lp_setup_planes_mask(plane, 3, bx + px, by + py);
+            putback_planes(scene, plane);
+            return lp_setup_bin_block(setup, &tri->inputs,
+                                      bx + px, by + py, mask);
          }
 
          if (sz < 16)
@@ -823,12 +932,35 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
             assert(px + 16 <= TILE_SIZE);
             assert(py + 16 <= TILE_SIZE);
 
-            return lp_scene_bin_cmd_with_state( scene, ix0, iy0,
-                                                setup->fs.stored,
-                                                use_32bits ?
-                                                LP_RAST_OP_TRIANGLE_32_3_16 :
-                                                LP_RAST_OP_TRIANGLE_3_16,
-                                                lp_rast_arg_triangle_contained(tri, px, py) );
+#if defined(PIPE_ARCH_SSE) || (defined(_ARCH_PWR8) && defined(PIPE_ARCH_LITTLE_ENDIAN))
+            /* Keep the rasterizer's SIMD code for these. */
+            if (use_32bits)
+               return lp_scene_bin_cmd_with_state( scene, ix0, iy0,
+                                                   setup->fs.stored,
+                                                   LP_RAST_OP_TRIANGLE_32_3_16,
+                                                   lp_rast_arg_triangle_contained(tri, px, py) );
+#endif
+
+            {
+               struct lp_rast_plane16 plane16[3];
+
+               /* dcdx and dcdy are whole pixel steps scaled by FIXED_ONE,
+                * so the inside test (c > 0) can be done on c - 1 shifted
+                * down to whole pixels as well.
+                */
+               for (i = 0; i < 3; i++) {
+                  int64_t c = (plane[i].c +
+                               IMUL64(plane[i].dcdy, by + py) -
+                               IMUL64(plane[i].dcdx, bx + px));
+                  plane16[i].c = (int32_t)((c - 1) >> FIXED_ORDER);
+                  plane16[i].dcdx = plane[i].dcdx >> FIXED_ORDER;
+                  plane16[i].dcdy = plane[i].dcdy >> FIXED_ORDER;
+               }
+
+               putback_planes(scene, plane);
+               return bin_block_tri(setup, &tri->inputs, plane16,
+                                    bx + px, by + py);
+            }
          }
       }
       else if (nr_planes == 4 && sz < 16) 
@@ -916,7 +1048,7 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                /* do nothing */
                if (in)
                   break;  /* exiting triangle, all done with this row */
-               LP_COUNT(nr_empty_64);
+               LP_COUNT(scene, nr_empty_64);
             }
             else if (partial) {
                /* Not trivially accepted by at least one plane -
@@ -933,11 +1065,11 @@ lp_setup_bin_triangle( struct lp_setup_context *setup,
                                                  lp_rast_arg_triangle(tri, partial) ))
                   goto fail;
 
-               LP_COUNT(nr_partially_covered_64);
+               LP_COUNT(scene, nr_partially_covered_64);
             }
             else {
                /* triangle covers the whole tile- shade whole tile */
-               LP_COUNT(nr_fully_covered_64);
+               LP_COUNT(scene, nr_fully_covered_64);
                in = TRUE;
                if (!lp_setup_whole_tile(setup, &tri->inputs, x, y))
                   goto fail;
@@ -1188,6 +1320,113 @@ static void triangle_both(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Coverage mask of the 4x4 block at x, y within an inclusive box, with
+ * bit (row * 4 + col) set for each covered pixel.
+ */
+unsigned
+lp_setup_box_mask(const struct u_rect *box, int x, int y)
+{
+   int r0 = MAX2(box->y0 - y, 0);
+   int r1 = MIN2(box->y1 - y, 3);
+   int c0 = MAX2(box->x0 - x, 0);
+   int c1 = MIN2(box->x1 - x, 3);
+   unsigned rows, cols;
+
+   if (r0 > r1 || c0 > c1)
+      return 0;
+
+   rows = (0xffff << (4 * r0)) & (0xffff >> (12 - 4 * r1));
+   cols = ((0xf << c0) & (0xf >> (3 - c1))) * 0x1111;
+
+   return rows & cols;
+}
+
+
+/**
+ * Coverage mask of the 4x4 block at x, y for a set of planes, evaluated
+ * per pixel the same way the triangle rasterizer does.
+ */
+unsigned
+lp_setup_planes_mask(const struct lp_rast_plane *plane, int nr_planes,
+                     int x, int y)
+{
+   unsigned mask = 0xffff;
+   int i, j, k;
+
+   for (i = 0; i < nr_planes; i++) {
+      for (j = 0; j < 4; j++) {
+         for (k = 0; k < 4; k++) {
+            int64_t c = (plane[i].c +
+                         IMUL64(plane[i].dcdy, y + j) -
+                         IMUL64(plane[i].dcdx, x + k));
+            if (c <= 0)
+               mask &= ~(1 << (j * 4 + k));
+         }
+      }
+   }
+
+   return mask;
+}
+
+
+/**
+ * Bin a primitive which touches only the 4x4 block at x, y (in
+ * framebuffer pixels).  Consecutive ones in the same block are packed
+ * into a single command, so a cloud of small points costs one bin slot
+ * per block rather than one per point.
+ */
+boolean
+lp_setup_bin_block(struct lp_setup_context *setup,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y,
+                   unsigned mask)
+{
+   struct lp_rast_block_prims *prims;
+   union lp_rast_cmd_arg *arg;
+   unsigned max;
+
+   if (mask == 0) {
+      LP_COUNT(setup->scene, nr_culled_tris);
+      return TRUE;
+   }
+
+   LP_COUNT(setup->scene, nr_block_prims);
+
+   arg = last_block_batch(setup, LP_RAST_OP_BLOCK_PRIMS, x, y, &max);
+   if (arg && arg->block->count < arg->block->max) {
+      prims = arg->block_prims;
+   }
+   else {
+      max = MIN2(max, LP_RAST_BLOCK_PRIMS_MAX);
+      prims = lp_scene_alloc_aligned(setup->scene,
+                                     offsetof(struct lp_rast_block_prims, prim) +
+                                     max * sizeof prims->prim[0],
+                                     8);
+      if (!prims)
+         return FALSE;
+
+      prims->header.x = x;
+      prims->header.y = y;
+      prims->header.count = 0;
+      prims->header.max = max;
+
+      if (!lp_scene_bin_cmd_with_state(setup->scene,
+                                       x / TILE_SIZE, y / TILE_SIZE,
+                                       setup->fs.stored,
+                                       LP_RAST_OP_BLOCK_PRIMS,
+                                       lp_rast_arg_block_prims(prims)))
+         return FALSE;
+   }
+
+   prims->prim[prims->header.count].mask = mask;
+   prims->prim[prims->header.count].inputs = inputs;
+   prims->header.count++;
+
+   return TRUE;
+}
+
+
 static void triangle_nop( struct lp_setup_context *setup,
 			  const float (*v0)[4],
 			  const float (*v1)[4],
@@ -1196,6 +1435,332 @@ static void triangle_nop( struct lp_setup_context *setup,
 }
 
 
+/**
+ * Alloc space for a new rectangle plus the input.a0/dadx/dady arrays.
+ */
+struct lp_rast_rectangle *
+lp_setup_alloc_rectangle(struct lp_scene *scene,
+                         unsigned nr_inputs)
+{
+   unsigned input_array_sz = NUM_CHANNELS * (nr_inputs + 1) * sizeof(float);
+   struct lp_rast_rectangle *rect;
+
+   rect = lp_scene_alloc_aligned(scene,
+                                 sizeof *rect + 3 * input_array_sz,
+                                 16);
+   if (!rect)
+      return NULL;
+
+   rect->inputs.stride = input_array_sz;
+
+   return rect;
+}
+
+
+/**
+ * Bin an axis-aligned rectangle: whole-tile shading for the tiles it
+ * fully covers, a rectangle command for the ones on its border, or a
+ * block command if it lies within a single 4x4 block.
+ * rect->box must already be clipped to the draw region.
+ */
+boolean
+lp_setup_bin_rectangle(struct lp_setup_context *setup,
+                       struct lp_rast_rectangle *rect)
+{
+   struct lp_scene *scene = setup->scene;
+   const struct u_rect *box = &rect->box;
+   int ix0, iy0, ix1, iy1;
+   int x, y;
+
+   if ((box->x0 & ~3) == (box->x1 & ~3) &&
+       (box->y0 & ~3) == (box->y1 & ~3)) {
+      return lp_setup_bin_block(setup, &rect->inputs,
+                                box->x0 & ~3, box->y0 & ~3,
+                                lp_setup_box_mask(box, box->x0 & ~3,
+                                                  box->y0 & ~3));
+   }
+
+   ix0 = box->x0 / TILE_SIZE;
+   iy0 = box->y0 / TILE_SIZE;
+   ix1 = box->x1 / TILE_SIZE;
+   iy1 = box->y1 / TILE_SIZE;
+
+   for (y = iy0; y <= iy1; y++) {
+      /* Tiles hanging over the framebuffer edge only need to be covered
+       * up to that edge.
+       */
+      boolean full_y = (box->y0 <= y * TILE_SIZE &&
+                        box->y1 >= MIN2(y * TILE_SIZE + TILE_SIZE - 1,
+                                        setup->framebuffer.y1));
+
+      for (x = ix0; x <= ix1; x++) {
+         boolean full_x = (box->x0 <= x * TILE_SIZE &&
+                           box->x1 >= MIN2(x * TILE_SIZE + TILE_SIZE - 1,
+                                           setup->framebuffer.x1));
+
+         if (full_y && full_x) {
+            if (!lp_setup_whole_tile(setup, &rect->inputs, x, y))
+               goto fail;
+         }
+         else {
+            LP_COUNT(scene, nr_partially_covered_64);
+            if (!lp_scene_bin_cmd_with_state(scene, x, y,
+                                             setup->fs.stored,
+                                             LP_RAST_OP_RECTANGLE,
+                                             lp_rast_arg_rectangle(rect)))
+               goto fail;
+         }
+      }
+   }
+
+   return TRUE;
+
+fail:
+   /* See lp_setup_bin_triangle() */
+   rect->inputs.disable = TRUE;
+   return FALSE;
+}
+
+
+/**
+ * Bin the rectangle made of a pair of triangles.
+ * \param v0, v1, v2  a ccw triangle of the rectangle, used for the
+ *                    interpolants (which are the same for both halves)
+ * \param box  covered pixels, inclusive, already clipped to the draw region
+ */
+static boolean
+do_rectangle(struct lp_setup_context *setup,
+             const float (*v0)[4],
+             const float (*v1)[4],
+             const float (*v2)[4],
+             boolean frontfacing,
+             const struct u_rect *box)
+{
+   const struct lp_setup_variant_key *key = &setup->setup.variant->key;
+   struct lp_rast_rectangle *rect;
+
+   rect = lp_setup_alloc_rectangle(setup->scene, key->num_inputs);
+   if (!rect)
+      return FALSE;
+
+   LP_COUNT(setup->scene, nr_rects);
+
+   rect->box = *box;
+
+   setup->setup.variant->jit_function(v0, v1, v2,
+                                      frontfacing,
+                                      GET_A0(&rect->inputs),
+                                      GET_DADX(&rect->inputs),
+                                      GET_DADY(&rect->inputs));
+
+   rect->inputs.frontfacing = frontfacing;
+   rect->inputs.disable = FALSE;
+   rect->inputs.opaque = setup->fs.current.variant->opaque;
+   rect->inputs.layer = 0;
+   rect->inputs.viewport_index = 0;
+
+   return lp_setup_bin_rectangle(setup, rect);
+}
+
+
+/**
+ * Check that an attribute interpolates the same way over both triangles
+ * of a rectangle, given its corners.
+ */
+static inline boolean
+rect_attrib_affine(const float *c0, const float *c1,
+                   const float *c2, const float *c3,
+                   unsigned usage_mask, boolean constant)
+{
+   unsigned chan;
+
+   for (chan = 0; chan < NUM_CHANNELS; chan++) {
+      if (!(usage_mask & (1 << chan)))
+         continue;
+      if (constant) {
+         if (c0[chan] != c1[chan] ||
+             c0[chan] != c2[chan] ||
+             c0[chan] != c3[chan])
+            return FALSE;
+      }
+      else if (c0[chan] + c3[chan] != c1[chan] + c2[chan]) {
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Draw a pair of triangles as a single rectangle if they are the two
+ * halves of a screen-aligned rectangle with affine attributes, so that
+ * the tiles along the shared diagonal are shaded once rather than
+ * twice, and the border tiles don't need edge functions.
+ *
+ * The vertices are passed exactly as they would be to setup->triangle.
+ * \return FALSE if the pair isn't such a rectangle, in which case the
+ *         caller has to draw the triangles itself.
+ */
+boolean
+lp_setup_rectangle(struct lp_setup_context *setup,
+                   const float (*a0)[4],
+                   const float (*a1)[4],
+                   const float (*a2)[4],
+                   const float (*b0)[4],
+                   const float (*b1)[4],
+                   const float (*b2)[4])
+{
+   const struct lp_setup_variant_key *key = &setup->setup.variant->key;
+   struct llvmpipe_context *lp_context = (struct llvmpipe_context *)setup->pipe;
+   PIPE_ALIGN_VAR(16) struct fixed_position pa;
+   PIPE_ALIGN_VAR(16) struct fixed_position pb;
+   const float (*verts[6])[4];
+   const float (*corner[4])[4];
+   int xmin, xmax, ymin, ymax;
+   unsigned mask_a = 0, mask_b = 0;
+   unsigned missing_a, missing_b;
+   boolean frontfacing;
+   struct u_rect box;
+   unsigned attrib_size;
+   unsigned i;
+
+   if (setup->triangle == triangle_nop ||
+       setup->layer_slot > 0 ||
+       setup->viewport_index_slot > 0 ||
+       key->twoside ||
+       lp_context->active_statistics_queries)
+      return FALSE;
+
+   calc_fixed_position(setup, &pa, a0, a1, a2);
+   calc_fixed_position(setup, &pb, b0, b1, b2);
+
+   if (pa.area == 0 || (pa.area > 0) != (pb.area > 0) || pb.area == 0)
+      return FALSE;
+
+   xmin = MIN2(MIN3(pa.x[0], pa.x[1], pa.x[2]), MIN3(pb.x[0], pb.x[1], pb.x[2]));
+   xmax = MAX2(MAX3(pa.x[0], pa.x[1], pa.x[2]), MAX3(pb.x[0], pb.x[1], pb.x[2]));
+   ymin = MIN2(MIN3(pa.y[0], pa.y[1], pa.y[2]), MIN3(pb.y[0], pb.y[1], pb.y[2]));
+   ymax = MAX2(MAX3(pa.y[0], pa.y[1], pa.y[2]), MAX3(pb.y[0], pb.y[1], pb.y[2]));
+
+   /* Every vertex must sit on a corner of the combined bounding box.
+    * Corners are numbered with bit 0 set for xmax and bit 1 for ymax.
+    */
+   /* Only compare the attributes: with lp_setup_set_vertices() the
+    * vertex stride also covers the draw module's vertex header, so
+    * comparing a whole stride would run past the end of the last vertex.
+    */
+   attrib_size = setup->vertex_info->num_attribs * 4 * sizeof(float);
+
+   verts[0] = a0; verts[1] = a1; verts[2] = a2;
+   verts[3] = b0; verts[4] = b1; verts[5] = b2;
+   memset(corner, 0, sizeof corner);
+
+   for (i = 0; i < 6; i++) {
+      const struct fixed_position *p = i < 3 ? &pa : &pb;
+      int x = p->x[i % 3];
+      int y = p->y[i % 3];
+      unsigned c;
+
+      if ((x != xmin && x != xmax) ||
+          (y != ymin && y != ymax))
+         return FALSE;
+
+      c = (x == xmax) | ((y == ymax) << 1);
+
+      if (!corner[c])
+         corner[c] = verts[i];
+      else if (corner[c] != verts[i] &&
+               memcmp(corner[c], verts[i], attrib_size) != 0)
+         return FALSE;
+
+      if (i < 3)
+         mask_a |= 1 << c;
+      else
+         mask_b |= 1 << c;
+   }
+
+   /* Neither triangle is degenerate, so each covers three corners.  They
+    * tile the rectangle only if the corners they leave out are opposite.
+    */
+   missing_a = ffs(~mask_a & 0xf) - 1;
+   missing_b = ffs(~mask_b & 0xf) - 1;
+   if (missing_a != (missing_b ^ 3))
+      return FALSE;
+
+   /* Position z has to be affine and w constant, so that the planes of
+    * one triangle are also valid for the other.
+    */
+   if (!rect_attrib_affine(corner[0][0], corner[1][0],
+                           corner[2][0], corner[3][0], 0x4, FALSE) ||
+       !rect_attrib_affine(corner[0][0], corner[1][0],
+                           corner[2][0], corner[3][0], 0x8, TRUE))
+      return FALSE;
+
+   for (i = 0; i < key->num_inputs; i++) {
+      const struct lp_shader_input *input = &key->inputs[i];
+      const unsigned src = input->src_index;
+
+      if (input->interp == LP_INTERP_POSITION ||
+          input->interp == LP_INTERP_FACING)
+         continue;
+
+      if (input->cyl_wrap)
+         return FALSE;
+
+      if (!rect_attrib_affine(corner[0][src], corner[1][src],
+                              corner[2][src], corner[3][src],
+                              input->usage_mask,
+                              input->interp == LP_INTERP_CONSTANT))
+         return FALSE;
+   }
+
+   /* Both halves have the same orientation, so cull them together. */
+   frontfacing = (pa.area > 0) ? setup->ccw_is_frontface :
+                                 !setup->ccw_is_frontface;
+   if (setup->cullmode & (frontfacing ? PIPE_FACE_FRONT : PIPE_FACE_BACK))
+      return TRUE;
+
+   /* Covered pixels, with the same fill conventions as the edge
+    * functions of the triangles would give.
+    */
+   box.x0 = (xmin + FIXED_ONE - 1) >> FIXED_ORDER;
+   box.x1 = (xmax - 1) >> FIXED_ORDER;
+   if (setup->bottom_edge_rule == 0) {
+      box.y0 = (ymin + FIXED_ONE - 1) >> FIXED_ORDER;
+      box.y1 = (ymax - 1) >> FIXED_ORDER;
+   }
+   else {
+      box.y0 = (ymin >> FIXED_ORDER) + 1;
+      box.y1 = ymax >> FIXED_ORDER;
+   }
+
+   if (box.x1 < box.x0 ||
+       box.y1 < box.y0 ||
+       !u_rect_test_intersection(&setup->draw_regions[0], &box)) {
+      LP_COUNT_ADD(setup->scene, nr_culled_tris, 2);
+      return TRUE;
+   }
+
+   u_rect_find_intersection(&setup->draw_regions[0], &box);
+
+   if (pa.area < 0) {
+      const float (*tmp)[4] = a0;
+      a0 = a1;
+      a1 = tmp;
+   }
+
+   if (!do_rectangle(setup, a0, a1, a2, frontfacing, &box)) {
+      if (!lp_setup_flush_and_restart(setup))
+         return TRUE;
+
+      do_rectangle(setup, a0, a1, a2, frontfacing, &box);
+   }
+
+   return TRUE;
+}
+
+
 void 
 lp_setup_choose_triangle( struct lp_setup_context *setup )
 {
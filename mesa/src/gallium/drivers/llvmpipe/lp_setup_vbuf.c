@@ -86,14 +86,35 @@ lp_setup_allocate_vertices(struct vbuf_render *vbr,
 
    setup->vertex_size = vertex_size;
    setup->nr_vertices = nr_vertices;
+   setup->vertex_data = setup->vertex_buffer;
    
    return setup->vertex_buffer != NULL;
 }
 
+/**
+ * Draw directly from the draw module's post-transform vertices.  This
+ * saves writing every vertex into our own buffer only to read it back
+ * once during triangle setup.
+ */
+static boolean
+lp_setup_set_vertices(struct vbuf_render *vbr,
+                      const void *vertices,
+                      ushort vertex_size, ushort nr_vertices)
+{
+   struct lp_setup_context *setup = lp_setup_context(vbr);
+
+   setup->vertex_size = vertex_size;
+   setup->nr_vertices = nr_vertices;
+   setup->vertex_data = vertices;
+
+   return TRUE;
+}
+
 static void
 lp_setup_release_vertices(struct vbuf_render *vbr)
 {
    /* keep the old allocation for next time */
+   lp_setup_context(vbr)->vertex_data = NULL;
 }
 
 static void *
@@ -129,6 +150,25 @@ static inline const_float4_ptr get_vert( const void *vertex_buffer,
    return (const_float4_ptr)((char *)vertex_buffer + index * stride);
 }
 
+/**
+ * Emit two triangles, drawing them as a single rectangle when they
+ * form one.
+ */
+static inline void
+triangle_pair( struct lp_setup_context *setup,
+               const float (*a0)[4],
+               const float (*a1)[4],
+               const float (*a2)[4],
+               const float (*b0)[4],
+               const float (*b1)[4],
+               const float (*b2)[4] )
+{
+   if (!lp_setup_rectangle(setup, a0, a1, a2, b0, b1, b2)) {
+      setup->triangle( setup, a0, a1, a2 );
+      setup->triangle( setup, b0, b1, b2 );
+   }
+}
+
 /**
  * draw elements / indexed primitives
  */
@@ -136,8 +176,8 @@ static void
 lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
 {
    struct lp_setup_context *setup = lp_setup_context(vbr);
-   const unsigned stride = setup->vertex_info->size * sizeof(float);
-   const void *vertex_buffer = setup->vertex_buffer;
+   const unsigned stride = setup->vertex_size;
+   const void *vertex_buffer = setup->vertex_data;
    const boolean flatshade_first = setup->flatshade_first;
    unsigned i;
 
@@ -146,6 +186,8 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    if (!lp_setup_update_state(setup, TRUE))
       return;
 
+   LP_TRACE_BEGIN(setup->trace, "binning");
+
    switch (setup->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
@@ -184,15 +226,45 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
+      /* Quads are commonly sent as pairs of triangles. */
+      for (i = 5; i < nr; i += 6) {
+         triangle_pair( setup,
+                        get_vert(vertex_buffer, indices[i-5], stride),
+                        get_vert(vertex_buffer, indices[i-4], stride),
+                        get_vert(vertex_buffer, indices[i-3], stride),
+                        get_vert(vertex_buffer, indices[i-2], stride),
+                        get_vert(vertex_buffer, indices[i-1], stride),
+                        get_vert(vertex_buffer, indices[i-0], stride) );
+      }
+      if (i - 3 < nr) {
          setup->triangle( setup,
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
+                          get_vert(vertex_buffer, indices[i-5], stride),
+                          get_vert(vertex_buffer, indices[i-4], stride),
+                          get_vert(vertex_buffer, indices[i-3], stride) );
       }
       break;
 
    case PIPE_PRIM_TRIANGLE_STRIP:
+      if (nr == 4) {
+         /* A single quad, check for a rectangle */
+         if (flatshade_first)
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, indices[0], stride),
+                           get_vert(vertex_buffer, indices[1], stride),
+                           get_vert(vertex_buffer, indices[2], stride),
+                           get_vert(vertex_buffer, indices[1], stride),
+                           get_vert(vertex_buffer, indices[3], stride),
+                           get_vert(vertex_buffer, indices[2], stride) );
+         else
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, indices[0], stride),
+                           get_vert(vertex_buffer, indices[1], stride),
+                           get_vert(vertex_buffer, indices[2], stride),
+                           get_vert(vertex_buffer, indices[2], stride),
+                           get_vert(vertex_buffer, indices[1], stride),
+                           get_vert(vertex_buffer, indices[3], stride) );
+         break;
+      }
       if (flatshade_first) {
          for (i = 2; i < nr; i += 1) {
             /* emit first triangle vertex as first triangle vertex */
@@ -240,29 +312,25 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       if (flatshade_first) { 
          /* emit last quad vertex as first triangle vertex */
          for (i = 3; i < nr; i += 4) {
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i-0], stride),
-                             get_vert(vertex_buffer, indices[i-3], stride),
-                             get_vert(vertex_buffer, indices[i-2], stride) );
-
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i-0], stride),
-                             get_vert(vertex_buffer, indices[i-2], stride),
-                             get_vert(vertex_buffer, indices[i-1], stride) );
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, indices[i-0], stride),
+                           get_vert(vertex_buffer, indices[i-3], stride),
+                           get_vert(vertex_buffer, indices[i-2], stride),
+                           get_vert(vertex_buffer, indices[i-0], stride),
+                           get_vert(vertex_buffer, indices[i-2], stride),
+                           get_vert(vertex_buffer, indices[i-1], stride) );
          }
       }
       else {
          /* emit last quad vertex as last triangle vertex */
          for (i = 3; i < nr; i += 4) {
-            setup->triangle( setup,
-                          get_vert(vertex_buffer, indices[i-3], stride),
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
-
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i-2], stride),
-                             get_vert(vertex_buffer, indices[i-1], stride),
-                             get_vert(vertex_buffer, indices[i-0], stride) );
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, indices[i-3], stride),
+                           get_vert(vertex_buffer, indices[i-2], stride),
+                           get_vert(vertex_buffer, indices[i-0], stride),
+                           get_vert(vertex_buffer, indices[i-2], stride),
+                           get_vert(vertex_buffer, indices[i-1], stride),
+                           get_vert(vertex_buffer, indices[i-0], stride) );
          }
       }
       break;
@@ -272,27 +340,25 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       if (flatshade_first) { 
          /* emit last quad vertex as first triangle vertex */
          for (i = 3; i < nr; i += 2) {
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i-0], stride),
-                             get_vert(vertex_buffer, indices[i-3], stride),
-                             get_vert(vertex_buffer, indices[i-2], stride) );
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i-0], stride),
-                             get_vert(vertex_buffer, indices[i-1], stride),
-                             get_vert(vertex_buffer, indices[i-3], stride) );
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, indices[i-0], stride),
+                           get_vert(vertex_buffer, indices[i-3], stride),
+                           get_vert(vertex_buffer, indices[i-2], stride),
+                           get_vert(vertex_buffer, indices[i-0], stride),
+                           get_vert(vertex_buffer, indices[i-1], stride),
+                           get_vert(vertex_buffer, indices[i-3], stride) );
          }
       }
       else {
          /* emit last quad vertex as last triangle vertex */
          for (i = 3; i < nr; i += 2) {
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i-3], stride),
-                             get_vert(vertex_buffer, indices[i-2], stride),
-                             get_vert(vertex_buffer, indices[i-0], stride) );
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i-1], stride),
-                             get_vert(vertex_buffer, indices[i-3], stride),
-                             get_vert(vertex_buffer, indices[i-0], stride) );
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, indices[i-3], stride),
+                           get_vert(vertex_buffer, indices[i-2], stride),
+                           get_vert(vertex_buffer, indices[i-0], stride),
+                           get_vert(vertex_buffer, indices[i-1], stride),
+                           get_vert(vertex_buffer, indices[i-3], stride),
+                           get_vert(vertex_buffer, indices[i-0], stride) );
          }
       }
       break;
@@ -324,6 +390,8 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   LP_TRACE_END(setup->trace, "binning");
 }
 
 
@@ -335,15 +403,17 @@ static void
 lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
 {
    struct lp_setup_context *setup = lp_setup_context(vbr);
-   const unsigned stride = setup->vertex_info->size * sizeof(float);
+   const unsigned stride = setup->vertex_size;
    const void *vertex_buffer =
-      (void *) get_vert(setup->vertex_buffer, start, stride);
+      (void *) get_vert(setup->vertex_data, start, stride);
    const boolean flatshade_first = setup->flatshade_first;
    unsigned i;
 
    if (!lp_setup_update_state(setup, TRUE))
       return;
 
+   LP_TRACE_BEGIN(setup->trace, "binning");
+
    switch (setup->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
@@ -382,15 +452,45 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
+      /* Quads are commonly sent as pairs of triangles. */
+      for (i = 5; i < nr; i += 6) {
+         triangle_pair( setup,
+                        get_vert(vertex_buffer, i-5, stride),
+                        get_vert(vertex_buffer, i-4, stride),
+                        get_vert(vertex_buffer, i-3, stride),
+                        get_vert(vertex_buffer, i-2, stride),
+                        get_vert(vertex_buffer, i-1, stride),
+                        get_vert(vertex_buffer, i-0, stride) );
+      }
+      if (i - 3 < nr) {
          setup->triangle( setup,
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
+                          get_vert(vertex_buffer, i-5, stride),
+                          get_vert(vertex_buffer, i-4, stride),
+                          get_vert(vertex_buffer, i-3, stride) );
       }
       break;
 
    case PIPE_PRIM_TRIANGLE_STRIP:
+      if (nr == 4) {
+         /* A single quad, check for a rectangle */
+         if (flatshade_first)
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, 0, stride),
+                           get_vert(vertex_buffer, 1, stride),
+                           get_vert(vertex_buffer, 2, stride),
+                           get_vert(vertex_buffer, 1, stride),
+                           get_vert(vertex_buffer, 3, stride),
+                           get_vert(vertex_buffer, 2, stride) );
+         else
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, 0, stride),
+                           get_vert(vertex_buffer, 1, stride),
+                           get_vert(vertex_buffer, 2, stride),
+                           get_vert(vertex_buffer, 2, stride),
+                           get_vert(vertex_buffer, 1, stride),
+                           get_vert(vertex_buffer, 3, stride) );
+         break;
+      }
       if (flatshade_first) {
          for (i = 2; i < nr; i++) {
             /* emit first triangle vertex as first triangle vertex */
@@ -437,27 +537,25 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       if (flatshade_first) { 
          /* emit last quad vertex as first triangle vertex */
          for (i = 3; i < nr; i += 4) {
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-0, stride),
-                             get_vert(vertex_buffer, i-3, stride),
-                             get_vert(vertex_buffer, i-2, stride) );
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-0, stride),
-                             get_vert(vertex_buffer, i-2, stride),
-                             get_vert(vertex_buffer, i-1, stride) );
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, i-0, stride),
+                           get_vert(vertex_buffer, i-3, stride),
+                           get_vert(vertex_buffer, i-2, stride),
+                           get_vert(vertex_buffer, i-0, stride),
+                           get_vert(vertex_buffer, i-2, stride),
+                           get_vert(vertex_buffer, i-1, stride) );
          }
       }
       else {
          /* emit last quad vertex as last triangle vertex */
          for (i = 3; i < nr; i += 4) {
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-3, stride),
-                             get_vert(vertex_buffer, i-2, stride),
-                             get_vert(vertex_buffer, i-0, stride) );
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-2, stride),
-                             get_vert(vertex_buffer, i-1, stride),
-                             get_vert(vertex_buffer, i-0, stride) );
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, i-3, stride),
+                           get_vert(vertex_buffer, i-2, stride),
+                           get_vert(vertex_buffer, i-0, stride),
+                           get_vert(vertex_buffer, i-2, stride),
+                           get_vert(vertex_buffer, i-1, stride),
+                           get_vert(vertex_buffer, i-0, stride) );
          }
       }
       break;
@@ -467,27 +565,25 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       if (flatshade_first) { 
          /* emit last quad vertex as first triangle vertex */
          for (i = 3; i < nr; i += 2) {
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-0, stride),
-                             get_vert(vertex_buffer, i-3, stride),
-                             get_vert(vertex_buffer, i-2, stride) );
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-0, stride),
-                             get_vert(vertex_buffer, i-1, stride),
-                             get_vert(vertex_buffer, i-3, stride) );
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, i-0, stride),
+                           get_vert(vertex_buffer, i-3, stride),
+                           get_vert(vertex_buffer, i-2, stride),
+                           get_vert(vertex_buffer, i-0, stride),
+                           get_vert(vertex_buffer, i-1, stride),
+                           get_vert(vertex_buffer, i-3, stride) );
          }
       }
       else {
          /* emit last quad vertex as last triangle vertex */
          for (i = 3; i < nr; i += 2) {
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-3, stride),
-                             get_vert(vertex_buffer, i-2, stride),
-                             get_vert(vertex_buffer, i-0, stride) );
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-1, stride),
-                             get_vert(vertex_buffer, i-3, stride),
-                             get_vert(vertex_buffer, i-0, stride) );
+            triangle_pair( setup,
+                           get_vert(vertex_buffer, i-3, stride),
+                           get_vert(vertex_buffer, i-2, stride),
+                           get_vert(vertex_buffer, i-0, stride),
+                           get_vert(vertex_buffer, i-1, stride),
+                           get_vert(vertex_buffer, i-3, stride),
+                           get_vert(vertex_buffer, i-0, stride) );
          }
       }
       break;
@@ -519,6 +615,8 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   LP_TRACE_END(setup->trace, "binning");
 }
 
 
@@ -592,6 +690,7 @@ lp_setup_init_vbuf(struct lp_setup_context *setup)
    setup->base.allocate_vertices = lp_setup_allocate_vertices;
    setup->base.map_vertices = lp_setup_map_vertices;
    setup->base.unmap_vertices = lp_setup_unmap_vertices;
+   setup->base.set_vertices = lp_setup_set_vertices;
    setup->base.set_primitive = lp_setup_set_primitive;
    setup->base.draw_elements = lp_setup_draw_elements;
    setup->base.draw_arrays = lp_setup_draw_arrays;
@@ -2562,6 +2562,7 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
    tgsi_dump(variant->shader->base.tokens, 0);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
+   debug_printf("variant->linear.kind = %u\n", variant->linear.kind);
    debug_printf("\n");
 }
 
@@ -2620,6 +2621,8 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.uses_kill
       ? TRUE : FALSE;
 
+   lp_linear_init_variant(variant);
+
    if ((shader->info.base.num_tokens <= 1) &&
        !key->depth.enabled && !key->stencil[0].enabled) {
       variant->ps_inv_multiplier = 0;
@@ -3200,12 +3203,14 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       /*
        * Generate the new variant.
        */
+      LP_TRACE_BEGIN(lp->trace, "compile fs");
       t0 = os_time_get();
       variant = generate_variant(lp, shader, &key);
       t1 = os_time_get();
+      LP_TRACE_END(lp->trace, "compile fs");
       dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      LP_COUNT_ADD(lp, llvm_compile_time, dt);
+      LP_COUNT_ADD(lp, nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
       /* Put the new variant into the list */
       if (variant) {
@@ -36,6 +36,7 @@
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
+#include "lp_linear.h"
 
 
 struct tgsi_token;
@@ -110,6 +111,9 @@ struct lp_fragment_shader_variant
 
    lp_jit_frag_func jit_function[2];
 
+   /* Span shading of simple 2D shaders, see lp_linear.c */
+   struct lp_linear_info linear;
+
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
@@ -35,6 +35,7 @@
 #include "draw/draw_context.h"
 
 #include "lp_context.h"
+#include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_debug.h"
@@ -265,6 +266,21 @@ prepare_shader_sampling(
          unsigned first_level = 0;
          unsigned last_level = 0;
 
+         if (llvmpipe_resource_is_texture(tex)) {
+            first_level = view->u.tex.first_level;
+            last_level = view->u.tex.last_level;
+         }
+
+         /* Vertex and geometry shaders run now, not when the scene is
+          * rasterized, so wait for binned copies to the levels they sample.
+          * Sampling a bound color buffer is a feedback loop, which isn't
+          * waited for.
+          */
+         if (lp_setup_is_resource_written(lp->setup, tex,
+                                          ((2u << last_level) - 1) &
+                                          ~((1u << first_level) - 1)))
+            llvmpipe_finish(&lp->pipe, "vertex sampling");
+
          if (!lp_tex->dt) {
             /* regular texture - setup array of mipmap level offsets */
             struct pipe_resource *res = view->texture;
@@ -170,6 +170,28 @@ vert_attrib(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Load a whole float[4] vertex attribute.
+ *
+ * Vertices may come straight from the draw module's vertex_header
+ * layout (see lp_setup_set_vertices()), where the attributes are only
+ * 4 byte aligned.
+ */
+static LLVMValueRef
+vert_attrib_vec4(struct gallivm_state *gallivm,
+                 LLVMValueRef vert,
+                 LLVMValueRef attr,
+                 const char *name)
+{
+   LLVMBuilderRef b = gallivm->builder;
+   LLVMValueRef res;
+
+   res = LLVMBuildLoad(b, LLVMBuildGEP(b, vert, &attr, 1, ""), name);
+   LLVMSetAlignment(res, 4);
+   return res;
+}
+
+
 static void
 lp_twoside(struct gallivm_state *gallivm,
            struct lp_setup_args *args,
@@ -185,9 +207,9 @@ lp_twoside(struct gallivm_state *gallivm,
    LLVMValueRef front_facing = LLVMBuildICmp(b, LLVMIntEQ, facing,
                                              lp_build_const_int32(gallivm, 0), ""); /** need i1 for if condition */
 
-   a0_back = LLVMBuildLoad(b, LLVMBuildGEP(b, args->v0, &idx2, 1, ""), "v0a_back");
-   a1_back = LLVMBuildLoad(b, LLVMBuildGEP(b, args->v1, &idx2, 1, ""), "v1a_back");
-   a2_back = LLVMBuildLoad(b, LLVMBuildGEP(b, args->v2, &idx2, 1, ""), "v2a_back");
+   a0_back = vert_attrib_vec4(gallivm, args->v0, idx2, "v0a_back");
+   a1_back = vert_attrib_vec4(gallivm, args->v1, idx2, "v1a_back");
+   a2_back = vert_attrib_vec4(gallivm, args->v2, idx2, "v2a_back");
 
    /* Possibly swap the front and back attrib values,
     *
@@ -359,14 +381,13 @@ load_attribute(struct gallivm_state *gallivm,
                unsigned vert_attr,
                LLVMValueRef attribv[3])
 {
-   LLVMBuilderRef b = gallivm->builder;
    LLVMValueRef idx = lp_build_const_int32(gallivm, vert_attr);
 
    /* Load the vertex data
     */
-   attribv[0] = LLVMBuildLoad(b, LLVMBuildGEP(b, args->v0, &idx, 1, ""), "v0a");
-   attribv[1] = LLVMBuildLoad(b, LLVMBuildGEP(b, args->v1, &idx, 1, ""), "v1a");
-   attribv[2] = LLVMBuildLoad(b, LLVMBuildGEP(b, args->v2, &idx, 1, ""), "v2a");
+   attribv[0] = vert_attrib_vec4(gallivm, args->v0, idx, "v0a");
+   attribv[1] = vert_attrib_vec4(gallivm, args->v1, idx, "v1a");
+   attribv[2] = vert_attrib_vec4(gallivm, args->v2, idx, "v2a");
 
 
    /* Potentially modify it according to twoside, etc:
@@ -717,7 +738,7 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    LLVMTypeRef arg_types[7];
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
-   int64_t t0 = 0, t1;
+   int64_t t0, t1;
 
    if (0)
       goto fail;
@@ -738,9 +759,7 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    builder = gallivm->builder;
 
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t0 = os_time_get();
-   }
+   t0 = os_time_get();
 
    memcpy(&variant->key, key, key->size);
    variant->list_item_global.base = variant;
@@ -811,11 +830,9 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    /*
     * Update timing information:
     */
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t1 = os_time_get();
-      LP_COUNT_ADD(llvm_compile_time, t1 - t0);
-      LP_COUNT_ADD(nr_llvm_compiles, 1);
-   }
+   t1 = os_time_get();
+   LP_COUNT_ADD(lp, llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD(lp, nr_llvm_compiles, 1);
 
    return variant;
 
@@ -962,7 +979,9 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
          cull_setup_variants(lp);
       }
 
+      LP_TRACE_BEGIN(lp->trace, "compile setup");
       variant = generate_setup_variant(key, lp);
+      LP_TRACE_END(lp->trace, "compile setup");
       if (variant) {
          insert_at_head(&lp->setup_variants_list, &variant->list_item_global);
          lp->nr_setup_variants++;
@@ -33,6 +33,7 @@
 #include "lp_surface.h"
 #include "lp_texture.h"
 #include "lp_query.h"
+#include "lp_setup.h"
 
 
 static void
@@ -42,6 +43,14 @@ lp_resource_copy(struct pipe_context *pipe,
                  struct pipe_resource *src, unsigned src_level,
                  const struct pipe_box *src_box)
 {
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   /* Copies from or to a bound color buffer can go into the scene. */
+   if (lp_setup_copy_region(llvmpipe->setup,
+                            dst, dst_level, dstx, dsty, dstz,
+                            src, src_level, src_box))
+      return;
+
    llvmpipe_flush_resource(pipe,
                            dst, dst_level,
                            FALSE, /* read_only */
@@ -198,6 +207,10 @@ llvmpipe_clear_render_target(struct pipe_context *pipe,
    if (render_condition_enabled && !llvmpipe_check_render_cond(llvmpipe))
       return;
 
+   if (lp_setup_fill_region(llvmpipe->setup, dst, color,
+                            dstx, dsty, width, height))
+      return;
+
    util_clear_render_target(pipe, dst, color,
                             dstx, dsty, width, height);
 }
@@ -0,0 +1,445 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests for the linear fragment path: compares its per-pixel
+ * arithmetic (lp_linear.h) with the LLVM IR generated for the same
+ * operations on 8-bit unorm data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/u_memory.h"
+#include "util/u_math.h"
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_conv.h"
+#include "lp_bld_blend.h"
+#include "lp_linear.h"
+#include "lp_test.h"
+
+
+#define NUM_PIXELS 4
+#define NUM_ITERATIONS 4096
+
+
+/** res = op(a, b, c), on NUM_PIXELS packed pixels */
+typedef void (*pixel_test_ptr_t)(const uint32_t *a, const uint32_t *b,
+                                 const uint32_t *c, uint32_t *res);
+
+/** res = unorm8(float(texel) * color), on the four channels of a pixel */
+typedef void (*modulate_test_ptr_t)(const uint32_t *texel,
+                                    const float *color, uint32_t *res);
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *name, boolean success)
+{
+   fprintf(fp, "%s\t%s\n", success ? "pass" : "fail", name);
+
+   fflush(fp);
+}
+
+
+static uint32_t
+random_pixel(void)
+{
+   return (uint32_t)(rand() & 0xffff) | ((uint32_t)(rand() & 0xffff) << 16);
+}
+
+
+/**
+ * Start a function taking three u8n vectors in and one out.
+ */
+static LLVMValueRef
+begin_pixel_test(struct gallivm_state *gallivm, struct lp_type type,
+                 LLVMValueRef *a, LLVMValueRef *b, LLVMValueRef *c,
+                 LLVMValueRef *res_ptr)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef args[4];
+   LLVMValueRef func;
+   LLVMBasicBlockRef block;
+
+   args[3] = args[2] = args[1] = args[0] = LLVMPointerType(vec_type, 0);
+   func = LLVMAddFunction(gallivm->module, "test",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, 4, 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   *a = LLVMBuildLoad(builder, LLVMGetParam(func, 0), "a");
+   *b = LLVMBuildLoad(builder, LLVMGetParam(func, 1), "b");
+   *c = LLVMBuildLoad(builder, LLVMGetParam(func, 2), "c");
+   *res_ptr = LLVMGetParam(func, 3);
+
+   return func;
+}
+
+
+static void
+end_test(struct gallivm_state *gallivm, LLVMValueRef func,
+         LLVMValueRef res, LLVMValueRef res_ptr)
+{
+   LLVMBuildStore(gallivm->builder, res, res_ptr);
+   LLVMBuildRetVoid(gallivm->builder);
+
+   gallivm_verify_function(gallivm, func);
+}
+
+
+/**
+ * res = lerp(a, b) with the weights in c, as bilinear filtering does.
+ */
+static LLVMValueRef
+add_lerp_test(struct gallivm_state *gallivm, struct lp_type type)
+{
+   struct lp_build_context bld;
+   LLVMValueRef func, a, b, c, res_ptr, res;
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   func = begin_pixel_test(gallivm, type, &a, &b, &c, &res_ptr);
+   res = lp_build_lerp(&bld, c, a, b, LP_BLD_LERP_PRESCALED_WEIGHTS);
+   end_test(gallivm, func, res, res_ptr);
+
+   return func;
+}
+
+
+/**
+ * res = blend(src = a, dst = b), as the fragment shader's blending does.
+ */
+static LLVMValueRef
+add_blend_test(struct gallivm_state *gallivm, struct lp_type type,
+               unsigned src_factor)
+{
+   const unsigned char swizzle[4] = { 0, 1, 2, 3 };
+   struct pipe_blend_state blend;
+   LLVMValueRef func, a, b, c, res_ptr, res;
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].blend_enable     = 1;
+   blend.rt[0].rgb_func         = PIPE_BLEND_ADD;
+   blend.rt[0].rgb_src_factor   = src_factor;
+   blend.rt[0].rgb_dst_factor   = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   blend.rt[0].alpha_func       = PIPE_BLEND_ADD;
+   blend.rt[0].alpha_src_factor = src_factor;
+   blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   blend.rt[0].colormask        = PIPE_MASK_RGBA;
+
+   func = begin_pixel_test(gallivm, type, &a, &b, &c, &res_ptr);
+   res = lp_build_blend_aos(gallivm, &blend, PIPE_FORMAT_R8G8B8A8_UNORM,
+                            type, 0, a, NULL, a, NULL, b, NULL, c, NULL,
+                            swizzle, 4);
+   end_test(gallivm, func, res, res_ptr);
+
+   return func;
+}
+
+
+/**
+ * res = texel * color, with the conversions to and from float the
+ * fragment shader does.
+ */
+static LLVMValueRef
+add_modulate_test(struct gallivm_state *gallivm)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type f32_type = lp_type_float_vec(32, 128);
+   struct lp_type i32_type = lp_int_type(f32_type);
+   LLVMTypeRef args[3];
+   LLVMValueRef func, texel, color, res;
+   LLVMBasicBlockRef block;
+
+   args[0] = LLVMPointerType(lp_build_vec_type(gallivm, i32_type), 0);
+   args[1] = LLVMPointerType(lp_build_vec_type(gallivm, f32_type), 0);
+   args[2] = args[0];
+   func = LLVMAddFunction(gallivm->module, "test",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, 3, 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   texel = LLVMBuildLoad(builder, LLVMGetParam(func, 0), "texel");
+   color = LLVMBuildLoad(builder, LLVMGetParam(func, 1), "color");
+
+   res = lp_build_unsigned_norm_to_float(gallivm, 8, f32_type, texel);
+   res = LLVMBuildFMul(builder, res, color, "");
+   res = lp_build_clamped_float_to_unsigned_norm(gallivm, f32_type, 8, res);
+
+   end_test(gallivm, func, res, LLVMGetParam(func, 2));
+
+   return func;
+}
+
+
+static void
+dump_pixels(FILE *fp, const char *name, const uint32_t *p)
+{
+   unsigned i;
+
+   fprintf(fp, "  %s:", name);
+   for (i = 0; i < NUM_PIXELS; i++)
+      fprintf(fp, " %08x", p[i]);
+   fprintf(fp, "\n");
+}
+
+
+/**
+ * Run the lerp and blend tests, which work on packed pixels.
+ */
+static boolean
+test_pixels(unsigned verbose, FILE *fp, const char *name, unsigned op)
+{
+   struct lp_type type = lp_type_unorm(8, 32 * NUM_PIXELS);
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef func;
+   pixel_test_ptr_t test_ptr;
+   uint32_t *a, *b, *c, *res;
+   boolean success = TRUE;
+   unsigned i, j;
+
+   if (verbose >= 1)
+      fprintf(stdout, "%s ...\n", name);
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("test_module", context);
+
+   if (op == LP_LINEAR_BLEND_NONE)
+      func = add_lerp_test(gallivm, type);
+   else
+      func = add_blend_test(gallivm, type,
+                            op == LP_LINEAR_BLEND_ALPHA ?
+                            PIPE_BLENDFACTOR_SRC_ALPHA :
+                            PIPE_BLENDFACTOR_ONE);
+
+   gallivm_compile_module(gallivm);
+
+   test_ptr = (pixel_test_ptr_t)gallivm_jit_function(gallivm, func);
+
+   gallivm_free_ir(gallivm);
+
+   a = align_malloc(4 * NUM_PIXELS, 16);
+   b = align_malloc(4 * NUM_PIXELS, 16);
+   c = align_malloc(4 * NUM_PIXELS, 16);
+   res = align_malloc(4 * NUM_PIXELS, 16);
+
+   for (i = 0; i < NUM_ITERATIONS && success; i++) {
+      uint32_t ref[NUM_PIXELS];
+
+      for (j = 0; j < NUM_PIXELS; j++) {
+         a[j] = random_pixel();
+         b[j] = random_pixel();
+         /* same weight for all channels of a pixel */
+         c[j] = (rand() & 0xff) * 0x01010101;
+      }
+
+      /* make sure the extreme alphas and weights get tested too */
+      if (i == 0) {
+         a[0] &= 0x00ffffff;
+         a[1] |= 0xff000000;
+         c[0] = 0;
+         c[1] = 0xffffffff;
+      }
+
+      for (j = 0; j < NUM_PIXELS; j++) {
+         if (op == LP_LINEAR_BLEND_NONE)
+            ref[j] = lp_linear_lerp_pixel(a[j], b[j], c[j] & 0xff);
+         else
+            ref[j] = lp_linear_blend_pixel(op, a[j], b[j]);
+      }
+
+      test_ptr(a, b, c, res);
+
+      if (memcmp(res, ref, sizeof ref) != 0) {
+         success = FALSE;
+
+         fprintf(stderr, "%s: MISMATCH\n", name);
+         dump_pixels(stderr, "A", a);
+         dump_pixels(stderr, "B", b);
+         dump_pixels(stderr, "C", c);
+         dump_pixels(stderr, "Res", res);
+         dump_pixels(stderr, "Ref", ref);
+      }
+   }
+
+   align_free(a);
+   align_free(b);
+   align_free(c);
+   align_free(res);
+
+   if (fp)
+      write_tsv_row(fp, name, success);
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   return success;
+}
+
+
+/**
+ * Check the modulation tables against the float math, for every texel
+ * value and a number of colors.
+ */
+static boolean
+test_modulate(unsigned verbose, FILE *fp)
+{
+   const char *name = "modulate";
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef func;
+   modulate_test_ptr_t test_ptr;
+   uint32_t *texel, *res;
+   float *color;
+   boolean success = TRUE;
+   unsigned i, j, k;
+
+   if (verbose >= 1)
+      fprintf(stdout, "%s ...\n", name);
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("test_module", context);
+
+   func = add_modulate_test(gallivm);
+
+   gallivm_compile_module(gallivm);
+
+   test_ptr = (modulate_test_ptr_t)gallivm_jit_function(gallivm, func);
+
+   gallivm_free_ir(gallivm);
+
+   texel = align_malloc(4 * sizeof *texel, 16);
+   color = align_malloc(4 * sizeof *color, 16);
+   res = align_malloc(4 * sizeof *res, 16);
+
+   for (i = 0; i < NUM_ITERATIONS / 64 && success; i++) {
+      for (k = 0; k < 4; k++) {
+         /* colors come from the vertices, so any float in [0, 1] */
+         color[k] = i == 0 ? (float)k / 3.0f : random_float();
+      }
+
+      for (j = 0; j < 256 && success; j++) {
+         for (k = 0; k < 4; k++)
+            texel[k] = (j + 64 * k) & 0xff;
+
+         test_ptr(texel, color, res);
+
+         for (k = 0; k < 4; k++) {
+            unsigned ref = lp_linear_modulate8(texel[k], color[k]);
+
+            if (res[k] != ref) {
+               success = FALSE;
+
+               fprintf(stderr, "%s: MISMATCH\n", name);
+               fprintf(stderr, "  Texel: %u\n", texel[k]);
+               fprintf(stderr, "  Color: %.9g\n", color[k]);
+               fprintf(stderr, "  Res: %u\n", res[k]);
+               fprintf(stderr, "  Ref: %u\n", ref);
+               break;
+            }
+         }
+      }
+   }
+
+   align_free(texel);
+   align_free(color);
+   align_free(res);
+
+   if (fp)
+      write_tsv_row(fp, name, success);
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+
+   if (!test_pixels(verbose, fp, "lerp", LP_LINEAR_BLEND_NONE))
+      success = FALSE;
+
+   if (!test_pixels(verbose, fp, "blend_alpha", LP_LINEAR_BLEND_ALPHA))
+      success = FALSE;
+
+   if (!test_pixels(verbose, fp, "blend_premul", LP_LINEAR_BLEND_PREMUL))
+      success = FALSE;
+
+   if (!test_modulate(verbose, fp))
+      success = FALSE;
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   /*
+    * The tests are already randomized, so test all.
+    */
+
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
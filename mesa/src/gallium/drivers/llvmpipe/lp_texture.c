@@ -35,7 +35,9 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
+#include "util/u_box.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
@@ -57,9 +59,172 @@
 #ifdef DEBUG
 static struct llvmpipe_resource resource_list;
 #endif
+/* Resources are created from any context's thread, so bump atomically. */
 static unsigned id_counter = 0;
 
 
+/**
+ * Alignment of all texture and buffer storage.  See the comment about
+ * mip_align in llvmpipe_texture_layout().
+ */
+static inline unsigned
+llvmpipe_storage_alignment(void)
+{
+   return MAX2(64, util_cpu_caps.cacheline);
+}
+
+
+/**
+ * Allocate 'size' bytes of backing storage, reusing a block released by
+ * an earlier resource of the same size if there is one.
+ * Note the contents are undefined.
+ */
+struct llvmpipe_storage *
+llvmpipe_storage_create(struct llvmpipe_screen *screen, unsigned size)
+{
+   struct llvmpipe_storage *storage = CALLOC_STRUCT(llvmpipe_storage);
+   unsigned i;
+
+   if (!storage)
+      return NULL;
+
+   pipe_reference_init(&storage->reference, 1);
+   storage->screen = screen;
+   storage->size = size;
+
+   pipe_mutex_lock(screen->storage_mutex);
+   for (i = 0; i < screen->num_cached_storage; i++) {
+      if (screen->cached_storage[i].size == size) {
+         storage->data = screen->cached_storage[i].data;
+         screen->cached_storage_bytes -= size;
+         screen->num_cached_storage--;
+         memmove(&screen->cached_storage[i], &screen->cached_storage[i + 1],
+                 (screen->num_cached_storage - i) *
+                 sizeof screen->cached_storage[0]);
+         break;
+      }
+   }
+   pipe_mutex_unlock(screen->storage_mutex);
+
+   if (!storage->data) {
+      storage->data = align_malloc(size, llvmpipe_storage_alignment());
+      if (!storage->data) {
+         FREE(storage);
+         return NULL;
+      }
+   }
+
+   return storage;
+}
+
+
+/**
+ * Drop the 'count' oldest blocks from the screen's cache, returning them
+ * in 'evicted' so they can be freed without holding the lock.
+ */
+static void
+llvmpipe_evict_cached_storage(struct llvmpipe_screen *screen,
+                              unsigned count, void **evicted)
+{
+   unsigned i;
+
+   assert(count <= screen->num_cached_storage);
+
+   for (i = 0; i < count; i++) {
+      evicted[i] = screen->cached_storage[i].data;
+      screen->cached_storage_bytes -= screen->cached_storage[i].size;
+   }
+
+   screen->num_cached_storage -= count;
+   memmove(&screen->cached_storage[0], &screen->cached_storage[count],
+           screen->num_cached_storage * sizeof screen->cached_storage[0]);
+}
+
+
+/**
+ * Called when the last reference to a storage block goes away.  Small
+ * enough blocks go back into the screen's cache, evicting the oldest
+ * entries to stay within LP_MAX_CACHED_STORAGE_BYTES.
+ */
+void
+llvmpipe_storage_destroy(struct llvmpipe_storage *storage)
+{
+   struct llvmpipe_screen *screen = storage->screen;
+   void *evicted[LP_MAX_CACHED_STORAGE];
+   unsigned num_evicted = 0;
+   unsigned bytes;
+   unsigned i;
+
+   if (storage->size > LP_MAX_CACHED_STORAGE_SIZE) {
+      align_free(storage->data);
+      FREE(storage);
+      return;
+   }
+
+   pipe_mutex_lock(screen->storage_mutex);
+   bytes = screen->cached_storage_bytes + storage->size;
+   while (num_evicted < screen->num_cached_storage &&
+          (screen->num_cached_storage - num_evicted == LP_MAX_CACHED_STORAGE ||
+           bytes > LP_MAX_CACHED_STORAGE_BYTES)) {
+      bytes -= screen->cached_storage[num_evicted].size;
+      num_evicted++;
+   }
+   if (num_evicted)
+      llvmpipe_evict_cached_storage(screen, num_evicted, evicted);
+   i = screen->num_cached_storage++;
+   screen->cached_storage[i].data = storage->data;
+   screen->cached_storage[i].size = storage->size;
+   screen->cached_storage[i].age = screen->storage_age;
+   screen->cached_storage_bytes += storage->size;
+   pipe_mutex_unlock(screen->storage_mutex);
+
+   for (i = 0; i < num_evicted; i++)
+      align_free(evicted[i]);
+
+   FREE(storage);
+}
+
+
+/**
+ * Called after each rasterized scene: free cached blocks that nobody
+ * reused for LP_MAX_CACHED_STORAGE_AGE scenes, so that storage doesn't
+ * stay pinned once the application stops recreating resources.
+ */
+void
+llvmpipe_age_cached_storage(struct llvmpipe_screen *screen)
+{
+   void *evicted[LP_MAX_CACHED_STORAGE];
+   unsigned num_evicted = 0;
+   unsigned i;
+
+   pipe_mutex_lock(screen->storage_mutex);
+   screen->storage_age++;
+   while (num_evicted < screen->num_cached_storage &&
+          screen->storage_age - screen->cached_storage[num_evicted].age >
+          LP_MAX_CACHED_STORAGE_AGE)
+      num_evicted++;
+   if (num_evicted)
+      llvmpipe_evict_cached_storage(screen, num_evicted, evicted);
+   pipe_mutex_unlock(screen->storage_mutex);
+
+   for (i = 0; i < num_evicted; i++)
+      align_free(evicted[i]);
+}
+
+
+void
+llvmpipe_free_cached_storage(struct llvmpipe_screen *screen)
+{
+   unsigned i;
+
+   for (i = 0; i < screen->num_cached_storage; i++)
+      align_free(screen->cached_storage[i].data);
+
+   screen->num_cached_storage = 0;
+   screen->cached_storage_bytes = 0;
+}
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Compute strides and allocate data (unless asked not to).
@@ -166,12 +331,16 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       depth = u_minify(depth, 1);
    }
 
+   lpr->total_alloc_size = (unsigned) total_size;
+
    if (allocate) {
-      lpr->tex_data = align_malloc(total_size, mip_align);
-      if (!lpr->tex_data) {
+      assert(mip_align == llvmpipe_storage_alignment());
+      lpr->storage = llvmpipe_storage_create(screen, lpr->total_alloc_size);
+      if (!lpr->storage) {
          return FALSE;
       }
       else {
+         lpr->tex_data = lpr->storage->data;
          memset(lpr->tex_data, 0, total_size);
       }
    }
@@ -232,6 +401,21 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
       winsys->displaytarget_unmap(winsys, lpr->dt);
    }
 
+   /* Track what gets drawn between presents.  Nothing has been presented
+    * yet, so it all starts out damaged.  Failing to allocate this only
+    * means every present covers the whole surface.
+    */
+   if (lpr->base.bind & PIPE_BIND_DISPLAY_TARGET) {
+      unsigned words;
+
+      lpr->damage_tiles_x = width / TILE_SIZE;
+      lpr->damage_tiles_y = height / TILE_SIZE;
+      words = BITSET_WORDS(lpr->damage_tiles_x * lpr->damage_tiles_y);
+      lpr->damage = MALLOC(words * sizeof(BITSET_WORD));
+      if (lpr->damage)
+         memset(lpr->damage, 0xff, words * sizeof(BITSET_WORD));
+   }
+
    return TRUE;
 }
 
@@ -278,7 +462,8 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
        * read/write always LP_RASTER_BLOCK_SIZE pixels, but the element
        * offset doesn't need to be aligned to LP_RASTER_BLOCK_SIZE.
        */
-      lpr->data = align_malloc(bytes + (LP_RASTER_BLOCK_SIZE - 1) * 4 * sizeof(float), 64);
+      lpr->storage = llvmpipe_storage_create(screen,
+                        bytes + (LP_RASTER_BLOCK_SIZE - 1) * 4 * sizeof(float));
 
       /*
        * buffers don't really have stride but it's probably safer
@@ -286,12 +471,13 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
        * to put something sane in there.
        */
       lpr->row_stride[0] = bytes;
-      if (!lpr->data)
+      if (!lpr->storage)
          goto fail;
+      lpr->data = lpr->storage->data;
       memset(lpr->data, 0, bytes);
    }
 
-   lpr->id = id_counter++;
+   lpr->id = p_atomic_inc_return(&id_counter);
 
 #ifdef DEBUG
    insert_at_tail(&resource_list, lpr);
@@ -310,6 +496,64 @@ llvmpipe_resource_create(struct pipe_screen *_screen,
    return llvmpipe_resource_create_front(_screen, templat, NULL);
 }
 
+
+/**
+ * Wrap client memory as a single-level 2D texture, so it can be rendered
+ * to and sampled from in place.
+ *
+ * The memory must be laid out exactly as llvmpipe_texture_layout() would
+ * lay out the texture (the caller can check the stride with a transfer).
+ * It stays owned by the caller and isn't freed on destruction.
+ *
+ * The rasterizer reads and writes whole LP_RASTER_BLOCK_SIZE blocks, so
+ * both dimensions must be multiples of it; otherwise the edge blocks would
+ * clobber the client's row padding or the memory past the last row.
+ */
+static struct pipe_resource *
+llvmpipe_resource_from_user_memory(struct pipe_screen *_screen,
+                                   const struct pipe_resource *templat,
+                                   void *user_memory)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   struct llvmpipe_resource *lpr;
+
+   if ((templat->target != PIPE_TEXTURE_2D &&
+        templat->target != PIPE_TEXTURE_RECT) ||
+       templat->last_level != 0 ||
+       templat->depth0 != 1 ||
+       templat->array_size != 1 ||
+       templat->nr_samples > 1 ||
+       util_format_is_compressed(templat->format) ||
+       templat->width0 % LP_RASTER_BLOCK_SIZE != 0 ||
+       templat->height0 % LP_RASTER_BLOCK_SIZE != 0 ||
+       ((uintptr_t) user_memory & 15) != 0)
+      return NULL;
+
+   lpr = CALLOC_STRUCT(llvmpipe_resource);
+   if (!lpr)
+      return NULL;
+
+   lpr->base = *templat;
+   pipe_reference_init(&lpr->base.reference, 1);
+   lpr->base.screen = &screen->base;
+
+   if (!llvmpipe_texture_layout(screen, lpr, false)) {
+      FREE(lpr);
+      return NULL;
+   }
+
+   lpr->tex_data = user_memory;
+   lpr->userBuffer = TRUE;
+
+   lpr->id = p_atomic_inc_return(&id_counter);
+
+#ifdef DEBUG
+   insert_at_tail(&resource_list, lpr);
+#endif
+
+   return &lpr->base;
+}
+
 static void
 llvmpipe_resource_destroy(struct pipe_screen *pscreen,
                           struct pipe_resource *pt)
@@ -321,17 +565,17 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
       /* display target */
       struct sw_winsys *winsys = screen->winsys;
       winsys->displaytarget_destroy(winsys, lpr->dt);
+      FREE(lpr->damage);
    }
    else if (llvmpipe_resource_is_texture(pt)) {
-      /* free linear image data */
-      if (lpr->tex_data) {
-         align_free(lpr->tex_data);
-         lpr->tex_data = NULL;
-      }
+      /* release linear image data (none for wrapped user memory) */
+      llvmpipe_storage_reference(&lpr->storage, NULL);
+      lpr->tex_data = NULL;
    }
    else if (!lpr->userBuffer) {
-      assert(lpr->data);
-      align_free(lpr->data);
+      assert(lpr->storage);
+      llvmpipe_storage_reference(&lpr->storage, NULL);
+      lpr->data = NULL;
    }
 
 #ifdef DEBUG
@@ -431,6 +675,109 @@ llvmpipe_resource_data(struct pipe_resource *resource)
 }
 
 
+/**
+ * Note that the area of the resource within box has been written to.
+ */
+void
+llvmpipe_resource_damage_box(struct llvmpipe_resource *lpr,
+                             const struct pipe_box *box)
+{
+   unsigned x0, y0, x1, y1, x, y;
+
+   if (!lpr->damage || box->width <= 0 || box->height <= 0)
+      return;
+
+   x0 = box->x / TILE_SIZE;
+   y0 = box->y / TILE_SIZE;
+   x1 = MIN2((box->x + box->width - 1) / TILE_SIZE, lpr->damage_tiles_x - 1);
+   y1 = MIN2((box->y + box->height - 1) / TILE_SIZE, lpr->damage_tiles_y - 1);
+
+   for (y = y0; y <= y1; y++)
+      for (x = x0; x <= x1; x++)
+         BITSET_SET(lpr->damage, y * lpr->damage_tiles_x + x);
+}
+
+
+/**
+ * Turn the tiles written since the last call into at most max_boxes
+ * rectangles, and start over.  Runs of damaged tiles in a row become a
+ * rectangle, which grows downwards while the rows below have the same
+ * run; if that takes too many rectangles, their bounding box is returned
+ * instead.  Returns 0 if the damage isn't known or is empty, in which
+ * case the whole resource should be assumed damaged.
+ */
+unsigned
+llvmpipe_resource_get_damage(struct llvmpipe_resource *lpr,
+                             struct pipe_box *boxes,
+                             unsigned max_boxes)
+{
+   const unsigned tiles_x = lpr->damage_tiles_x;
+   const unsigned tiles_y = lpr->damage_tiles_y;
+   unsigned nboxes = 0;
+   boolean merged = FALSE;
+   unsigned x, y, i;
+
+   if (!lpr->damage || !max_boxes)
+      return 0;
+
+   for (y = 0; y < tiles_y; y++) {
+      for (x = 0; x < tiles_x; x++) {
+         struct pipe_box run;
+         unsigned x0 = x;
+
+         if (!BITSET_TEST(lpr->damage, y * tiles_x + x))
+            continue;
+
+         while (x + 1 < tiles_x && BITSET_TEST(lpr->damage, y * tiles_x + x + 1))
+            x++;
+
+         u_box_2d(x0 * TILE_SIZE, y * TILE_SIZE,
+                  (x + 1 - x0) * TILE_SIZE, TILE_SIZE, &run);
+
+         if (merged) {
+            u_box_union_2d(&boxes[0], &boxes[0], &run);
+            continue;
+         }
+
+         /* extend a rectangle ending right above with the same run */
+         for (i = 0; i < nboxes; i++) {
+            if (boxes[i].x == run.x && boxes[i].width == run.width &&
+                boxes[i].y + boxes[i].height == run.y) {
+               boxes[i].height += TILE_SIZE;
+               break;
+            }
+         }
+         if (i < nboxes)
+            continue;
+
+         if (nboxes == max_boxes) {
+            for (i = 1; i < nboxes; i++)
+               u_box_union_2d(&boxes[0], &boxes[0], &boxes[i]);
+            u_box_union_2d(&boxes[0], &boxes[0], &run);
+            nboxes = 1;
+            merged = TRUE;
+            continue;
+         }
+
+         boxes[nboxes++] = run;
+      }
+   }
+
+   memset(lpr->damage, 0,
+          BITSET_WORDS(tiles_x * tiles_y) * sizeof(BITSET_WORD));
+
+   /* the displaytarget is padded to whole tiles, the resource isn't */
+   for (i = 0; i < nboxes; i++) {
+      boxes[i].width = MIN2(boxes[i].width,
+                            (int) lpr->base.width0 - boxes[i].x);
+      boxes[i].height = MIN2(boxes[i].height,
+                             (int) lpr->base.height0 - boxes[i].y);
+   }
+
+   return nboxes;
+}
+
+
 static struct pipe_resource *
 llvmpipe_resource_from_handle(struct pipe_screen *screen,
                               const struct pipe_resource *template,
@@ -468,7 +815,7 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
       goto no_dt;
    }
 
-   lpr->id = id_counter++;
+   lpr->id = p_atomic_inc_return(&id_counter);
 
 #ifdef DEBUG
    insert_at_tail(&resource_list, lpr);
@@ -501,6 +848,54 @@ llvmpipe_resource_get_handle(struct pipe_screen *screen,
 }
 
 
+/**
+ * Give a resource new backing storage instead of waiting for the scene
+ * which is still reading the old one.
+ *
+ * Only done when the whole resource is being discarded and the pending
+ * scene merely samples from it; render targets are referenced through
+ * the framebuffer state and keep the flush.  The scene and any bound
+ * rasterization state hold their own references to the old storage, so
+ * it is released once the scene has been rasterized and every context
+ * has picked up the new pointer (the screen timestamp bump in
+ * llvmpipe_transfer_map() makes them re-validate their sampler views).
+ *
+ * Buffers are never renamed: draw keeps pointers into bound constant
+ * buffers and stream output targets keep their mapping, neither of which
+ * would follow the new storage.
+ *
+ * \return TRUE if the resource was renamed and no flush is needed.
+ */
+static boolean
+llvmpipe_resource_rename(struct pipe_context *pipe,
+                         struct pipe_resource *resource)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   struct llvmpipe_storage *storage;
+
+   if (!lpr->storage || !llvmpipe_resource_is_texture(resource))
+      return FALSE;
+
+   if (lp_setup_is_resource_referenced(llvmpipe->setup, resource, ~0) !=
+       LP_REFERENCED_FOR_READ)
+      return FALSE;
+
+   storage = llvmpipe_storage_create(lpr->storage->screen,
+                                     lpr->storage->size);
+   if (!storage)
+      return FALSE;
+
+   llvmpipe_storage_reference(&lpr->storage, NULL);
+   lpr->storage = storage;
+   lpr->tex_data = storage->data;
+
+   llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
+
+   return TRUE;
+}
+
+
 static void *
 llvmpipe_transfer_map( struct pipe_context *pipe,
                        struct pipe_resource *resource,
@@ -526,7 +921,9 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
     * Transfers, like other pipe operations, must happen in order, so flush the
     * context if necessary.
     */
-   if (!(usage & PIPE_TRANSFER_UNSYNCHRONIZED)) {
+   if (!(usage & PIPE_TRANSFER_UNSYNCHRONIZED) &&
+       !((usage & PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE) &&
+         llvmpipe_resource_rename(pipe, resource))) {
       boolean read_only = !(usage & PIPE_TRANSFER_WRITE);
       boolean do_not_block = !!(usage & PIPE_TRANSFER_DONTBLOCK);
       if (!llvmpipe_flush_resource(pipe, resource,
@@ -606,6 +1003,7 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       /* Do something to notify sharing contexts of a texture change.
        */
       screen->timestamp++;
+      llvmpipe_resource_damage_box(lpr, box);
    }
 
    map +=
@@ -641,12 +1039,16 @@ llvmpipe_is_resource_referenced( struct pipe_context *pipe,
                                  unsigned level)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
+
+   /* Any texture may be the destination of a binned copy. */
    if (!(presource->bind & (PIPE_BIND_DEPTH_STENCIL |
                             PIPE_BIND_RENDER_TARGET |
-                            PIPE_BIND_SAMPLER_VIEW)))
+                            PIPE_BIND_SAMPLER_VIEW)) &&
+       !llvmpipe_resource_is_texture(presource))
       return LP_UNREFERENCED;
 
-   return lp_setup_is_resource_referenced(llvmpipe->setup, presource);
+   return lp_setup_is_resource_referenced(llvmpipe->setup, presource,
+                                          1 << level);
 }
 
 
@@ -805,6 +1207,7 @@ llvmpipe_init_screen_resource_funcs(struct pipe_screen *screen)
 /*   screen->resource_create_front = llvmpipe_resource_create_front; */
    screen->resource_destroy = llvmpipe_resource_destroy;
    screen->resource_from_handle = llvmpipe_resource_from_handle;
+   screen->resource_from_user_memory = llvmpipe_resource_from_user_memory;
    screen->resource_get_handle = llvmpipe_resource_get_handle;
    screen->can_create_resource = llvmpipe_can_create_resource;
 }
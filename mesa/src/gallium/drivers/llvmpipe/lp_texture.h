@@ -31,6 +31,8 @@
 
 #include "pipe/p_state.h"
 #include "util/u_debug.h"
+#include "util/u_inlines.h"
+#include "util/bitset.h"
 #include "lp_limits.h"
 
 
@@ -47,6 +49,25 @@ struct pipe_screen;
 struct llvmpipe_context;
 
 struct sw_displaytarget;
+struct llvmpipe_screen;
+
+
+/**
+ * Backing memory of a regular texture or buffer.
+ *
+ * This is kept apart from the llvmpipe_resource so that a resource which
+ * is still being read by a pending scene can be given fresh storage on a
+ * discarding map (see llvmpipe_transfer_map()), while the scene and any
+ * bound rasterization state keep the old storage alive through their
+ * own references.
+ */
+struct llvmpipe_storage
+{
+   struct pipe_reference reference;
+   struct llvmpipe_screen *screen;
+   void *data;
+   unsigned size;
+};
 
 
 /**
@@ -85,10 +106,23 @@ struct llvmpipe_resource
     */
    void *data;
 
-   boolean userBuffer;  /** Is this a user-space buffer? */
+   /**
+    * Current backing store of tex_data or data, NULL for display targets
+    * and user buffers.
+    */
+   struct llvmpipe_storage *storage;
+
+   boolean userBuffer;  /** Is this a user-space buffer or texture? */
    unsigned timestamp;
 
-   unsigned id;  /**< temporary, for debugging */
+   /**
+    * For display targets, one bit per TILE_SIZE square which has been
+    * written since the resource was last displayed.  NULL if not tracked.
+    */
+   BITSET_WORD *damage;
+   unsigned damage_tiles_x, damage_tiles_y;
+
+   unsigned id;  /**< unique, see llvmpipe_flush_frontbuffer() */
 
 #ifdef DEBUG
    /** for linked list */
@@ -211,6 +245,53 @@ void *
 llvmpipe_resource_data(struct pipe_resource *resource);
 
 
+/** Note that tile (x, y) of the resource has been rendered to. */
+static inline void
+llvmpipe_resource_damage_tile(struct llvmpipe_resource *lpr,
+                              unsigned x, unsigned y)
+{
+   if (lpr->damage) {
+      assert(x < lpr->damage_tiles_x);
+      assert(y < lpr->damage_tiles_y);
+      BITSET_SET(lpr->damage, y * lpr->damage_tiles_x + x);
+   }
+}
+
+void
+llvmpipe_resource_damage_box(struct llvmpipe_resource *lpr,
+                             const struct pipe_box *box);
+
+unsigned
+llvmpipe_resource_get_damage(struct llvmpipe_resource *lpr,
+                             struct pipe_box *boxes,
+                             unsigned max_boxes);
+
+
+struct llvmpipe_storage *
+llvmpipe_storage_create(struct llvmpipe_screen *screen, unsigned size);
+
+void
+llvmpipe_storage_destroy(struct llvmpipe_storage *storage);
+
+static inline void
+llvmpipe_storage_reference(struct llvmpipe_storage **ptr,
+                           struct llvmpipe_storage *storage)
+{
+   struct llvmpipe_storage *old = *ptr;
+
+   if (pipe_reference(old ? &old->reference : NULL,
+                      storage ? &storage->reference : NULL))
+      llvmpipe_storage_destroy(old);
+   *ptr = storage;
+}
+
+void
+llvmpipe_age_cached_storage(struct llvmpipe_screen *screen);
+
+void
+llvmpipe_free_cached_storage(struct llvmpipe_screen *screen);
+
+
 unsigned
 llvmpipe_resource_size(const struct pipe_resource *resource);
 
@@ -0,0 +1,162 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "os/os_thread.h"
+#include "lp_trace.h"
+
+
+static struct {
+   boolean initialized;
+   const char *filename;
+   unsigned num_buffers;
+   struct lp_trace_buffer *buffers[LP_TRACE_MAX_BUFFERS];
+} lp_trace;
+
+pipe_static_mutex(lp_trace_mutex);
+
+
+static void
+lp_trace_write(void);
+
+
+/**
+ * Called for every new screen.  Tracing is on if LP_TRACE was set when
+ * the first screen was created.
+ */
+void
+lp_trace_init(void)
+{
+   pipe_mutex_lock(lp_trace_mutex);
+   if (!lp_trace.initialized) {
+      lp_trace.initialized = TRUE;
+      lp_trace.filename = debug_get_option("LP_TRACE", NULL);
+
+      /* Many applications don't destroy their screens, and others create
+       * and destroy several, so the buffers are kept and only written at
+       * exit time.
+       */
+      if (lp_trace.filename)
+         atexit(lp_trace_write);
+   }
+   pipe_mutex_unlock(lp_trace_mutex);
+}
+
+
+/**
+ * Return a buffer for the calling thread to record into, or NULL if
+ * tracing is off or there are too many threads already.
+ */
+struct lp_trace_buffer *
+lp_trace_create_buffer(const char *thread_name)
+{
+   struct lp_trace_buffer *buffer = NULL;
+
+   pipe_mutex_lock(lp_trace_mutex);
+   if (lp_trace.filename &&
+       lp_trace.num_buffers < LP_TRACE_MAX_BUFFERS) {
+      buffer = CALLOC_STRUCT(lp_trace_buffer);
+      if (buffer) {
+         util_snprintf(buffer->thread_name, sizeof buffer->thread_name,
+                       "%s", thread_name);
+         buffer->tid = lp_trace.num_buffers + 1;
+         lp_trace.buffers[lp_trace.num_buffers++] = buffer;
+      }
+   }
+   pipe_mutex_unlock(lp_trace_mutex);
+
+   return buffer;
+}
+
+
+static void
+lp_trace_write_buffer(FILE *f, const struct lp_trace_buffer *buffer)
+{
+   /* the owning thread may still be recording */
+   const unsigned head = buffer->head;
+   unsigned first = head > LP_TRACE_EVENTS ? head - LP_TRACE_EVENTS : 0;
+   unsigned depth = 0;
+   unsigned i;
+
+   fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+           "\"args\":{\"name\":\"%s\"}}",
+           buffer->tid, buffer->thread_name);
+
+   for (i = first; i < head; i++) {
+      const struct lp_trace_event *event =
+         &buffer->events[i & (LP_TRACE_EVENTS - 1)];
+
+      /* Events nest, so ends before as many begins were recorded belong
+       * to begins the ring buffer has lost.
+       */
+      if (event->phase == 'B')
+         depth++;
+      else if (depth)
+         depth--;
+      else
+         continue;
+
+      /* timestamps are in microseconds */
+      fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,"
+              "\"ts\":%.3f}",
+              event->name, event->phase, buffer->tid,
+              event->timestamp / 1000.0);
+   }
+}
+
+
+/**
+ * Write out all the buffers, at exit.
+ */
+static void
+lp_trace_write(void)
+{
+   FILE *f;
+   unsigned i;
+
+   pipe_mutex_lock(lp_trace_mutex);
+
+   f = fopen(lp_trace.filename, "w");
+   if (f) {
+      fprintf(f, "{\"traceEvents\":[\n");
+      for (i = 0; i < lp_trace.num_buffers; i++) {
+         if (i)
+            fprintf(f, ",\n");
+         lp_trace_write_buffer(f, lp_trace.buffers[i]);
+      }
+      fprintf(f, "\n]}\n");
+      fclose(f);
+   }
+   else {
+      debug_printf("llvmpipe: couldn't open %s for LP_TRACE\n",
+                   lp_trace.filename);
+   }
+
+   pipe_mutex_unlock(lp_trace_mutex);
+}
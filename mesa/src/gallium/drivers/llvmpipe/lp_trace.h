@@ -0,0 +1,97 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Timeline tracing.
+ *
+ * With LP_TRACE=<file>, the application threads (one buffer per context)
+ * and the rasterizer threads record timestamped begin/end events into
+ * per-thread ring buffers.  At exit the buffers are written to <file>
+ * in the Chrome trace event JSON format, which chrome://tracing and
+ * ui.perfetto.dev open.
+ *
+ * Each buffer is only ever written by the thread that owns it, so
+ * recording takes no locks; when a buffer wraps the oldest events are
+ * lost.  With tracing off the buffers are NULL and every event costs a
+ * single branch.
+ */
+
+#ifndef LP_TRACE_H
+#define LP_TRACE_H
+
+#include "pipe/p_compiler.h"
+#include "util/macros.h"
+#include "os/os_time.h"
+
+
+/** Events kept per thread, must be a power of two */
+#define LP_TRACE_EVENTS (64 * 1024)
+
+/** Threads which can record; later ones go untraced */
+#define LP_TRACE_MAX_BUFFERS 64
+
+
+struct lp_trace_event
+{
+   int64_t timestamp;     /**< os_time_get_nano() */
+   const char *name;      /**< must be a static string */
+   char phase;            /**< 'B' or 'E' */
+};
+
+
+struct lp_trace_buffer
+{
+   char thread_name[32];
+   unsigned tid;
+   unsigned head;         /**< events recorded so far */
+   struct lp_trace_event events[LP_TRACE_EVENTS];
+};
+
+
+void
+lp_trace_init(void);
+
+struct lp_trace_buffer *
+lp_trace_create_buffer(const char *thread_name);
+
+
+static inline void
+lp_trace_record(struct lp_trace_buffer *buffer, const char *name, char phase)
+{
+   struct lp_trace_event *event =
+      &buffer->events[buffer->head++ & (LP_TRACE_EVENTS - 1)];
+
+   event->timestamp = os_time_get_nano();
+   event->name = name;
+   event->phase = phase;
+}
+
+/* The name is only evaluated when tracing. */
+#define LP_TRACE_BEGIN(buffer, name) \
+   do { if (unlikely(buffer)) lp_trace_record(buffer, name, 'B'); } while (0)
+#define LP_TRACE_END(buffer, name) \
+   do { if (unlikely(buffer)) lp_trace_record(buffer, name, 'E'); } while (0)
+
+
+#endif /* LP_TRACE_H */
@@ -452,6 +452,7 @@ static int si_get_param(struct pipe_screen* pscreen, enum pipe_cap param)
 	case PIPE_CAP_PRIMITIVE_RESTART_FOR_PATCHES:
 	case PIPE_CAP_TGSI_VOTE:
 	case PIPE_CAP_MAX_WINDOW_RECTANGLES:
+	case PIPE_CAP_TEXTURE_FROM_USER_MEMORY:
 		return 0;
 
 	case PIPE_CAP_DRAW_PARAMETERS:
@@ -325,6 +325,8 @@ swr_get_param(struct pipe_screen *screen, enum pipe_cap param)
       return 0;
    case PIPE_CAP_RESOURCE_FROM_USER_MEMORY:
       return 0; // xxx
+   case PIPE_CAP_TEXTURE_FROM_USER_MEMORY:
+      return 0;
    case PIPE_CAP_DEVICE_RESET_STATUS_QUERY:
       return 0;
    case PIPE_CAP_MAX_SHADER_PATCH_VARYINGS:
@@ -701,7 +703,8 @@ swr_flush_frontbuffer(struct pipe_screen *p_screen,
    debug_assert(spr->display_target);
    if (spr->display_target)
       winsys->displaytarget_display(
-         winsys, spr->display_target, context_private, sub_box);
+         winsys, spr->display_target, context_private,
+         sub_box ? 1 : 0, sub_box);
 }
 
 
@@ -25,6 +25,7 @@
  *
  **************************************************************************/
 
+#include "util/u_format.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
@@ -49,6 +50,15 @@ struct trace_query
 };
 
 
+struct trace_vertex_elements
+{
+   void *state;
+
+   unsigned count;
+   struct pipe_vertex_element elements[PIPE_MAX_ATTRIBS];
+};
+
+
 static inline struct trace_query *
 trace_query(struct pipe_query *query)
 {
@@ -106,6 +116,101 @@ trace_surface_unwrap(struct trace_context *tr_ctx,
 }
 
 
+static void
+trace_dump_user_memory(unsigned index, const void *user_buffer,
+                       unsigned begin, unsigned end)
+{
+   trace_dump_elem_begin();
+   trace_dump_struct_begin("user_memory");
+   trace_dump_member_begin("index");
+   trace_dump_uint(index);
+   trace_dump_member_end();
+   trace_dump_member_begin("offset");
+   trace_dump_uint(begin);
+   trace_dump_member_end();
+   trace_dump_member_begin("data");
+   trace_dump_bytes((const uint8_t *)user_buffer + begin, end - begin);
+   trace_dump_member_end();
+   trace_dump_struct_end();
+   trace_dump_elem_end();
+}
+
+
+/**
+ * Dump the parts of user vertex and index buffers a draw reads, like
+ * trace_dump_constant_buffer() does for user constant buffers, so that
+ * binary traces can replay it.  Offsets are relative to the user pointer.
+ */
+static void
+trace_context_dump_user_memory(struct trace_context *tr_ctx,
+                               const struct pipe_draw_info *info)
+{
+   const struct trace_vertex_elements *velems = tr_ctx->velems;
+   const struct pipe_index_buffer *ib = &tr_ctx->index_buffer;
+   unsigned i, j;
+
+   if (!trace_dump_trace_is_binary() || info->indirect)
+      return;
+
+   trace_dump_arg_begin("user_vertex_buffers");
+   trace_dump_array_begin();
+   for (i = 0; i < PIPE_MAX_ATTRIBS && velems; i++) {
+      const struct pipe_vertex_buffer *vb = &tr_ctx->vertex_buffers[i];
+      unsigned begin = ~0u, end = 0;
+
+      if (!vb->user_buffer)
+         continue;
+
+      for (j = 0; j < velems->count; j++) {
+         const struct pipe_vertex_element *ve = &velems->elements[j];
+         unsigned start, count, offset;
+
+         if (ve->vertex_buffer_index != i)
+            continue;
+
+         if (ve->instance_divisor) {
+            start = info->start_instance;
+            count = DIV_ROUND_UP(info->instance_count, ve->instance_divisor);
+         }
+         else if (info->indexed) {
+            start = info->min_index + info->index_bias;
+            count = info->max_index >= info->min_index ?
+                    info->max_index - info->min_index + 1 : 0;
+         }
+         else {
+            start = info->start;
+            count = info->count;
+         }
+         if (!count)
+            continue;
+
+         offset = vb->buffer_offset + ve->src_offset;
+         begin = MIN2(begin, offset + start * vb->stride);
+         end = MAX2(end, offset + (start + count - 1) * vb->stride +
+                         util_format_get_blocksize(ve->src_format));
+      }
+
+      if (begin < end)
+         trace_dump_user_memory(i, vb->user_buffer, begin, end);
+   }
+   trace_dump_array_end();
+   trace_dump_arg_end();
+
+   trace_dump_arg_begin("user_index_buffer");
+   if (info->indexed && ib->user_buffer && info->count) {
+      unsigned begin = ib->offset + info->start * ib->index_size;
+
+      trace_dump_array_begin();
+      trace_dump_user_memory(0, ib->user_buffer, begin,
+                             begin + info->count * ib->index_size);
+      trace_dump_array_end();
+   }
+   else
+      trace_dump_null();
+   trace_dump_arg_end();
+}
+
+
 static void
 trace_context_draw_vbo(struct pipe_context *_pipe,
                        const struct pipe_draw_info *info)
@@ -117,6 +222,7 @@ trace_context_draw_vbo(struct pipe_context *_pipe,
 
    trace_dump_arg(ptr,  pipe);
    trace_dump_arg(draw_info, info);
+   trace_context_dump_user_memory(tr_ctx, info);
 
    trace_dump_trace_flush();
 
@@ -659,6 +765,22 @@ trace_context_create_vertex_elements_state(struct pipe_context *_pipe,
 
    trace_dump_call_end();
 
+   /* Wrap the state, keeping the elements for trace_context_draw_vbo(). */
+   if (result) {
+      struct trace_vertex_elements *tr_velems =
+         CALLOC_STRUCT(trace_vertex_elements);
+      if (tr_velems) {
+         tr_velems->state = result;
+         tr_velems->count = MIN2(num_elements, PIPE_MAX_ATTRIBS);
+         memcpy(tr_velems->elements, elements,
+                tr_velems->count * sizeof *elements);
+         result = tr_velems;
+      } else {
+         pipe->delete_vertex_elements_state(pipe, result);
+         result = NULL;
+      }
+   }
+
    return result;
 }
 
@@ -670,6 +792,9 @@ trace_context_bind_vertex_elements_state(struct pipe_context *_pipe,
    struct trace_context *tr_ctx = trace_context(_pipe);
    struct pipe_context *pipe = tr_ctx->pipe;
 
+   tr_ctx->velems = state;
+   state = state ? tr_ctx->velems->state : NULL;
+
    trace_dump_call_begin("pipe_context", "bind_vertex_elements_state");
 
    trace_dump_arg(ptr, pipe);
@@ -687,6 +812,12 @@ trace_context_delete_vertex_elements_state(struct pipe_context *_pipe,
 {
    struct trace_context *tr_ctx = trace_context(_pipe);
    struct pipe_context *pipe = tr_ctx->pipe;
+   struct trace_vertex_elements *tr_velems = state;
+
+   if (tr_ctx->velems == tr_velems)
+      tr_ctx->velems = NULL;
+   state = tr_velems->state;
+   FREE(tr_velems);
 
    trace_dump_call_begin("pipe_context", "delete_vertex_elements_state");
 
@@ -1069,6 +1200,14 @@ trace_context_set_vertex_buffers(struct pipe_context *_pipe,
    trace_dump_struct_array(vertex_buffer, buffers, num_buffers);
    trace_dump_arg_end();
 
+   for (i = 0; i < num_buffers && start_slot + i < PIPE_MAX_ATTRIBS; i++) {
+      if (buffers)
+         tr_ctx->vertex_buffers[start_slot + i] = buffers[i];
+      else
+         memset(&tr_ctx->vertex_buffers[start_slot + i], 0,
+                sizeof tr_ctx->vertex_buffers[0]);
+   }
+
    if (buffers) {
       struct pipe_vertex_buffer *_buffers = MALLOC(num_buffers * sizeof(*_buffers));
       memcpy(_buffers, buffers, num_buffers * sizeof(*_buffers));
@@ -1096,6 +1235,11 @@ trace_context_set_index_buffer(struct pipe_context *_pipe,
    trace_dump_arg(ptr, pipe);
    trace_dump_arg(index_buffer, ib);
 
+   if (ib)
+      tr_ctx->index_buffer = *ib;
+   else
+      memset(&tr_ctx->index_buffer, 0, sizeof tr_ctx->index_buffer);
+
    if (ib) {
       struct pipe_index_buffer _ib;
       _ib = *ib;
@@ -32,6 +32,7 @@
 #include "pipe/p_compiler.h"
 #include "util/u_debug.h"
 #include "pipe/p_context.h"
+#include "pipe/p_state.h"
 
 #include "tr_screen.h"
 
@@ -41,12 +42,20 @@ extern "C" {
 
 
 struct trace_screen;
+struct trace_vertex_elements;
    
 struct trace_context
 {
    struct pipe_context base;
 
    struct pipe_context *pipe;
+
+   /* Bound state that draws from user memory depend on.  The resources
+    * aren't referenced, only the user memory pointers are looked at.
+    */
+   struct trace_vertex_elements *velems;
+   struct pipe_vertex_buffer vertex_buffers[PIPE_MAX_ATTRIBS];
+   struct pipe_index_buffer index_buffer;
 };
 
 
@@ -30,10 +30,10 @@
  * @file
  * Trace dumping functions.
  *
- * For now we just use standard XML for dumping the trace calls, as this is
- * simple to write, parse, and visually inspect, but the actual representation
- * is abstracted out of this file, so that we can switch to a binary
- * representation if/when it becomes justified.
+ * By default we use standard XML for dumping the trace calls, as this is
+ * simple to write, parse, and visually inspect.  Traces whose file name ends
+ * in ".gbtrace" use the much more compact binary representation described
+ * in tr_dump_bin.h instead, which also holds texture uploads.
  *
  * @author Jose Fonseca <jfonseca@vmware.com>
  */
@@ -53,12 +53,14 @@
 #include "util/u_format.h"
 
 #include "tr_dump.h"
+#include "tr_dump_bin.h"
 #include "tr_screen.h"
 #include "tr_texture.h"
 
 
 static boolean close_stream = FALSE;
 static FILE *stream = NULL;
+static boolean binary = FALSE;
 pipe_static_mutex(call_mutex);
 static long unsigned call_no = 0;
 static boolean dumping = FALSE;
@@ -218,6 +220,7 @@ trace_dump_tag_end(const char *name)
 void
 trace_dump_trace_flush(void)
 {
+   /* Binary traces are written through a shared mapping, nothing to flush */
    if (stream) {
       fflush(stream);
    }
@@ -226,7 +229,12 @@ trace_dump_trace_flush(void)
 static void
 trace_dump_trace_close(void)
 {
-   if (stream) {
+   if (binary) {
+      trace_bin_close();
+      binary = FALSE;
+      call_no = 0;
+   }
+   else if (stream) {
       trace_dump_writes("</trace>\n");
       if (close_stream) {
          fclose(stream);
@@ -251,6 +259,17 @@ trace_dump_call_time(int64_t time)
 }
 
 
+static boolean
+trace_dump_is_binary(const char *filename)
+{
+   static const char suffix[] = ".gbtrace";
+   size_t len = strlen(filename);
+
+   return len >= sizeof suffix - 1 &&
+          strcmp(filename + len - (sizeof suffix - 1), suffix) == 0;
+}
+
+
 boolean
 trace_dump_trace_begin(void)
 {
@@ -260,7 +279,15 @@ trace_dump_trace_begin(void)
    if (!filename)
       return FALSE;
 
-   if (!stream) {
+   if (!stream && !binary) {
+
+      if (trace_dump_is_binary(filename)) {
+         if (!trace_bin_open(filename))
+            return FALSE;
+         binary = TRUE;
+         atexit(trace_dump_trace_close);
+         return TRUE;
+      }
 
       if (strcmp(filename, "stderr") == 0) {
          close_stream = FALSE;
@@ -293,7 +320,12 @@ trace_dump_trace_begin(void)
 
 boolean trace_dump_trace_enabled(void)
 {
-   return stream ? TRUE : FALSE;
+   return stream || binary ? TRUE : FALSE;
+}
+
+boolean trace_dump_trace_is_binary(void)
+{
+   return binary;
 }
 
 /*
@@ -364,6 +396,15 @@ void trace_dump_call_begin_locked(const char *klass, const char *method)
       return;
 
    ++call_no;
+
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_CALL_BEGIN);
+      trace_bin_name(klass);
+      trace_bin_name(method);
+      call_start_time = os_time_get();
+      return;
+   }
+
    trace_dump_indent(1);
    trace_dump_writes("<call no=\'");
    trace_dump_writef("%lu", call_no);
@@ -386,6 +427,12 @@ void trace_dump_call_end_locked(void)
 
    call_end_time = os_time_get();
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_CALL_END);
+      trace_bin_int(call_end_time - call_start_time);
+      return;
+   }
+
    trace_dump_call_time(call_end_time - call_start_time);
    trace_dump_indent(1);
    trace_dump_tag_end("call");
@@ -410,13 +457,19 @@ void trace_dump_arg_begin(const char *name)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_ARG);
+      trace_bin_name(name);
+      return;
+   }
+
    trace_dump_indent(2);
    trace_dump_tag_begin1("arg", "name", name);
 }
 
 void trace_dump_arg_end(void)
 {
-   if (!dumping)
+   if (!dumping || binary)
       return;
 
    trace_dump_tag_end("arg");
@@ -428,13 +481,18 @@ void trace_dump_ret_begin(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_RET);
+      return;
+   }
+
    trace_dump_indent(2);
    trace_dump_tag_begin("ret");
 }
 
 void trace_dump_ret_end(void)
 {
-   if (!dumping)
+   if (!dumping || binary)
       return;
 
    trace_dump_tag_end("ret");
@@ -446,6 +504,12 @@ void trace_dump_bool(int value)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_BOOL);
+      trace_bin_uint(value ? 1 : 0);
+      return;
+   }
+
    trace_dump_writef("<bool>%c</bool>", value ? '1' : '0');
 }
 
@@ -454,6 +518,12 @@ void trace_dump_int(long long int value)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_INT);
+      trace_bin_int(value);
+      return;
+   }
+
    trace_dump_writef("<int>%lli</int>", value);
 }
 
@@ -462,6 +532,12 @@ void trace_dump_uint(long long unsigned value)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_UINT);
+      trace_bin_uint(value);
+      return;
+   }
+
    trace_dump_writef("<uint>%llu</uint>", value);
 }
 
@@ -470,6 +546,12 @@ void trace_dump_float(double value)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_FLOAT);
+      trace_bin_float(value);
+      return;
+   }
+
    trace_dump_writef("<float>%g</float>", value);
 }
 
@@ -483,6 +565,11 @@ void trace_dump_bytes(const void *data,
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_bytes(data, size);
+      return;
+   }
+
    trace_dump_writes("<bytes>");
    for(i = 0; i < size; ++i) {
       uint8_t byte = *p++;
@@ -503,11 +590,19 @@ void trace_dump_box_bytes(const void *data,
    size_t size;
 
    /*
-    * Only dump buffer transfers to avoid huge files.
-    * TODO: Make this run-time configurable
+    * Only dump buffer transfers to avoid huge XML files.  Binary traces
+    * share repeated uploads, so they can afford to keep texture contents,
+    * which are needed to replay them.
     */
    if (resource->target != PIPE_BUFFER) {
+      enum pipe_format format = resource->format;
       size = 0;
+      if (binary && box->width && box->height && box->depth) {
+         /* Stop at the end of the last row, which may be short of stride */
+         size = (util_format_get_nblocksy(format, box->height) - 1) * stride +
+                util_format_get_stride(format, box->width);
+         size += (box->depth - 1) * slice_stride;
+      }
    } else {
       enum pipe_format format = resource->format;
       if (slice_stride)
@@ -527,6 +622,12 @@ void trace_dump_string(const char *str)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_STRING);
+      trace_bin_string(str);
+      return;
+   }
+
    trace_dump_writes("<string>");
    trace_dump_escape(str);
    trace_dump_writes("</string>");
@@ -537,6 +638,12 @@ void trace_dump_enum(const char *value)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_ENUM);
+      trace_bin_name(value);
+      return;
+   }
+
    trace_dump_writes("<enum>");
    trace_dump_escape(value);
    trace_dump_writes("</enum>");
@@ -547,6 +654,11 @@ void trace_dump_array_begin(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_ARRAY_BEGIN);
+      return;
+   }
+
    trace_dump_writes("<array>");
 }
 
@@ -555,12 +667,17 @@ void trace_dump_array_end(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_ARRAY_END);
+      return;
+   }
+
    trace_dump_writes("</array>");
 }
 
 void trace_dump_elem_begin(void)
 {
-   if (!dumping)
+   if (!dumping || binary)
       return;
 
    trace_dump_writes("<elem>");
@@ -568,7 +685,7 @@ void trace_dump_elem_begin(void)
 
 void trace_dump_elem_end(void)
 {
-   if (!dumping)
+   if (!dumping || binary)
       return;
 
    trace_dump_writes("</elem>");
@@ -579,6 +696,12 @@ void trace_dump_struct_begin(const char *name)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_STRUCT_BEGIN);
+      trace_bin_name(name);
+      return;
+   }
+
    trace_dump_writef("<struct name='%s'>", name);
 }
 
@@ -587,6 +710,11 @@ void trace_dump_struct_end(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_STRUCT_END);
+      return;
+   }
+
    trace_dump_writes("</struct>");
 }
 
@@ -595,12 +723,18 @@ void trace_dump_member_begin(const char *name)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_MEMBER);
+      trace_bin_name(name);
+      return;
+   }
+
    trace_dump_writef("<member name='%s'>", name);
 }
 
 void trace_dump_member_end(void)
 {
-   if (!dumping)
+   if (!dumping || binary)
       return;
 
    trace_dump_writes("</member>");
@@ -611,6 +745,11 @@ void trace_dump_null(void)
    if (!dumping)
       return;
 
+   if (binary) {
+      trace_bin_tag(TRACE_BIN_NULL);
+      return;
+   }
+
    trace_dump_writes("<null/>");
 }
 
@@ -619,6 +758,16 @@ void trace_dump_ptr(const void *value)
    if (!dumping)
       return;
 
+   if (binary) {
+      if (value) {
+         trace_bin_tag(TRACE_BIN_PTR);
+         trace_bin_uint((uintptr_t)value);
+      }
+      else
+         trace_bin_tag(TRACE_BIN_NULL);
+      return;
+   }
+
    if(value)
       trace_dump_writef("<ptr>0x%08lx</ptr>", (unsigned long)(uintptr_t)value);
    else
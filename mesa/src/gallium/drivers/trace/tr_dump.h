@@ -49,6 +49,7 @@ struct pipe_box;
  */
 boolean trace_dump_trace_begin(void);
 boolean trace_dump_trace_enabled(void);
+boolean trace_dump_trace_is_binary(void);
 void trace_dump_trace_flush(void);
 
 /*
@@ -0,0 +1,441 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Binary trace writer.
+ *
+ * The file is written through a window of it mapped shared, which slides
+ * forward as it fills up.  Emitting a token is then a couple of stores
+ * instead of a stdio call, and everything that reached the mapping ends up
+ * in the file even if the traced process crashes.
+ *
+ * Blobs are hashed, and a blob matching an earlier one is checked against
+ * the copy already in the file before being written as a reference, so hash
+ * collisions can't corrupt the trace.
+ */
+
+#include "pipe/p_config.h"
+
+#include <string.h>
+
+#if defined(PIPE_OS_UNIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "pipe/p_compiler.h"
+#include "util/u_debug.h"
+#include "util/u_hash_table.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+#include "tr_dump_bin.h"
+
+
+#if defined(PIPE_OS_UNIX)
+
+
+/** Size of the mapped part of the file; a multiple of the page size. */
+#define TRACE_BIN_WINDOW (8 << 20)
+
+/** Blobs smaller than this aren't worth looking up. */
+#define TRACE_BIN_MIN_SHARED_BLOB 16
+
+
+struct trace_bin_blob
+{
+   uint64_t hash;
+   size_t size;
+   uint64_t offset;   /**< where the contents are in the file */
+   unsigned index;
+};
+
+
+static int fd = -1;
+static uint8_t *window = NULL;
+static uint64_t window_offset = 0;
+static size_t window_used = 0;
+
+static struct util_hash_table *names = NULL;
+static unsigned num_names = 0;
+static struct util_hash_table *blobs = NULL;
+static unsigned num_blobs = 0;
+
+
+static uint64_t
+trace_bin_hash(const void *data, size_t size)
+{
+   const uint8_t *p = data;
+   uint64_t hash = 0xcbf29ce484222325ull;
+
+   /* FNV-1a, a word at a time for the bulk of the data */
+   while (size >= 8) {
+      uint64_t word;
+      memcpy(&word, p, 8);
+      hash = (hash ^ word) * 0x100000001b3ull;
+      p += 8;
+      size -= 8;
+   }
+   while (size--)
+      hash = (hash ^ *p++) * 0x100000001b3ull;
+
+   return hash;
+}
+
+
+static unsigned
+trace_bin_name_hash(void *key)
+{
+   const char *name = key;
+   uint64_t hash = trace_bin_hash(name, strlen(name));
+   return (unsigned)(hash ^ (hash >> 32));
+}
+
+
+static int
+trace_bin_name_compare(void *key1, void *key2)
+{
+   return strcmp(key1, key2);
+}
+
+
+static unsigned
+trace_bin_blob_hash(void *key)
+{
+   const struct trace_bin_blob *blob = key;
+   return (unsigned)(blob->hash ^ (blob->hash >> 32));
+}
+
+
+static int
+trace_bin_blob_compare(void *key1, void *key2)
+{
+   const struct trace_bin_blob *blob1 = key1;
+   const struct trace_bin_blob *blob2 = key2;
+   return blob1->hash != blob2->hash || blob1->size != blob2->size;
+}
+
+
+static enum pipe_error
+trace_bin_free_key(void *key, void *value, void *data)
+{
+   FREE(key);
+   return PIPE_OK;
+}
+
+
+static boolean
+trace_bin_map_window(uint64_t offset)
+{
+   void *map;
+
+   if (window) {
+      munmap(window, TRACE_BIN_WINDOW);
+      window = NULL;
+   }
+
+   if (ftruncate(fd, offset + TRACE_BIN_WINDOW) != 0)
+      goto fail;
+
+   map = mmap(NULL, TRACE_BIN_WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED,
+              fd, offset);
+   if (map == MAP_FAILED)
+      goto fail;
+
+   window = map;
+   window_offset = offset;
+   window_used = 0;
+   return TRUE;
+
+fail:
+   /* Drop the rest of the trace; what is in the file so far stays valid */
+   debug_printf("trace: failed to extend the trace file\n");
+   return FALSE;
+}
+
+
+static void
+trace_bin_write(const void *data, size_t size)
+{
+   const uint8_t *p = data;
+
+   while (size && window) {
+      size_t n;
+
+      if (window_used == TRACE_BIN_WINDOW &&
+          !trace_bin_map_window(window_offset + TRACE_BIN_WINDOW))
+         return;
+
+      n = MIN2(size, TRACE_BIN_WINDOW - window_used);
+      memcpy(window + window_used, p, n);
+      window_used += n;
+      p += n;
+      size -= n;
+   }
+}
+
+
+/**
+ * Compare data against a blob written earlier, reading it back from the
+ * file as it may have left the window long ago.
+ */
+static boolean
+trace_bin_blob_matches(const struct trace_bin_blob *blob, const void *data)
+{
+   static uint8_t buf[64 * 1024];
+   const uint8_t *p = data;
+   size_t done = 0;
+
+   while (done < blob->size) {
+      size_t n = MIN2(blob->size - done, sizeof buf);
+      if (pread(fd, buf, n, blob->offset + done) != (ssize_t)n ||
+          memcmp(buf, p + done, n) != 0)
+         return FALSE;
+      done += n;
+   }
+
+   return TRUE;
+}
+
+
+boolean
+trace_bin_open(const char *filename)
+{
+   fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd < 0)
+      return FALSE;
+
+   names = util_hash_table_create(trace_bin_name_hash,
+                                  trace_bin_name_compare);
+   blobs = util_hash_table_create(trace_bin_blob_hash,
+                                  trace_bin_blob_compare);
+   if (!names || !blobs || !trace_bin_map_window(0)) {
+      trace_bin_close();
+      return FALSE;
+   }
+
+   trace_bin_write(TRACE_BIN_MAGIC, sizeof TRACE_BIN_MAGIC);
+   trace_bin_uint(TRACE_BIN_VERSION);
+
+   return TRUE;
+}
+
+
+void
+trace_bin_close(void)
+{
+   if (window) {
+      munmap(window, TRACE_BIN_WINDOW);
+      window = NULL;
+   }
+
+   if (fd >= 0) {
+      /* Drop the unused tail of the last window */
+      if (ftruncate(fd, window_offset + window_used) != 0)
+         debug_printf("trace: failed to truncate the trace file\n");
+      close(fd);
+      fd = -1;
+   }
+
+   if (names) {
+      util_hash_table_foreach(names, trace_bin_free_key, NULL);
+      util_hash_table_destroy(names);
+      names = NULL;
+   }
+   if (blobs) {
+      util_hash_table_foreach(blobs, trace_bin_free_key, NULL);
+      util_hash_table_destroy(blobs);
+      blobs = NULL;
+   }
+
+   window_offset = 0;
+   window_used = 0;
+   num_names = 0;
+   num_blobs = 0;
+}
+
+
+void
+trace_bin_tag(enum trace_bin_tag tag)
+{
+   if (window && window_used < TRACE_BIN_WINDOW)
+      window[window_used++] = tag;
+   else {
+      uint8_t byte = tag;
+      trace_bin_write(&byte, 1);
+   }
+}
+
+
+void
+trace_bin_uint(uint64_t value)
+{
+   uint8_t buf[10];
+   unsigned len = 0;
+
+   do {
+      buf[len] = value & 0x7f;
+      value >>= 7;
+      if (value)
+         buf[len] |= 0x80;
+      ++len;
+   } while (value);
+
+   trace_bin_write(buf, len);
+}
+
+
+void
+trace_bin_int(int64_t value)
+{
+   trace_bin_uint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+
+void
+trace_bin_float(double value)
+{
+   union {
+      double d;
+      uint64_t u;
+   } bits;
+   uint8_t buf[8];
+   unsigned i;
+
+   bits.d = value;
+   for (i = 0; i < 8; ++i)
+      buf[i] = bits.u >> (i * 8);
+
+   trace_bin_write(buf, 8);
+}
+
+
+void
+trace_bin_name(const char *name)
+{
+   void *value;
+   char *key;
+   size_t len;
+
+   if (!name)
+      name = "";
+
+   value = util_hash_table_get(names, (void *)name);
+   if (value) {
+      trace_bin_uint((uintptr_t)value - 1);
+      return;
+   }
+
+   /* First use: the index is the table size, followed by the definition */
+   len = strlen(name);
+   key = MALLOC(len + 1);
+   if (key) {
+      memcpy(key, name, len + 1);
+      if (util_hash_table_set(names, key,
+                              (void *)(uintptr_t)(num_names + 1)) != PIPE_OK)
+         FREE(key);
+   }
+
+   trace_bin_uint(num_names++);
+   trace_bin_uint(len);
+   trace_bin_write(name, len);
+}
+
+
+void
+trace_bin_string(const char *str)
+{
+   size_t len = strlen(str);
+
+   trace_bin_uint(len);
+   trace_bin_write(str, len);
+}
+
+
+void
+trace_bin_bytes(const void *data, size_t size)
+{
+   struct trace_bin_blob key;
+   struct trace_bin_blob *blob = NULL;
+
+   if (size >= TRACE_BIN_MIN_SHARED_BLOB) {
+      key.hash = trace_bin_hash(data, size);
+      key.size = size;
+
+      blob = util_hash_table_get(blobs, &key);
+      if (blob && trace_bin_blob_matches(blob, data)) {
+         trace_bin_tag(TRACE_BIN_BYTES_REF);
+         trace_bin_uint(blob->index);
+         return;
+      }
+   }
+
+   trace_bin_tag(TRACE_BIN_BYTES);
+   trace_bin_uint(size);
+
+   /*
+    * Only remember the first blob with a given hash, a colliding one is
+    * simply never shared.
+    */
+   if (size >= TRACE_BIN_MIN_SHARED_BLOB && !blob && window) {
+      blob = CALLOC_STRUCT(trace_bin_blob);
+      if (blob) {
+         *blob = key;
+         blob->offset = window_offset + window_used;
+         blob->index = num_blobs;
+         if (util_hash_table_set(blobs, blob, blob) != PIPE_OK)
+            FREE(blob);
+      }
+   }
+
+   ++num_blobs;
+   trace_bin_write(data, size);
+}
+
+
+#else /* !PIPE_OS_UNIX */
+
+
+boolean
+trace_bin_open(const char *filename)
+{
+   debug_printf("trace: binary traces are not supported on this platform\n");
+   return FALSE;
+}
+
+void trace_bin_close(void) {}
+void trace_bin_tag(enum trace_bin_tag tag) {}
+void trace_bin_name(const char *name) {}
+void trace_bin_uint(uint64_t value) {}
+void trace_bin_int(int64_t value) {}
+void trace_bin_float(double value) {}
+void trace_bin_string(const char *str) {}
+void trace_bin_bytes(const void *data, size_t size) {}
+
+
+#endif /* !PIPE_OS_UNIX */
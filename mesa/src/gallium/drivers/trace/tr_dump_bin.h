@@ -0,0 +1,97 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Binary trace format.
+ *
+ * Chosen by giving GALLIUM_TRACE a file name ending in ".gbtrace".  It
+ * encodes the same tree as the XML dump: after the magic and a varint
+ * version, every node is a one byte tag followed by its payload.
+ *
+ * - Integers are LEB128 varints, signed ones zigzag encoded first.
+ * - Floats are little endian IEEE doubles.
+ * - Names (classes, methods, arguments, members, structs and enums) are
+ *   varint indices into a table grown on first use: an index equal to the
+ *   current table size is followed by the length and bytes of the new name.
+ * - Byte blobs are numbered in order of appearance; a blob identical to an
+ *   earlier one is written as a reference to that number.
+ * - Arguments, members, return values and array elements hold exactly one
+ *   value, so only calls, arrays and structs have end tags.
+ *
+ * A zero tag ends the stream.  That also covers the zero padding left
+ * behind by a writer that died before truncating the file.
+ */
+
+#ifndef TR_DUMP_BIN_H
+#define TR_DUMP_BIN_H
+
+
+#include "pipe/p_compiler.h"
+
+
+#define TRACE_BIN_MAGIC "GTRACEB"   /* 8 bytes, including the terminator */
+#define TRACE_BIN_VERSION 1
+
+
+enum trace_bin_tag {
+   TRACE_BIN_END = 0,
+   TRACE_BIN_CALL_BEGIN,     /* name class, name method */
+   TRACE_BIN_CALL_END,       /* int time */
+   TRACE_BIN_ARG,            /* name, value */
+   TRACE_BIN_RET,            /* value */
+   TRACE_BIN_NULL,
+   TRACE_BIN_BOOL,           /* uint */
+   TRACE_BIN_INT,            /* int */
+   TRACE_BIN_UINT,           /* uint */
+   TRACE_BIN_FLOAT,          /* double */
+   TRACE_BIN_STRING,         /* uint length, bytes */
+   TRACE_BIN_ENUM,           /* name */
+   TRACE_BIN_BYTES,          /* uint size, bytes */
+   TRACE_BIN_BYTES_REF,      /* uint blob index */
+   TRACE_BIN_PTR,            /* uint address */
+   TRACE_BIN_ARRAY_BEGIN,    /* values */
+   TRACE_BIN_ARRAY_END,
+   TRACE_BIN_STRUCT_BEGIN,   /* name, members */
+   TRACE_BIN_STRUCT_END,
+   TRACE_BIN_MEMBER,         /* name, value */
+};
+
+
+/*
+ * Writer, used by tr_dump.c with the call mutex held.
+ */
+
+boolean trace_bin_open(const char *filename);
+void trace_bin_close(void);
+void trace_bin_tag(enum trace_bin_tag tag);
+void trace_bin_name(const char *name);
+void trace_bin_uint(uint64_t value);
+void trace_bin_int(int64_t value);
+void trace_bin_float(double value);
+void trace_bin_string(const char *str);
+void trace_bin_bytes(const void *data, size_t size);
+
+
+#endif /* TR_DUMP_BIN_H */
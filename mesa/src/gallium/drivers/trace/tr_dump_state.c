@@ -536,6 +536,7 @@ void trace_dump_sampler_view_template(const struct pipe_sampler_view *state,
 
    trace_dump_struct_begin("pipe_sampler_view");
 
+   trace_dump_member(uint, state, target);
    trace_dump_member(format, state, format);
 
    trace_dump_member_begin("u");
@@ -696,6 +697,8 @@ void trace_dump_vertex_element(const struct pipe_vertex_element *state)
 
    trace_dump_member(uint, state, src_offset);
 
+   trace_dump_member(uint, state, instance_divisor);
+
    trace_dump_member(uint, state, vertex_buffer_index);
 
    trace_dump_member(format, state, src_format);
@@ -718,6 +721,19 @@ void trace_dump_constant_buffer(const struct pipe_constant_buffer *state)
    trace_dump_member(ptr, state, buffer);
    trace_dump_member(uint, state, buffer_offset);
    trace_dump_member(uint, state, buffer_size);
+
+   /* Needed to replay drivers that take user constant buffers, but only
+    * binary traces can afford it.
+    */
+   if (trace_dump_trace_is_binary()) {
+      trace_dump_member_begin("user_buffer");
+      if (state->user_buffer)
+         trace_dump_bytes(state->user_buffer, state->buffer_size);
+      else
+         trace_dump_null();
+      trace_dump_member_end();
+   }
+
    trace_dump_struct_end();
 }
 
@@ -322,10 +322,23 @@ trace_screen_resource_from_handle(struct pipe_screen *_screen,
    struct pipe_screen *screen = tr_screen->screen;
    struct pipe_resource *result;
 
-   /* TODO trace call */
+   /*
+    * The handle itself means nothing outside of this process, but the
+    * template is enough for a replay to stand in a resource of its own.
+    */
+   trace_dump_call_begin("pipe_screen", "resource_from_handle");
+
+   trace_dump_arg(ptr, screen);
+   trace_dump_arg(resource_template, templ);
+   trace_dump_arg(ptr, handle);
+   trace_dump_arg(uint, usage);
 
    result = screen->resource_from_handle(screen, templ, handle, usage);
 
+   trace_dump_ret(ptr, result);
+
+   trace_dump_call_end();
+
    result = trace_resource_create(trace_screen(_screen), result);
 
    return result;
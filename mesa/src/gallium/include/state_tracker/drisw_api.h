@@ -18,6 +18,14 @@ struct drisw_loader_funcs
                       void *data, unsigned width, unsigned height);
    void (*put_image2) (struct dri_drawable *dri_drawable,
                        void *data, int x, int y, unsigned width, unsigned height, unsigned stride);
+   /* optional, NULL if the loader can't take shared memory images */
+   void (*put_image_shm) (struct dri_drawable *dri_drawable,
+                          int shmid, char *shmaddr, unsigned offset,
+                          int x, int y, unsigned width, unsigned height, unsigned stride);
+   /* optional, NULL if the loader wants one put per rectangle */
+   void (*put_image_rects) (struct dri_drawable *dri_drawable,
+                            void *data, unsigned width, unsigned height,
+                            unsigned stride, const int *rects, unsigned nrects);
 };
 
 #endif
@@ -311,6 +311,13 @@ struct st_framebuffer_iface
     */
    const struct st_visual *visual;
 
+   /**
+    * The textures returned by validate store the image bottom-up (row 0 is
+    * the bottom) instead of top-down.  Read at validation time, so bump the
+    * stamp when it changes.
+    */
+   boolean bottom_up;
+
    /**
     * Flush the front buffer.
     *
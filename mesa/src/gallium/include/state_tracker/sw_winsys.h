@@ -125,12 +125,16 @@ struct sw_winsys
    /**
     * @sa pipe_screen:flush_frontbuffer.
     *
+    * Only the nboxes rectangles in box need to be updated on the
+    * destination; nboxes == 0 means the whole surface.
+    *
     * This call will likely become asynchronous eventually.
     */
    void
    (*displaytarget_display)( struct sw_winsys *ws, 
                              struct sw_displaytarget *dt,
                              void *context_private,
+                             unsigned nboxes,
                              struct pipe_box *box );
 
    void 
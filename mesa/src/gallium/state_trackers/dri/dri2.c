@@ -1883,7 +1883,12 @@ dri_kms_init_screen(__DRIscreen * sPriv)
 
    sPriv->driverPrivate = (void *)screen;
 
-   if (screen->fd < 0 || (fd = dup(screen->fd)) < 0)
+   /* Without a DRM device the winsys keeps buffers in memfds, which can
+    * be imported and exported just like dma-bufs.
+    */
+   if (screen->fd < 0)
+      fd = -1;
+   else if ((fd = dup(screen->fd)) < 0)
       goto free_screen;
 
    if (pipe_loader_sw_probe_kms(&screen->dev, fd))
@@ -1892,8 +1897,9 @@ dri_kms_init_screen(__DRIscreen * sPriv)
    if (!pscreen)
        goto release_pipe;
 
-   if (drmGetCap(sPriv->fd, DRM_CAP_PRIME, &cap) == 0 &&
-          (cap & DRM_PRIME_CAP_IMPORT)) {
+   if (screen->fd < 0 ||
+       (drmGetCap(sPriv->fd, DRM_CAP_PRIME, &cap) == 0 &&
+        (cap & DRM_PRIME_CAP_IMPORT))) {
       dri2ImageExtension.createImageFromFds = dri2_from_fds;
       dri2ImageExtension.createImageFromDmaBufs = dri2_from_dma_bufs;
    }
@@ -1917,7 +1923,7 @@ destroy_screen:
 release_pipe:
    if (screen->dev)
       pipe_loader_release(&screen->dev, 1);
-   else
+   else if (fd >= 0)
       close(fd);
 
 free_screen:
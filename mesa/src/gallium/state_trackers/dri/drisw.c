@@ -28,10 +28,13 @@
 
 /* TODO:
  *
- * xshm / EGLImage:
+ * EGLImage:
  *
- * Allow the loaders to use the XSHM extension. It probably requires callbacks
- * for createImage/destroyImage similar to DRI2 getBuffers.
+ * Display targets live in SysV shared memory when the loader implements
+ * putImageShm (swrast loader version 4), so an X loader can use MIT-SHM,
+ * unless it implements putImageRects.
+ * Sharing them as EGLImages would need createImage/destroyImage callbacks
+ * similar to DRI2 getBuffers.
  */
 
 #include "util/u_format.h"
@@ -85,6 +88,32 @@ put_image2(__DRIdrawable *dPriv, void *data, int x, int y,
                      data, dPriv->loaderPrivate);
 }
 
+static inline void
+put_image_shm(__DRIdrawable *dPriv, int shmid, char *shmaddr,
+              unsigned offset, int x, int y,
+              unsigned width, unsigned height, unsigned stride)
+{
+   __DRIscreen *sPriv = dPriv->driScreenPriv;
+   const __DRIswrastLoaderExtension *loader = sPriv->swrast_loader;
+
+   loader->putImageShm(dPriv, __DRI_SWRAST_IMAGE_OP_SWAP,
+                       x, y, width, height, stride,
+                       shmid, shmaddr, offset, dPriv->loaderPrivate);
+}
+
+static inline void
+put_image_rects(__DRIdrawable *dPriv, void *data,
+                unsigned width, unsigned height, unsigned stride,
+                const int *rects, unsigned nrects)
+{
+   __DRIscreen *sPriv = dPriv->driScreenPriv;
+   const __DRIswrastLoaderExtension *loader = sPriv->swrast_loader;
+
+   loader->putImageRects(dPriv, __DRI_SWRAST_IMAGE_OP_SWAP,
+                         width, height, stride, data,
+                         rects, nrects, dPriv->loaderPrivate);
+}
+
 static inline void
 get_image(__DRIdrawable *dPriv, int x, int y, int width, int height, void *data)
 {
@@ -151,6 +180,27 @@ drisw_put_image2(struct dri_drawable *drawable,
    put_image2(dPriv, data, x, y, width, height, stride);
 }
 
+static void
+drisw_put_image_shm(struct dri_drawable *drawable,
+                    int shmid, char *shmaddr, unsigned offset,
+                    int x, int y, unsigned width, unsigned height,
+                    unsigned stride)
+{
+   __DRIdrawable *dPriv = drawable->dPriv;
+
+   put_image_shm(dPriv, shmid, shmaddr, offset, x, y, width, height, stride);
+}
+
+static void
+drisw_put_image_rects(struct dri_drawable *drawable,
+                      void *data, unsigned width, unsigned height,
+                      unsigned stride, const int *rects, unsigned nrects)
+{
+   __DRIdrawable *dPriv = drawable->dPriv;
+
+   put_image_rects(dPriv, data, width, height, stride, rects, nrects);
+}
+
 static inline void
 drisw_present_texture(__DRIdrawable *dPriv,
                       struct pipe_resource *ptex, struct pipe_box *sub_box)
@@ -378,9 +428,25 @@ static struct drisw_loader_funcs drisw_lf = {
    .put_image2 = drisw_put_image2
 };
 
+static struct drisw_loader_funcs drisw_shm_lf = {
+   .get_image = drisw_get_image,
+   .put_image = drisw_put_image,
+   .put_image2 = drisw_put_image2,
+   .put_image_shm = drisw_put_image_shm
+};
+
+static struct drisw_loader_funcs drisw_rects_lf = {
+   .get_image = drisw_get_image,
+   .put_image = drisw_put_image,
+   .put_image2 = drisw_put_image2,
+   .put_image_rects = drisw_put_image_rects
+};
+
 static const __DRIconfig **
 drisw_init_screen(__DRIscreen * sPriv)
 {
+   const __DRIswrastLoaderExtension *loader = sPriv->swrast_loader;
+   struct drisw_loader_funcs *lf = &drisw_lf;
    const __DRIconfig **configs;
    struct dri_screen *screen;
    struct pipe_screen *pscreen = NULL;
@@ -397,7 +463,15 @@ drisw_init_screen(__DRIscreen * sPriv)
    sPriv->driverPrivate = (void *)screen;
    sPriv->extensions = drisw_screen_extensions;
 
-   if (pipe_loader_sw_probe_dri(&screen->dev, &drisw_lf))
+   /* A loader that wants whole updates gets them even if it could also take
+    * shared memory, as each putImageShm would be presented on its own.
+    */
+   if (loader->base.version >= 4 && loader->putImageRects)
+      lf = &drisw_rects_lf;
+   else if (loader->base.version >= 4 && loader->putImageShm)
+      lf = &drisw_shm_lf;
+
+   if (pipe_loader_sw_probe_dri(&screen->dev, lf))
       pscreen = pipe_loader_create_screen(screen->dev);
 
    if (!pscreen)
@@ -31,16 +31,16 @@
  * Otherwise we use softpipe.  The GALLIUM_DRIVER environment variable
  * may be set to "softpipe" or "llvmpipe" to override.
  *
- * With softpipe we could render directly into the user's buffer by using a
- * display target resource.  However, softpipe doesn't support "upside-down"
- * rendering which would be needed for the OSMESA_Y_UP=TRUE case.
+ * When the driver can wrap client memory as a texture (llvmpipe) and the
+ * user's buffer happens to have the row stride, alignment and height padding
+ * the driver would have chosen itself, we render directly into the user's
+ * buffer.  The OSMESA_Y_UP=TRUE case is then handled by telling the state
+ * tracker the buffer is stored bottom-up, so it flips the viewport rather
+ * than us flipping the image afterwards.
  *
- * With llvmpipe we could only render directly into the user's buffer when its
- * width and height is a multiple of the tile size (64 pixels).
- *
- * Because of these constraints we always render into ordinary resources then
- * copy the results to the user's buffer in the flush_front() function which
- * is called when the app calls glFlush/Finish.
+ * Otherwise we render into ordinary resources then copy the results to the
+ * user's buffer in the flush_front() function which is called when the app
+ * calls glFlush/Finish.
  *
  * In general, the OSMesa interface is pretty ugly and not a good match
  * for Gallium.  But we're interested in doing the best we can to preserve
@@ -62,6 +62,7 @@
 #include "util/u_box.h"
 #include "util/u_debug.h"
 #include "util/u_format.h"
+#include "util/u_inlines.h"
 #include "util/u_memory.h"
 
 #include "postprocess/filters.h"
@@ -86,6 +87,9 @@ struct osmesa_buffer
    struct pipe_resource *textures[ST_ATTACHMENT_COUNT];
 
    void *map;
+   GLint user_row_length;  /*< context's row length, at MakeCurrent time */
+   GLboolean y_up;         /*< context's Y direction, at MakeCurrent time */
+   boolean zero_copy;      /*< rendering directly into the user's buffer */
 
    struct osmesa_buffer *next;  /**< next in linked list */
 };
@@ -301,7 +305,8 @@ stfbi_to_osbuffer(struct st_framebuffer_iface *stfbi)
 
 /**
  * Called via glFlush/glFinish.  This is where we copy the contents
- * of the driver's color buffer into the user-specified buffer.
+ * of the driver's color buffer into the user-specified buffer, unless we
+ * rendered into it directly.
  */
 static boolean
 osmesa_st_framebuffer_flush_front(struct st_context_iface *stctx,
@@ -345,6 +350,14 @@ osmesa_st_framebuffer_flush_front(struct st_context_iface *stctx,
 
    map = pipe->transfer_map(pipe, res, 0, PIPE_TRANSFER_READ, &box,
                             &transfer);
+   if (!map)
+      return FALSE;
+
+   if (osbuffer->zero_copy) {
+      /* The map waited for rendering to finish; the pixels are in place. */
+      pipe->transfer_unmap(pipe, transfer);
+      return TRUE;
+   }
 
    /*
     * Copy the color buffer from the resource to the user's buffer.
@@ -376,6 +389,56 @@ osmesa_st_framebuffer_flush_front(struct st_context_iface *stctx,
 }
 
 
+/**
+ * Try to wrap the user's buffer as the color resource.  Only possible if
+ * the driver lays the resource out exactly like the user's buffer, which
+ * we check by mapping it.
+ */
+static struct pipe_resource *
+osmesa_wrap_user_buffer(struct st_context_iface *stctx,
+                        struct osmesa_buffer *osbuffer,
+                        const struct pipe_resource *templat)
+{
+   struct pipe_screen *screen = get_st_manager()->screen;
+   struct pipe_context *pipe = stctx->pipe;
+   struct pipe_resource *res;
+   struct pipe_transfer *transfer = NULL;
+   struct pipe_box box;
+   unsigned bpp, stride;
+   void *map;
+
+   if (!screen->resource_from_user_memory ||
+       !screen->get_param(screen, PIPE_CAP_TEXTURE_FROM_USER_MEMORY))
+      return NULL;
+
+   res = screen->resource_from_user_memory(screen, templat, osbuffer->map);
+   if (!res)
+      return NULL;
+
+   bpp = util_format_get_blocksize(templat->format);
+   if (osbuffer->user_row_length)
+      stride = bpp * osbuffer->user_row_length;
+   else
+      stride = bpp * osbuffer->width;
+
+   u_box_2d(0, 0, res->width0, res->height0, &box);
+   map = pipe->transfer_map(pipe, res, 0,
+                            PIPE_TRANSFER_READ | PIPE_TRANSFER_UNSYNCHRONIZED,
+                            &box, &transfer);
+   if (map) {
+      if (map != osbuffer->map || transfer->stride != stride) {
+         pipe_resource_reference(&res, NULL);
+      }
+      pipe->transfer_unmap(pipe, transfer);
+   }
+   else {
+      pipe_resource_reference(&res, NULL);
+   }
+
+   return res;
+}
+
+
 /**
  * Called by the st manager to validate the framebuffer (allocate
  * its resources).
@@ -432,8 +495,15 @@ osmesa_st_framebuffer_validate(struct st_context_iface *stctx,
 
       templat.format = format;
       templat.bind = bind;
-      out[i] = osbuffer->textures[statts[i]] =
-         screen->resource_create(screen, &templat);
+      out[i] = NULL;
+      if (statts[i] == ST_ATTACHMENT_FRONT_LEFT) {
+         out[i] = osmesa_wrap_user_buffer(stctx, osbuffer, &templat);
+         osbuffer->zero_copy = out[i] != NULL;
+         stfbi->bottom_up = osbuffer->zero_copy && osbuffer->y_up;
+      }
+      if (!out[i])
+         out[i] = screen->resource_create(screen, &templat);
+      osbuffer->textures[statts[i]] = out[i];
    }
 
    return TRUE;
@@ -774,9 +844,19 @@ OSMesaMakeCurrent(OSMesaContext osmesa, void *buffer, GLenum type,
                                       osmesa->accum_format);
    }
 
+   if (osbuffer->zero_copy &&
+       (osbuffer->map != buffer ||
+        osbuffer->user_row_length != osmesa->user_row_length ||
+        osbuffer->y_up != osmesa->y_up)) {
+      /* the color resource wraps the old buffer, have it re-validated */
+      p_atomic_inc(&osbuffer->stfb->stamp);
+   }
+
    osbuffer->width = width;
    osbuffer->height = height;
    osbuffer->map = buffer;
+   osbuffer->user_row_length = osmesa->user_row_length;
+   osbuffer->y_up = osmesa->y_up;
 
    /* XXX unused for now */
    (void) osmesa_destroy_buffer;
@@ -828,6 +908,7 @@ GLAPI void GLAPIENTRY
 OSMesaPixelStore(GLint pname, GLint value)
 {
    OSMesaContext osmesa = OSMesaGetCurrentContext();
+   struct osmesa_buffer *osbuffer = osmesa->current_buffer;
 
    switch (pname) {
    case OSMESA_ROW_LENGTH:
@@ -840,6 +921,15 @@ OSMesaPixelStore(GLint pname, GLint value)
       fprintf(stderr, "Invalid pname in OSMesaPixelStore()\n");
       return;
    }
+
+   if (osbuffer &&
+       (osbuffer->user_row_length != osmesa->user_row_length ||
+        osbuffer->y_up != osmesa->y_up)) {
+      osbuffer->user_row_length = osmesa->user_row_length;
+      osbuffer->y_up = osmesa->y_up;
+      if (osbuffer->zero_copy)
+         p_atomic_inc(&osbuffer->stfb->stamp);
+   }
 }
 
 
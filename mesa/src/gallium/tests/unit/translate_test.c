@@ -29,6 +29,7 @@
 #include "util/u_format.h"
 #include "util/u_half.h"
 #include "util/u_cpu_detect.h"
+#include "os/os_time.h"
 #include "rtasm/rtasm_cpu.h"
 
 /* don't use this for serious use */
@@ -46,11 +47,143 @@ static double rand_double()
    return v;
 }
 
+/**
+ * Check that a linear run long enough to be converted in several batches
+ * gives the same result as converting the same vertices through run_elts.
+ * The last vertices are past max_index and have to be clamped either way.
+ * If a reference translate is given, its run_elts output has to be the
+ * same too.
+ */
+static boolean
+test_batch(struct translate *translate, struct translate *reference,
+           const unsigned char *input, unsigned input_size,
+           unsigned output_size)
+{
+   const unsigned start = 3;
+   const unsigned max_index = 72;
+   unsigned elts[100];
+   const unsigned count = ARRAY_SIZE(elts);
+   unsigned char *run_output, *elts_output;
+   boolean success;
+   unsigned i;
+
+   run_output = align_malloc(count * output_size, 64);
+   elts_output = align_malloc(count * output_size, 64);
+
+   for (i = 0; i < count; ++i)
+      elts[i] = start + i;
+
+   translate->set_buffer(translate, 0, input, input_size, max_index);
+   translate->run(translate, start, count, 0, 0, run_output);
+   translate->run_elts(translate, elts, count, 0, 0, elts_output);
+
+   success = memcmp(run_output, elts_output, count * output_size) == 0;
+
+   if (reference)
+   {
+      reference->set_buffer(reference, 0, input, input_size, max_index);
+      reference->run_elts(reference, elts, count, 0, 0, elts_output);
+
+      if (memcmp(run_output, elts_output, count * output_size) != 0)
+         success = FALSE;
+   }
+
+   align_free(elts_output);
+   align_free(run_output);
+
+   return success;
+}
+
+static const struct {
+   enum pipe_format input_format;
+   enum pipe_format output_format;
+} throughput_tests[] = {
+   { PIPE_FORMAT_R32G32B32_FLOAT,    PIPE_FORMAT_R32G32B32A32_FLOAT },
+   { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   { PIPE_FORMAT_R8G8B8A8_UNORM,     PIPE_FORMAT_R32G32B32A32_FLOAT },
+   { PIPE_FORMAT_R16G16B16A16_SNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   { PIPE_FORMAT_R16G16_FLOAT,       PIPE_FORMAT_R32G32_FLOAT },
+   { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R8G8B8A8_UNORM },
+   { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R16G16B16A16_FLOAT },
+};
+
+/**
+ * Time the linear and indexed paths over a vertex buffer much larger than
+ * the one used by the conversion checks, and print vertices per second
+ * for each format pair.
+ */
+static void
+test_throughput(struct translate *(*create_fn)(const struct translate_key *key),
+                const char *name)
+{
+   const unsigned nr_vertices = 64 * 1024;
+   const unsigned iterations = 64;
+   unsigned char *input, *output;
+   unsigned *elts;
+   unsigned i, j;
+
+   input = align_malloc(nr_vertices * 16, 64);
+   output = align_malloc(nr_vertices * 16, 64);
+   elts = align_malloc(nr_vertices * sizeof *elts, 64);
+
+   for (i = 0; i < nr_vertices * 16; ++i)
+      input[i] = rand() & 0x7f;
+
+   for (i = 0; i < nr_vertices; ++i)
+      elts[i] = (i * 7) % nr_vertices;
+
+   for (i = 0; i < ARRAY_SIZE(throughput_tests); ++i)
+   {
+      enum pipe_format input_format = throughput_tests[i].input_format;
+      enum pipe_format output_format = throughput_tests[i].output_format;
+      unsigned input_size = util_format_get_stride(input_format, 1);
+      struct translate_key key;
+      struct translate *translate;
+      int64_t start, run_time, elts_time;
+
+      memset(&key, 0, sizeof key);
+      key.nr_elements = 1;
+      key.output_stride = util_format_get_stride(output_format, 1);
+      key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+      key.element[0].input_format = input_format;
+      key.element[0].output_format = output_format;
+
+      translate = create_fn(&key);
+      if (!translate)
+         continue;
+
+      translate->set_buffer(translate, 0, input, input_size, nr_vertices - 1);
+
+      start = os_time_get_nano();
+      for (j = 0; j < iterations; ++j)
+         translate->run(translate, 0, nr_vertices, 0, 0, output);
+      run_time = os_time_get_nano() - start;
+
+      start = os_time_get_nano();
+      for (j = 0; j < iterations; ++j)
+         translate->run_elts(translate, elts, nr_vertices, 0, 0, output);
+      elts_time = os_time_get_nano() - start;
+
+      printf("PERF: %s -> %s: run %.1f Mverts/s, run_elts %.1f Mverts/s (translate_%s)\n",
+             util_format_name(input_format), util_format_name(output_format),
+             (double)nr_vertices * iterations * 1e3 / MAX2(run_time, 1),
+             (double)nr_vertices * iterations * 1e3 / MAX2(elts_time, 1),
+             name);
+
+      translate->release(translate);
+   }
+
+   align_free(elts);
+   align_free(output);
+   align_free(input);
+}
+
 int main(int argc, char** argv)
 {
    struct translate *(*create_fn)(const struct translate_key *key) = 0;
 
    struct translate_key key;
+   struct translate *batch_translate;
    unsigned output_format;
    unsigned input_format;
    unsigned buffer_size = 4096;
@@ -64,6 +197,8 @@ int main(int argc, char** argv)
    unsigned i, j, k;
    unsigned passed = 0;
    unsigned total = 0;
+   boolean perf;
+   boolean exact = FALSE;
    const float error = 0.03125;
 
    create_fn = 0;
@@ -75,6 +210,19 @@ int main(int argc, char** argv)
       create_fn = translate_create;
    else if (!strcmp(argv[1], "generic"))
       create_fn = translate_generic_create;
+#if defined(USE_AVX2)
+   else if (!strcmp(argv[1], "avx2"))
+   {
+      if(!util_cpu_caps.has_avx2)
+      {
+         printf("Error: CPU doesn't support AVX2\n");
+         return 2;
+      }
+      /* does the same arithmetic as the generic backend */
+      exact = TRUE;
+      create_fn = translate_avx2_create;
+   }
+#endif
    else if (!strcmp(argv[1], "x86"))
       create_fn = translate_sse2_create;
    else if (!strcmp(argv[1], "nosse"))
@@ -130,10 +278,12 @@ int main(int argc, char** argv)
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|sse4.1]\n");
+      printf("Usage: ./translate_test [default|generic|avx2|x86|nosse|sse|sse2|sse3|sse4.1] [perf]\n");
       return 2;
    }
 
+   perf = argc > 2 && !strcmp(argv[2], "perf");
+
    for (i = 1; i < ARRAY_SIZE(buffer); ++i)
       buffer[i] = align_malloc(buffer_size, 4096);
 
@@ -287,6 +437,21 @@ int main(int argc, char** argv)
             }
          }
 
+         key.element[0].input_format = input_format;
+         key.element[0].output_format = output_format;
+         key.output_stride = output_format_size;
+         batch_translate = translate_generic_create(&key);
+         if (batch_translate)
+         {
+            if (!test_batch(batch_translate, NULL, buffer[0],
+                            input_format_size, output_format_size))
+               fail = 1;
+            if (exact && !test_batch(translate[0], batch_translate, buffer[0],
+                                     input_format_size, output_format_size))
+               fail = 1;
+            batch_translate->release(batch_translate);
+         }
+
          printf("%s%s: %s -> %s -> %s -> %s -> %s\n",
                fail ? "FAIL" : "PASS",
                used_generic ? "[GENERIC]" : "",
@@ -320,6 +485,9 @@ int main(int argc, char** argv)
       }
    }
 
+   if (perf)
+      test_throughput(create_fn, argv[1]);
+
    printf("%u/%u tests passed for translate_%s\n", passed, total, argv[1]);
    return passed != total;
 }
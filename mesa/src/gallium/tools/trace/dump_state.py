@@ -191,6 +191,9 @@ class Screen(Dispatcher):
     def is_format_supported(self, format, target, sample_count, bind, geom_flags):
         pass
     
+    def resource_from_handle(self, templ, handle, usage):
+        return self.resource_create(templ)
+
     def resource_create(self, templat):
         resource = templat
         # Normalize state to avoid spurious differences
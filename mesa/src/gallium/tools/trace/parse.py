@@ -28,6 +28,7 @@
 
 
 import sys
+import struct
 import xml.parsers.expat
 import optparse
 
@@ -37,6 +38,15 @@ from model import *
 ELEMENT_START, ELEMENT_END, CHARACTER_DATA, EOF = range(4)
 
 
+# Binary traces, see src/gallium/drivers/trace/tr_dump_bin.h
+BINARY_MAGIC = 'GTRACEB\0'
+
+(BIN_END, BIN_CALL_BEGIN, BIN_CALL_END, BIN_ARG, BIN_RET, BIN_NULL, BIN_BOOL,
+ BIN_INT, BIN_UINT, BIN_FLOAT, BIN_STRING, BIN_ENUM, BIN_BYTES, BIN_BYTES_REF,
+ BIN_PTR, BIN_ARRAY_BEGIN, BIN_ARRAY_END, BIN_STRUCT_BEGIN, BIN_STRUCT_END,
+ BIN_MEMBER) = range(20)
+
+
 class XmlToken:
 
     def __init__(self, type, name_or_data, attrs = None, line = None, column = None):
@@ -190,10 +200,23 @@ class XmlParser:
 class TraceParser(XmlParser):
 
     def __init__(self, fp):
-        XmlParser.__init__(self, fp)
+        self.binary = fp.read(len(BINARY_MAGIC)) == BINARY_MAGIC
+        if self.binary:
+            self.fp = fp
+            self.names = []
+            self.blobs = []
+            version = self.read_uint()
+            if version != 1:
+                raise ValueError('unsupported binary trace version %u' % version)
+        else:
+            fp.seek(0)
+            XmlParser.__init__(self, fp)
         self.last_call_no = 0
     
     def parse(self):
+        if self.binary:
+            self.parse_binary()
+            return
         self.element_start('trace')
         while self.token.type not in (ELEMENT_END, EOF):
             call = self.parse_call()
@@ -346,6 +369,98 @@ class TraceParser(XmlParser):
 
         return Pointer(address)
 
+    def read_byte(self):
+        c = self.fp.read(1)
+        if not c:
+            return BIN_END
+        return ord(c)
+
+    def read_uint(self):
+        value = 0
+        shift = 0
+        while True:
+            byte = self.read_byte()
+            value |= (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    def read_int(self):
+        value = self.read_uint()
+        return (value >> 1) ^ -(value & 1)
+
+    def read_name(self):
+        index = self.read_uint()
+        if index == len(self.names):
+            self.names.append(self.fp.read(self.read_uint()))
+        return self.names[index]
+
+    def parse_binary(self):
+        while self.read_byte() == BIN_CALL_BEGIN:
+            call = self.parse_binary_call()
+            self.handle_call(call)
+
+    def parse_binary_call(self):
+        self.last_call_no += 1
+        klass = self.read_name()
+        method = self.read_name()
+        args = []
+        ret = None
+        while True:
+            tag = self.read_byte()
+            if tag == BIN_ARG:
+                name = self.read_name()
+                args.append((name, self.parse_binary_value(self.read_byte())))
+            elif tag == BIN_RET:
+                ret = self.parse_binary_value(self.read_byte())
+            elif tag == BIN_CALL_END:
+                time = Literal(self.read_int())
+                break
+            else:
+                raise ValueError('unexpected tag %u in call %u' % (tag, self.last_call_no))
+        return Call(self.last_call_no, klass, method, args, ret, time)
+
+    def parse_binary_value(self, tag):
+        if tag == BIN_NULL:
+            return Literal(None)
+        if tag in (BIN_BOOL, BIN_UINT):
+            return Literal(self.read_uint())
+        if tag == BIN_INT:
+            return Literal(self.read_int())
+        if tag == BIN_FLOAT:
+            return Literal(struct.unpack('<d', self.fp.read(8))[0])
+        if tag == BIN_STRING:
+            return Literal(self.fp.read(self.read_uint()))
+        if tag == BIN_ENUM:
+            return NamedConstant(self.read_name())
+        if tag == BIN_BYTES:
+            data = self.fp.read(self.read_uint())
+            self.blobs.append(data)
+            return Blob(None, data)
+        if tag == BIN_BYTES_REF:
+            return Blob(None, self.blobs[self.read_uint()])
+        if tag == BIN_PTR:
+            return Pointer('0x%08x' % self.read_uint())
+        if tag == BIN_ARRAY_BEGIN:
+            elems = []
+            tag = self.read_byte()
+            while tag != BIN_ARRAY_END:
+                elems.append(self.parse_binary_value(tag))
+                tag = self.read_byte()
+            return Array(elems)
+        if tag == BIN_STRUCT_BEGIN:
+            name = self.read_name()
+            members = []
+            tag = self.read_byte()
+            while tag == BIN_MEMBER:
+                member = self.read_name()
+                members.append((member, self.parse_binary_value(self.read_byte())))
+                tag = self.read_byte()
+            if tag != BIN_STRUCT_END:
+                raise ValueError('unexpected tag %u in struct %s' % (tag, name))
+            return Struct(name, members)
+        raise ValueError('unexpected tag %u' % tag)
+
     def handle_call(self, call):
         pass
     
@@ -383,7 +498,7 @@ class Main:
                 from bz2 import BZ2File
                 stream = BZ2File(arg, 'rU')
             else:
-                stream = open(arg, 'rt')
+                stream = open(arg, 'rb')
             self.process_arg(stream, options)
 
     def get_optparser(self):
@@ -0,0 +1,2407 @@
+/**************************************************************************
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Replay a binary trace on a pipe driver and time every frame.
+ *
+ * Frames end at pipe_screen::flush_frontbuffer or at a context flush with
+ * PIPE_FLUSH_END_OF_FRAME, after which the replay waits for the driver to
+ * finish, so each frame is charged for all of its own rendering.  All the
+ * calls of a frame are decoded before its clock starts.  Both wall clock
+ * time and the CPU time of the whole process, which includes llvmpipe's
+ * rasterizer threads, are reported.
+ *
+ * Things the trace can't reproduce are skipped and counted: draws sourcing
+ * user vertex or index buffers whose contents weren't recorded, indirect
+ * draws, compute, shader images and buffers.  Presentation is skipped as
+ * well.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "pipe-loader/pipe_loader.h"
+#include "os/os_time.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_box.h"
+#include "util/u_dump.h"
+#include "util/u_format.h"
+#include "util/u_hash_table.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+
+#include "trace/tr_dump_bin.h"
+
+
+#define MAX_TGSI_TOKENS 16384
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+
+/**
+ * A node of the value tree of the current call.  Nodes refer to each other
+ * by index, index 0 being a null value that missing arguments and members
+ * resolve to.
+ */
+struct value
+{
+   enum trace_bin_tag type;
+   const char *name;       /**< argument or member name */
+   unsigned next;          /**< next sibling */
+   union {
+      uint64_t u;
+      int64_t i;
+      double f;
+      unsigned first;      /**< first child of arrays and structs */
+      unsigned string;     /**< offset into reader::chars */
+      const char *enum_name;
+      struct {
+         const uint8_t *data;
+         size_t size;
+      } bytes;
+   } u;
+};
+
+
+struct blob
+{
+   const uint8_t *data;
+   size_t size;
+};
+
+
+struct reader
+{
+   const uint8_t *ptr;
+   const uint8_t *end;
+
+   char **names;
+   unsigned num_names, max_names;
+
+   struct blob *blobs;
+   unsigned num_blobs, max_blobs;
+
+   unsigned num_calls;
+
+   /* Reset for every frame */
+   struct value *values;
+   unsigned num_values, max_values;
+   char *chars;
+   unsigned num_chars, max_chars;
+};
+
+
+struct call
+{
+   unsigned no;
+   const char *klass;
+   unsigned method;        /**< index into reader::names */
+   unsigned args;          /**< first argument */
+   unsigned ret;
+};
+
+
+struct replay_context
+{
+   struct pipe_context *pipe;
+   unsigned user_vertex_buffers;    /**< slots bound to user memory */
+   boolean user_index_buffer;
+
+   /* Bound buffers, for rebinding user memory recorded with the draws */
+   struct pipe_vertex_buffer vertex_buffers[PIPE_MAX_ATTRIBS];
+   struct pipe_index_buffer index_buffer;
+};
+
+
+struct frame
+{
+   int64_t wall;
+   int64_t cpu;
+};
+
+
+struct replay
+{
+   struct reader reader;
+   struct call call;
+
+   /** Calls of the current frame */
+   struct call *calls;
+   unsigned num_calls, max_calls;
+
+   struct pipe_loader_device *dev;
+   struct pipe_screen *screen;
+
+   /** trace address -> object created by the replay */
+   struct util_hash_table *objects;
+
+   /** Context that did the latest work, which the frame end waits for */
+   struct replay_context *last_ctx;
+
+   /** Handler for each method name, looked up on first use */
+   void (**handlers)(struct replay *);
+   unsigned num_handlers;
+
+   struct frame *frames;
+   unsigned num_frames, max_frames;
+   int64_t frame_wall, frame_cpu;
+   unsigned frame_calls;
+
+   unsigned skipped_draws;
+   unsigned *ignored;   /**< per method name */
+   boolean quiet;
+};
+
+
+static void *
+grow(void *array, unsigned *max, unsigned needed, size_t size)
+{
+   unsigned new_max;
+
+   if (needed <= *max)
+      return array;
+
+   new_max = MAX2(needed, *max * 2);
+   new_max = MAX2(new_max, 64);
+   array = realloc(array, new_max * size);
+   if (!array) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+   }
+
+   *max = new_max;
+   return array;
+}
+
+
+/*
+ * Reader
+ */
+
+
+static void
+reader_error(const char *what)
+{
+   fprintf(stderr, "corrupt trace: %s\n", what);
+   exit(1);
+}
+
+
+static unsigned
+read_byte(struct reader *r)
+{
+   /* Running off the end reads as TRACE_BIN_END */
+   if (r->ptr >= r->end)
+      return TRACE_BIN_END;
+   return *r->ptr++;
+}
+
+
+static const uint8_t *
+read_data(struct reader *r, uint64_t size)
+{
+   const uint8_t *data = r->ptr;
+
+   if (size > (uint64_t)(r->end - r->ptr))
+      reader_error("truncated data");
+
+   r->ptr += size;
+   return data;
+}
+
+
+static uint64_t
+read_uint(struct reader *r)
+{
+   uint64_t value = 0;
+   unsigned shift = 0;
+   unsigned byte;
+
+   do {
+      if (shift >= 64)
+         reader_error("bad varint");
+      byte = read_byte(r);
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      shift += 7;
+   } while (byte & 0x80);
+
+   return value;
+}
+
+
+static int64_t
+read_int(struct reader *r)
+{
+   uint64_t value = read_uint(r);
+   return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+static double
+read_float(struct reader *r)
+{
+   const uint8_t *p = read_data(r, 8);
+   union {
+      double d;
+      uint64_t u;
+   } bits;
+   unsigned i;
+
+   bits.u = 0;
+   for (i = 0; i < 8; ++i)
+      bits.u |= (uint64_t)p[i] << (i * 8);
+
+   return bits.d;
+}
+
+
+static unsigned
+read_name_index(struct reader *r)
+{
+   uint64_t index = read_uint(r);
+
+   if (index == r->num_names) {
+      uint64_t len = read_uint(r);
+      const uint8_t *str = read_data(r, len);
+      char *name = malloc(len + 1);
+
+      if (!name)
+         reader_error("out of memory");
+      memcpy(name, str, len);
+      name[len] = 0;
+
+      r->names = grow(r->names, &r->max_names, r->num_names + 1,
+                      sizeof *r->names);
+      r->names[r->num_names++] = name;
+   }
+   else if (index > r->num_names)
+      reader_error("bad name index");
+
+   return index;
+}
+
+
+static const char *
+read_name(struct reader *r)
+{
+   return r->names[read_name_index(r)];
+}
+
+
+static unsigned
+new_value(struct reader *r, enum trace_bin_tag type, const char *name)
+{
+   struct value *v;
+
+   r->values = grow(r->values, &r->max_values, r->num_values + 1,
+                    sizeof *r->values);
+   v = &r->values[r->num_values];
+   memset(v, 0, sizeof *v);
+   v->type = type;
+   v->name = name;
+   return r->num_values++;
+}
+
+
+static unsigned
+parse_value(struct reader *r, unsigned tag, const char *name)
+{
+   unsigned index = new_value(r, tag, name);
+   unsigned last = 0;
+   uint64_t size;
+
+   switch (tag) {
+   case TRACE_BIN_NULL:
+      break;
+   case TRACE_BIN_BOOL:
+   case TRACE_BIN_UINT:
+   case TRACE_BIN_PTR:
+      r->values[index].u.u = read_uint(r);
+      break;
+   case TRACE_BIN_INT:
+      r->values[index].u.i = read_int(r);
+      break;
+   case TRACE_BIN_FLOAT:
+      r->values[index].u.f = read_float(r);
+      break;
+   case TRACE_BIN_STRING:
+      size = read_uint(r);
+      r->chars = grow(r->chars, &r->max_chars, r->num_chars + size + 1, 1);
+      memcpy(r->chars + r->num_chars, read_data(r, size), size);
+      r->values[index].u.string = r->num_chars;
+      r->num_chars += size;
+      r->chars[r->num_chars++] = 0;
+      break;
+   case TRACE_BIN_ENUM:
+      r->values[index].u.enum_name = read_name(r);
+      break;
+   case TRACE_BIN_BYTES:
+      size = read_uint(r);
+      r->blobs = grow(r->blobs, &r->max_blobs, r->num_blobs + 1,
+                      sizeof *r->blobs);
+      r->blobs[r->num_blobs].size = size;
+      r->blobs[r->num_blobs].data = read_data(r, size);
+      r->values[index].u.bytes.data = r->blobs[r->num_blobs].data;
+      r->values[index].u.bytes.size = size;
+      r->num_blobs++;
+      break;
+   case TRACE_BIN_BYTES_REF:
+      size = read_uint(r);
+      if (size >= r->num_blobs)
+         reader_error("bad blob reference");
+      r->values[index].type = TRACE_BIN_BYTES;
+      r->values[index].u.bytes.data = r->blobs[size].data;
+      r->values[index].u.bytes.size = r->blobs[size].size;
+      break;
+   case TRACE_BIN_ARRAY_BEGIN:
+      while ((tag = read_byte(r)) != TRACE_BIN_ARRAY_END) {
+         unsigned elem = parse_value(r, tag, NULL);
+         if (last)
+            r->values[last].next = elem;
+         else
+            r->values[index].u.first = elem;
+         last = elem;
+      }
+      break;
+   case TRACE_BIN_STRUCT_BEGIN:
+      read_name_index(r);
+      while ((tag = read_byte(r)) == TRACE_BIN_MEMBER) {
+         const char *member = read_name(r);
+         unsigned elem = parse_value(r, read_byte(r), member);
+         if (last)
+            r->values[last].next = elem;
+         else
+            r->values[index].u.first = elem;
+         last = elem;
+      }
+      if (tag != TRACE_BIN_STRUCT_END)
+         reader_error("unterminated struct");
+      break;
+   default:
+      reader_error("unknown value tag");
+   }
+
+   return index;
+}
+
+
+/**
+ * Parse the next call into the value tree, returning FALSE at the end.
+ */
+static boolean
+parse_call(struct reader *r, struct call *call)
+{
+   unsigned last = 0;
+   unsigned tag;
+
+   if (read_byte(r) != TRACE_BIN_CALL_BEGIN)
+      return FALSE;
+
+   call->no = ++r->num_calls;
+   call->klass = read_name(r);
+   call->method = read_name_index(r);
+   call->args = 0;
+   call->ret = 0;
+
+   while ((tag = read_byte(r)) != TRACE_BIN_CALL_END) {
+      if (tag == TRACE_BIN_ARG) {
+         const char *name = read_name(r);
+         unsigned arg = parse_value(r, read_byte(r), name);
+         if (last)
+            r->values[last].next = arg;
+         else
+            call->args = arg;
+         last = arg;
+      }
+      else if (tag == TRACE_BIN_RET)
+         call->ret = parse_value(r, read_byte(r), NULL);
+      else
+         reader_error("unexpected tag in call");
+   }
+   read_int(r); /* time */
+
+   return TRUE;
+}
+
+
+/*
+ * Value access
+ */
+
+
+static const struct value *
+value(const struct replay *rp, unsigned index)
+{
+   return &rp->reader.values[index];
+}
+
+
+static const struct value *
+find(const struct replay *rp, unsigned index, const char *name)
+{
+   while (index) {
+      const struct value *v = value(rp, index);
+      if (v->name && strcmp(v->name, name) == 0)
+         return v;
+      index = v->next;
+   }
+   return value(rp, 0);
+}
+
+
+static const struct value *
+arg(const struct replay *rp, const char *name)
+{
+   return find(rp, rp->call.args, name);
+}
+
+
+static const struct value *
+member(const struct replay *rp, const struct value *v, const char *name)
+{
+   if (v->type != TRACE_BIN_STRUCT_BEGIN)
+      return value(rp, 0);
+   return find(rp, v->u.first, name);
+}
+
+
+static const struct value *
+elem(const struct replay *rp, const struct value *v, unsigned i)
+{
+   unsigned index;
+
+   if (v->type != TRACE_BIN_ARRAY_BEGIN)
+      return value(rp, 0);
+
+   for (index = v->u.first; index && i; --i)
+      index = value(rp, index)->next;
+   return value(rp, index);
+}
+
+
+static unsigned
+num_elems(const struct replay *rp, const struct value *v)
+{
+   unsigned index, count = 0;
+
+   if (v->type != TRACE_BIN_ARRAY_BEGIN)
+      return 0;
+
+   for (index = v->u.first; index; index = value(rp, index)->next)
+      ++count;
+   return count;
+}
+
+
+static uint64_t
+uint_of(const struct value *v)
+{
+   switch (v->type) {
+   case TRACE_BIN_BOOL:
+   case TRACE_BIN_UINT:
+   case TRACE_BIN_PTR:
+      return v->u.u;
+   case TRACE_BIN_INT:
+      return v->u.i;
+   case TRACE_BIN_FLOAT:
+      return (uint64_t)v->u.f;
+   default:
+      return 0;
+   }
+}
+
+
+static double
+float_of(const struct value *v)
+{
+   switch (v->type) {
+   case TRACE_BIN_FLOAT:
+      return v->u.f;
+   case TRACE_BIN_INT:
+      return v->u.i;
+   default:
+      return uint_of(v);
+   }
+}
+
+
+static const char *
+string_of(const struct replay *rp, const struct value *v)
+{
+   if (v->type != TRACE_BIN_STRING)
+      return NULL;
+   return rp->reader.chars + v->u.string;
+}
+
+
+static enum pipe_format
+format_of(const struct value *v)
+{
+   unsigned i;
+
+   if (v->type != TRACE_BIN_ENUM)
+      return PIPE_FORMAT_NONE;
+
+   for (i = 0; i < PIPE_FORMAT_COUNT; ++i)
+      if (strcmp(util_format_name(i), v->u.enum_name) == 0)
+         return i;
+
+   return PIPE_FORMAT_NONE;
+}
+
+
+static void
+box_of(const struct replay *rp, const struct value *v, struct pipe_box *box)
+{
+   u_box_3d(uint_of(member(rp, v, "x")),
+            uint_of(member(rp, v, "y")),
+            uint_of(member(rp, v, "z")),
+            uint_of(member(rp, v, "width")),
+            uint_of(member(rp, v, "height")),
+            uint_of(member(rp, v, "depth")),
+            box);
+}
+
+
+#define MEMBER_UINT(_v, _obj, _member) \
+   ((_obj)->_member = uint_of(member(rp, _v, #_member)))
+
+#define MEMBER_FLOAT(_v, _obj, _member) \
+   ((_obj)->_member = float_of(member(rp, _v, #_member)))
+
+#define MEMBER_FLOAT_ARRAY(_v, _obj, _member, _name) \
+   do { \
+      const struct value *_array = member(rp, _v, _name); \
+      unsigned _i; \
+      for (_i = 0; _i < ARRAY_SIZE((_obj)->_member); ++_i) \
+         (_obj)->_member[_i] = float_of(elem(rp, _array, _i)); \
+   } while (0)
+
+
+/*
+ * Objects
+ */
+
+
+static unsigned
+object_hash(void *key)
+{
+   uintptr_t address = (uintptr_t)key;
+   return (unsigned)(address >> 4) ^ (unsigned)(address >> 20);
+}
+
+
+static int
+object_compare(void *key1, void *key2)
+{
+   return key1 != key2;
+}
+
+
+static void *
+object(const struct replay *rp, const struct value *v)
+{
+   if (v->type != TRACE_BIN_PTR)
+      return NULL;
+   return util_hash_table_get(rp->objects, (void *)(uintptr_t)v->u.u);
+}
+
+
+static void
+object_set(struct replay *rp, const struct value *v, void *obj)
+{
+   if (v->type != TRACE_BIN_PTR)
+      return;
+
+   if (obj)
+      util_hash_table_set(rp->objects, (void *)(uintptr_t)v->u.u, obj);
+   else
+      util_hash_table_remove(rp->objects, (void *)(uintptr_t)v->u.u);
+}
+
+
+static void
+object_remove(struct replay *rp, const struct value *v)
+{
+   object_set(rp, v, NULL);
+}
+
+
+/**
+ * The context of a pipe_context call, which is always the first argument.
+ */
+static struct replay_context *
+context(struct replay *rp)
+{
+   struct replay_context *ctx = object(rp, value(rp, rp->call.args));
+
+   if (ctx)
+      rp->last_ctx = ctx;
+   return ctx;
+}
+
+
+/*
+ * Frames
+ */
+
+
+static int64_t
+cpu_time(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+   return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void
+frame_start(struct replay *rp)
+{
+   rp->frame_calls = 0;
+   rp->frame_wall = os_time_get_nano();
+   rp->frame_cpu = cpu_time();
+}
+
+
+static void
+frame_end(struct replay *rp)
+{
+   struct frame *frame;
+
+   /* Several end of frame markers in a row only end one frame */
+   if (!rp->frame_calls)
+      return;
+
+   if (rp->last_ctx) {
+      struct pipe_fence_handle *fence = NULL;
+
+      rp->last_ctx->pipe->flush(rp->last_ctx->pipe, &fence, 0);
+      if (fence) {
+         rp->screen->fence_finish(rp->screen, NULL, fence,
+                                  PIPE_TIMEOUT_INFINITE);
+         rp->screen->fence_reference(rp->screen, &fence, NULL);
+      }
+   }
+
+   rp->frames = grow(rp->frames, &rp->max_frames, rp->num_frames + 1,
+                     sizeof *rp->frames);
+   frame = &rp->frames[rp->num_frames++];
+   frame->wall = os_time_get_nano() - rp->frame_wall;
+   frame->cpu = cpu_time() - rp->frame_cpu;
+
+   if (!rp->quiet)
+      printf("frame %u: %.3f ms cpu, %.3f ms wall, %u calls\n",
+             rp->num_frames, frame->cpu / 1e6, frame->wall / 1e6,
+             rp->frame_calls);
+}
+
+
+/*
+ * pipe_screen
+ */
+
+
+static void
+replay_context_create(struct replay *rp)
+{
+   struct replay_context *ctx = CALLOC_STRUCT(replay_context);
+
+   if (!ctx)
+      return;
+
+   ctx->pipe = rp->screen->context_create(rp->screen, NULL,
+                                          uint_of(arg(rp, "flags")));
+   if (!ctx->pipe) {
+      FREE(ctx);
+      return;
+   }
+
+   object_set(rp, value(rp, rp->call.ret), ctx);
+}
+
+
+static void
+replay_resource_create(struct replay *rp)
+{
+   const struct value *templ = arg(rp, "templat");
+   struct pipe_resource tmpl, *res;
+
+   if (templ->type != TRACE_BIN_STRUCT_BEGIN)
+      templ = arg(rp, "templ");
+
+   memset(&tmpl, 0, sizeof tmpl);
+   MEMBER_UINT(templ, &tmpl, target);
+   tmpl.format = format_of(member(rp, templ, "format"));
+   tmpl.width0 = uint_of(member(rp, templ, "width"));
+   tmpl.height0 = uint_of(member(rp, templ, "height"));
+   tmpl.depth0 = uint_of(member(rp, templ, "depth"));
+   MEMBER_UINT(templ, &tmpl, array_size);
+   MEMBER_UINT(templ, &tmpl, last_level);
+   MEMBER_UINT(templ, &tmpl, nr_samples);
+   MEMBER_UINT(templ, &tmpl, usage);
+   MEMBER_UINT(templ, &tmpl, bind);
+   MEMBER_UINT(templ, &tmpl, flags);
+
+   /* Nothing is presented, so these would only get in the way */
+   tmpl.bind &= ~(PIPE_BIND_DISPLAY_TARGET | PIPE_BIND_SCANOUT |
+                  PIPE_BIND_SHARED);
+
+   res = rp->screen->resource_create(rp->screen, &tmpl);
+   object_set(rp, value(rp, rp->call.ret), res);
+}
+
+
+static void
+replay_resource_destroy(struct replay *rp)
+{
+   struct pipe_resource *res = object(rp, arg(rp, "resource"));
+
+   pipe_resource_reference(&res, NULL);
+   object_remove(rp, arg(rp, "resource"));
+}
+
+
+static void
+replay_flush_frontbuffer(struct replay *rp)
+{
+   /* The frame ends after this call, see parse_frame() */
+}
+
+
+static void
+replay_destroy(struct replay *rp)
+{
+   struct replay_context *ctx;
+
+   if (strcmp(rp->call.klass, "pipe_context") != 0)
+      return;
+
+   ctx = context(rp);
+   if (!ctx)
+      return;
+
+   ctx->pipe->destroy(ctx->pipe);
+   object_remove(rp, value(rp, rp->call.args));
+   if (rp->last_ctx == ctx)
+      rp->last_ctx = NULL;
+   FREE(ctx);
+}
+
+
+/*
+ * pipe_context state objects
+ */
+
+
+static void
+replay_create_blend_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "state");
+   const struct value *rts = member(rp, state, "rt");
+   struct pipe_blend_state blend;
+   unsigned i;
+
+   if (!ctx)
+      return;
+
+   memset(&blend, 0, sizeof blend);
+   MEMBER_UINT(state, &blend, dither);
+   MEMBER_UINT(state, &blend, logicop_enable);
+   MEMBER_UINT(state, &blend, logicop_func);
+   MEMBER_UINT(state, &blend, independent_blend_enable);
+
+   for (i = 0; i < MIN2(num_elems(rp, rts), PIPE_MAX_COLOR_BUFS); ++i) {
+      const struct value *rt = elem(rp, rts, i);
+      MEMBER_UINT(rt, &blend.rt[i], blend_enable);
+      MEMBER_UINT(rt, &blend.rt[i], rgb_func);
+      MEMBER_UINT(rt, &blend.rt[i], rgb_src_factor);
+      MEMBER_UINT(rt, &blend.rt[i], rgb_dst_factor);
+      MEMBER_UINT(rt, &blend.rt[i], alpha_func);
+      MEMBER_UINT(rt, &blend.rt[i], alpha_src_factor);
+      MEMBER_UINT(rt, &blend.rt[i], alpha_dst_factor);
+      MEMBER_UINT(rt, &blend.rt[i], colormask);
+   }
+
+   object_set(rp, value(rp, rp->call.ret),
+              ctx->pipe->create_blend_state(ctx->pipe, &blend));
+}
+
+
+static void
+replay_create_sampler_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "state");
+   struct pipe_sampler_state sampler;
+
+   if (!ctx)
+      return;
+
+   memset(&sampler, 0, sizeof sampler);
+   MEMBER_UINT(state, &sampler, wrap_s);
+   MEMBER_UINT(state, &sampler, wrap_t);
+   MEMBER_UINT(state, &sampler, wrap_r);
+   MEMBER_UINT(state, &sampler, min_img_filter);
+   MEMBER_UINT(state, &sampler, min_mip_filter);
+   MEMBER_UINT(state, &sampler, mag_img_filter);
+   MEMBER_UINT(state, &sampler, compare_mode);
+   MEMBER_UINT(state, &sampler, compare_func);
+   MEMBER_UINT(state, &sampler, normalized_coords);
+   MEMBER_UINT(state, &sampler, max_anisotropy);
+   MEMBER_UINT(state, &sampler, seamless_cube_map);
+   MEMBER_FLOAT(state, &sampler, lod_bias);
+   MEMBER_FLOAT(state, &sampler, min_lod);
+   MEMBER_FLOAT(state, &sampler, max_lod);
+   MEMBER_FLOAT_ARRAY(state, &sampler, border_color.f, "border_color.f");
+
+   object_set(rp, value(rp, rp->call.ret),
+              ctx->pipe->create_sampler_state(ctx->pipe, &sampler));
+}
+
+
+static void
+replay_create_rasterizer_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "state");
+   struct pipe_rasterizer_state rast;
+
+   if (!ctx)
+      return;
+
+   memset(&rast, 0, sizeof rast);
+   MEMBER_UINT(state, &rast, flatshade);
+   MEMBER_UINT(state, &rast, light_twoside);
+   MEMBER_UINT(state, &rast, clamp_vertex_color);
+   MEMBER_UINT(state, &rast, clamp_fragment_color);
+   MEMBER_UINT(state, &rast, front_ccw);
+   MEMBER_UINT(state, &rast, cull_face);
+   MEMBER_UINT(state, &rast, fill_front);
+   MEMBER_UINT(state, &rast, fill_back);
+   MEMBER_UINT(state, &rast, offset_point);
+   MEMBER_UINT(state, &rast, offset_line);
+   MEMBER_UINT(state, &rast, offset_tri);
+   MEMBER_UINT(state, &rast, scissor);
+   MEMBER_UINT(state, &rast, poly_smooth);
+   MEMBER_UINT(state, &rast, poly_stipple_enable);
+   MEMBER_UINT(state, &rast, point_smooth);
+   MEMBER_UINT(state, &rast, sprite_coord_mode);
+   MEMBER_UINT(state, &rast, point_quad_rasterization);
+   MEMBER_UINT(state, &rast, point_size_per_vertex);
+   MEMBER_UINT(state, &rast, multisample);
+   MEMBER_UINT(state, &rast, line_smooth);
+   MEMBER_UINT(state, &rast, line_stipple_enable);
+   MEMBER_UINT(state, &rast, line_last_pixel);
+   MEMBER_UINT(state, &rast, flatshade_first);
+   MEMBER_UINT(state, &rast, half_pixel_center);
+   MEMBER_UINT(state, &rast, bottom_edge_rule);
+   MEMBER_UINT(state, &rast, rasterizer_discard);
+   MEMBER_UINT(state, &rast, depth_clip);
+   MEMBER_UINT(state, &rast, clip_halfz);
+   MEMBER_UINT(state, &rast, clip_plane_enable);
+   MEMBER_UINT(state, &rast, line_stipple_factor);
+   MEMBER_UINT(state, &rast, line_stipple_pattern);
+   MEMBER_UINT(state, &rast, sprite_coord_enable);
+   MEMBER_FLOAT(state, &rast, line_width);
+   MEMBER_FLOAT(state, &rast, point_size);
+   MEMBER_FLOAT(state, &rast, offset_units);
+   MEMBER_FLOAT(state, &rast, offset_scale);
+   MEMBER_FLOAT(state, &rast, offset_clamp);
+
+   object_set(rp, value(rp, rp->call.ret),
+              ctx->pipe->create_rasterizer_state(ctx->pipe, &rast));
+}
+
+
+static void
+replay_create_depth_stencil_alpha_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "state");
+   const struct value *depth = member(rp, state, "depth");
+   const struct value *stencils = member(rp, state, "stencil");
+   const struct value *alpha = member(rp, state, "alpha");
+   struct pipe_depth_stencil_alpha_state dsa;
+   unsigned i;
+
+   if (!ctx)
+      return;
+
+   memset(&dsa, 0, sizeof dsa);
+   MEMBER_UINT(depth, &dsa.depth, enabled);
+   MEMBER_UINT(depth, &dsa.depth, writemask);
+   MEMBER_UINT(depth, &dsa.depth, func);
+
+   for (i = 0; i < ARRAY_SIZE(dsa.stencil); ++i) {
+      const struct value *stencil = elem(rp, stencils, i);
+      MEMBER_UINT(stencil, &dsa.stencil[i], enabled);
+      MEMBER_UINT(stencil, &dsa.stencil[i], func);
+      MEMBER_UINT(stencil, &dsa.stencil[i], fail_op);
+      MEMBER_UINT(stencil, &dsa.stencil[i], zpass_op);
+      MEMBER_UINT(stencil, &dsa.stencil[i], zfail_op);
+      MEMBER_UINT(stencil, &dsa.stencil[i], valuemask);
+      MEMBER_UINT(stencil, &dsa.stencil[i], writemask);
+   }
+
+   MEMBER_UINT(alpha, &dsa.alpha, enabled);
+   MEMBER_UINT(alpha, &dsa.alpha, func);
+   MEMBER_FLOAT(alpha, &dsa.alpha, ref_value);
+
+   object_set(rp, value(rp, rp->call.ret),
+              ctx->pipe->create_depth_stencil_alpha_state(ctx->pipe, &dsa));
+}
+
+
+static void
+replay_create_shader_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const char *method = rp->reader.names[rp->call.method];
+   const struct value *state = arg(rp, "state");
+   const struct value *so = member(rp, state, "stream_output");
+   const struct value *outputs = member(rp, so, "output");
+   const char *text = string_of(rp, member(rp, state, "tokens"));
+   static struct tgsi_token tokens[MAX_TGSI_TOKENS];
+   struct pipe_shader_state shader;
+   void *result = NULL;
+   unsigned i;
+
+   if (!ctx || !text)
+      return;
+
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens))) {
+      fprintf(stderr, "call %u: failed to translate shader\n", rp->call.no);
+      return;
+   }
+
+   memset(&shader, 0, sizeof shader);
+   shader.type = PIPE_SHADER_IR_TGSI;
+   shader.tokens = tokens;
+   MEMBER_UINT(so, &shader.stream_output, num_outputs);
+   for (i = 0; i < PIPE_MAX_SO_BUFFERS; ++i)
+      shader.stream_output.stride[i] = uint_of(elem(rp, member(rp, so, "stride"), i));
+   for (i = 0; i < MIN2(num_elems(rp, outputs), PIPE_MAX_SO_OUTPUTS); ++i) {
+      const struct value *output = elem(rp, outputs, i);
+      MEMBER_UINT(output, &shader.stream_output.output[i], register_index);
+      MEMBER_UINT(output, &shader.stream_output.output[i], start_component);
+      MEMBER_UINT(output, &shader.stream_output.output[i], num_components);
+      MEMBER_UINT(output, &shader.stream_output.output[i], output_buffer);
+      MEMBER_UINT(output, &shader.stream_output.output[i], dst_offset);
+      MEMBER_UINT(output, &shader.stream_output.output[i], stream);
+   }
+
+   if (strcmp(method, "create_fs_state") == 0)
+      result = ctx->pipe->create_fs_state(ctx->pipe, &shader);
+   else if (strcmp(method, "create_vs_state") == 0)
+      result = ctx->pipe->create_vs_state(ctx->pipe, &shader);
+   else if (strcmp(method, "create_gs_state") == 0)
+      result = ctx->pipe->create_gs_state(ctx->pipe, &shader);
+   else if (strcmp(method, "create_tcs_state") == 0 &&
+            ctx->pipe->create_tcs_state)
+      result = ctx->pipe->create_tcs_state(ctx->pipe, &shader);
+   else if (strcmp(method, "create_tes_state") == 0 &&
+            ctx->pipe->create_tes_state)
+      result = ctx->pipe->create_tes_state(ctx->pipe, &shader);
+
+   object_set(rp, value(rp, rp->call.ret), result);
+}
+
+
+static void
+replay_create_vertex_elements_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *elements = arg(rp, "elements");
+   struct pipe_vertex_element velems[PIPE_MAX_ATTRIBS];
+   unsigned num = MIN2(num_elems(rp, elements), PIPE_MAX_ATTRIBS);
+   unsigned i;
+
+   if (!ctx)
+      return;
+
+   memset(velems, 0, sizeof velems);
+   for (i = 0; i < num; ++i) {
+      const struct value *velem = elem(rp, elements, i);
+      MEMBER_UINT(velem, &velems[i], src_offset);
+      MEMBER_UINT(velem, &velems[i], instance_divisor);
+      MEMBER_UINT(velem, &velems[i], vertex_buffer_index);
+      velems[i].src_format = format_of(member(rp, velem, "src_format"));
+   }
+
+   object_set(rp, value(rp, rp->call.ret),
+              ctx->pipe->create_vertex_elements_state(ctx->pipe, num, velems));
+}
+
+
+/**
+ * All bind_*_state calls take a single state object.
+ */
+static void
+replay_bind_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const char *method = rp->reader.names[rp->call.method];
+   struct pipe_context *pipe;
+   void *state = object(rp, arg(rp, "state"));
+
+   if (!ctx)
+      return;
+   pipe = ctx->pipe;
+
+   if (strcmp(method, "bind_blend_state") == 0)
+      pipe->bind_blend_state(pipe, state);
+   else if (strcmp(method, "bind_rasterizer_state") == 0)
+      pipe->bind_rasterizer_state(pipe, state);
+   else if (strcmp(method, "bind_depth_stencil_alpha_state") == 0)
+      pipe->bind_depth_stencil_alpha_state(pipe, state);
+   else if (strcmp(method, "bind_vertex_elements_state") == 0)
+      pipe->bind_vertex_elements_state(pipe, state);
+   else if (strcmp(method, "bind_fs_state") == 0)
+      pipe->bind_fs_state(pipe, state);
+   else if (strcmp(method, "bind_vs_state") == 0)
+      pipe->bind_vs_state(pipe, state);
+   else if (strcmp(method, "bind_gs_state") == 0)
+      pipe->bind_gs_state(pipe, state);
+   else if (strcmp(method, "bind_tcs_state") == 0 && pipe->bind_tcs_state)
+      pipe->bind_tcs_state(pipe, state);
+   else if (strcmp(method, "bind_tes_state") == 0 && pipe->bind_tes_state)
+      pipe->bind_tes_state(pipe, state);
+}
+
+
+static void
+replay_delete_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const char *method = rp->reader.names[rp->call.method];
+   struct pipe_context *pipe;
+   void *state = object(rp, arg(rp, "state"));
+
+   if (!ctx || !state)
+      return;
+   pipe = ctx->pipe;
+
+   if (strcmp(method, "delete_blend_state") == 0)
+      pipe->delete_blend_state(pipe, state);
+   else if (strcmp(method, "delete_sampler_state") == 0)
+      pipe->delete_sampler_state(pipe, state);
+   else if (strcmp(method, "delete_rasterizer_state") == 0)
+      pipe->delete_rasterizer_state(pipe, state);
+   else if (strcmp(method, "delete_depth_stencil_alpha_state") == 0)
+      pipe->delete_depth_stencil_alpha_state(pipe, state);
+   else if (strcmp(method, "delete_vertex_elements_state") == 0)
+      pipe->delete_vertex_elements_state(pipe, state);
+   else if (strcmp(method, "delete_fs_state") == 0)
+      pipe->delete_fs_state(pipe, state);
+   else if (strcmp(method, "delete_vs_state") == 0)
+      pipe->delete_vs_state(pipe, state);
+   else if (strcmp(method, "delete_gs_state") == 0)
+      pipe->delete_gs_state(pipe, state);
+   else if (strcmp(method, "delete_tcs_state") == 0)
+      pipe->delete_tcs_state(pipe, state);
+   else if (strcmp(method, "delete_tes_state") == 0)
+      pipe->delete_tes_state(pipe, state);
+
+   object_remove(rp, arg(rp, "state"));
+}
+
+
+static void
+replay_bind_sampler_states(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *states = arg(rp, "states");
+   void *samplers[PIPE_MAX_SAMPLERS];
+   unsigned start = uint_of(arg(rp, "start"));
+   unsigned num = uint_of(arg(rp, "num_states"));
+   unsigned i;
+
+   if (!ctx || start + num > PIPE_MAX_SAMPLERS)
+      return;
+
+   for (i = 0; i < num; ++i)
+      samplers[i] = object(rp, elem(rp, states, i));
+
+   ctx->pipe->bind_sampler_states(ctx->pipe, uint_of(arg(rp, "shader")),
+                                  start, num,
+                                  states->type == TRACE_BIN_NULL ?
+                                  NULL : samplers);
+}
+
+
+/*
+ * pipe_context parameters
+ */
+
+
+static void
+replay_set_blend_color(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_blend_color color;
+
+   if (!ctx)
+      return;
+
+   MEMBER_FLOAT_ARRAY(arg(rp, "state"), &color, color, "color");
+   ctx->pipe->set_blend_color(ctx->pipe, &color);
+}
+
+
+static void
+replay_set_stencil_ref(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *values = member(rp, arg(rp, "state"), "ref_value");
+   struct pipe_stencil_ref ref;
+   unsigned i;
+
+   if (!ctx)
+      return;
+
+   for (i = 0; i < ARRAY_SIZE(ref.ref_value); ++i)
+      ref.ref_value[i] = uint_of(elem(rp, values, i));
+   ctx->pipe->set_stencil_ref(ctx->pipe, &ref);
+}
+
+
+static void
+replay_set_sample_mask(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+
+   if (ctx)
+      ctx->pipe->set_sample_mask(ctx->pipe, uint_of(arg(rp, "sample_mask")));
+}
+
+
+static void
+replay_set_clip_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *ucps = member(rp, arg(rp, "state"), "ucp");
+   struct pipe_clip_state clip;
+   unsigned i, j;
+
+   if (!ctx)
+      return;
+
+   for (i = 0; i < PIPE_MAX_CLIP_PLANES; ++i)
+      for (j = 0; j < 4; ++j)
+         clip.ucp[i][j] = float_of(elem(rp, elem(rp, ucps, i), j));
+   ctx->pipe->set_clip_state(ctx->pipe, &clip);
+}
+
+
+static void
+replay_set_polygon_stipple(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *values = member(rp, arg(rp, "state"), "stipple");
+   struct pipe_poly_stipple stipple;
+   unsigned i;
+
+   if (!ctx)
+      return;
+
+   for (i = 0; i < ARRAY_SIZE(stipple.stipple); ++i)
+      stipple.stipple[i] = uint_of(elem(rp, values, i));
+   ctx->pipe->set_polygon_stipple(ctx->pipe, &stipple);
+}
+
+
+/* Only the first of several scissors and viewports is traced */
+
+static void
+replay_set_scissor_states(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "states");
+   struct pipe_scissor_state scissor;
+
+   if (!ctx || state->type != TRACE_BIN_STRUCT_BEGIN)
+      return;
+
+   MEMBER_UINT(state, &scissor, minx);
+   MEMBER_UINT(state, &scissor, miny);
+   MEMBER_UINT(state, &scissor, maxx);
+   MEMBER_UINT(state, &scissor, maxy);
+   ctx->pipe->set_scissor_states(ctx->pipe, uint_of(arg(rp, "start_slot")),
+                                 1, &scissor);
+}
+
+
+static void
+replay_set_viewport_states(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "states");
+   struct pipe_viewport_state viewport;
+
+   if (!ctx || state->type != TRACE_BIN_STRUCT_BEGIN)
+      return;
+
+   MEMBER_FLOAT_ARRAY(state, &viewport, scale, "scale");
+   MEMBER_FLOAT_ARRAY(state, &viewport, translate, "translate");
+   ctx->pipe->set_viewport_states(ctx->pipe, uint_of(arg(rp, "start_slot")),
+                                  1, &viewport);
+}
+
+
+static void
+replay_set_constant_buffer(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "constant_buffer");
+   const struct value *user = member(rp, state, "user_buffer");
+   struct pipe_constant_buffer cb;
+
+   if (!ctx)
+      return;
+
+   if (state->type != TRACE_BIN_STRUCT_BEGIN) {
+      ctx->pipe->set_constant_buffer(ctx->pipe, uint_of(arg(rp, "shader")),
+                                     uint_of(arg(rp, "index")), NULL);
+      return;
+   }
+
+   memset(&cb, 0, sizeof cb);
+   cb.buffer = object(rp, member(rp, state, "buffer"));
+   MEMBER_UINT(state, &cb, buffer_offset);
+   MEMBER_UINT(state, &cb, buffer_size);
+   if (user->type == TRACE_BIN_BYTES)
+      cb.user_buffer = user->u.bytes.data;
+
+   ctx->pipe->set_constant_buffer(ctx->pipe, uint_of(arg(rp, "shader")),
+                                  uint_of(arg(rp, "index")), &cb);
+}
+
+
+static void
+replay_set_framebuffer_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "state");
+   const struct value *cbufs = member(rp, state, "cbufs");
+   struct pipe_framebuffer_state fb;
+   unsigned i;
+
+   if (!ctx)
+      return;
+
+   memset(&fb, 0, sizeof fb);
+   MEMBER_UINT(state, &fb, width);
+   MEMBER_UINT(state, &fb, height);
+   MEMBER_UINT(state, &fb, samples);
+   MEMBER_UINT(state, &fb, layers);
+   MEMBER_UINT(state, &fb, nr_cbufs);
+   fb.nr_cbufs = MIN2(fb.nr_cbufs, PIPE_MAX_COLOR_BUFS);
+   for (i = 0; i < fb.nr_cbufs; ++i)
+      fb.cbufs[i] = object(rp, elem(rp, cbufs, i));
+   fb.zsbuf = object(rp, member(rp, state, "zsbuf"));
+
+   ctx->pipe->set_framebuffer_state(ctx->pipe, &fb);
+}
+
+
+static void
+replay_set_vertex_buffers(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *buffers = arg(rp, "buffers");
+   struct pipe_vertex_buffer vbs[PIPE_MAX_ATTRIBS];
+   unsigned start = uint_of(arg(rp, "start_slot"));
+   unsigned num = uint_of(arg(rp, "num_buffers"));
+   unsigned i;
+
+   if (!ctx || start + num > PIPE_MAX_ATTRIBS)
+      return;
+
+   memset(vbs, 0, sizeof vbs);
+   for (i = 0; i < num; ++i) {
+      const struct value *vb = elem(rp, buffers, i);
+      unsigned slot = 1u << (start + i);
+
+      MEMBER_UINT(vb, &vbs[i], stride);
+      MEMBER_UINT(vb, &vbs[i], buffer_offset);
+      vbs[i].buffer = object(rp, member(rp, vb, "buffer"));
+      ctx->vertex_buffers[start + i] = vbs[i];
+
+      /* The contents of user memory are recorded with each draw */
+      if (member(rp, vb, "user_buffer")->type == TRACE_BIN_PTR)
+         ctx->user_vertex_buffers |= slot;
+      else
+         ctx->user_vertex_buffers &= ~slot;
+   }
+
+   ctx->pipe->set_vertex_buffers(ctx->pipe, start, num,
+                                 buffers->type == TRACE_BIN_NULL ? NULL : vbs);
+}
+
+
+static void
+replay_set_index_buffer(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "ib");
+   struct pipe_index_buffer ib;
+
+   if (!ctx)
+      return;
+
+   ctx->user_index_buffer = FALSE;
+   memset(&ctx->index_buffer, 0, sizeof ctx->index_buffer);
+
+   if (state->type != TRACE_BIN_STRUCT_BEGIN) {
+      ctx->pipe->set_index_buffer(ctx->pipe, NULL);
+      return;
+   }
+
+   memset(&ib, 0, sizeof ib);
+   MEMBER_UINT(state, &ib, index_size);
+   MEMBER_UINT(state, &ib, offset);
+   ib.buffer = object(rp, member(rp, state, "buffer"));
+   if (member(rp, state, "user_buffer")->type == TRACE_BIN_PTR)
+      ctx->user_index_buffer = TRUE;
+   ctx->index_buffer = ib;
+
+   ctx->pipe->set_index_buffer(ctx->pipe, &ib);
+}
+
+
+static void
+replay_set_tess_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   float outer[4], inner[2];
+   unsigned i;
+
+   if (!ctx || !ctx->pipe->set_tess_state)
+      return;
+
+   for (i = 0; i < 4; ++i)
+      outer[i] = float_of(elem(rp, arg(rp, "default_outer_level"), i));
+   for (i = 0; i < 2; ++i)
+      inner[i] = float_of(elem(rp, arg(rp, "default_inner_level"), i));
+   ctx->pipe->set_tess_state(ctx->pipe, outer, inner);
+}
+
+
+/*
+ * Views and surfaces
+ */
+
+
+static void
+replay_create_sampler_view(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_resource *res = object(rp, arg(rp, "resource"));
+   const struct value *templ = arg(rp, "templ");
+   const struct value *u = member(rp, templ, "u");
+   struct pipe_sampler_view tmpl;
+
+   if (!ctx || !res)
+      return;
+
+   memset(&tmpl, 0, sizeof tmpl);
+   tmpl.target = res->target;
+   if (member(rp, templ, "target")->type != TRACE_BIN_NULL)
+      MEMBER_UINT(templ, &tmpl, target);
+   tmpl.format = format_of(member(rp, templ, "format"));
+   if (res->target == PIPE_BUFFER) {
+      const struct value *buf = member(rp, u, "buf");
+      MEMBER_UINT(buf, &tmpl.u.buf, offset);
+      MEMBER_UINT(buf, &tmpl.u.buf, size);
+   } else {
+      const struct value *tex = member(rp, u, "tex");
+      MEMBER_UINT(tex, &tmpl.u.tex, first_layer);
+      MEMBER_UINT(tex, &tmpl.u.tex, last_layer);
+      MEMBER_UINT(tex, &tmpl.u.tex, first_level);
+      MEMBER_UINT(tex, &tmpl.u.tex, last_level);
+   }
+   MEMBER_UINT(templ, &tmpl, swizzle_r);
+   MEMBER_UINT(templ, &tmpl, swizzle_g);
+   MEMBER_UINT(templ, &tmpl, swizzle_b);
+   MEMBER_UINT(templ, &tmpl, swizzle_a);
+
+   object_set(rp, value(rp, rp->call.ret),
+              ctx->pipe->create_sampler_view(ctx->pipe, res, &tmpl));
+}
+
+
+static void
+replay_sampler_view_destroy(struct replay *rp)
+{
+   struct pipe_sampler_view *view = object(rp, arg(rp, "view"));
+
+   pipe_sampler_view_reference(&view, NULL);
+   object_remove(rp, arg(rp, "view"));
+}
+
+
+static void
+replay_set_sampler_views(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *views = arg(rp, "views");
+   struct pipe_sampler_view *sviews[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   unsigned start = uint_of(arg(rp, "start"));
+   unsigned num = uint_of(arg(rp, "num"));
+   unsigned i;
+
+   if (!ctx || start + num > PIPE_MAX_SHADER_SAMPLER_VIEWS)
+      return;
+
+   for (i = 0; i < num; ++i)
+      sviews[i] = object(rp, elem(rp, views, i));
+
+   ctx->pipe->set_sampler_views(ctx->pipe, uint_of(arg(rp, "shader")),
+                                start, num,
+                                views->type == TRACE_BIN_NULL ? NULL : sviews);
+}
+
+
+static void
+replay_create_surface(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_resource *res = object(rp, arg(rp, "resource"));
+   const struct value *templ = arg(rp, "surf_tmpl");
+   const struct value *u = member(rp, templ, "u");
+   struct pipe_surface tmpl;
+
+   if (!ctx || !res)
+      return;
+
+   memset(&tmpl, 0, sizeof tmpl);
+   tmpl.format = format_of(member(rp, templ, "format"));
+   MEMBER_UINT(templ, &tmpl, width);
+   MEMBER_UINT(templ, &tmpl, height);
+   if (res->target == PIPE_BUFFER) {
+      const struct value *buf = member(rp, u, "buf");
+      MEMBER_UINT(buf, &tmpl.u.buf, first_element);
+      MEMBER_UINT(buf, &tmpl.u.buf, last_element);
+   } else {
+      const struct value *tex = member(rp, u, "tex");
+      MEMBER_UINT(tex, &tmpl.u.tex, level);
+      MEMBER_UINT(tex, &tmpl.u.tex, first_layer);
+      MEMBER_UINT(tex, &tmpl.u.tex, last_layer);
+   }
+
+   object_set(rp, value(rp, rp->call.ret),
+              ctx->pipe->create_surface(ctx->pipe, res, &tmpl));
+}
+
+
+static void
+replay_surface_destroy(struct replay *rp)
+{
+   struct pipe_surface *surf = object(rp, arg(rp, "surface"));
+
+   pipe_surface_reference(&surf, NULL);
+   object_remove(rp, arg(rp, "surface"));
+}
+
+
+/*
+ * Stream output
+ */
+
+
+static void
+replay_create_stream_output_target(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_resource *res = object(rp, arg(rp, "res"));
+
+   if (!ctx || !res)
+      return;
+
+   object_set(rp, value(rp, rp->call.ret),
+              ctx->pipe->create_stream_output_target(
+                 ctx->pipe, res,
+                 uint_of(arg(rp, "buffer_offset")),
+                 uint_of(arg(rp, "buffer_size"))));
+}
+
+
+static void
+replay_stream_output_target_destroy(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_stream_output_target *target = object(rp, arg(rp, "target"));
+
+   if (!ctx || !target)
+      return;
+
+   pipe_so_target_reference(&target, NULL);
+   object_remove(rp, arg(rp, "target"));
+}
+
+
+static void
+replay_set_stream_output_targets(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_stream_output_target *targets[PIPE_MAX_SO_BUFFERS];
+   unsigned offsets[PIPE_MAX_SO_BUFFERS];
+   unsigned num = uint_of(arg(rp, "num_targets"));
+   unsigned i;
+
+   if (!ctx || num > PIPE_MAX_SO_BUFFERS)
+      return;
+
+   for (i = 0; i < num; ++i) {
+      targets[i] = object(rp, elem(rp, arg(rp, "tgs"), i));
+      offsets[i] = uint_of(elem(rp, arg(rp, "offsets"), i));
+   }
+
+   ctx->pipe->set_stream_output_targets(ctx->pipe, num, targets, offsets);
+}
+
+
+/*
+ * Queries
+ */
+
+
+static void
+replay_create_query(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *type = arg(rp, "query_type");
+   unsigned i;
+
+   if (!ctx || type->type != TRACE_BIN_ENUM)
+      return;
+
+   for (i = 0; i < PIPE_QUERY_TYPES; ++i) {
+      if (strcmp(util_dump_query_type(i, FALSE), type->u.enum_name) == 0) {
+         object_set(rp, value(rp, rp->call.ret),
+                    ctx->pipe->create_query(ctx->pipe, i,
+                                            uint_of(arg(rp, "index"))));
+         return;
+      }
+   }
+}
+
+
+static void
+replay_destroy_query(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_query *query = object(rp, arg(rp, "query"));
+
+   if (!ctx || !query)
+      return;
+
+   ctx->pipe->destroy_query(ctx->pipe, query);
+   object_remove(rp, arg(rp, "query"));
+}
+
+
+static void
+replay_begin_query(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_query *query = object(rp, arg(rp, "query"));
+
+   if (ctx && query)
+      ctx->pipe->begin_query(ctx->pipe, query);
+}
+
+
+static void
+replay_end_query(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_query *query = object(rp, arg(rp, "query"));
+
+   if (ctx && query)
+      ctx->pipe->end_query(ctx->pipe, query);
+}
+
+
+static void
+replay_get_query_result(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_query *query = object(rp, arg(rp, "query"));
+   union pipe_query_result result;
+
+   /* Whether the caller waited isn't traced; the result was ready, though */
+   if (ctx && query)
+      ctx->pipe->get_query_result(ctx->pipe, query, TRUE, &result);
+}
+
+
+static void
+replay_render_condition(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+
+   if (ctx)
+      ctx->pipe->render_condition(ctx->pipe,
+                                  object(rp, arg(rp, "query")),
+                                  uint_of(arg(rp, "condition")),
+                                  uint_of(arg(rp, "mode")));
+}
+
+
+static void
+replay_set_active_query_state(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+
+   if (ctx && ctx->pipe->set_active_query_state)
+      ctx->pipe->set_active_query_state(ctx->pipe,
+                                        uint_of(arg(rp, "enable")));
+}
+
+
+/*
+ * Rendering
+ */
+
+
+/**
+ * Find the recorded user memory of a vertex buffer slot, or of the index
+ * buffer, and return a pointer which addresses it like the original one.
+ */
+static const void *
+user_memory(const struct replay *rp, const struct value *list, unsigned index)
+{
+   unsigned i, num = num_elems(rp, list);
+
+   for (i = 0; i < num; ++i) {
+      const struct value *mem = elem(rp, list, i);
+      const struct value *data = member(rp, mem, "data");
+
+      if (uint_of(member(rp, mem, "index")) == index &&
+          data->type == TRACE_BIN_BYTES)
+         return data->u.bytes.data - uint_of(member(rp, mem, "offset"));
+   }
+
+   return NULL;
+}
+
+
+static void
+replay_draw_vbo(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "info");
+   const struct value *user_vbs = arg(rp, "user_vertex_buffers");
+   struct pipe_draw_info info;
+   unsigned mask;
+
+   if (!ctx)
+      return;
+
+   memset(&info, 0, sizeof info);
+   MEMBER_UINT(state, &info, indexed);
+   MEMBER_UINT(state, &info, mode);
+   MEMBER_UINT(state, &info, start);
+   MEMBER_UINT(state, &info, count);
+   MEMBER_UINT(state, &info, start_instance);
+   MEMBER_UINT(state, &info, instance_count);
+   MEMBER_UINT(state, &info, vertices_per_patch);
+   MEMBER_UINT(state, &info, index_bias);
+   MEMBER_UINT(state, &info, min_index);
+   MEMBER_UINT(state, &info, max_index);
+   MEMBER_UINT(state, &info, primitive_restart);
+   MEMBER_UINT(state, &info, restart_index);
+
+   if (member(rp, state, "indirect")->type == TRACE_BIN_PTR ||
+       member(rp, state, "count_from_stream_output")->type == TRACE_BIN_PTR) {
+      rp->skipped_draws++;
+      return;
+   }
+
+   /* Point user buffers at the memory recorded with the draw.  The driver
+    * only reads the recorded range.
+    */
+   mask = ctx->user_vertex_buffers;
+   while (mask) {
+      unsigned slot = u_bit_scan(&mask);
+      struct pipe_vertex_buffer vb = ctx->vertex_buffers[slot];
+
+      vb.user_buffer = user_memory(rp, user_vbs, slot);
+      if (!vb.user_buffer) {
+         rp->skipped_draws++;
+         return;
+      }
+      ctx->pipe->set_vertex_buffers(ctx->pipe, slot, 1, &vb);
+   }
+   if (info.indexed && ctx->user_index_buffer) {
+      struct pipe_index_buffer ib = ctx->index_buffer;
+
+      ib.user_buffer = user_memory(rp, arg(rp, "user_index_buffer"), 0);
+      if (!ib.user_buffer) {
+         rp->skipped_draws++;
+         return;
+      }
+      ctx->pipe->set_index_buffer(ctx->pipe, &ib);
+   }
+
+   ctx->pipe->draw_vbo(ctx->pipe, &info);
+}
+
+
+static void
+replay_clear(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *values = arg(rp, "color");
+   union pipe_color_union color;
+   unsigned i;
+
+   if (!ctx)
+      return;
+
+   for (i = 0; i < 4; ++i)
+      color.f[i] = float_of(elem(rp, values, i));
+
+   ctx->pipe->clear(ctx->pipe, uint_of(arg(rp, "buffers")),
+                    values->type == TRACE_BIN_NULL ? NULL : &color,
+                    float_of(arg(rp, "depth")), uint_of(arg(rp, "stencil")));
+}
+
+
+static void
+replay_clear_render_target(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_surface *dst = object(rp, arg(rp, "dst"));
+   union pipe_color_union color;
+   unsigned i;
+
+   if (!ctx || !dst)
+      return;
+
+   for (i = 0; i < 4; ++i)
+      color.f[i] = float_of(elem(rp, arg(rp, "color->f"), i));
+
+   ctx->pipe->clear_render_target(ctx->pipe, dst, &color,
+                                  uint_of(arg(rp, "dstx")),
+                                  uint_of(arg(rp, "dsty")),
+                                  uint_of(arg(rp, "width")),
+                                  uint_of(arg(rp, "height")),
+                                  uint_of(arg(rp, "render_condition_enabled")));
+}
+
+
+static void
+replay_clear_depth_stencil(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_surface *dst = object(rp, arg(rp, "dst"));
+
+   if (!ctx || !dst)
+      return;
+
+   ctx->pipe->clear_depth_stencil(ctx->pipe, dst,
+                                  uint_of(arg(rp, "clear_flags")),
+                                  float_of(arg(rp, "depth")),
+                                  uint_of(arg(rp, "stencil")),
+                                  uint_of(arg(rp, "dstx")),
+                                  uint_of(arg(rp, "dsty")),
+                                  uint_of(arg(rp, "width")),
+                                  uint_of(arg(rp, "height")),
+                                  uint_of(arg(rp, "render_condition_enabled")));
+}
+
+
+static void
+replay_resource_copy_region(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_resource *dst = object(rp, arg(rp, "dst"));
+   struct pipe_resource *src = object(rp, arg(rp, "src"));
+   struct pipe_box box;
+
+   if (!ctx || !dst || !src)
+      return;
+
+   box_of(rp, arg(rp, "src_box"), &box);
+   ctx->pipe->resource_copy_region(ctx->pipe, dst,
+                                   uint_of(arg(rp, "dst_level")),
+                                   uint_of(arg(rp, "dstx")),
+                                   uint_of(arg(rp, "dsty")),
+                                   uint_of(arg(rp, "dstz")),
+                                   src, uint_of(arg(rp, "src_level")), &box);
+}
+
+
+static void
+replay_blit(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   const struct value *state = arg(rp, "_info");
+   const struct value *dst = member(rp, state, "dst");
+   const struct value *src = member(rp, state, "src");
+   const struct value *scissor = member(rp, state, "scissor");
+   const char *mask = string_of(rp, member(rp, state, "mask"));
+   struct pipe_blit_info info;
+
+   if (!ctx)
+      return;
+
+   memset(&info, 0, sizeof info);
+   info.dst.resource = object(rp, member(rp, dst, "resource"));
+   MEMBER_UINT(dst, &info.dst, level);
+   info.dst.format = format_of(member(rp, dst, "format"));
+   box_of(rp, member(rp, dst, "box"), &info.dst.box);
+   info.src.resource = object(rp, member(rp, src, "resource"));
+   MEMBER_UINT(src, &info.src, level);
+   info.src.format = format_of(member(rp, src, "format"));
+   box_of(rp, member(rp, src, "box"), &info.src.box);
+
+   if (mask && strlen(mask) == 6) {
+      info.mask |= mask[0] == 'R' ? PIPE_MASK_R : 0;
+      info.mask |= mask[1] == 'G' ? PIPE_MASK_G : 0;
+      info.mask |= mask[2] == 'B' ? PIPE_MASK_B : 0;
+      info.mask |= mask[3] == 'A' ? PIPE_MASK_A : 0;
+      info.mask |= mask[4] == 'Z' ? PIPE_MASK_Z : 0;
+      info.mask |= mask[5] == 'S' ? PIPE_MASK_S : 0;
+   }
+   MEMBER_UINT(state, &info, filter);
+   MEMBER_UINT(state, &info, scissor_enable);
+   MEMBER_UINT(scissor, &info.scissor, minx);
+   MEMBER_UINT(scissor, &info.scissor, miny);
+   MEMBER_UINT(scissor, &info.scissor, maxx);
+   MEMBER_UINT(scissor, &info.scissor, maxy);
+
+   if (!info.dst.resource || !info.src.resource)
+      return;
+
+   ctx->pipe->blit(ctx->pipe, &info);
+}
+
+
+static void
+replay_flush_resource(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_resource *res = object(rp, arg(rp, "resource"));
+
+   if (ctx && res && ctx->pipe->flush_resource)
+      ctx->pipe->flush_resource(ctx->pipe, res);
+}
+
+
+static void
+replay_generate_mipmap(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_resource *res = object(rp, arg(rp, "res"));
+
+   if (!ctx || !res || !ctx->pipe->generate_mipmap)
+      return;
+
+   ctx->pipe->generate_mipmap(ctx->pipe, res,
+                              format_of(arg(rp, "format")),
+                              uint_of(arg(rp, "base_level")),
+                              uint_of(arg(rp, "last_level")),
+                              uint_of(arg(rp, "first_layer")),
+                              uint_of(arg(rp, "last_layer")));
+}
+
+
+static void
+replay_texture_barrier(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+
+   if (ctx && ctx->pipe->texture_barrier)
+      ctx->pipe->texture_barrier(ctx->pipe);
+}
+
+
+static void
+replay_memory_barrier(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+
+   if (ctx && ctx->pipe->memory_barrier)
+      ctx->pipe->memory_barrier(ctx->pipe, uint_of(arg(rp, "flags")));
+}
+
+
+static void
+replay_flush(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   unsigned flags = uint_of(arg(rp, "flags"));
+
+   /* frame_end() flushes at the end of frames, see parse_frame() */
+   if (!ctx || (flags & PIPE_FLUSH_END_OF_FRAME))
+      return;
+
+   ctx->pipe->flush(ctx->pipe, NULL, flags);
+}
+
+
+/*
+ * Uploads
+ */
+
+
+/* The rest of the usage bits describe the original mapping, not the upload */
+#define UPLOAD_USAGE_MASK (PIPE_TRANSFER_WRITE | \
+                           PIPE_TRANSFER_DISCARD_RANGE | \
+                           PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE | \
+                           PIPE_TRANSFER_UNSYNCHRONIZED)
+
+
+static void
+replay_buffer_subdata(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_resource *res = object(rp, arg(rp, "resource"));
+   const struct value *data = arg(rp, "data");
+   const struct value *box = arg(rp, "box");
+   unsigned usage = uint_of(arg(rp, "usage"));
+   unsigned offset, size;
+
+   if (!ctx || !res || data->type != TRACE_BIN_BYTES)
+      return;
+
+   /* Unmapped write transfers are traced with a box instead */
+   if (box->type == TRACE_BIN_STRUCT_BEGIN) {
+      offset = uint_of(member(rp, box, "x"));
+      size = uint_of(member(rp, box, "width"));
+   } else {
+      offset = uint_of(arg(rp, "offset"));
+      size = uint_of(arg(rp, "size"));
+   }
+   size = MIN2(size, data->u.bytes.size);
+
+   ctx->pipe->buffer_subdata(ctx->pipe, res,
+                             (usage & UPLOAD_USAGE_MASK) | PIPE_TRANSFER_WRITE,
+                             offset, size, data->u.bytes.data);
+}
+
+
+static void
+replay_texture_subdata(struct replay *rp)
+{
+   struct replay_context *ctx = context(rp);
+   struct pipe_resource *res = object(rp, arg(rp, "resource"));
+   const struct value *data = arg(rp, "data");
+   unsigned usage = uint_of(arg(rp, "usage"));
+   struct pipe_box box;
+
+   /* Empty unless the trace was taken in the binary format */
+   if (!ctx || !res || data->type != TRACE_BIN_BYTES ||
+       !data->u.bytes.size)
+      return;
+
+   box_of(rp, arg(rp, "box"), &box);
+   ctx->pipe->texture_subdata(ctx->pipe, res, uint_of(arg(rp, "level")),
+                              (usage & UPLOAD_USAGE_MASK) |
+                              PIPE_TRANSFER_WRITE,
+                              &box, data->u.bytes.data,
+                              uint_of(arg(rp, "stride")),
+                              uint_of(arg(rp, "layer_stride")));
+}
+
+
+/*
+ * Dispatch
+ */
+
+
+static void
+replay_ignore(struct replay *rp)
+{
+}
+
+
+static const struct {
+   const char *method;
+   void (*handler)(struct replay *rp);
+} replay_handlers[] = {
+   /* pipe_screen */
+   { "context_create", replay_context_create },
+   { "resource_create", replay_resource_create },
+   { "resource_from_handle", replay_resource_create },
+   { "resource_destroy", replay_resource_destroy },
+   { "flush_frontbuffer", replay_flush_frontbuffer },
+   { "destroy", replay_destroy },
+
+   /* Queries of the screen and fences have no effect on the replay */
+   { "pipe_screen_create", replay_ignore },
+   { "get_name", replay_ignore },
+   { "get_vendor", replay_ignore },
+   { "get_device_vendor", replay_ignore },
+   { "get_param", replay_ignore },
+   { "get_shader_param", replay_ignore },
+   { "get_paramf", replay_ignore },
+   { "get_compute_param", replay_ignore },
+   { "is_format_supported", replay_ignore },
+   { "fence_reference", replay_ignore },
+   { "fence_finish", replay_ignore },
+   { "get_timestamp", replay_ignore },
+
+   /* pipe_context */
+   { "create_blend_state", replay_create_blend_state },
+   { "bind_blend_state", replay_bind_state },
+   { "delete_blend_state", replay_delete_state },
+   { "create_sampler_state", replay_create_sampler_state },
+   { "bind_sampler_states", replay_bind_sampler_states },
+   { "delete_sampler_state", replay_delete_state },
+   { "create_rasterizer_state", replay_create_rasterizer_state },
+   { "bind_rasterizer_state", replay_bind_state },
+   { "delete_rasterizer_state", replay_delete_state },
+   { "create_depth_stencil_alpha_state", replay_create_depth_stencil_alpha_state },
+   { "bind_depth_stencil_alpha_state", replay_bind_state },
+   { "delete_depth_stencil_alpha_state", replay_delete_state },
+   { "create_fs_state", replay_create_shader_state },
+   { "bind_fs_state", replay_bind_state },
+   { "delete_fs_state", replay_delete_state },
+   { "create_vs_state", replay_create_shader_state },
+   { "bind_vs_state", replay_bind_state },
+   { "delete_vs_state", replay_delete_state },
+   { "create_gs_state", replay_create_shader_state },
+   { "bind_gs_state", replay_bind_state },
+   { "delete_gs_state", replay_delete_state },
+   { "create_tcs_state", replay_create_shader_state },
+   { "bind_tcs_state", replay_bind_state },
+   { "delete_tcs_state", replay_delete_state },
+   { "create_tes_state", replay_create_shader_state },
+   { "bind_tes_state", replay_bind_state },
+   { "delete_tes_state", replay_delete_state },
+   { "create_vertex_elements_state", replay_create_vertex_elements_state },
+   { "bind_vertex_elements_state", replay_bind_state },
+   { "delete_vertex_elements_state", replay_delete_state },
+   { "set_blend_color", replay_set_blend_color },
+   { "set_stencil_ref", replay_set_stencil_ref },
+   { "set_sample_mask", replay_set_sample_mask },
+   { "set_clip_state", replay_set_clip_state },
+   { "set_constant_buffer", replay_set_constant_buffer },
+   { "set_framebuffer_state", replay_set_framebuffer_state },
+   { "set_polygon_stipple", replay_set_polygon_stipple },
+   { "set_scissor_states", replay_set_scissor_states },
+   { "set_viewport_states", replay_set_viewport_states },
+   { "set_vertex_buffers", replay_set_vertex_buffers },
+   { "set_index_buffer", replay_set_index_buffer },
+   { "set_tess_state", replay_set_tess_state },
+   { "create_sampler_view", replay_create_sampler_view },
+   { "sampler_view_destroy", replay_sampler_view_destroy },
+   { "set_sampler_views", replay_set_sampler_views },
+   { "create_surface", replay_create_surface },
+   { "surface_destroy", replay_surface_destroy },
+   { "create_stream_output_target", replay_create_stream_output_target },
+   { "stream_output_target_destroy", replay_stream_output_target_destroy },
+   { "set_stream_output_targets", replay_set_stream_output_targets },
+   { "create_query", replay_create_query },
+   { "destroy_query", replay_destroy_query },
+   { "begin_query", replay_begin_query },
+   { "end_query", replay_end_query },
+   { "get_query_result", replay_get_query_result },
+   { "render_condition", replay_render_condition },
+   { "set_active_query_state", replay_set_active_query_state },
+   { "draw_vbo", replay_draw_vbo },
+   { "clear", replay_clear },
+   { "clear_render_target", replay_clear_render_target },
+   { "clear_depth_stencil", replay_clear_depth_stencil },
+   { "resource_copy_region", replay_resource_copy_region },
+   { "blit", replay_blit },
+   { "flush_resource", replay_flush_resource },
+   { "generate_mipmap", replay_generate_mipmap },
+   { "texture_barrier", replay_texture_barrier },
+   { "memory_barrier", replay_memory_barrier },
+   { "flush", replay_flush },
+   { "buffer_subdata", replay_buffer_subdata },
+   { "texture_subdata", replay_texture_subdata },
+};
+
+
+static void
+replay_call(struct replay *rp)
+{
+   unsigned method = rp->call.method;
+
+   if (method >= rp->num_handlers) {
+      unsigned old = rp->num_handlers;
+      unsigned num = rp->reader.num_names;
+
+      rp->handlers = realloc(rp->handlers, num * sizeof *rp->handlers);
+      rp->ignored = realloc(rp->ignored, num * sizeof *rp->ignored);
+      if (!rp->handlers || !rp->ignored) {
+         fprintf(stderr, "out of memory\n");
+         exit(1);
+      }
+      memset(rp->handlers + old, 0, (num - old) * sizeof *rp->handlers);
+      memset(rp->ignored + old, 0, (num - old) * sizeof *rp->ignored);
+      rp->num_handlers = num;
+   }
+
+   if (!rp->handlers[method]) {
+      const char *name = rp->reader.names[method];
+      unsigned i;
+
+      rp->handlers[method] = replay_ignore;
+      for (i = 0; i < ARRAY_SIZE(replay_handlers); ++i) {
+         if (strcmp(replay_handlers[i].method, name) == 0) {
+            rp->handlers[method] = replay_handlers[i].handler;
+            break;
+         }
+      }
+      if (i == ARRAY_SIZE(replay_handlers))
+         rp->ignored[method] = 1;
+   }
+   else if (rp->ignored[method])
+      rp->ignored[method]++;
+
+   rp->frame_calls++;
+   rp->handlers[method](rp);
+}
+
+
+/**
+ * Does the call end a frame?
+ */
+static boolean
+ends_frame(const struct replay *rp, const struct call *call)
+{
+   const char *method = rp->reader.names[call->method];
+
+   if (strcmp(method, "flush_frontbuffer") == 0)
+      return TRUE;
+
+   return strcmp(call->klass, "pipe_context") == 0 &&
+          strcmp(method, "flush") == 0 &&
+          (uint_of(find(rp, call->args, "flags")) & PIPE_FLUSH_END_OF_FRAME);
+}
+
+
+/**
+ * Parse the calls of the next frame, up to and including the one which
+ * ends it, so that decoding them isn't timed.  Returns FALSE at the end.
+ */
+static boolean
+parse_frame(struct replay *rp)
+{
+   struct reader *r = &rp->reader;
+
+   r->num_values = 0;
+   r->num_chars = 0;
+   new_value(r, TRACE_BIN_NULL, NULL);
+
+   rp->num_calls = 0;
+   for (;;) {
+      struct call *call;
+
+      rp->calls = grow(rp->calls, &rp->max_calls, rp->num_calls + 1,
+                       sizeof *rp->calls);
+      call = &rp->calls[rp->num_calls];
+      if (!parse_call(r, call))
+         break;
+      rp->num_calls++;
+      if (ends_frame(rp, call))
+         break;
+   }
+
+   return rp->num_calls != 0;
+}
+
+
+static int
+compare_int64(const void *a, const void *b)
+{
+   int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+   return x < y ? -1 : x > y;
+}
+
+
+static void
+report_times(const char *what, int64_t *times, unsigned num)
+{
+   int64_t total = 0;
+   unsigned i;
+
+   for (i = 0; i < num; ++i)
+      total += times[i];
+   qsort(times, num, sizeof *times, compare_int64);
+
+   printf("%s: total %.3f ms, min %.3f, median %.3f, mean %.3f, max %.3f\n",
+          what, total / 1e6, times[0] / 1e6, times[num / 2] / 1e6,
+          total / 1e6 / num, times[num - 1] / 1e6);
+}
+
+
+static void
+report(struct replay *rp)
+{
+   unsigned i;
+
+   if (rp->num_frames) {
+      int64_t *times = malloc(rp->num_frames * sizeof *times);
+
+      if (times) {
+         printf("%u frames\n", rp->num_frames);
+         for (i = 0; i < rp->num_frames; ++i)
+            times[i] = rp->frames[i].cpu;
+         report_times("cpu", times, rp->num_frames);
+         for (i = 0; i < rp->num_frames; ++i)
+            times[i] = rp->frames[i].wall;
+         report_times("wall", times, rp->num_frames);
+         free(times);
+      }
+   }
+   else
+      printf("no frames\n");
+
+   if (rp->skipped_draws)
+      fprintf(stderr, "%u draws using unrecorded user memory or indirect "
+              "parameters skipped\n", rp->skipped_draws);
+   for (i = 0; i < rp->num_handlers; ++i)
+      if (rp->ignored[i])
+         fprintf(stderr, "%u calls to %s ignored\n", rp->ignored[i],
+                 rp->reader.names[i]);
+}
+
+
+static void
+usage(void)
+{
+   fprintf(stderr,
+           "usage: replay [-hw] [-q] TRACE.gbtrace\n"
+           "\n"
+           "Replays a binary gallium trace and reports the time of every frame.\n"
+           "\n"
+           "  -hw   use the first hardware device instead of the software one,\n"
+           "        whose driver is chosen with GALLIUM_DRIVER\n"
+           "  -q    only print the summary\n");
+   exit(1);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   struct replay rp;
+   const char *filename = NULL;
+   boolean hw = FALSE;
+   struct stat st;
+   void *map;
+   int fd, i;
+
+   memset(&rp, 0, sizeof rp);
+
+   for (i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], "-hw") == 0)
+         hw = TRUE;
+      else if (strcmp(argv[i], "-q") == 0)
+         rp.quiet = TRUE;
+      else if (argv[i][0] == '-' || filename)
+         usage();
+      else
+         filename = argv[i];
+   }
+   if (!filename)
+      usage();
+
+   fd = open(filename, O_RDONLY);
+   if (fd < 0 || fstat(fd, &st) < 0) {
+      perror(filename);
+      return 1;
+   }
+   /* Fault the whole trace in now rather than while timing frames */
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      perror(filename);
+      return 1;
+   }
+
+   rp.reader.ptr = map;
+   rp.reader.end = rp.reader.ptr + st.st_size;
+   if (st.st_size < (off_t)sizeof TRACE_BIN_MAGIC ||
+       memcmp(map, TRACE_BIN_MAGIC, sizeof TRACE_BIN_MAGIC) != 0) {
+      fprintf(stderr, "%s: not a binary gallium trace\n", filename);
+      return 1;
+   }
+   rp.reader.ptr += sizeof TRACE_BIN_MAGIC;
+   if (read_uint(&rp.reader) != TRACE_BIN_VERSION) {
+      fprintf(stderr, "%s: unsupported trace version\n", filename);
+      return 1;
+   }
+
+   if (hw ? pipe_loader_probe(&rp.dev, 1) < 1 :
+            !pipe_loader_sw_probe_null(&rp.dev)) {
+      fprintf(stderr, "no device found\n");
+      return 1;
+   }
+   rp.screen = pipe_loader_create_screen(rp.dev);
+   if (!rp.screen) {
+      fprintf(stderr, "failed to create the screen\n");
+      return 1;
+   }
+   fprintf(stderr, "replaying on %s\n", rp.screen->get_name(rp.screen));
+
+   rp.objects = util_hash_table_create(object_hash, object_compare);
+
+   while (parse_frame(&rp)) {
+      unsigned c;
+
+      frame_start(&rp);
+      for (c = 0; c < rp.num_calls; ++c) {
+         rp.call = rp.calls[c];
+         replay_call(&rp);
+      }
+      frame_end(&rp);
+   }
+
+   report(&rp);
+
+   util_hash_table_destroy(rp.objects);
+   rp.screen->destroy(rp.screen);
+   pipe_loader_release(&rp.dev, 1);
+   munmap(map, st.st_size);
+
+   return 0;
+}
@@ -26,6 +26,9 @@
  *
  **************************************************************************/
 
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
 #include "pipe/p_compiler.h"
 #include "pipe/p_format.h"
 #include "util/u_inlines.h"
@@ -45,6 +48,7 @@ struct dri_sw_displaytarget
    unsigned stride;
 
    unsigned map_flags;
+   int shmid;  /**< -1 unless data is a shared memory segment */
    void *data;
    void *mapped;
    const void *front_private;
@@ -79,6 +83,36 @@ dri_sw_is_displaytarget_format_supported( struct sw_winsys *ws,
    return TRUE;
 }
 
+/**
+ * Allocate the backing store as a SysV shared memory segment, which the
+ * loader can attach to the display server (MIT-SHM) so presenting doesn't
+ * send the pixels.
+ */
+static char *
+alloc_shm(struct dri_sw_displaytarget *dri_sw_dt, unsigned size)
+{
+   char *addr;
+
+   dri_sw_dt->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT|0600);
+   if (dri_sw_dt->shmid < 0)
+      return NULL;
+
+   addr = (char *) shmat(dri_sw_dt->shmid, 0, 0);
+
+   /* Mark the segment for deletion right away so it can't leak if we
+    * crash.  Linux still lets the X server attach it until the last
+    * detach.
+    */
+   shmctl(dri_sw_dt->shmid, IPC_RMID, 0);
+
+   if (addr == (char *) -1) {
+      dri_sw_dt->shmid = -1;
+      return NULL;
+   }
+
+   return addr;
+}
+
 static struct sw_displaytarget *
 dri_sw_displaytarget_create(struct sw_winsys *winsys,
                             unsigned tex_usage,
@@ -88,6 +122,7 @@ dri_sw_displaytarget_create(struct sw_winsys *winsys,
                             const void *front_private,
                             unsigned *stride)
 {
+   struct dri_sw_winsys *ws = dri_sw_winsys(winsys);
    struct dri_sw_displaytarget *dri_sw_dt;
    unsigned nblocksy, size, format_stride;
 
@@ -106,7 +141,13 @@ dri_sw_displaytarget_create(struct sw_winsys *winsys,
    nblocksy = util_format_get_nblocksy(format, height);
    size = dri_sw_dt->stride * nblocksy;
 
-   dri_sw_dt->data = align_malloc(size, alignment);
+   dri_sw_dt->shmid = -1;
+   /* shmat() returns page aligned memory */
+   if (ws->lf->put_image_shm)
+      dri_sw_dt->data = alloc_shm(dri_sw_dt, size);
+
+   if (!dri_sw_dt->data)
+      dri_sw_dt->data = align_malloc(size, alignment);
    if(!dri_sw_dt->data)
       goto no_data;
 
@@ -125,7 +166,10 @@ dri_sw_displaytarget_destroy(struct sw_winsys *ws,
 {
    struct dri_sw_displaytarget *dri_sw_dt = dri_sw_displaytarget(dt);
 
-   align_free(dri_sw_dt->data);
+   if (dri_sw_dt->shmid >= 0)
+      shmdt(dri_sw_dt->data);
+   else
+      align_free(dri_sw_dt->data);
 
    FREE(dri_sw_dt);
 }
@@ -182,13 +226,16 @@ static void
 dri_sw_displaytarget_display(struct sw_winsys *ws,
                              struct sw_displaytarget *dt,
                              void *context_private,
-                             struct pipe_box *box)
+                             unsigned nboxes,
+                             struct pipe_box *boxes)
 {
    struct dri_sw_winsys *dri_sw_ws = dri_sw_winsys(ws);
    struct dri_sw_displaytarget *dri_sw_dt = dri_sw_displaytarget(dt);
    struct dri_drawable *dri_drawable = (struct dri_drawable *)context_private;
    unsigned width, height;
    unsigned blsize = util_format_get_blocksize(dri_sw_dt->format);
+   int *rects;
+   unsigned i;
 
    /* Set the width to 'stride / cpp'.
     *
@@ -198,11 +245,52 @@ dri_sw_displaytarget_display(struct sw_winsys *ws,
 
    height = dri_sw_dt->height;
 
-   if (box) {
-       void *data;
-       data = dri_sw_dt->data + (dri_sw_dt->stride * box->y) + box->x * blsize;
-       dri_sw_ws->lf->put_image2(dri_drawable, data,
-                                 box->x, box->y, box->width, box->height, dri_sw_dt->stride);
+   if (nboxes && dri_sw_ws->lf->put_image_rects) {
+      /* The loader presents every put on its own, so all rectangles have to
+       * go out in one.
+       */
+      rects = MALLOC(nboxes * 4 * sizeof(int));
+      if (rects) {
+         for (i = 0; i < nboxes; i++) {
+            rects[i * 4 + 0] = boxes[i].x;
+            rects[i * 4 + 1] = boxes[i].y;
+            rects[i * 4 + 2] = boxes[i].width;
+            rects[i * 4 + 3] = boxes[i].height;
+         }
+         dri_sw_ws->lf->put_image_rects(dri_drawable, dri_sw_dt->data,
+                                        width, height, dri_sw_dt->stride,
+                                        rects, nboxes);
+         FREE(rects);
+         return;
+      }
+      nboxes = 0;
+   }
+
+   if (dri_sw_dt->shmid >= 0) {
+      /* Only the rectangles are read by the server, so presenting part of
+       * the surface costs nothing for the rest of it.
+       */
+      for (i = 0; i < nboxes; i++) {
+         const struct pipe_box *box = &boxes[i];
+         unsigned offset = dri_sw_dt->stride * box->y + box->x * blsize;
+         dri_sw_ws->lf->put_image_shm(dri_drawable, dri_sw_dt->shmid,
+                                      dri_sw_dt->data, offset,
+                                      box->x, box->y, box->width, box->height,
+                                      dri_sw_dt->stride);
+      }
+      if (!nboxes)
+         dri_sw_ws->lf->put_image_shm(dri_drawable, dri_sw_dt->shmid,
+                                      dri_sw_dt->data, 0,
+                                      0, 0, width, height, dri_sw_dt->stride);
+   } else if (nboxes) {
+      for (i = 0; i < nboxes; i++) {
+         const struct pipe_box *box = &boxes[i];
+         void *data;
+         data = dri_sw_dt->data + (dri_sw_dt->stride * box->y) + box->x * blsize;
+         dri_sw_ws->lf->put_image2(dri_drawable, data,
+                                   box->x, box->y, box->width, box->height,
+                                   dri_sw_dt->stride);
+      }
    } else {
        dri_sw_ws->lf->put_image(dri_drawable, dri_sw_dt->data, width, height);
    }
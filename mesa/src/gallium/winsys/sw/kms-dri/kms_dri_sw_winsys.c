@@ -36,6 +36,10 @@
 
 #include <sys/types.h>
 #include <sys/mman.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/syscall.h>
+#include <linux/memfd.h>
+#endif
 #include <unistd.h>
 #include <dlfcn.h>
 #include <fcntl.h>
@@ -71,6 +75,11 @@ struct kms_sw_displaytarget
    uint32_t handle;
    void *mapped;
 
+   /* Backing memory when there is no DRM device, mapped for the whole
+    * life of the display target.  -1 for dumb buffers.
+    */
+   int memfd;
+
    int ref_count;
    struct list_head link;
 };
@@ -79,7 +88,8 @@ struct kms_sw_winsys
 {
    struct sw_winsys base;
 
-   int fd;
+   int fd;      /* -1 if buffers live in memfds instead of dumb buffers */
+   uint32_t next_handle;   /* for memfd buffers */
    struct list_head bo_list;
 };
 
@@ -96,6 +106,36 @@ kms_sw_winsys( struct sw_winsys *ws )
 }
 
 
+static inline int
+kms_sw_memfd_create(const char *name)
+{
+#ifdef HAVE_MEMFD_CREATE
+   return syscall(SYS_memfd_create, name, MFD_CLOEXEC);
+#else
+   return -1;
+#endif
+}
+
+/**
+ * Map size bytes of memfd for the display target to own.
+ */
+static boolean
+kms_sw_displaytarget_map_memfd(struct kms_sw_winsys *kms_sw,
+                               struct kms_sw_displaytarget *kms_sw_dt,
+                               int memfd, unsigned size)
+{
+   void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+   if (map == MAP_FAILED)
+      return FALSE;
+
+   kms_sw_dt->memfd = memfd;
+   kms_sw_dt->mapped = map;
+   kms_sw_dt->size = size;
+   kms_sw_dt->handle = ++kms_sw->next_handle;
+   return TRUE;
+}
+
 static boolean
 kms_sw_is_displaytarget_format_supported( struct sw_winsys *ws,
                                           unsigned tex_usage,
@@ -125,11 +165,35 @@ kms_sw_displaytarget_create(struct sw_winsys *ws,
       goto no_dt;
 
    kms_sw_dt->ref_count = 1;
+   kms_sw_dt->memfd = -1;
 
    kms_sw_dt->format = format;
    kms_sw_dt->width = width;
    kms_sw_dt->height = height;
 
+   if (kms_sw->fd < 0) {
+      unsigned size;
+      int memfd;
+
+      kms_sw_dt->stride = align(util_format_get_stride(format, width),
+                                alignment);
+      size = kms_sw_dt->stride * util_format_get_nblocksy(format, height);
+
+      memfd = kms_sw_memfd_create("kms_swrast");
+      if (memfd < 0)
+         goto free_dt;
+      if (ftruncate(memfd, size) < 0 ||
+          !kms_sw_displaytarget_map_memfd(kms_sw, kms_sw_dt, memfd, size)) {
+         close(memfd);
+         goto free_dt;
+      }
+
+      list_add(&kms_sw_dt->link, &kms_sw->bo_list);
+
+      *stride = kms_sw_dt->stride;
+      return (struct sw_displaytarget *)kms_sw_dt;
+   }
+
    memset(&create_req, 0, sizeof(create_req));
    create_req.bpp = 32;
    create_req.width = width;
@@ -153,6 +217,7 @@ kms_sw_displaytarget_create(struct sw_winsys *ws,
    memset(&destroy_req, 0, sizeof destroy_req);
    destroy_req.handle = create_req.handle;
    drmIoctl(kms_sw->fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_req);
+ free_dt:
    FREE(kms_sw_dt);
  no_dt:
    return NULL;
@@ -170,9 +235,14 @@ kms_sw_displaytarget_destroy(struct sw_winsys *ws,
    if (kms_sw_dt->ref_count > 0)
       return;
 
-   memset(&destroy_req, 0, sizeof destroy_req);
-   destroy_req.handle = kms_sw_dt->handle;
-   drmIoctl(kms_sw->fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_req);
+   if (kms_sw_dt->memfd >= 0) {
+      munmap(kms_sw_dt->mapped, kms_sw_dt->size);
+      close(kms_sw_dt->memfd);
+   } else {
+      memset(&destroy_req, 0, sizeof destroy_req);
+      destroy_req.handle = kms_sw_dt->handle;
+      drmIoctl(kms_sw->fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_req);
+   }
 
    list_del(&kms_sw_dt->link);
 
@@ -191,6 +261,9 @@ kms_sw_displaytarget_map(struct sw_winsys *ws,
    struct drm_mode_map_dumb map_req;
    int prot, ret;
 
+   if (kms_sw_dt->memfd >= 0)
+      return kms_sw_dt->mapped;
+
    memset(&map_req, 0, sizeof map_req);
    map_req.handle = kms_sw_dt->handle;
    ret = drmIoctl(kms_sw->fd, DRM_IOCTL_MODE_MAP_DUMB, &map_req);
@@ -271,12 +344,55 @@ kms_sw_displaytarget_add_from_prime(struct kms_sw_winsys *kms_sw, int fd,
    return kms_sw_dt;
 }
 
+static struct kms_sw_displaytarget *
+kms_sw_displaytarget_add_from_memfd(struct kms_sw_winsys *kms_sw, int fd,
+                                    unsigned width, unsigned height,
+                                    unsigned stride)
+{
+   struct kms_sw_displaytarget *kms_sw_dt;
+   off_t size;
+   int memfd;
+
+   size = lseek(fd, 0, SEEK_END);
+   if (size == (off_t)-1 || size < (off_t)stride * height)
+      return NULL;
+   lseek(fd, 0, SEEK_SET);
+
+   memfd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+   if (memfd < 0)
+      return NULL;
+
+   kms_sw_dt = CALLOC_STRUCT(kms_sw_displaytarget);
+   if (!kms_sw_dt) {
+      close(memfd);
+      return NULL;
+   }
+
+   kms_sw_dt->ref_count = 1;
+   kms_sw_dt->width = width;
+   kms_sw_dt->height = height;
+   kms_sw_dt->stride = stride;
+
+   if (!kms_sw_displaytarget_map_memfd(kms_sw, kms_sw_dt, memfd, size)) {
+      close(memfd);
+      FREE(kms_sw_dt);
+      return NULL;
+   }
+
+   list_add(&kms_sw_dt->link, &kms_sw->bo_list);
+
+   return kms_sw_dt;
+}
+
 static void
 kms_sw_displaytarget_unmap(struct sw_winsys *ws,
                            struct sw_displaytarget *dt)
 {
    struct kms_sw_displaytarget *kms_sw_dt = kms_sw_displaytarget(dt);
 
+   if (kms_sw_dt->memfd >= 0)
+      return;
+
    DEBUG_PRINT("KMS-DEBUG: unmapped buffer %u (was %p)\n", kms_sw_dt->handle, kms_sw_dt->mapped);
 
    munmap(kms_sw_dt->mapped, kms_sw_dt->size);
@@ -303,10 +419,18 @@ kms_sw_displaytarget_from_handle(struct sw_winsys *ws,
 
    switch(whandle->type) {
    case DRM_API_HANDLE_TYPE_FD:
-      kms_sw_dt = kms_sw_displaytarget_add_from_prime(kms_sw, whandle->handle,
-                                                      templ->width0,
-                                                      templ->height0,
-                                                      whandle->stride);
+      if (kms_sw->fd < 0)
+         kms_sw_dt = kms_sw_displaytarget_add_from_memfd(kms_sw,
+                                                         whandle->handle,
+                                                         templ->width0,
+                                                         templ->height0,
+                                                         whandle->stride);
+      else
+         kms_sw_dt = kms_sw_displaytarget_add_from_prime(kms_sw,
+                                                         whandle->handle,
+                                                         templ->width0,
+                                                         templ->height0,
+                                                         whandle->stride);
       if (kms_sw_dt)
          *stride = kms_sw_dt->stride;
       return (struct sw_displaytarget *)kms_sw_dt;
@@ -340,8 +464,17 @@ kms_sw_displaytarget_get_handle(struct sw_winsys *winsys,
       whandle->offset = 0;
       return TRUE;
    case DRM_API_HANDLE_TYPE_FD:
-      if (!drmPrimeHandleToFD(kms_sw->fd, kms_sw_dt->handle,
-                             DRM_CLOEXEC, (int*)&whandle->handle)) {
+      if (kms_sw_dt->memfd >= 0) {
+         int fd = fcntl(kms_sw_dt->memfd, F_DUPFD_CLOEXEC, 0);
+
+         if (fd >= 0) {
+            whandle->handle = fd;
+            whandle->stride = kms_sw_dt->stride;
+            whandle->offset = 0;
+            return TRUE;
+         }
+      } else if (!drmPrimeHandleToFD(kms_sw->fd, kms_sw_dt->handle,
+                                     DRM_CLOEXEC, (int*)&whandle->handle)) {
          whandle->stride = kms_sw_dt->stride;
          whandle->offset = 0;
          return TRUE;
@@ -359,6 +492,7 @@ static void
 kms_sw_displaytarget_display(struct sw_winsys *ws,
                              struct sw_displaytarget *dt,
                              void *context_private,
+                             unsigned nboxes,
                              struct pipe_box *box)
 {
    /* This function should not be called, instead the dri2 loader should
@@ -379,6 +513,12 @@ kms_dri_create_winsys(int fd)
 {
    struct kms_sw_winsys *ws;
 
+#ifndef HAVE_MEMFD_CREATE
+   /* Without a device, buffers can only be memfds. */
+   if (fd < 0)
+      return NULL;
+#endif
+
    ws = CALLOC_STRUCT(kms_sw_winsys);
    if (!ws)
       return NULL;
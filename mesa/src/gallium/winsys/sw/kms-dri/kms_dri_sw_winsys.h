@@ -32,6 +32,9 @@
 
 struct sw_winsys;
 
+/* With fd -1 there is no DRM device, and buffers are memfds instead of
+ * dumb buffers.  That needs memfd_create(), without it this returns NULL.
+ */
 struct sw_winsys *kms_dri_create_winsys(int fd);
 
 #endif
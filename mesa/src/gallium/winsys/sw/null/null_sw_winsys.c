@@ -116,6 +116,7 @@ static void
 null_sw_displaytarget_display(struct sw_winsys *winsys,
                               struct sw_displaytarget *dt,
                               void *context_private,
+                              unsigned nboxes,
                               struct pipe_box *box)
 {
    assert(0);
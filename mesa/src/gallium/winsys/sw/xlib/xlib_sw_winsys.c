@@ -294,13 +294,17 @@ xlib_displaytarget_destroy(struct sw_winsys *ws,
  */
 static void
 xlib_sw_display(struct xlib_drawable *xlib_drawable,
-                struct sw_displaytarget *dt)
+                struct sw_displaytarget *dt,
+                unsigned nboxes,
+                const struct pipe_box *boxes)
 {
    static boolean no_swap = 0;
    static boolean firsttime = 1;
    struct xlib_displaytarget *xlib_dt = xlib_displaytarget(dt);
    Display *display = xlib_dt->display;
    XImage *ximage;
+   struct pipe_box whole;
+   unsigned i;
 
    if (firsttime) {
       no_swap = getenv("SP_NO_RAST") != NULL;
@@ -339,13 +343,21 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
       XSetFunction(display, xlib_dt->gc, GXcopy);
    }
 
+   if (!nboxes) {
+      u_box_origin_2d(xlib_dt->width, xlib_dt->height, &whole);
+      boxes = &whole;
+      nboxes = 1;
+   }
+
    if (xlib_dt->shm) {
       ximage = xlib_dt->tempImage;
       ximage->data = xlib_dt->data;
 
       /* _debug_printf("XSHM\n"); */
-      XShmPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
-                   ximage, 0, 0, 0, 0, xlib_dt->width, xlib_dt->height, False);
+      for (i = 0; i < nboxes; i++)
+         XShmPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
+                      ximage, boxes[i].x, boxes[i].y, boxes[i].x, boxes[i].y,
+                      boxes[i].width, boxes[i].height, False);
    }
    else {
       /* display image in Window */
@@ -362,8 +374,10 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
       ximage->bytes_per_line = xlib_dt->stride;
 
       /* _debug_printf("XPUT\n"); */
-      XPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
-                ximage, 0, 0, 0, 0, xlib_dt->width, xlib_dt->height);
+      for (i = 0; i < nboxes; i++)
+         XPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
+                   ximage, boxes[i].x, boxes[i].y, boxes[i].x, boxes[i].y,
+                   boxes[i].width, boxes[i].height);
    }
 
    XFlush(xlib_dt->display);
@@ -378,10 +392,11 @@ static void
 xlib_displaytarget_display(struct sw_winsys *ws,
                            struct sw_displaytarget *dt,
                            void *context_private,
+                           unsigned nboxes,
                            struct pipe_box *box)
 {
    struct xlib_drawable *xlib_drawable = (struct xlib_drawable *)context_private;
-   xlib_sw_display(xlib_drawable, dt);
+   xlib_sw_display(xlib_drawable, dt, nboxes, box);
 }
 
 
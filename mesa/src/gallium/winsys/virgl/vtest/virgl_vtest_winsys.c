@@ -609,7 +609,7 @@ static void virgl_vtest_flush_frontbuffer(struct virgl_winsys *vws,
    vtws->sws->displaytarget_unmap(vtws->sws, res->dt);
 
    vtws->sws->displaytarget_display(vtws->sws, res->dt, winsys_drawable_handle,
-                                    sub_box);
+                                    sub_box ? 1 : 0, sub_box);
 }
 
 static void
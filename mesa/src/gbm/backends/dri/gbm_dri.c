@@ -425,6 +425,7 @@ static int
 dri_screen_create_dri2(struct gbm_dri_device *dri, char *driver_name)
 {
    const __DRIextension **extensions;
+   int fd = dri->memfd_buffers ? -1 : dri->base.base.fd;
    int ret = 0;
 
    dri->base.driver_name = driver_name;
@@ -443,12 +444,12 @@ dri_screen_create_dri2(struct gbm_dri_device *dri, char *driver_name)
       return -1;
 
    if (dri->dri2->base.version >= 4) {
-      dri->screen = dri->dri2->createNewScreen2(0, dri->base.base.fd,
+      dri->screen = dri->dri2->createNewScreen2(0, fd,
                                                 dri->extensions,
                                                 dri->driver_extensions,
                                                 &dri->driver_configs, dri);
    } else {
-      dri->screen = dri->dri2->createNewScreen(0, dri->base.base.fd,
+      dri->screen = dri->dri2->createNewScreen(0, fd,
                                                dri->extensions,
                                                &dri->driver_configs, dri);
    }
@@ -525,16 +526,24 @@ static int
 dri_screen_create_sw(struct gbm_dri_device *dri)
 {
    char *driver_name;
+   uint64_t cap;
    int ret;
 
    driver_name = strdup("kms_swrast");
    if (!driver_name)
       return -errno;
 
+   /* Render nodes, or fds that aren't DRM devices at all, have no dumb
+    * buffers; kms_swrast then keeps its buffers in memfds.
+    */
+   if (drmGetCap(dri->base.base.fd, DRM_CAP_DUMB_BUFFER, &cap) != 0 || !cap)
+      dri->memfd_buffers = 1;
+
    ret = dri_screen_create_dri2(dri, driver_name);
    if (ret == 0)
       return ret;
 
+   dri->memfd_buffers = 0;
    return dri_screen_create_swrast(dri);
 }
 
@@ -569,7 +578,7 @@ gbm_dri_bo_write(struct gbm_bo *_bo, const void *buf, size_t count)
 {
    struct gbm_dri_bo *bo = gbm_dri_bo(_bo);
 
-   if (bo->image != NULL) {
+   if (bo->map == NULL) {
       errno = EINVAL;
       return -1;
    }
@@ -602,6 +611,8 @@ gbm_dri_bo_destroy(struct gbm_bo *_bo)
    struct drm_mode_destroy_dumb arg;
 
    if (bo->image != NULL) {
+      if (bo->map != NULL)
+         munmap(bo->map, bo->size);
       dri->image->destroyImage(bo->image);
    } else {
       gbm_dri_bo_unmap_dumb(bo);
@@ -642,6 +653,31 @@ gbm_dri_to_gbm_format(uint32_t dri_format)
    return ret;
 }
 
+/**
+ * Memfd BOs are mapped once for their whole life, which gives
+ * gbm_bo_map() and gbm_bo_write() direct access to the pixels without a
+ * context or staging copies.
+ */
+static void *
+gbm_dri_bo_map_memfd(struct gbm_dri_device *dri, struct gbm_dri_bo *bo)
+{
+   void *map;
+   int fd = -1;
+
+   dri->image->queryImage(bo->image, __DRI_IMAGE_ATTRIB_FD, &fd);
+   if (fd < 0)
+      return NULL;
+
+   bo->size = bo->base.base.stride * bo->base.base.height;
+   map = mmap(0, bo->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return NULL;
+
+   bo->map = map;
+   return map;
+}
+
 static struct gbm_bo *
 gbm_dri_bo_import(struct gbm_device *gbm,
                   uint32_t type, void *buffer, uint32_t usage)
@@ -783,6 +819,12 @@ gbm_dri_bo_import(struct gbm_device *gbm,
    dri->image->queryImage(bo->image, __DRI_IMAGE_ATTRIB_HANDLE,
                           &bo->base.base.handle.s32);
 
+   if (dri->memfd_buffers && gbm_dri_bo_map_memfd(dri, bo) == NULL) {
+      dri->image->destroyImage(bo->image);
+      free(bo);
+      return NULL;
+   }
+
    return &bo->base.base;
 }
 
@@ -854,7 +896,8 @@ gbm_dri_bo_create(struct gbm_device *gbm,
    int dri_format;
    unsigned dri_use = 0;
 
-   if (usage & GBM_BO_USE_WRITE || dri->image == NULL)
+   /* memfd BOs are always mapped, so they can do GBM_BO_USE_WRITE too */
+   if ((usage & GBM_BO_USE_WRITE && !dri->memfd_buffers) || dri->image == NULL)
       return create_dumb(gbm, width, height, format, usage);
 
    bo = calloc(1, sizeof *bo);
@@ -918,6 +961,11 @@ gbm_dri_bo_create(struct gbm_device *gbm,
    dri->image->queryImage(bo->image, __DRI_IMAGE_ATTRIB_STRIDE,
                           (int *) &bo->base.base.stride);
 
+   if (dri->memfd_buffers && gbm_dri_bo_map_memfd(dri, bo) == NULL) {
+      dri->image->destroyImage(bo->image);
+      goto failed;
+   }
+
    return &bo->base.base;
 
 failed:
@@ -934,7 +982,7 @@ gbm_dri_bo_map(struct gbm_bo *_bo,
    struct gbm_dri_device *dri = gbm_dri_device(_bo->gbm);
    struct gbm_dri_bo *bo = gbm_dri_bo(_bo);
 
-   /* If it's a dumb buffer, we already have a mapping */
+   /* If it's a dumb or memfd buffer, we already have a mapping */
    if (bo->map) {
       *map_data = (char *)bo->map + (bo->base.base.stride * y) + (x * 4);
       *stride = bo->base.base.stride;
@@ -965,7 +1013,7 @@ gbm_dri_bo_unmap(struct gbm_bo *_bo, void *map_data)
    struct gbm_dri_device *dri = gbm_dri_device(_bo->gbm);
    struct gbm_dri_bo *bo = gbm_dri_bo(_bo);
 
-   /* Check if it's a dumb buffer and check the pointer is in range */
+   /* Check if it's a dumb or memfd buffer and check the pointer is in range */
    if (bo->map) {
       assert(map_data >= bo->map);
       assert(map_data < (bo->map + bo->size));
@@ -96,6 +96,9 @@ struct gbm_dri_device {
                             void          *loaderPrivate);
 
    struct wl_drm *wl_drm;
+
+   /* kms_swrast without dumb buffers on the fd, which allocates memfds */
+   int memfd_buffers;
 };
 
 struct gbm_dri_bo {
@@ -103,7 +106,7 @@ struct gbm_dri_bo {
 
    __DRIimage *image;
 
-   /* Used for cursors and the swrast front BO */
+   /* Used for cursors, the swrast front BO and memfd BOs */
    uint32_t handle, size;
    void *map;
 };
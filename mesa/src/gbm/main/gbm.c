@@ -111,6 +111,11 @@ gbm_device_destroy(struct gbm_device *gbm)
  * the file descriptor returned when opening a device such as \c
  * /dev/dri/card0
  *
+ * Render nodes and character devices that can't allocate buffers at all,
+ * such as \c /dev/null, get the software renderer with buffers kept in
+ * anonymous shared memory. Those can still be mapped with gbm_bo_map() and
+ * shared with gbm_bo_get_fd().
+ *
  * \param fd The file descriptor for a backend specific device
  * \return The newly created struct gbm_device. The resources associated with
  * the device should be freed with gbm_device_destroy() when it is no longer
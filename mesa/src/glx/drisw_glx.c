@@ -48,6 +48,8 @@ XCreateDrawable(struct drisw_drawable * pdp,
    XChangeGC(dpy, pdp->swapgc, GCFunction, &gcvalues);
    XChangeGC(dpy, pdp->swapgc, GCGraphicsExposures, &gcvalues);
 
+   pdp->shminfo.shmid = -1;
+
    /* visual */
    visTemp.visualid = visualid;
    visMask = VisualIDMask;
@@ -76,9 +78,85 @@ XCreateDrawable(struct drisw_drawable * pdp,
    return True;
 }
 
+/**
+ * X Shared Memory Image extension code
+ */
+
+static volatile int XErrorFlag = 0;
+
+/**
+ * Catches potential Xlib errors.
+ */
+static int
+handle_xerror(Display *dpy, XErrorEvent *event)
+{
+   (void) dpy;
+   (void) event;
+   XErrorFlag = 1;
+   return 0;
+}
+
+static void
+XDestroyShmImage(struct drisw_drawable * pdp, Display * dpy)
+{
+   if (pdp->shmimage) {
+      XShmDetach(dpy, &pdp->shminfo);
+      pdp->shmimage->data = NULL;
+      XDestroyImage(pdp->shmimage);
+      pdp->shmimage = NULL;
+   }
+   pdp->shminfo.shmid = -1;
+}
+
+/**
+ * Attach the driver's shared memory segment to the X server.  On failure
+ * (remote display, no MIT-SHM) the segment is remembered anyway so we don't
+ * try again on every swap, and shmimage stays NULL.
+ */
+static void
+XCreateShmImage(struct drisw_drawable * pdp, Display * dpy,
+                int shmid, char *shmaddr)
+{
+   int (*old_handler)(Display *, XErrorEvent *);
+
+   XDestroyShmImage(pdp, dpy);
+
+   pdp->shminfo.shmid = shmid;
+   pdp->shminfo.shmaddr = shmaddr;
+   pdp->shminfo.readOnly = True;
+
+   if (!XShmQueryExtension(dpy))
+      return;
+
+   pdp->shmimage = XShmCreateImage(dpy,
+                                   pdp->visinfo->visual,
+                                   pdp->visinfo->depth,
+                                   ZPixmap, NULL, &pdp->shminfo, 0, 0);
+   if (!pdp->shmimage)
+      return;
+
+   /* dispatch pending errors before installing our handler */
+   XSync(dpy, False);
+
+   XErrorFlag = 0;
+   old_handler = XSetErrorHandler(handle_xerror);
+   /* This may trigger the X protocol error we're ready to catch: */
+   XShmAttach(dpy, &pdp->shminfo);
+   XSync(dpy, False);
+   (void) XSetErrorHandler(old_handler);
+
+   if (XErrorFlag) {
+      /* we are on a remote display, this error is normal, don't print it */
+      XErrorFlag = 0;
+      XDestroyImage(pdp->shmimage);
+      pdp->shmimage = NULL;
+   }
+}
+
 static void
 XDestroyDrawable(struct drisw_drawable * pdp, Display * dpy, XID drawable)
 {
+   XDestroyShmImage(pdp, dpy);
    XDestroyImage(pdp->ximage);
    free(pdp->visinfo);
 
@@ -176,6 +254,55 @@ swrastPutImage(__DRIdrawable * draw, int op,
    swrastPutImage2(draw, op, x, y, w, h, 0, data, loaderPrivate);
 }
 
+static void
+swrastPutImageShm(__DRIdrawable * draw, int op,
+                  int x, int y, int w, int h, int stride,
+                  int shmid, char *shmaddr, unsigned offset,
+                  void *loaderPrivate)
+{
+   struct drisw_drawable *pdp = loaderPrivate;
+   __GLXDRIdrawable *pdraw = &(pdp->base);
+   Display *dpy = pdraw->psc->dpy;
+   XImage *ximage;
+   GC gc;
+
+   if (shmid != pdp->shminfo.shmid || shmaddr != pdp->shminfo.shmaddr)
+      XCreateShmImage(pdp, dpy, shmid, shmaddr);
+
+   if (!pdp->shmimage) {
+      swrastPutImage2(draw, op, x, y, w, h, stride, shmaddr + offset,
+                      loaderPrivate);
+      return;
+   }
+
+   switch (op) {
+   case __DRI_SWRAST_IMAGE_OP_DRAW:
+      gc = pdp->gc;
+      break;
+   case __DRI_SWRAST_IMAGE_OP_SWAP:
+      gc = pdp->swapgc;
+      break;
+   default:
+      return;
+   }
+
+   /* The image covers the rows from offset on; the server reads the
+    * pixels straight out of the segment.
+    */
+   ximage = pdp->shmimage;
+   ximage->data = shmaddr + offset;
+   ximage->bytes_per_line = stride;
+   ximage->width = stride / ((ximage->bits_per_pixel + 7) / 8);
+   ximage->height = h;
+
+   XShmPutImage(dpy, pdraw->xDrawable, gc, ximage, 0, 0, x, y, w, h, False);
+
+   /* The driver may render into the segment again as soon as we return. */
+   XSync(dpy, False);
+
+   ximage->data = NULL;
+}
+
 static void
 swrastGetImage2(__DRIdrawable * read,
                 int x, int y, int w, int h, int stride,
@@ -209,13 +336,14 @@ swrastGetImage(__DRIdrawable * read,
 }
 
 static const __DRIswrastLoaderExtension swrastLoaderExtension = {
-   .base = {__DRI_SWRAST_LOADER, 3 },
+   .base = {__DRI_SWRAST_LOADER, 4 },
 
    .getDrawableInfo     = swrastGetDrawableInfo,
    .putImage            = swrastPutImage,
    .getImage            = swrastGetImage,
    .putImage2           = swrastPutImage2,
    .getImage2           = swrastGetImage2,
+   .putImageShm         = swrastPutImageShm,
 };
 
 static const __DRIextension *loader_extensions[] = {
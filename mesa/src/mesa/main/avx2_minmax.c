@@ -0,0 +1,107 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "main/avx2_minmax.h"
+#include <immintrin.h>
+#include <stdint.h>
+
+/*
+ * Each function scans 32 bytes of indices per iteration.  Restart indices
+ * are masked out by forcing them to all ones for the min and to zero for
+ * the max, so they never win either comparison.
+ *
+ * Only fold the vector results in if some lane saw a real index, which is
+ * exactly when the vector min doesn't exceed the vector max.
+ */
+
+#define AVX2_MIN_MAX_FUNC(name, type, bits, lanes)                           \
+void                                                                         \
+name(const type *indices, unsigned *min_index, unsigned *max_index,          \
+     const unsigned count, bool restart, unsigned restart_index)             \
+{                                                                            \
+   unsigned max_val = 0;                                                     \
+   unsigned min_val = ~0U;                                                   \
+   unsigned i = 0, j;                                                        \
+                                                                             \
+   /* a restart index the type can't hold never matches */                   \
+   if (restart_index > (type) ~0U)                                           \
+      restart = false;                                                       \
+                                                                             \
+   if (count >= 2 * lanes) {                                                 \
+      type max_arr[lanes] __attribute__ ((aligned (32)));                    \
+      type min_arr[lanes] __attribute__ ((aligned (32)));                    \
+      const unsigned vec_count = count & ~(lanes - 1);                       \
+      const __m256i restart_vec =                                            \
+         _mm256_set1_epi##bits((type) restart_index);                        \
+      __m256i max_vec = _mm256_setzero_si256();                              \
+      __m256i min_vec = _mm256_set1_epi##bits(-1);                           \
+      unsigned vec_min = ~0U, vec_max = 0;                                   \
+                                                                             \
+      if (restart) {                                                         \
+         for (i = 0; i < vec_count; i += lanes) {                            \
+            __m256i v = _mm256_loadu_si256((const __m256i *)&indices[i]);    \
+            __m256i is_restart = _mm256_cmpeq_epi##bits(v, restart_vec);     \
+            __m256i kept = _mm256_andnot_si256(is_restart, v);               \
+            max_vec = _mm256_max_epu##bits(max_vec, kept);                   \
+            min_vec = _mm256_min_epu##bits(min_vec,                          \
+                                           _mm256_or_si256(is_restart, v));  \
+         }                                                                   \
+      }                                                                      \
+      else {                                                                 \
+         for (i = 0; i < vec_count; i += lanes) {                            \
+            __m256i v = _mm256_loadu_si256((const __m256i *)&indices[i]);    \
+            max_vec = _mm256_max_epu##bits(max_vec, v);                      \
+            min_vec = _mm256_min_epu##bits(min_vec, v);                      \
+         }                                                                   \
+      }                                                                      \
+                                                                             \
+      _mm256_store_si256((__m256i *)max_arr, max_vec);                       \
+      _mm256_store_si256((__m256i *)min_arr, min_vec);                       \
+                                                                             \
+      for (j = 0; j < lanes; j++) {                                          \
+         if (max_arr[j] > vec_max)                                           \
+            vec_max = max_arr[j];                                            \
+         if (min_arr[j] < vec_min)                                           \
+            vec_min = min_arr[j];                                            \
+      }                                                                      \
+                                                                             \
+      if (vec_min <= vec_max) {                                              \
+         min_val = vec_min;                                                  \
+         max_val = vec_max;                                                  \
+      }                                                                      \
+   }                                                                         \
+                                                                             \
+   for (; i < count; i++) {                                                  \
+      if (restart && indices[i] == restart_index)                            \
+         continue;                                                           \
+      if (indices[i] > max_val)                                              \
+         max_val = indices[i];                                               \
+      if (indices[i] < min_val)                                              \
+         min_val = indices[i];                                               \
+   }                                                                         \
+                                                                             \
+   *min_index = min_val;                                                     \
+   *max_index = max_val;                                                     \
+}
+
+AVX2_MIN_MAX_FUNC(_mesa_avx2_uint_array_min_max, unsigned, 32, 8)
+AVX2_MIN_MAX_FUNC(_mesa_avx2_ushort_array_min_max, unsigned short, 16, 16)
+AVX2_MIN_MAX_FUNC(_mesa_avx2_ubyte_array_min_max, unsigned char, 8, 32)
@@ -0,0 +1,46 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+
+/*
+ * AVX2 versions of the index range scans used by vbo_get_minmax_index().
+ *
+ * If 'restart' is set, indices equal to 'restart_index' are skipped.  If no
+ * index is left, *min_index is ~0 and *max_index is 0, as for the C paths.
+ */
+
+void
+_mesa_avx2_uint_array_min_max(const unsigned *indices, unsigned *min_index,
+                              unsigned *max_index, const unsigned count,
+                              bool restart, unsigned restart_index);
+
+void
+_mesa_avx2_ushort_array_min_max(const unsigned short *indices,
+                                unsigned *min_index, unsigned *max_index,
+                                const unsigned count,
+                                bool restart, unsigned restart_index);
+
+void
+_mesa_avx2_ubyte_array_min_max(const unsigned char *indices,
+                               unsigned *min_index, unsigned *max_index,
+                               const unsigned count,
+                               bool restart, unsigned restart_index);
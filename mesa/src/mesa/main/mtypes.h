@@ -3241,6 +3241,13 @@ struct gl_framebuffer
 
    GLboolean DeletePending;
 
+   /**
+    * Window system framebuffers only: if set, row 0 of the buffers is the
+    * bottom of the image, as with FBOs, rather than the top.  Lets a winsys
+    * render straight into client memory laid out that way.
+    */
+   GLboolean BottomUp;
+
    /**
     * The framebuffer's visual. Immutable if this is a window system buffer.
     * Computed from attachments if user-made FBO.
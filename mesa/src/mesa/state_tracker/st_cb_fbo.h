@@ -49,6 +49,7 @@ struct st_renderbuffer
    struct pipe_resource *texture;
    struct pipe_surface *surface; /* temporary view into texture */
    GLboolean defined;        /**< defined contents? */
+   boolean bottom_up;        /**< winsys buffer stored bottom-up */
 
    struct pipe_transfer *transfer; /**< only used when mapping the resource */
 
@@ -247,6 +247,47 @@ void st_invalidate_readpix_cache(struct st_context *st)
    pipe_resource_reference(&st->readpix_cache.cache, NULL);
 }
 
+/**
+ * Blit the requested region to the top-left corner of dst.
+ */
+static void
+blit_to_resource(struct st_context *st, struct st_renderbuffer *strb,
+                 bool invert_y,
+                 GLint x, GLint y, GLsizei width, GLsizei height,
+                 GLenum format,
+                 enum pipe_format src_format, struct pipe_resource *dst)
+{
+   struct pipe_blit_info blit;
+
+   memset(&blit, 0, sizeof(blit));
+   blit.src.resource = strb->texture;
+   blit.src.level = strb->surface->u.tex.level;
+   blit.src.format = src_format;
+   blit.dst.resource = dst;
+   blit.dst.level = 0;
+   blit.dst.format = dst->format;
+   blit.src.box.x = x;
+   blit.dst.box.x = 0;
+   blit.src.box.y = y;
+   blit.dst.box.y = 0;
+   blit.src.box.z = strb->surface->u.tex.first_layer;
+   blit.dst.box.z = 0;
+   blit.src.box.width = blit.dst.box.width = width;
+   blit.src.box.height = blit.dst.box.height = height;
+   blit.src.box.depth = blit.dst.box.depth = 1;
+   blit.mask = st_get_blit_mask(strb->Base._BaseFormat, format);
+   blit.filter = PIPE_TEX_FILTER_NEAREST;
+   blit.scissor_enable = FALSE;
+
+   if (invert_y) {
+      blit.src.box.y = strb->Base.Height - blit.src.box.y;
+      blit.src.box.height = -blit.src.box.height;
+   }
+
+   /* blit */
+   st->pipe->blit(st->pipe, &blit);
+}
+
 /**
  * Create a staging texture and blit the requested region to it.
  */
@@ -261,7 +302,6 @@ blit_to_staging(struct st_context *st, struct st_renderbuffer *strb,
    struct pipe_screen *screen = pipe->screen;
    struct pipe_resource dst_templ;
    struct pipe_resource *dst;
-   struct pipe_blit_info blit;
 
    /* We are creating a texture of the size of the region being read back.
     * Need to check for NPOT texture support. */
@@ -289,35 +329,89 @@ blit_to_staging(struct st_context *st, struct st_renderbuffer *strb,
    if (!dst)
       return NULL;
 
-   memset(&blit, 0, sizeof(blit));
-   blit.src.resource = strb->texture;
-   blit.src.level = strb->surface->u.tex.level;
-   blit.src.format = src_format;
-   blit.dst.resource = dst;
-   blit.dst.level = 0;
-   blit.dst.format = dst->format;
-   blit.src.box.x = x;
-   blit.dst.box.x = 0;
-   blit.src.box.y = y;
-   blit.dst.box.y = 0;
-   blit.src.box.z = strb->surface->u.tex.first_layer;
-   blit.dst.box.z = 0;
-   blit.src.box.width = blit.dst.box.width = width;
-   blit.src.box.height = blit.dst.box.height = height;
-   blit.src.box.depth = blit.dst.box.depth = 1;
-   blit.mask = st_get_blit_mask(strb->Base._BaseFormat, format);
-   blit.filter = PIPE_TEX_FILTER_NEAREST;
-   blit.scissor_enable = FALSE;
+   blit_to_resource(st, strb, invert_y, x, y, width, height, format,
+                    src_format, dst);
 
-   if (invert_y) {
-      blit.src.box.y = strb->Base.Height - blit.src.box.y;
-      blit.src.box.height = -blit.src.box.height;
+   return dst;
+}
+
+/**
+ * Wrap the destination memory (client memory or a mapped PBO) in a texture
+ * and blit the requested region straight into it.  The driver converts the
+ * pixels while it executes the blit, possibly on several threads, and all
+ * that's left for us is waiting on the fence.
+ *
+ * Only possible when the driver lays out such a texture exactly as the
+ * pack parameters lay out the destination.  The texture is exactly as wide
+ * as the region read, so that the driver never touches memory past the end
+ * of a row, which for the last row may be past the end of the destination.
+ */
+static bool
+try_blit_to_user_memory(struct st_context *st, struct st_renderbuffer *strb,
+                        bool invert_y,
+                        GLint x, GLint y, GLsizei width, GLsizei height,
+                        GLenum format, GLenum type,
+                        enum pipe_format src_format,
+                        enum pipe_format dst_format,
+                        const struct gl_pixelstore_attrib *pack,
+                        void *pixels)
+{
+   struct pipe_context *pipe = st->pipe;
+   struct pipe_screen *screen = pipe->screen;
+   const GLint stride = _mesa_image_row_stride(pack, width, format, type);
+   struct pipe_resource dst_templ;
+   struct pipe_resource *dst;
+   struct pipe_transfer *xfer;
+   struct pipe_fence_handle *fence = NULL;
+   void *dest, *map;
+
+   if (stride <= 0)
+      return false;
+
+   dest = _mesa_image_address2d(pack, pixels, width, height, format, type,
+                                0, 0);
+
+   memset(&dst_templ, 0, sizeof(dst_templ));
+   dst_templ.target = PIPE_TEXTURE_2D;
+   dst_templ.format = dst_format;
+   dst_templ.bind = PIPE_BIND_TRANSFER_READ;
+   if (util_format_is_depth_or_stencil(dst_format))
+      dst_templ.bind |= PIPE_BIND_DEPTH_STENCIL;
+   else
+      dst_templ.bind |= PIPE_BIND_RENDER_TARGET;
+   dst_templ.usage = PIPE_USAGE_STAGING;
+   dst_templ.width0 = width;
+   dst_templ.height0 = height;
+   dst_templ.depth0 = 1;
+   dst_templ.array_size = 1;
+
+   dst = screen->resource_from_user_memory(screen, &dst_templ, dest);
+   if (!dst)
+      return false;
+
+   map = pipe_transfer_map(pipe, dst, 0, 0,
+                           PIPE_TRANSFER_READ | PIPE_TRANSFER_UNSYNCHRONIZED,
+                           0, 0, dst_templ.width0, height, &xfer);
+   if (!map) {
+      pipe_resource_reference(&dst, NULL);
+      return false;
    }
+   if (map != dest || xfer->stride != (unsigned) stride) {
+      pipe_transfer_unmap(pipe, xfer);
+      pipe_resource_reference(&dst, NULL);
+      return false;
+   }
+   pipe_transfer_unmap(pipe, xfer);
 
-   /* blit */
-   st->pipe->blit(st->pipe, &blit);
+   blit_to_resource(st, strb, invert_y, x, y, width, height, format,
+                    src_format, dst);
 
-   return dst;
+   pipe->flush(pipe, &fence, 0);
+   screen->fence_finish(screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+   screen->fence_reference(screen, &fence, NULL);
+
+   pipe_resource_reference(&dst, NULL);
+   return true;
 }
 
 static struct pipe_resource *
@@ -414,7 +508,8 @@ st_ReadPixels(struct gl_context *ctx, GLint x, GLint y,
    st_validate_state(st, ST_PIPELINE_RENDER);
    st_flush_bitmap_cache(st);
 
-   if (!st->prefer_blit_based_texture_transfer) {
+   if (!st->prefer_blit_based_texture_transfer &&
+       !st->has_texture_from_user_memory) {
       goto fallback;
    }
 
@@ -477,6 +572,31 @@ st_ReadPixels(struct gl_context *ctx, GLint x, GLint y,
       goto fallback;
    }
 
+   /* If the texture format already matches the format and type, the
+    * memcpy-based fast path is cheaper than any blit.
+    */
+   if (st->has_texture_from_user_memory &&
+       !_mesa_format_matches_format_and_type(rb->Format, format, type,
+                                             pack->SwapBytes, NULL)) {
+      void *dest = _mesa_map_pbo_dest(ctx, pack, pixels);
+      bool done = false;
+
+      if (dest) {
+         done = try_blit_to_user_memory(st, strb,
+                                        st_fb_orientation(ctx->ReadBuffer) ==
+                                        Y_0_TOP,
+                                        x, y, width, height, format, type,
+                                        src_format, dst_format, pack, dest);
+         _mesa_unmap_pbo_dest(ctx, pack);
+      }
+      if (done)
+         return;
+   }
+
+   if (!st->prefer_blit_based_texture_transfer) {
+      goto fallback;
+   }
+
    /* Cache a staging texture for back-to-back ReadPixels, to avoid CPU-GPU
     * synchronization overhead.
     */
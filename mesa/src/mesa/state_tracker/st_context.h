@@ -86,6 +86,7 @@ struct st_context
    boolean has_shareable_shaders;
    boolean has_half_float_packing;
    boolean has_multi_draw_indirect;
+   boolean has_texture_from_user_memory;
 
    /**
     * If a shader can be created when we get its source.
@@ -295,7 +296,7 @@ void st_invalidate_readpix_cache(struct st_context *st);
 static inline GLuint
 st_fb_orientation(const struct gl_framebuffer *fb)
 {
-   if (fb && _mesa_is_winsys_fbo(fb)) {
+   if (fb && _mesa_is_winsys_fbo(fb) && !fb->BottomUp) {
       /* Drawing into a window (on-screen buffer).
        *
        * Negate Y scale to flip image vertically.
@@ -308,7 +309,8 @@ st_fb_orientation(const struct gl_framebuffer *fb)
       return Y_0_TOP;
    }
    else {
-      /* Drawing into user-created FBO (very likely a texture).
+      /* Drawing into user-created FBO (very likely a texture), or into a
+       * window system buffer the winsys stores bottom-up.
        *
        * For textures, T=0=Bottom, so by extension Y=0=Bottom for rendering.
        */
@@ -210,6 +210,13 @@ st_framebuffer_validate(struct st_framebuffer *stfb,
    width = stfb->Base.Width;
    height = stfb->Base.Height;
 
+   if (stfb->Base.BottomUp != stfb->iface->bottom_up) {
+      /* the viewport, scissor, polygon orientation etc. all depend on it */
+      stfb->Base.BottomUp = stfb->iface->bottom_up;
+      st->ctx->NewState |= _NEW_BUFFERS;
+      changed = TRUE;
+   }
+
    for (i = 0; i < stfb->num_statts; i++) {
       struct st_renderbuffer *strb;
       struct pipe_surface *ps, surf_tmpl;
@@ -226,6 +233,7 @@ st_framebuffer_validate(struct st_framebuffer *stfb,
 
       strb = st_renderbuffer(stfb->Base.Attachment[idx].Renderbuffer);
       assert(strb);
+      strb->bottom_up = stfb->iface->bottom_up;
       if (strb->texture == textures[i]) {
          pipe_resource_reference(&textures[i], NULL);
          continue;
@@ -31,6 +31,7 @@
 #include "main/varray.h"
 #include "main/macros.h"
 #include "main/sse_minmax.h"
+#include "main/avx2_minmax.h"
 #include "x86/common_x86_asm.h"
 #include "util/hash_table.h"
 
@@ -39,6 +40,8 @@ struct minmax_cache_key {
    GLintptr offset;
    GLuint count;
    GLenum type;
+   GLboolean restart;
+   GLuint restart_index;
 };
 
 
@@ -60,7 +63,9 @@ static bool
 vbo_minmax_cache_key_equal(const struct minmax_cache_key *a,
                            const struct minmax_cache_key *b)
 {
-   return (a->offset == b->offset) && (a->count == b->count) && (a->type == b->type);
+   return (a->offset == b->offset) && (a->count == b->count) &&
+          (a->type == b->type) && (a->restart == b->restart) &&
+          (a->restart_index == b->restart_index);
 }
 
 
@@ -99,9 +104,25 @@ vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj)
 }
 
 
+static void
+vbo_minmax_cache_key_init(struct minmax_cache_key *key,
+                          GLenum type, GLintptr offset, GLuint count,
+                          GLboolean restart, GLuint restart_index)
+{
+   /* the key is hashed as raw data, so clear the padding */
+   memset(key, 0, sizeof(*key));
+   key->type = type;
+   key->offset = offset;
+   key->count = count;
+   key->restart = restart;
+   key->restart_index = restart ? restart_index : 0;
+}
+
+
 static GLboolean
 vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
                       GLenum type, GLintptr offset, GLuint count,
+                      GLboolean restart, GLuint restart_index,
                       GLuint *min_index, GLuint *max_index)
 {
    GLboolean found = GL_FALSE;
@@ -137,9 +158,8 @@ vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
       goto out_invalidate;
    }
 
-   key.type = type;
-   key.offset = offset;
-   key.count = count;
+   vbo_minmax_cache_key_init(&key, type, offset, count,
+                             restart, restart_index);
    hash = vbo_minmax_cache_hash(&key);
    result = _mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache, hash, &key);
    if (result) {
@@ -174,6 +194,7 @@ static void
 vbo_minmax_cache_store(struct gl_context *ctx,
                        struct gl_buffer_object *bufferObj,
                        GLenum type, GLintptr offset, GLuint count,
+                       GLboolean restart, GLuint restart_index,
                        GLuint min, GLuint max)
 {
    struct minmax_cache_entry *entry;
@@ -198,9 +219,8 @@ vbo_minmax_cache_store(struct gl_context *ctx,
    if (!entry)
       goto out;
 
-   entry->key.offset = offset;
-   entry->key.count = count;
-   entry->key.type = type;
+   vbo_minmax_cache_key_init(&entry->key, type, offset, count,
+                             restart, restart_index);
    entry->min = min;
    entry->max = max;
    hash = vbo_minmax_cache_hash(&entry->key);
@@ -243,17 +263,20 @@ vbo_get_minmax_index(struct gl_context *ctx,
    const GLuint restartIndex = _mesa_primitive_restart_index(ctx, ib->type);
    const int index_size = vbo_sizeof_ib_type(ib->type);
    const char *indices;
+   GLintptr offset = 0;
    GLuint i;
 
    indices = (char *) ib->ptr + prim->start * index_size;
    if (_mesa_is_bufferobj(ib->obj)) {
       GLsizeiptr size = MIN2(count * index_size, ib->obj->Size);
 
-      if (vbo_get_minmax_cached(ib->obj, ib->type, (GLintptr) indices, count,
+      offset = (GLintptr) indices;
+      if (vbo_get_minmax_cached(ib->obj, ib->type, offset, count,
+                                restart, restartIndex,
                                 min_index, max_index))
          return;
 
-      indices = ctx->Driver.MapBufferRange(ctx, (GLintptr) indices, size,
+      indices = ctx->Driver.MapBufferRange(ctx, offset, size,
                                            GL_MAP_READ_BIT, ib->obj,
                                            MAP_INTERNAL);
    }
@@ -263,6 +286,13 @@ vbo_get_minmax_index(struct gl_context *ctx,
       const GLuint *ui_indices = (const GLuint *)indices;
       GLuint max_ui = 0;
       GLuint min_ui = ~0U;
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_uint_array_min_max(ui_indices, &min_ui, &max_ui, count,
+                                       restart, restartIndex);
+      }
+      else
+#endif
       if (restart) {
          for (i = 0; i < count; i++) {
             if (ui_indices[i] != restartIndex) {
@@ -291,6 +321,13 @@ vbo_get_minmax_index(struct gl_context *ctx,
       const GLushort *us_indices = (const GLushort *)indices;
       GLuint max_us = 0;
       GLuint min_us = ~0U;
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_ushort_array_min_max(us_indices, &min_us, &max_us, count,
+                                         restart, restartIndex);
+      }
+      else
+#endif
       if (restart) {
          for (i = 0; i < count; i++) {
             if (us_indices[i] != restartIndex) {
@@ -313,6 +350,13 @@ vbo_get_minmax_index(struct gl_context *ctx,
       const GLubyte *ub_indices = (const GLubyte *)indices;
       GLuint max_ub = 0;
       GLuint min_ub = ~0U;
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_ubyte_array_min_max(ub_indices, &min_ub, &max_ub, count,
+                                        restart, restartIndex);
+      }
+      else
+#endif
       if (restart) {
          for (i = 0; i < count; i++) {
             if (ub_indices[i] != restartIndex) {
@@ -336,7 +380,8 @@ vbo_get_minmax_index(struct gl_context *ctx,
    }
 
    if (_mesa_is_bufferobj(ib->obj)) {
-      vbo_minmax_cache_store(ctx, ib->obj, ib->type, prim->start, count,
+      vbo_minmax_cache_store(ctx, ib->obj, ib->type, offset, count,
+                             restart, restartIndex,
                              *min_index, *max_index);
       ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
    }
@@ -354,6 +354,19 @@ _mesa_get_x86_features(void)
 
       if (ecx & bit_SSE4_1)
          _mesa_x86_cpu_features |= X86_FEATURE_SSE4_1;
+
+      /* AVX2 also needs the OS to save the upper halves of the ymm
+       * registers.
+       */
+      if ((ecx & X86_CPU_OSXSAVE) && __get_cpuid_max(0, NULL) >= 7) {
+         unsigned int xcr0_lo, xcr0_hi;
+
+         __asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+         __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+         if ((xcr0_lo & 0x6) == 0x6 && (ebx & X86_CPU_AVX2))
+            _mesa_x86_cpu_features |= X86_FEATURE_AVX2;
+      }
    }
 #endif /* USE_X86_64_ASM */
 
@@ -44,6 +44,7 @@
 #define X86_FEATURE_3DNOWEXT	(1<<7)
 #define X86_FEATURE_3DNOW	(1<<8)
 #define X86_FEATURE_SSE4_1	(1<<9)
+#define X86_FEATURE_AVX2	(1<<10)
 
 /* standard X86 CPU features */
 #define X86_CPU_FPU		(1<<0)
@@ -53,6 +54,9 @@
 #define X86_CPU_XMM2		(1<<26)
 /* ECX. */
 #define X86_CPU_SSE4_1		(1<<19)
+#define X86_CPU_OSXSAVE		(1<<27)
+/* EBX of leaf 7. */
+#define X86_CPU_AVX2		(1<<5)
 
 /* extended X86 CPU features */
 #define X86_CPUEXT_MMX_EXT	(1<<22)
@@ -93,5 +97,11 @@
 #define cpu_has_sse4_1		(_mesa_x86_cpu_features & X86_FEATURE_SSE4_1)
 #endif
 
+#ifdef __AVX2__
+#define cpu_has_avx2		1
+#else
+#define cpu_has_avx2		(_mesa_x86_cpu_features & X86_FEATURE_AVX2)
+#endif
+
 #endif
 